@@ -0,0 +1,358 @@
+#include "blade.h"
+
+/*
+* the sampling allocation profiler. every interval bytes allocated, the
+* call stack of the allocation is recorded, along with what was allocated
+* (an object type, or a buffer grown through bl_mem_realloc()), and is
+* credited with all the bytes since the previous sample. the sites found
+* are written as folded stacks, one per line:
+*
+*   @.script (main.b:3);build (main.b:12);String 131072
+*
+* which flamegraph.pl and the like take as they are.
+*/
+
+typedef struct AllocSite AllocSite;
+struct AllocSite
+{
+    char* stack;
+    uint32_t hash;
+    size_t bytes;
+};
+
+struct AllocProfile
+{
+    size_t interval;
+    // bytes left to allocate before the next sample
+    size_t left;
+    // open addressed, with NULL stacks for free slots
+    AllocSite* sites;
+    int sitecount;
+    int sitecapacity;
+    // where the stack of a sample is put together
+    char* key;
+    size_t keylength;
+    size_t keycapacity;
+    // written to when profiling stops, if set
+    char* path;
+};
+
+// the vm whose profile is written at exit, if it wasn't stopped before.
+static VMState* bl_profile_exitvm;
+
+static uint32_t bl_profile_hash(const char* key, size_t length)
+{
+    size_t i;
+    uint32_t hash;
+    hash = 2166136261u;
+    for(i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool bl_profile_append(AllocProfile* profile, const char* format, ...)
+{
+    int length;
+    size_t capacity;
+    char* grown;
+    va_list args;
+    while(true)
+    {
+        va_start(args, format);
+        length = vsnprintf(profile->key + profile->keylength, profile->keycapacity - profile->keylength, format, args);
+        va_end(args);
+        if(length < 0)
+        {
+            return false;
+        }
+        if(profile->keylength + length < profile->keycapacity)
+        {
+            profile->keylength += length;
+            return true;
+        }
+        capacity = profile->keycapacity * 2;
+        while(capacity <= profile->keylength + length)
+        {
+            capacity *= 2;
+        }
+        grown = (char*)realloc(profile->key, capacity);
+        if(grown == NULL)
+        {
+            return false;
+        }
+        profile->key = grown;
+        profile->keycapacity = capacity;
+    }
+}
+
+/*
+* the stack of the allocation, outermost frame first. natives have no
+* frame of their own, so what they allocate goes to the line calling them.
+*/
+static bool bl_profile_buildkey(VMState* vm, AllocProfile* profile, int type)
+{
+    int i;
+    int line;
+    size_t instruction;
+    CallFrame* frame;
+    ObjFunction* function;
+    profile->keylength = 0;
+    profile->key[0] = '\0';
+    if(vm->framecount == 0)
+    {
+        // compiling, or setting up the vm.
+        if(!bl_profile_append(profile, "(vm);"))
+        {
+            return false;
+        }
+    }
+    for(i = 0; i < vm->framecount; i++)
+    {
+        frame = &vm->frames[i];
+        function = frame->closure->fnptr;
+        // -1 because the IP is sitting on the next instruction to be executed
+        instruction = frame->ip - function->blob.code;
+        if(instruction > 0)
+        {
+            instruction--;
+        }
+        line = function->blob.count > 0 ? function->blob.lines[instruction] : 0;
+        if(!bl_profile_append(profile, "%s (%s:%d);", function->name == NULL ? "@.script" : function->name->chars, function->module->file, line))
+        {
+            return false;
+        }
+    }
+    return bl_profile_append(profile, "%s", type < 0 ? "(buffer)" : bl_gc_typename((ObjType)type));
+}
+
+static bool bl_profile_growsites(AllocProfile* profile)
+{
+    int i;
+    int slot;
+    int capacity;
+    AllocSite* sites;
+    capacity = profile->sitecapacity == 0 ? 256 : profile->sitecapacity * 2;
+    sites = (AllocSite*)calloc(capacity, sizeof(AllocSite));
+    if(sites == NULL)
+    {
+        return false;
+    }
+    for(i = 0; i < profile->sitecapacity; i++)
+    {
+        if(profile->sites[i].stack != NULL)
+        {
+            slot = (int)(profile->sites[i].hash & (uint32_t)(capacity - 1));
+            while(sites[slot].stack != NULL)
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            sites[slot] = profile->sites[i];
+        }
+    }
+    free(profile->sites);
+    profile->sites = sites;
+    profile->sitecapacity = capacity;
+    return true;
+}
+
+static void bl_profile_record(VMState* vm, AllocProfile* profile, int type, size_t bytes)
+{
+    int slot;
+    uint32_t hash;
+    AllocSite* site;
+    if(!bl_profile_buildkey(vm, profile, type))
+    {
+        return;
+    }
+    if((profile->sitecount + 1) * 2 > profile->sitecapacity && !bl_profile_growsites(profile))
+    {
+        return;
+    }
+    hash = bl_profile_hash(profile->key, profile->keylength);
+    slot = (int)(hash & (uint32_t)(profile->sitecapacity - 1));
+    while(true)
+    {
+        site = &profile->sites[slot];
+        if(site->stack == NULL)
+        {
+            site->stack = strdup(profile->key);
+            if(site->stack == NULL)
+            {
+                return;
+            }
+            site->hash = hash;
+            site->bytes = 0;
+            profile->sitecount++;
+            break;
+        }
+        if(site->hash == hash && strcmp(site->stack, profile->key) == 0)
+        {
+            break;
+        }
+        slot = (slot + 1) & (profile->sitecapacity - 1);
+    }
+    site->bytes += bytes;
+}
+
+/*
+* counts size bytes just allocated for an object of the given type (-1 for
+* a buffer), and samples the allocation if they cross the interval. see
+* bl_object_allocobject() and bl_mem_realloc().
+*/
+void bl_profile_count(VMState* vm, size_t size, int type)
+{
+    size_t samples;
+    AllocProfile* profile;
+    profile = vm->allocprofile;
+    if(size < profile->left)
+    {
+        profile->left -= size;
+        return;
+    }
+    size -= profile->left;
+    samples = 1 + (size / profile->interval);
+    profile->left = profile->interval - (size % profile->interval);
+    bl_profile_record(vm, profile, type, samples * profile->interval);
+}
+
+/*
+* starts sampling every interval bytes, or changes the interval of the
+* profile running already.
+*/
+bool bl_profile_start(VMState* vm, size_t interval)
+{
+    AllocProfile* profile;
+    if(interval == 0)
+    {
+        return false;
+    }
+    profile = vm->allocprofile;
+    if(profile == NULL)
+    {
+        profile = (AllocProfile*)calloc(1, sizeof(AllocProfile));
+        if(profile == NULL)
+        {
+            return false;
+        }
+        profile->keycapacity = 256;
+        profile->key = (char*)malloc(profile->keycapacity);
+        if(profile->key == NULL)
+        {
+            free(profile);
+            return false;
+        }
+        vm->allocprofile = profile;
+    }
+    profile->interval = interval;
+    profile->left = interval;
+    return true;
+}
+
+/*
+* writes the sites sampled so far to path, as folded stacks.
+*/
+bool bl_profile_write(VMState* vm, const char* path)
+{
+    int i;
+    bool ok;
+    FILE* out;
+    AllocProfile* profile;
+    profile = vm->allocprofile;
+    if(profile == NULL)
+    {
+        return false;
+    }
+    out = fopen(path, "w");
+    if(out == NULL)
+    {
+        return false;
+    }
+    for(i = 0; i < profile->sitecapacity; i++)
+    {
+        if(profile->sites[i].stack != NULL)
+        {
+            fprintf(out, "%s %zu\n", profile->sites[i].stack, profile->sites[i].bytes);
+        }
+    }
+    ok = !ferror(out);
+    if(fclose(out) != 0)
+    {
+        ok = false;
+    }
+    return ok;
+}
+
+/*
+* stops sampling, and writes the profile out first if it is to be written
+* at exit.
+*/
+void bl_profile_stop(VMState* vm)
+{
+    int i;
+    AllocProfile* profile;
+    profile = vm->allocprofile;
+    if(profile == NULL)
+    {
+        return;
+    }
+    if(profile->path != NULL)
+    {
+        if(bl_profile_write(vm, profile->path))
+        {
+            fprintf(stderr, "allocation profile written to %s\n", profile->path);
+        }
+        else
+        {
+            fprintf(stderr, "could not write allocation profile %s: %s\n", profile->path, strerror(errno));
+        }
+        free(profile->path);
+    }
+    for(i = 0; i < profile->sitecapacity; i++)
+    {
+        free(profile->sites[i].stack);
+    }
+    free(profile->sites);
+    free(profile->key);
+    free(profile);
+    vm->allocprofile = NULL;
+    if(bl_profile_exitvm == vm)
+    {
+        bl_profile_exitvm = NULL;
+    }
+}
+
+static void bl_profile_atexit(void)
+{
+    if(bl_profile_exitvm != NULL)
+    {
+        bl_profile_stop(bl_profile_exitvm);
+    }
+}
+
+/*
+* has the running profile written to path once the vm is freed, or the
+* process exits, whichever comes first.
+*/
+bool bl_profile_writeatexit(VMState* vm, const char* path)
+{
+    char* copy;
+    if(vm->allocprofile == NULL)
+    {
+        return false;
+    }
+    copy = strdup(path);
+    if(copy == NULL)
+    {
+        return false;
+    }
+    free(vm->allocprofile->path);
+    vm->allocprofile->path = copy;
+    if(bl_profile_exitvm == NULL)
+    {
+        atexit(bl_profile_atexit);
+    }
+    bl_profile_exitvm = vm;
+    return true;
+}
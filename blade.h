@@ -29,6 +29,8 @@
     #include <sys/types.h>
     #include <sys/wait.h>
     #include <sys/time.h>
+    #include <pthread.h>
+    #include <signal.h>
 #endif
 
 #include "xxhash.h"
@@ -54,10 +56,26 @@
 #define NUMBER_FORMAT "%.16g"
 #define MAX_INTERPOLATION_NESTING 8
 #define MAX_EXCEPTION_HANDLERS 16
+// number of receiver classes an inline cache remembers
+#define INLINE_CACHE_WAYS 4
+// instances with more fields than this, or of a class with more shapes than
+// this, fall back to keeping their properties in a hash table
+#define SHAPE_MAX_SLOTS 64
+#define SHAPE_MAX_PER_CLASS 256
+// compiled bytecode cache files. bump the version whenever the opcodes or
+// the layout written by bytecode.c change, so stale caches get recompiled.
+#define BYTECODE_MAGIC "BLDC"
+#define BYTECODE_VERSION 2
+#define BYTECODE_EXTENSION ".blc"
 // Maximum load factor of 12/14
 // see: https://engineering.fb.com/2019/04/25/developer-tools/f14/
 #define TABLE_MAX_LOAD 0.85714286
+// the heap is given at least this much room to grow after a full collection,
+// and at most GC_MAX_HEAP_GROWTH, depending on how much of the run time
+// collections take up.
 #define GC_HEAP_GROWTH_FACTOR 1.25
+#define GC_MAX_HEAP_GROWTH 4.0
+#define GC_DEFAULT_TIME_TARGET 5
 #define HAVE_TERMIOS_H
 #define HAVE_SYS_UTSNAME_H
 #define HAVE_UTIME
@@ -120,6 +138,14 @@
     #define IS_64_BIT 0
 #endif
 
+// pack every Value into a single 64-bit word (NaN-boxing).
+// numbers are stored as-is, everything else lives in the unused space of quiet NaNs.
+// this assumes object pointers fit into 48 bits; build with -DBLADE_NAN_BOXING=0
+// to use the plain tagged union instead.
+#ifndef BLADE_NAN_BOXING
+    #define BLADE_NAN_BOXING 1
+#endif
+
 // --> debug mode options starts here...
 #if DEBUG_MODE == 1
     #define DEBUG_TRACE_EXECUTION 0
@@ -171,6 +197,51 @@
 
 
 #define DEFAULT_GC_START (1024 * 1024)
+// bytes allocated since the last collection that trigger a minor collection
+#if !defined(GC_NURSERY_SIZE)
+    #define GC_NURSERY_SIZE (256 * 1024)
+#endif
+// bytes allocated between two slices of an incremental collection
+#if !defined(GC_STEP_SIZE)
+    #define GC_STEP_SIZE (64 * 1024)
+#endif
+// objects a lazy sweep frees or keeps every GC_STEP_SIZE bytes
+#if !defined(GC_SWEEP_STEP)
+    #define GC_SWEEP_STEP 4096
+#endif
+// full collections of a heap at least this big trace it with several threads
+#if !defined(GC_PARALLEL_MIN_HEAP)
+    #define GC_PARALLEL_MIN_HEAP (8 * 1024 * 1024)
+#endif
+#define GC_MAX_MARKERS 64
+// pauses are counted in buckets of powers of two microseconds: bucket i holds
+// the ones shorter than 2^i, and the last one everything longer.
+#define GC_PAUSE_BUCKETS 24
+// the allocation profiler samples once every this many bytes by default
+#define ALLOC_SAMPLE_INTERVAL (64 * 1024)
+// + makes a rope rather than copying both strings when the result is at
+// least this many bytes long
+#if !defined(ROPE_MIN_LENGTH)
+    #define ROPE_MIN_LENGTH 256
+#endif
+// the first buffer a string builder grows to; it doubles from there
+#define STRBUILDER_MIN_CAPACITY 64
+// gc objects up to SLAB_MAX_SIZE bytes are carved out of pages of
+// SLAB_PAGE_SIZE bytes, one size class every SLAB_GRANULE bytes.
+// define BLADE_NO_SLAB to malloc every object instead (for memory checkers).
+#define SLAB_PAGE_SIZE (64 * 1024)
+#define SLAB_GRANULE 16
+#define SLAB_MAX_SIZE 256
+#define SLAB_CLASS_COUNT (SLAB_MAX_SIZE / SLAB_GRANULE)
+// a string whose chars fit in a slab object along with it has them stored
+// right after it; longer ones get a buffer of their own.
+#define STRING_INLINE_FITS(length) (sizeof(ObjString) + (size_t)(length) + 1 <= SLAB_MAX_SIZE)
+// one mark bit per granule of a page, kept in the page header rather than in the
+// objects, so that marking doesn't write to (and unshare, after a fork) their pages.
+#define SLAB_MARK_WORDS (SLAB_PAGE_SIZE / SLAB_GRANULE / 64)
+// objects larger than SLAB_MAX_SIZE get a page (or more) of their own.
+#define SLAB_CLASS_LARGE (-1)
+#define SLAB_PAGE_OF(pointer) ((SlabPage*)((uintptr_t)(pointer) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1)))
 #define EXIT_COMPILE 10
 #define EXIT_RUNTIME 11
 #define EXIT_TERMINAL 12
@@ -296,20 +367,48 @@
 #define GC_STRING(o) OBJ_VAL(bl_mem_gcprotect(vm, (Object*)bl_string_copystringlen(vm, (const char*)(o), (int)strlen(o))))
 #define GC_L_STRING(o, l) OBJ_VAL(bl_mem_gcprotect(vm, (Object*)bl_string_copystringlen(vm, (const char*)(o), (l))))
 
-// promote C values to blade value
-#define EMPTY_VAL ((Value){ VAL_EMPTY, { .number = 0 } })
-#define NIL_VAL ((Value){ VAL_NIL, { .number = 0 } })
-#define TRUE_VAL ((Value){ VAL_BOOL, { .boolean = true } })
-#define FALSE_VAL ((Value){ VAL_BOOL, { .boolean = false } })
-#define BOOL_VAL(v) ((Value){ VAL_BOOL, { .boolean = (v) } })
-#define NUMBER_VAL(v) ((Value){ VAL_NUMBER, { .number = (double)(v) } })
-#define INTEGER_VAL(v) ((Value){ VAL_NUMBER, { .number = (double)(v) } })
-#define OBJ_VAL(v) ((Value){ VAL_OBJ, { .obj = (Object*)(v) } })
-
-// demote blade values to C value
-#define AS_BOOL(v) ((v).as.boolean)
-#define AS_NUMBER(v) ((v).as.number)
-#define AS_OBJ(v) ((v).as.obj)
+#if BLADE_NAN_BOXING
+    // a value is a number unless all of the quiet NaN bits are set.
+    // objects additionally set the sign bit and keep their pointer in the low 48 bits,
+    // the singletons (nil, false, true, empty) are tagged in the low bits.
+    #define VALUE_SIGN_BIT ((uint64_t)0x8000000000000000)
+    #define VALUE_QNAN ((uint64_t)0x7ffc000000000000)
+    #define VALUE_CANONICAL_NAN ((uint64_t)0x7ff8000000000000)
+    #define VALUE_TAG_NIL 1
+    #define VALUE_TAG_FALSE 2
+    #define VALUE_TAG_TRUE 3
+    #define VALUE_TAG_EMPTY 4
+
+    // promote C values to blade value
+    #define EMPTY_VAL ((Value){ VALUE_QNAN | VALUE_TAG_EMPTY })
+    #define NIL_VAL ((Value){ VALUE_QNAN | VALUE_TAG_NIL })
+    #define TRUE_VAL ((Value){ VALUE_QNAN | VALUE_TAG_TRUE })
+    #define FALSE_VAL ((Value){ VALUE_QNAN | VALUE_TAG_FALSE })
+    #define BOOL_VAL(v) ((Value){ VALUE_QNAN | ((v) ? VALUE_TAG_TRUE : VALUE_TAG_FALSE) })
+    #define NUMBER_VAL(v) bl_value_fromnumber((double)(v))
+    #define INTEGER_VAL(v) bl_value_fromnumber((double)(v))
+    #define OBJ_VAL(v) ((Value){ VALUE_SIGN_BIT | VALUE_QNAN | (uint64_t)(uintptr_t)(v) })
+
+    // demote blade values to C value
+    #define AS_BOOL(v) ((v).raw == (VALUE_QNAN | VALUE_TAG_TRUE))
+    #define AS_NUMBER(v) bl_value_tonumber(v)
+    #define AS_OBJ(v) ((Object*)(uintptr_t)((v).raw & ~(VALUE_SIGN_BIT | VALUE_QNAN)))
+#else
+    // promote C values to blade value
+    #define EMPTY_VAL ((Value){ VAL_EMPTY, { .number = 0 } })
+    #define NIL_VAL ((Value){ VAL_NIL, { .number = 0 } })
+    #define TRUE_VAL ((Value){ VAL_BOOL, { .boolean = true } })
+    #define FALSE_VAL ((Value){ VAL_BOOL, { .boolean = false } })
+    #define BOOL_VAL(v) ((Value){ VAL_BOOL, { .boolean = (v) } })
+    #define NUMBER_VAL(v) ((Value){ VAL_NUMBER, { .number = (double)(v) } })
+    #define INTEGER_VAL(v) ((Value){ VAL_NUMBER, { .number = (double)(v) } })
+    #define OBJ_VAL(v) ((Value){ VAL_OBJ, { .obj = (Object*)(v) } })
+
+    // demote blade values to C value
+    #define AS_BOOL(v) ((v).as.boolean)
+    #define AS_NUMBER(v) ((v).as.number)
+    #define AS_OBJ(v) ((v).as.obj)
+#endif
 
 // testing blade value types
 
@@ -317,6 +416,7 @@
 #define GROW_ARRAY(type, sztype, pointer, oldcount, newcount) (type*)bl_mem_growarray(vm, pointer, sztype, oldcount, newcount)
 #define FREE_ARRAY(type, pointer, oldcount) bl_mem_free(vm, pointer, sizeof(type) * (oldcount))
 #define FREE(type, pointer) bl_mem_free(vm, pointer, sizeof(type))
+#define FREE_OBJ(type, pointer) bl_mem_freeobjectmem(vm, pointer, sizeof(type))
 #define ALLOCATE(type, count) (type*)bl_mem_realloc(vm, NULL, 0, sizeof(type) * (count))
 #define STRING_VAL(val) OBJ_VAL(bl_string_copystringlen(vm, val, (int)strlen(val)))
 #define STRING_L_VAL(val, l) OBJ_VAL(bl_string_copystringlen(vm, val, l))
@@ -324,7 +424,7 @@
 #define OBJ_TYPE(v) (AS_OBJ(v)->type)
 
 // promote Value to object
-#define AS_STRING(v) ((ObjString*)AS_OBJ(v))
+#define AS_STRING(v) bl_string_flat((ObjString*)AS_OBJ(v))
 #define AS_NATIVE(v) ((ObjNativeFunction*)AS_OBJ(v))
 #define AS_FUNCTION(v) ((ObjFunction*)AS_OBJ(v))
 #define AS_CLOSURE(v) ((ObjClosure*)AS_OBJ(v))
@@ -340,13 +440,14 @@
 
 // containers
 #define AS_BYTES(v) ((ObjBytes*)AS_OBJ(v))
+#define AS_STRBUILDER(v) ((ObjStringBuilder*)AS_OBJ(v))
 #define AS_LIST(v) ((ObjArray*)AS_OBJ(v))
 #define AS_DICT(v) ((ObjDict*)AS_OBJ(v))
 #define AS_FILE(v) ((ObjFile*)AS_OBJ(v))
 #define AS_RANGE(v) ((ObjRange*)AS_OBJ(v))
 
 // demote blade value to c string
-#define AS_C_STRING(v) (((ObjString*)AS_OBJ(v))->chars)
+#define AS_C_STRING(v) (AS_STRING(v)->chars)
 
 #define IS_CHAR(v) (bl_value_isstring(v) && (AS_STRING(v)->length == 1 || AS_STRING(v)->length == 0))
 
@@ -401,6 +502,11 @@
         args[-1] = OBJ_VAL(bl_string_takestring(vm, v, l)); \
         return true; \
     }
+#define RETURN_U_STRING(v, l) \
+    { \
+        args[-1] = OBJ_VAL(bl_string_takeuninterned(vm, v, l)); \
+        return true; \
+    }
 #define RETURN_TT_STRING(v) \
     { \
         args[-1] = OBJ_VAL(bl_string_takestring(vm, v, (int)strlen(v))); \
@@ -500,6 +606,39 @@ enum OpCode
     OP_STRINGIFY,
     OP_SWITCH,
     OP_CHOICE,
+    // quickened forms of the arithmetic and comparison instructions.
+    // the compiler never emits these; the vm rewrites an instruction into
+    // its _NUM form in place after seeing two numbers at that site.
+    OP_ADD_NUM,
+    OP_SUBTRACT_NUM,
+    OP_MULTIPLY_NUM,
+    OP_DIVIDE_NUM,
+    OP_EQUAL_NUM,
+    OP_GREATERTHAN_NUM,
+    OP_LESSTHAN_NUM,
+    // the generic forms a site settles into once its _NUM form has seen
+    // something other than two numbers. they never quicken again, so a site
+    // that sees both numbers and other values does not keep rewriting itself.
+    OP_ADD_ANY,
+    OP_SUBTRACT_ANY,
+    OP_MULTIPLY_ANY,
+    OP_DIVIDE_ANY,
+    OP_EQUAL_ANY,
+    OP_GREATERTHAN_ANY,
+    OP_LESSTHAN_ANY,
+    // short forms and superinstructions.
+    // these are only produced by the peephole pass that runs when a function
+    // has been compiled (see bl_compiler_optimize() in parser.c).
+    OP_GET_LOCAL_0,
+    OP_GET_LOCAL_1,
+    OP_GET_LOCAL_2,
+    OP_GET_LOCAL_3,
+    OP_SET_LOCAL_POP,// set local, then pop
+    OP_CONSTANT_SMALLINT,// 8-bit unsigned integer operand
+    OP_POP_JUMP_IF_FALSE,// pop the condition, then jump if it was false
+    OP_EQUAL_JUMP,// compare, pop both operands, jump if not equal
+    OP_GREATERTHAN_JUMP,
+    OP_LESSTHAN_JUMP,
     // the break placeholder... it never gets to the vm
     // care should be taken to
     OP_BREAK_PL,
@@ -524,6 +663,7 @@ enum ObjType
     OBJ_DICT,
     OBJ_FILE,
     OBJ_BYTES,
+    OBJ_STRBUILDER,
     // base object types
     OBJ_UP_VALUE,
     OBJ_BOUNDFUNCTION,
@@ -538,6 +678,7 @@ enum ObjType
     OBJ_SWITCH,
     OBJ_PTR,// object type that can hold any C pointer
 };
+#define OBJ_TYPE_COUNT (OBJ_PTR + 1)
 
 enum TokType
 {
@@ -650,6 +791,13 @@ enum PtrResult
     PTR_RUNTIME_ERR,
 };
 
+enum GCPhase
+{
+    GC_PHASE_IDLE,
+    GC_PHASE_MARK,
+    GC_PHASE_SWEEP,
+};
+
 
 enum AstPrecedence
 {
@@ -678,6 +826,7 @@ typedef enum OpCode OpCode;
 typedef enum FuncType FuncType;
 typedef enum ObjType ObjType;
 typedef enum PtrResult PtrResult;
+typedef enum GCPhase GCPhase;
 typedef enum TokType TokType;
 typedef enum AstPrecedence AstPrecedence;
 typedef enum ValType ValType;
@@ -685,6 +834,7 @@ typedef struct Value Value;
 typedef struct AstCompiler AstCompiler;
 typedef struct Object Object;
 typedef struct ObjString ObjString;
+typedef struct ObjRope ObjRope;
 typedef struct VMState VMState;
 typedef struct RegModule RegModule;
 typedef struct RegFunc RegFunc;
@@ -692,6 +842,7 @@ typedef struct RegField RegField;
 typedef struct RegClass RegClass;
 typedef struct ValArray ValArray;
 typedef struct ByteArray ByteArray;
+typedef struct StringBuilder StringBuilder;
 typedef struct BinaryBlob BinaryBlob;
 typedef struct HashEntry HashEntry;
 typedef struct HashTable HashTable;
@@ -706,12 +857,17 @@ typedef struct ObjNativeFunction ObjNativeFunction;
 typedef struct ObjArray ObjArray;
 typedef struct ObjRange ObjRange;
 typedef struct ObjBytes ObjBytes;
+typedef struct ObjStringBuilder ObjStringBuilder;
 typedef struct ObjDict ObjDict;
 typedef struct ObjFile ObjFile;
 typedef struct ObjSwitch ObjSwitch;
 typedef struct ObjPointer ObjPointer;
 typedef struct ExceptionFrame ExceptionFrame;
 typedef struct CallFrame CallFrame;
+typedef struct InlineCacheEntry InlineCacheEntry;
+typedef struct Shape Shape;
+typedef struct InlineCache InlineCache;
+typedef struct GlobalCache GlobalCache;
 typedef struct AstToken AstToken;
 typedef struct AstScanner AstScanner;
 typedef struct AstLocal AstLocal;
@@ -722,6 +878,11 @@ typedef struct AstRule AstRule;
 typedef struct DynArray DynArray;
 typedef struct BProcess BProcess;
 typedef struct BProcessShared BProcessShared;
+typedef struct SlabPage SlabPage;
+typedef struct SlabClass SlabClass;
+typedef struct GCFreer GCFreer;
+typedef struct HeapSnapshot HeapSnapshot;
+typedef struct AllocProfile AllocProfile;
 typedef Value (*ClassFieldFunc)(VMState*);
 typedef void (*ModLoaderFunc)(VMState*);
 typedef RegModule* (*ModInitFunc)(VMState*);
@@ -731,6 +892,59 @@ typedef void (*bparseprefixfn)(AstParser*, bool);
 typedef void (*bparseinfixfn)(AstParser*, AstToken, bool);
 typedef double(*VMBinaryCallbackFn)(double, double);
 
+#if BLADE_NAN_BOXING
+struct Value
+{
+    uint64_t raw;
+};
+
+static inline Value bl_value_fromnumber(double num)
+{
+    Value v;
+    memcpy(&v.raw, &num, sizeof(double));
+    if(num != num)
+    {
+        // NaNs lose their payload (but keep their sign), so no bit pattern can pass for a tagged value.
+        v.raw = VALUE_CANONICAL_NAN | (v.raw & VALUE_SIGN_BIT);
+    }
+    return v;
+}
+
+static inline double bl_value_tonumber(Value v)
+{
+    double num;
+    memcpy(&num, &v.raw, sizeof(double));
+    return num;
+}
+
+// primitive type checks.
+// they guard nearly every instruction, so they are inlined rather than living in value.c.
+static inline bool bl_value_isnil(Value v)
+{
+    return (v.raw == NIL_VAL.raw);
+}
+
+static inline bool bl_value_isbool(Value v)
+{
+    // false and true only differ in the lowest bit
+    return ((v.raw | 1) == TRUE_VAL.raw);
+}
+
+static inline bool bl_value_isnumber(Value v)
+{
+    return ((v.raw & VALUE_QNAN) != VALUE_QNAN);
+}
+
+static inline bool bl_value_isobject(Value v)
+{
+    return ((v.raw & (VALUE_QNAN | VALUE_SIGN_BIT)) == (VALUE_QNAN | VALUE_SIGN_BIT));
+}
+
+static inline bool bl_value_isempty(Value v)
+{
+    return (v.raw == EMPTY_VAL.raw);
+}
+#else
 struct Value
 {
     ValType type;
@@ -743,6 +957,34 @@ struct Value
     } as;
 };
 
+// primitive type checks.
+// they guard nearly every instruction, so they are inlined rather than living in value.c.
+static inline bool bl_value_isnil(Value v)
+{
+    return ((v).type == VAL_NIL);
+}
+
+static inline bool bl_value_isbool(Value v)
+{
+    return ((v).type == VAL_BOOL);
+}
+
+static inline bool bl_value_isnumber(Value v)
+{
+    return ((v).type == VAL_NUMBER);
+}
+
+static inline bool bl_value_isobject(Value v)
+{
+    return ((v).type == VAL_OBJ);
+}
+
+static inline bool bl_value_isempty(Value v)
+{
+    return ((v).type == VAL_EMPTY);
+}
+#endif
+
 struct RegFunc
 {
     const char* name;
@@ -787,6 +1029,53 @@ struct ByteArray
     unsigned char* bytes;
 };
 
+/*
+* a growable buffer strings are put together in (see strbuilder.c). chars
+* is kept NUL terminated, and is NULL until something is appended.
+*/
+struct StringBuilder
+{
+    char* chars;
+    size_t length;
+    size_t capacity;
+};
+
+struct InlineCacheEntry
+{
+    // the receiver's shape for instances, its class for anything else
+    const void* key;
+    // vm->methodepoch at the time the entry was filled
+    uint32_t epoch;
+    // version of the class the lookup was made in (see ObjClass)
+    uint32_t version;
+    // slot of an instance field, or -1 if value holds the result
+    int slot;
+    // true if value is a native field that still has to be called
+    bool isfield;
+    // shape of the instance after a property store
+    Shape* newshape;
+    Value value;
+};
+
+// per call site cache of property and method lookups
+struct InlineCache
+{
+    // the entry that gets replaced next
+    int next;
+    InlineCacheEntry entries[INLINE_CACHE_WAYS];
+};
+
+// per site cache of where a global variable was found
+struct GlobalCache
+{
+    // index into the table's entries, or -1 if nothing is cached
+    int index;
+    // whether the entry lives in vm->globals rather than the module
+    bool inglobals;
+    // vm->globalsepoch when a vm->globals entry was cached
+    uint32_t epoch;
+};
+
 struct BinaryBlob
 {
     int count;
@@ -794,6 +1083,12 @@ struct BinaryBlob
     uint8_t* code;
     int* lines;
     ValArray constants;
+    int cachecount;
+    int cachecapacity;
+    InlineCache* caches;
+    int globalcachecount;
+    int globalcachecapacity;
+    GlobalCache* globalcaches;
 };
 
 struct HashEntry
@@ -812,8 +1107,13 @@ struct HashTable
 struct Object
 {
     ObjType type;
+#if defined(BLADE_NO_SLAB)
     bool mark;
+#endif
     bool definitelyreal;
+    // survived a collection; only traced by a minor collection when remembered
+    bool old;
+    bool remembered;
     Object* sibling;
 };
 
@@ -821,12 +1121,39 @@ struct ObjString
 {
     Object obj;
     int length;
+    // -1 until bl_string_utf8length() counts it
     int utf8length;
+    // only ever true once the string is known to be all ASCII; counting
+    // its code points finds out (see bl_string_utf8length()).
     bool isascii;
+    // allocated as an ObjRope
+    bool isrope;
+    // in vm->strings, and thus the one string with these chars that is.
+    // strings made from data at run time are not, until they become keys.
+    bool isinterned;
+    // false until bl_string_gethash() computes hash. interned strings have it.
+    bool ishashed;
     uint32_t hash;
+    // right after the string when it is short enough (see
+    // STRING_INLINE_FITS), a buffer of its own otherwise.
     char* chars;
 };
 
+/*
+* what + makes of two strings when the result is too long to be worth
+* copying (see ROPE_MIN_LENGTH). its chars are only put together once
+* something needs them (see bl_string_flatten()): until then chars is NULL
+* and left and right are the two halves, which are let go afterwards.
+*/
+struct ObjRope
+{
+    ObjString string;
+    ObjString* left;
+    ObjString* right;
+    // flattening may happen where no vm is at hand (hashing, equality).
+    VMState* vm;
+};
+
 struct ObjUpvalue
 {
     Object obj;
@@ -842,6 +1169,10 @@ struct ObjModule
     HashTable values;
     char* name;
     char* file;
+    // what an import statement asked for (and whether relative to the
+    // importing file), which resolved to file. see bytecode.c.
+    char* importpath;
+    bool importrelative;
     void* preloader;
     void* unloader;
     void* handle;
@@ -867,6 +1198,23 @@ struct ObjClosure
     ObjUpvalue** upvalues;
 };
 
+/*
+* instances of a class that got the same properties added in the same order
+* share a shape, and keep the values at the same indices of their slots.
+* shapes form a transition tree per class and are freed along with it.
+*/
+struct Shape
+{
+    Shape* parent;
+    // first shape derived from this one, and the next one derived from parent
+    Shape* children;
+    Shape* sibling;
+    // property added by the transition from parent, NULL for the root
+    ObjString* name;
+    // number of slots; the property added by this shape lives at count - 1
+    int count;
+};
+
 struct ObjClass
 {
     Object obj;
@@ -876,12 +1224,26 @@ struct ObjClass
     HashTable methods;
     ObjString* name;
     ObjClass* superclass;
+    Shape* rootshape;
+    // shape of a freshly made instance, holding the default properties
+    Shape* initshape;
+    int shapecount;
+    // largest slot count seen on an instance, used to size new ones
+    int slothint;
+    // bumped whenever its methods or properties change; inline cache
+    // entries made at an older version are ignored.
+    uint32_t version;
 };
 
 struct ObjInstance
 {
     Object obj;
-    HashTable properties;
+    // NULL once the instance fell back to dictionary mode
+    Shape* shape;
+    Value* slots;
+    int slotcapacity;
+    // only allocated in dictionary mode
+    HashTable* properties;
     ObjClass* klass;
 };
 
@@ -920,6 +1282,12 @@ struct ObjBytes
     ByteArray bytes;
 };
 
+struct ObjStringBuilder
+{
+    Object obj;
+    StringBuilder builder;
+};
+
 struct ObjDict
 {
     Object obj;
@@ -968,6 +1336,37 @@ struct CallFrame
     ExceptionFrame handlers[MAX_EXCEPTION_HANDLERS];
 };
 
+/*
+* the header at the start of every (SLAB_PAGE_SIZE aligned) slab page.
+* pages with free slots are also kept on their class' available list.
+*/
+struct SlabPage
+{
+    SlabPage* next;
+    SlabPage* prev;
+    SlabPage* availnext;
+    SlabPage* availprev;
+    bool isavailable;
+    int sizeclass;
+    int used;
+    int capacity;
+    // slots freed by the gc, then the never used ones from bump onwards
+    void* freelist;
+    char* bump;
+    // the whole mapping, for large objects
+    size_t mapsize;
+    uint64_t marks[SLAB_MARK_WORDS];
+};
+
+struct SlabClass
+{
+    size_t size;
+    int pagecount;
+    size_t used;
+    SlabPage* pages;
+    SlabPage* available;
+};
+
 struct VMState
 {
     bool allowgc;
@@ -979,7 +1378,9 @@ struct VMState
     Value* stacktop;
     ObjUpvalue* openupvalues;
     size_t objectcount;
+    // old objects. new ones go to younglinks until they survive a collection.
     Object* objectlinks;
+    Object* younglinks;
     AstCompiler* compiler;
     ObjClass* exceptionclass;
     // gc
@@ -989,6 +1390,70 @@ struct VMState
     Object** graystack;
     size_t bytesallocated;
     size_t nextgc;
+    // bytes allocated since the last collection of either kind
+    size_t youngbytes;
+    bool gcisminor;
+    // old objects that may have been given a reference to a young one
+    int remembercount;
+    int remembercapacity;
+    Object** rememberset;
+    // incremental collection. a pause budget of 0 collects everything at once.
+    GCPhase gcphase;
+    int gcpausebudget;
+    size_t gcstepbytes;
+    // old objects still to be swept, and the survivors swept so far
+    Object* sweeplinks;
+    Object* sweptfirst;
+    Object* sweptlast;
+    SlabClass slabs[SLAB_CLASS_COUNT];
+    // threads tracing a large heap in a full collection. 1 keeps it on the vm's own thread.
+    int gcmarkers;
+    // frees what a sweep releases on a background thread, when set.
+    GCFreer* gcfreer;
+    bool gcsweeping;
+    // heap sizing (see bl_mem_resizeheap()). the limits are in bytes, the
+    // target in percent of the run time; a target of 0 keeps the growth fixed.
+    size_t gcminheap;
+    size_t gcsoftlimit;
+    int gctimetarget;
+    double gcgrowth;
+    double gcsurvival;
+    double gctimeshare;
+    // the full collection in progress: heap size and time spent so far
+    size_t gcheapbefore;
+    size_t gcfreed;
+    int64_t gctime;
+    int64_t gclastcycle;
+    // telemetry, read by the _gc module. pauses are in microseconds.
+    bool gcdisabled;
+    size_t gccollections;
+    size_t gcminorcollections;
+    // slices an incremental collection marked in (see bl_mem_gcstep())
+    size_t gcmarkslices;
+    // full collections traced by several threads (see bl_mem_paralleltrace())
+    size_t gcparalleltraces;
+    // slices old objects were swept in after a collection (see bl_mem_gcstep()),
+    // and batches of memory handed over to the background freer
+    size_t gcsweepslices;
+    size_t gcfreedbatches;
+    int64_t gcpausetotal;
+    int64_t gcpausemax;
+    size_t gcpausehistogram[GC_PAUSE_BUCKETS];
+    // objects allocated and not yet freed, and their size, by type
+    size_t gctypecount[OBJ_TYPE_COUNT];
+    size_t gctypebytes[OBJ_TYPE_COUNT];
+    // set while a collection writes a heap snapshot (see heapsnap.c), and
+    // by a SIGUSR2 asking for one.
+    HeapSnapshot* heapsnapshot;
+    volatile sig_atomic_t snapshotrequested;
+    // the sampling allocation profiler (see allocprof.c), when running.
+    AllocProfile* allocprofile;
+    // bumped whenever a class is freed, as a new class or shape may reuse its
+    // address; inline cache entries from an older epoch are ignored.
+    uint32_t methodepoch;
+    // bumped whenever a name is added to a module; a module name shadows
+    // vm->globals, so cached vm->globals entries from older epochs are ignored.
+    uint32_t globalsepoch;
     // objects tracker
     HashTable modules;
     HashTable strings;
@@ -1000,6 +1465,7 @@ struct VMState
     ObjClass* classobjdict;
     ObjClass* classobjfile;
     ObjClass* classobjbytes;
+    ObjClass* classobjstrbuilder;
     ObjClass* classobjrange;
     ObjClass* classobjmath;
     char** stdargs;
@@ -1009,6 +1475,9 @@ struct VMState
     // for switching through the command line args...
     bool shoulddebugstack;
     bool shouldprintbytecode;
+    // bytecode cache; a NULL directory keeps cache files next to their source.
+    bool shouldcachebytecode;
+    char* bytecodecachedir;
 };
 
 struct AstToken
@@ -1052,6 +1521,14 @@ struct AstCompiler
     Upvalue upvalues[UINT8_COUNT];
     int scopedepth;
     int handlercount;
+    // maps strings and numbers to their index in the constant pool,
+    // so that repeated identifiers and literals share one slot.
+    HashTable constants;
+    // the last constant pushed, [conststart, constend) in the code,
+    // so that operators over known values can be folded.
+    int conststart;
+    int constend;
+    Value constvalue;
 };
 
 struct AstClassCompiler
@@ -1112,4 +1589,105 @@ struct BProcessShared
 
 #include "prot.inc"
 
+/*
+* the string, with its chars put together if it is a rope. nothing is
+* collected on the way.
+*/
+static inline ObjString* bl_string_flat(ObjString* string)
+{
+    if(string->chars == NULL)
+    {
+        bl_string_flatten(string);
+    }
+    return string;
+}
 
+static inline uint32_t bl_string_gethash(ObjString* string)
+{
+    if(!string->ishashed)
+    {
+        bl_string_flat(string);
+        string->hash = bl_util_hashstring(string->chars, string->length);
+        string->ishashed = true;
+    }
+    return string->hash;
+}
+
+static inline int bl_string_utf8length(ObjString* string)
+{
+    bool isascii;
+    if(string->utf8length < 0)
+    {
+        string->utf8length = bl_util_utf8count(bl_string_flat(string)->chars, string->length, &isascii);
+        if(isascii)
+        {
+            string->isascii = true;
+        }
+    }
+    return string->utf8length;
+}
+
+static inline bool bl_mem_ismarked(Object* object)
+{
+#if defined(BLADE_NO_SLAB)
+    return __atomic_load_n(&object->mark, __ATOMIC_RELAXED);
+#else
+    size_t bit;
+    SlabPage* page;
+    page = SLAB_PAGE_OF(object);
+    bit = ((uintptr_t)object - (uintptr_t)page) / SLAB_GRANULE;
+    return (__atomic_load_n(&page->marks[bit / 64], __ATOMIC_RELAXED) >> (bit % 64)) & 1;
+#endif
+}
+
+/*
+* sets the mark, returning false if another thread beat us to it.
+*/
+static inline bool bl_mem_trysetmarked(Object* object)
+{
+#if defined(BLADE_NO_SLAB)
+    return !__atomic_exchange_n(&object->mark, true, __ATOMIC_RELAXED);
+#else
+    size_t bit;
+    uint64_t mask;
+    SlabPage* page;
+    page = SLAB_PAGE_OF(object);
+    bit = ((uintptr_t)object - (uintptr_t)page) / SLAB_GRANULE;
+    mask = (uint64_t)1 << (bit % 64);
+    return (__atomic_fetch_or(&page->marks[bit / 64], mask, __ATOMIC_RELAXED) & mask) == 0;
+#endif
+}
+
+static inline void bl_mem_setmarked(Object* object, bool mark)
+{
+#if defined(BLADE_NO_SLAB)
+    object->mark = mark;
+#else
+    size_t bit;
+    SlabPage* page;
+    page = SLAB_PAGE_OF(object);
+    bit = ((uintptr_t)object - (uintptr_t)page) / SLAB_GRANULE;
+    if(mark)
+    {
+        page->marks[bit / 64] |= ((uint64_t)1 << (bit % 64));
+    }
+    else
+    {
+        page->marks[bit / 64] &= ~((uint64_t)1 << (bit % 64));
+    }
+#endif
+}
+
+/*
+* must follow any store of a reference into an object that may be old,
+* once nothing can allocate (and thus collect) before the next store.
+* while an incremental collection is marking, every written object is
+* remembered so that it gets traced again before the sweep.
+*/
+static inline void bl_mem_writebarrier(VMState* vm, Object* object)
+{
+    if((object->old || vm->gcphase == GC_PHASE_MARK) && !object->remembered)
+    {
+        bl_mem_remember(vm, object);
+    }
+}
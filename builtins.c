@@ -113,6 +113,18 @@ static bool cfn_bytes(VMState* vm, int argcount, Value* args)
     RETURN_ERROR("expected bytes size or bytes list as argument");
 }
 
+/**
+ * string_builder()
+ *
+ * returns an empty StringBuilder, for putting a string together piece by
+ * piece without copying it all over on every append.
+ */
+static bool cfn_stringbuilder(VMState* vm, int argcount, Value* args)
+{
+    ENFORCE_ARG_COUNT(string_builder, 0);
+    RETURN_OBJ(bl_object_makestrbuilder(vm));
+}
+
 /**
  * time()
  *
@@ -170,7 +182,7 @@ static bool cfn_hasprop(VMState* vm, int argcount, Value* args)
     ENFORCE_ARG_TYPE(hasprop, 1, bl_value_isstring);
     ObjInstance* instance = AS_INSTANCE(args[0]);
     Value dummy;
-    RETURN_BOOL(bl_hashtable_get(&instance->properties, args[1], &dummy));
+    RETURN_BOOL(bl_instance_getfield(instance, AS_STRING(args[1]), &dummy));
 }
 
 /**
@@ -187,7 +199,7 @@ static bool cfn_getprop(VMState* vm, int argcount, Value* args)
     ENFORCE_ARG_TYPE(getprop, 1, bl_value_isstring);
     ObjInstance* instance = AS_INSTANCE(args[0]);
     Value value;
-    if(bl_hashtable_get(&instance->properties, args[1], &value) || bl_hashtable_get(&instance->klass->methods, args[1], &value))
+    if(bl_instance_getfield(instance, AS_STRING(args[1]), &value) || bl_hashtable_get(&instance->klass->methods, args[1], &value))
     {
         RETURN_VALUE(value);
     }
@@ -209,7 +221,7 @@ static bool cfn_setprop(VMState* vm, int argcount, Value* args)
     ENFORCE_ARG_TYPE(setprop, 0, bl_value_isinstance);
     ENFORCE_ARG_TYPE(setprop, 1, bl_value_isstring);
     ObjInstance* instance = AS_INSTANCE(args[0]);
-    RETURN_BOOL(bl_hashtable_set(vm, &instance->properties, args[1], args[2]));
+    RETURN_BOOL(bl_instance_setfield(vm, instance, AS_STRING(args[1]), args[2]));
 }
 
 /**
@@ -224,7 +236,7 @@ static bool cfn_delprop(VMState* vm, int argcount, Value* args)
     ENFORCE_ARG_TYPE(delprop, 0, bl_value_isinstance);
     ENFORCE_ARG_TYPE(delprop, 1, bl_value_isstring);
     ObjInstance* instance = AS_INSTANCE(args[0]);
-    RETURN_BOOL(bl_hashtable_delete(&instance->properties, args[1]));
+    RETURN_BOOL(bl_instance_deletefield(vm, instance, AS_STRING(args[1])));
 }
 
 /**
@@ -407,8 +419,14 @@ static bool cfn_tostring(VMState* vm, int argcount, Value* args)
 {
     ENFORCE_ARG_COUNT(to_string, 1);
     METHOD_OVERRIDE(to_string, 9);
-    char* result = bl_value_tostring(vm, args[0]);
-    RETURN_TT_STRING(result);
+    if(bl_value_isstring(args[0]))
+    {
+        RETURN_VALUE(args[0]);
+    }
+    StringBuilder sb;
+    bl_builder_init(&sb);
+    bl_builder_appendvalue(vm, &sb, args[0]);
+    RETURN_OBJ(bl_builder_take(vm, &sb));
 }
 
 /**
@@ -509,13 +527,15 @@ static bool cfn_tolist(VMState* vm, int argcount, Value* args)
             Value value;
             bl_hashtable_get(&dict->items, dict->names.values[i], &value);
             bl_valarray_push(vm, &nlist->items, value);
+            bl_mem_writebarrier(vm, (Object*)nlist);
             bl_valarray_push(vm, &list->items, OBJ_VAL(nlist));
+            bl_mem_writebarrier(vm, (Object*)list);
         }
     }
     else if(bl_value_isstring(args[0]))
     {
         ObjString* str = AS_STRING(args[0]);
-        for(int i = 0; i < str->utf8length; i++)
+        for(int i = 0; i < bl_string_utf8length(str); i++)
         {
             int start = i;
             int end = i + 1;
@@ -544,6 +564,7 @@ static bool cfn_tolist(VMState* vm, int argcount, Value* args)
     else
     {
         bl_valarray_push(vm, &list->items, args[0]);
+        bl_mem_writebarrier(vm, (Object*)list);
     }
     RETURN_OBJ(list);
 }
@@ -921,6 +942,7 @@ void bl_state_initbuiltinfunctions(VMState* vm)
     define_usernative(vm, "println", cfn_println);
     define_usernative(vm, "rand", cfn_rand);
     define_usernative(vm, "setprop", cfn_setprop);
+    define_usernative(vm, "string_builder", cfn_stringbuilder);
     define_usernative(vm, "sum", cfn_sum);
     define_usernative(vm, "time", cfn_time);
     define_usernative(vm, "to_bool", cfn_tobool);
@@ -940,6 +962,7 @@ void bl_state_initbuiltinmethods(VMState* vm)
     bl_state_initarraymethods(vm);
     bl_state_initfilemethods(vm);
     bl_state_initbytesmethods(vm);
+    bl_state_initbuildermethods(vm);
     bl_state_initrangemethods(vm);
 }
 
@@ -0,0 +1,638 @@
+#include "blade.h"
+
+/*
+* compiled bytecode cache.
+*
+* a cache file holds the top level function of a single source file, exactly as the
+* compiler emitted it (before the vm gets a chance to quicken anything), prefixed by a
+* header carrying the format version, the number of opcodes, a hash of the source
+* it was compiled from and a checksum of the rest of the file. a cache whose header
+* does not match, or that was cut short or damaged, is ignored and the source is
+* compiled again.
+*
+* integers and doubles are written in host order; the version check rejects files
+* written by a machine of the other endianness.
+*
+* imported modules are not embedded. an import is written as a reference to the
+* module's file, which is loaded (from its own cache when that is fresh) every time
+* the importing file is, so a change to an imported file never requires the
+* importer's cache to be thrown away. the import as it was written is kept too,
+* and resolved again on loading: when it now leads to another file (one was added
+* earlier on the search path, or the old one removed), the cache is stale.
+*/
+
+typedef struct BytecodeWriter BytecodeWriter;
+typedef struct BytecodeReader BytecodeReader;
+
+enum
+{
+    BYTECODE_CONST_NIL,
+    BYTECODE_CONST_TRUE,
+    BYTECODE_CONST_FALSE,
+    BYTECODE_CONST_NUMBER,
+    BYTECODE_CONST_STRING,
+    BYTECODE_CONST_FUNCTION,
+    BYTECODE_CONST_SWITCH,
+    BYTECODE_CONST_IMPORT,
+};
+
+struct BytecodeWriter
+{
+    FILE* handle;
+    XXH3_state_t* checksum;
+    bool ok;
+};
+
+struct BytecodeReader
+{
+    VMState* vm;
+    ObjModule* module;
+    const uint8_t* data;
+    size_t length;
+    size_t position;
+    bool failed;
+};
+
+static ObjFunction* bl_bytecode_readfunction(BytecodeReader* r);
+static void bl_bytecode_writefunction(BytecodeWriter* w, ObjFunction* function);
+
+/*
+* returns the path of the cache file for module, or NULL when the module
+* does not come from a regular file (e.g. the repl or -e).
+* the caller owns the returned string.
+*/
+static char* bl_bytecode_cachepath(VMState* vm, ObjModule* module, uint64_t hash)
+{
+    size_t length;
+    uint64_t key;
+    char* path;
+    struct stat st;
+    if(module->file == NULL || stat(module->file, &st) == -1 || !S_ISREG(st.st_mode))
+    {
+        return NULL;
+    }
+    if(vm->bytecodecachedir == NULL)
+    {
+        length = strlen(module->file) + 2;
+        path = (char*)malloc(length);
+        if(path != NULL)
+        {
+            snprintf(path, length, "%sc", module->file);
+        }
+        return path;
+    }
+    // the same source imported from two places may resolve its own
+    // relative imports differently, so the path is part of the key.
+    key = XXH3_64bits_withSeed(module->file, strlen(module->file), hash);
+    length = strlen(vm->bytecodecachedir) + strlen(BLADE_PATH_SEPARATOR) + 16 + strlen(BYTECODE_EXTENSION) + 1;
+    path = (char*)malloc(length);
+    if(path != NULL)
+    {
+        snprintf(path, length, "%s" BLADE_PATH_SEPARATOR "%016" PRIx64 BYTECODE_EXTENSION, vm->bytecodecachedir, key);
+    }
+    return path;
+}
+
+static void bl_bytecode_write(BytecodeWriter* w, const void* data, size_t size)
+{
+    if(w->ok && size > 0 && fwrite(data, 1, size, w->handle) != size)
+    {
+        w->ok = false;
+    }
+    if(w->ok && w->checksum != NULL)
+    {
+        XXH3_64bits_update(w->checksum, data, size);
+    }
+}
+
+static void bl_bytecode_writebyte(BytecodeWriter* w, uint8_t byte)
+{
+    bl_bytecode_write(w, &byte, sizeof(byte));
+}
+
+static void bl_bytecode_writeint(BytecodeWriter* w, int32_t value)
+{
+    bl_bytecode_write(w, &value, sizeof(value));
+}
+
+static void bl_bytecode_writechars(BytecodeWriter* w, const char* chars, int length)
+{
+    bl_bytecode_writeint(w, length);
+    bl_bytecode_write(w, chars, length);
+}
+
+static void bl_bytecode_writevalue(BytecodeWriter* w, Value value)
+{
+    int count;
+    int i;
+    double number;
+    ObjSwitch* sw;
+    ObjModule* module;
+    HashEntry* entry;
+    if(bl_value_isnil(value))
+    {
+        bl_bytecode_writebyte(w, BYTECODE_CONST_NIL);
+    }
+    else if(bl_value_isbool(value))
+    {
+        bl_bytecode_writebyte(w, AS_BOOL(value) ? BYTECODE_CONST_TRUE : BYTECODE_CONST_FALSE);
+    }
+    else if(bl_value_isnumber(value))
+    {
+        number = AS_NUMBER(value);
+        bl_bytecode_writebyte(w, BYTECODE_CONST_NUMBER);
+        bl_bytecode_write(w, &number, sizeof(number));
+    }
+    else if(bl_value_isobject(value))
+    {
+        switch(OBJ_TYPE(value))
+        {
+            case OBJ_STRING:
+            {
+                bl_bytecode_writebyte(w, BYTECODE_CONST_STRING);
+                bl_bytecode_writechars(w, AS_STRING(value)->chars, AS_STRING(value)->length);
+            }
+            break;
+            case OBJ_SCRIPTFUNCTION:
+            {
+                bl_bytecode_writebyte(w, BYTECODE_CONST_FUNCTION);
+                bl_bytecode_writefunction(w, AS_FUNCTION(value));
+            }
+            break;
+            case OBJ_SWITCH:
+            {
+                sw = AS_SWITCH(value);
+                count = 0;
+                for(i = 0; i < sw->table.capacity; i++)
+                {
+                    if(!bl_value_isempty(sw->table.entries[i].key))
+                    {
+                        count++;
+                    }
+                }
+                bl_bytecode_writebyte(w, BYTECODE_CONST_SWITCH);
+                bl_bytecode_writeint(w, sw->defaultjump);
+                bl_bytecode_writeint(w, sw->exitjump);
+                bl_bytecode_writeint(w, count);
+                for(i = 0; i < sw->table.capacity; i++)
+                {
+                    entry = &sw->table.entries[i];
+                    if(!bl_value_isempty(entry->key))
+                    {
+                        bl_bytecode_writevalue(w, entry->key);
+                        bl_bytecode_writevalue(w, entry->value);
+                    }
+                }
+            }
+            break;
+            case OBJ_CLOSURE:
+            {
+                // only imports are compiled into closure constants.
+                module = AS_CLOSURE(value)->fnptr->module;
+                if(module->name == NULL || module->file == NULL || module->importpath == NULL)
+                {
+                    w->ok = false;
+                    break;
+                }
+                bl_bytecode_writebyte(w, BYTECODE_CONST_IMPORT);
+                bl_bytecode_writechars(w, module->name, (int)strlen(module->name));
+                bl_bytecode_writechars(w, module->importpath, (int)strlen(module->importpath));
+                bl_bytecode_writebyte(w, module->importrelative);
+                bl_bytecode_writechars(w, module->file, (int)strlen(module->file));
+            }
+            break;
+            default:
+            {
+                w->ok = false;
+            }
+            break;
+        }
+    }
+    else
+    {
+        w->ok = false;
+    }
+}
+
+static void bl_bytecode_writefunction(BytecodeWriter* w, ObjFunction* function)
+{
+    int i;
+    BinaryBlob* blob;
+    blob = &function->blob;
+    bl_bytecode_writebyte(w, (uint8_t)function->type);
+    bl_bytecode_writeint(w, function->arity);
+    bl_bytecode_writeint(w, function->upvaluecount);
+    bl_bytecode_writebyte(w, function->isvariadic);
+    if(function->name == NULL)
+    {
+        bl_bytecode_writebyte(w, 0);
+    }
+    else
+    {
+        bl_bytecode_writebyte(w, 1);
+        bl_bytecode_writechars(w, function->name->chars, function->name->length);
+    }
+    bl_bytecode_writeint(w, blob->count);
+    bl_bytecode_write(w, blob->code, blob->count);
+    bl_bytecode_write(w, blob->lines, sizeof(int) * blob->count);
+    bl_bytecode_writeint(w, blob->cachecount);
+    bl_bytecode_writeint(w, blob->globalcachecount);
+    bl_bytecode_writeint(w, blob->constants.count);
+    for(i = 0; i < blob->constants.count && w->ok; i++)
+    {
+        bl_bytecode_writevalue(w, blob->constants.values[i]);
+    }
+}
+
+/*
+* writes the freshly compiled top level function of module to its cache file.
+* the file is written under a temporary name and renamed into place, so a
+* concurrent reader never sees half a cache.
+*/
+bool bl_bytecode_store(VMState* vm, ObjModule* module, const char* source, ObjFunction* function)
+{
+    size_t length;
+    long checksumat;
+    uint32_t header[2];
+    uint64_t hash;
+    uint64_t checksum;
+    char* path;
+    char* tmppath;
+    BytecodeWriter writer;
+    hash = XXH3_64bits(source, strlen(source));
+    path = bl_bytecode_cachepath(vm, module, hash);
+    if(path == NULL)
+    {
+        return false;
+    }
+    length = strlen(path) + 32;
+    tmppath = (char*)malloc(length);
+    if(tmppath == NULL)
+    {
+        free(path);
+        return false;
+    }
+    snprintf(tmppath, length, "%s.%ld.tmp", path, (long)getpid());
+    writer.handle = fopen(tmppath, "wb");
+    writer.checksum = NULL;
+    writer.ok = writer.handle != NULL;
+    if(writer.ok)
+    {
+        header[0] = BYTECODE_VERSION;
+        header[1] = OP_BREAK_PL + 1;
+        checksum = 0;
+        bl_bytecode_write(&writer, BYTECODE_MAGIC, strlen(BYTECODE_MAGIC));
+        bl_bytecode_write(&writer, header, sizeof(header));
+        bl_bytecode_write(&writer, &hash, sizeof(hash));
+        // the checksum is filled in once everything after it is written.
+        checksumat = ftell(writer.handle);
+        bl_bytecode_write(&writer, &checksum, sizeof(checksum));
+        writer.checksum = XXH3_createState();
+        if(writer.checksum == NULL || XXH3_64bits_reset(writer.checksum) == XXH_ERROR)
+        {
+            writer.ok = false;
+        }
+        bl_bytecode_writefunction(&writer, function);
+        if(writer.ok)
+        {
+            checksum = XXH3_64bits_digest(writer.checksum);
+            XXH3_freeState(writer.checksum);
+            writer.checksum = NULL;
+            if(fseek(writer.handle, checksumat, SEEK_SET) != 0)
+            {
+                writer.ok = false;
+            }
+            bl_bytecode_write(&writer, &checksum, sizeof(checksum));
+        }
+        XXH3_freeState(writer.checksum);
+        if(fclose(writer.handle) != 0)
+        {
+            writer.ok = false;
+        }
+        if(!writer.ok || rename(tmppath, path) != 0)
+        {
+            writer.ok = false;
+            remove(tmppath);
+        }
+    }
+    free(tmppath);
+    free(path);
+    return writer.ok;
+}
+
+static void bl_bytecode_read(BytecodeReader* r, void* dest, size_t size)
+{
+    if(r->failed || size > r->length - r->position)
+    {
+        r->failed = true;
+        memset(dest, 0, size);
+        return;
+    }
+    memcpy(dest, r->data + r->position, size);
+    r->position += size;
+}
+
+static uint8_t bl_bytecode_readbyte(BytecodeReader* r)
+{
+    uint8_t byte;
+    bl_bytecode_read(r, &byte, sizeof(byte));
+    return byte;
+}
+
+static int32_t bl_bytecode_readint(BytecodeReader* r)
+{
+    int32_t value;
+    bl_bytecode_read(r, &value, sizeof(value));
+    return value;
+}
+
+/*
+* reads an element count. nothing in a cache can hold more elements than
+* the file has bytes, which keeps a damaged file from asking for huge allocations.
+*/
+static int bl_bytecode_readcount(BytecodeReader* r)
+{
+    int32_t count;
+    count = bl_bytecode_readint(r);
+    if(count < 0 || (size_t)count > r->length)
+    {
+        r->failed = true;
+        return 0;
+    }
+    return count;
+}
+
+static const char* bl_bytecode_readchars(BytecodeReader* r, int* length)
+{
+    const char* chars;
+    *length = bl_bytecode_readcount(r);
+    if(r->failed || (size_t)*length > r->length - r->position)
+    {
+        r->failed = true;
+        return NULL;
+    }
+    chars = (const char*)(r->data + r->position);
+    r->position += *length;
+    return chars;
+}
+
+static char* bl_bytecode_readcstring(BytecodeReader* r)
+{
+    int length;
+    const char* chars;
+    chars = bl_bytecode_readchars(r, &length);
+    if(chars == NULL)
+    {
+        return NULL;
+    }
+    return strndup(chars, length);
+}
+
+/*
+* loads the module an import refers to, provided the import still resolves
+* to the file it did when the cache was written.
+*/
+static Value bl_bytecode_readimport(BytecodeReader* r)
+{
+    size_t srclen;
+    bool relative;
+    char* name;
+    char* importpath;
+    char* file;
+    char* resolved;
+    char* source;
+    ObjModule* module;
+    ObjFunction* function;
+    ObjClosure* closure;
+    VMState* vm;
+    vm = r->vm;
+    name = bl_bytecode_readcstring(r);
+    importpath = bl_bytecode_readcstring(r);
+    relative = bl_bytecode_readbyte(r) != 0;
+    file = bl_bytecode_readcstring(r);
+    resolved = NULL;
+    source = NULL;
+    if(importpath != NULL && file != NULL && r->module->file != NULL)
+    {
+        resolved = bl_util_resolveimportpath(importpath, r->module->file, relative);
+    }
+    if(resolved != NULL && strcmp(resolved, file) == 0)
+    {
+        source = bl_util_readfile(file, &srclen);
+    }
+    free(resolved);
+    if(name == NULL || source == NULL)
+    {
+        free(name);
+        free(importpath);
+        free(file);
+        r->failed = true;
+        return NIL_VAL;
+    }
+    module = bl_object_makemodule(vm, name, file);
+    module->importpath = importpath;
+    module->importrelative = relative;
+    bl_vm_pushvalue(vm, OBJ_VAL(module));
+    function = bl_compiler_compilesource(vm, module, source, NULL);
+    free(source);
+    if(function == NULL)
+    {
+        bl_vm_popvalue(vm);
+        r->failed = true;
+        return NIL_VAL;
+    }
+    function->name = NULL;
+    bl_vm_pushvalue(vm, OBJ_VAL(function));
+    closure = bl_object_makeclosure(vm, function);
+    bl_vm_popvalue(vm);
+    bl_vm_popvalue(vm);
+    return OBJ_VAL(closure);
+}
+
+static Value bl_bytecode_readvalue(BytecodeReader* r)
+{
+    int count;
+    int i;
+    int length;
+    double number;
+    const char* chars;
+    Value key;
+    Value value;
+    ObjSwitch* sw;
+    ObjFunction* function;
+    switch(bl_bytecode_readbyte(r))
+    {
+        case BYTECODE_CONST_NIL:
+            return NIL_VAL;
+        case BYTECODE_CONST_TRUE:
+            return BOOL_VAL(true);
+        case BYTECODE_CONST_FALSE:
+            return BOOL_VAL(false);
+        case BYTECODE_CONST_NUMBER:
+        {
+            bl_bytecode_read(r, &number, sizeof(number));
+            return NUMBER_VAL(number);
+        }
+        case BYTECODE_CONST_STRING:
+        {
+            chars = bl_bytecode_readchars(r, &length);
+            if(chars == NULL)
+            {
+                return NIL_VAL;
+            }
+            return OBJ_VAL(bl_string_copystringlen(r->vm, chars, length));
+        }
+        case BYTECODE_CONST_FUNCTION:
+        {
+            function = bl_bytecode_readfunction(r);
+            return function != NULL ? OBJ_VAL(function) : NIL_VAL;
+        }
+        case BYTECODE_CONST_SWITCH:
+        {
+            sw = bl_object_makeswitch(r->vm);
+            bl_vm_pushvalue(r->vm, OBJ_VAL(sw));
+            sw->defaultjump = bl_bytecode_readint(r);
+            sw->exitjump = bl_bytecode_readint(r);
+            count = bl_bytecode_readcount(r);
+            for(i = 0; i < count && !r->failed; i++)
+            {
+                key = bl_bytecode_readvalue(r);
+                bl_vm_pushvalue(r->vm, key);
+                value = bl_bytecode_readvalue(r);
+                if(!r->failed)
+                {
+                    bl_hashtable_set(r->vm, &sw->table, key, value);
+                    bl_mem_writebarrier(r->vm, (Object*)sw);
+                }
+                bl_vm_popvalue(r->vm);
+            }
+            bl_vm_popvalue(r->vm);
+            return OBJ_VAL(sw);
+        }
+        case BYTECODE_CONST_IMPORT:
+            return bl_bytecode_readimport(r);
+        default:
+            break;
+    }
+    r->failed = true;
+    return NIL_VAL;
+}
+
+static ObjFunction* bl_bytecode_readfunction(BytecodeReader* r)
+{
+    int i;
+    int count;
+    int length;
+    uint8_t type;
+    const char* chars;
+    Value value;
+    ObjFunction* function;
+    VMState* vm;
+    vm = r->vm;
+    type = bl_bytecode_readbyte(r);
+    if(r->failed || type > TYPE_SCRIPT)
+    {
+        r->failed = true;
+        return NULL;
+    }
+    function = bl_object_makescriptfunction(vm, r->module, (FuncType)type);
+    bl_vm_pushvalue(vm, OBJ_VAL(function));
+    function->arity = bl_bytecode_readint(r);
+    function->upvaluecount = bl_bytecode_readint(r);
+    function->isvariadic = bl_bytecode_readbyte(r) != 0;
+    if(bl_bytecode_readbyte(r) != 0)
+    {
+        chars = bl_bytecode_readchars(r, &length);
+        if(chars != NULL)
+        {
+            function->name = bl_string_copystringlen(vm, chars, length);
+            bl_mem_writebarrier(vm, (Object*)function);
+        }
+    }
+    count = bl_bytecode_readcount(r);
+    if(!r->failed && count > 0)
+    {
+        function->blob.code = ALLOCATE(uint8_t, count);
+        function->blob.lines = ALLOCATE(int, count);
+        function->blob.capacity = count;
+        function->blob.count = count;
+        bl_bytecode_read(r, function->blob.code, count);
+        bl_bytecode_read(r, function->blob.lines, sizeof(int) * count);
+    }
+    // caches start out empty, just like after a fresh compile.
+    count = bl_bytecode_readcount(r);
+    for(i = 0; i < count; i++)
+    {
+        bl_blob_addcache(vm, &function->blob);
+    }
+    count = bl_bytecode_readcount(r);
+    for(i = 0; i < count; i++)
+    {
+        bl_blob_addglobalcache(vm, &function->blob);
+    }
+    count = bl_bytecode_readcount(r);
+    for(i = 0; i < count && !r->failed; i++)
+    {
+        value = bl_bytecode_readvalue(r);
+        if(!r->failed)
+        {
+            bl_blob_addconst(vm, &function->blob, value);
+            bl_mem_writebarrier(vm, (Object*)function);
+        }
+    }
+    bl_vm_popvalue(vm);
+    return r->failed ? NULL : function;
+}
+
+/*
+* returns the cached top level function of module if there is a cache
+* file compiled from exactly this source, or NULL if it must be compiled.
+*/
+ObjFunction* bl_bytecode_load(VMState* vm, ObjModule* module, const char* source)
+{
+    size_t length;
+    uint32_t header[2];
+    uint64_t hash;
+    uint64_t filehash;
+    uint64_t checksum;
+    char magic[sizeof(BYTECODE_MAGIC) - 1];
+    char* path;
+    char* data;
+    ObjFunction* function;
+    BytecodeReader reader;
+    hash = XXH3_64bits(source, strlen(source));
+    path = bl_bytecode_cachepath(vm, module, hash);
+    if(path == NULL)
+    {
+        return NULL;
+    }
+    data = bl_util_readfile(path, &length);
+    free(path);
+    if(data == NULL)
+    {
+        return NULL;
+    }
+    reader.vm = vm;
+    reader.module = module;
+    reader.data = (const uint8_t*)data;
+    reader.length = length;
+    reader.position = 0;
+    reader.failed = false;
+    function = NULL;
+    bl_bytecode_read(&reader, magic, sizeof(magic));
+    bl_bytecode_read(&reader, header, sizeof(header));
+    bl_bytecode_read(&reader, &filehash, sizeof(filehash));
+    bl_bytecode_read(&reader, &checksum, sizeof(checksum));
+    if(!reader.failed && memcmp(magic, BYTECODE_MAGIC, sizeof(magic)) == 0 && header[0] == BYTECODE_VERSION
+       && header[1] == OP_BREAK_PL + 1 && filehash == hash
+       && XXH3_64bits(reader.data + reader.position, reader.length - reader.position) == checksum)
+    {
+        function = bl_bytecode_readfunction(&reader);
+    }
+    if(reader.failed || reader.position != reader.length)
+    {
+        function = NULL;
+    }
+    free(data);
+    return function;
+}
@@ -5,12 +5,13 @@ void bl_class_defhashtabfield(VMState* vm, ObjClass* klass, HashTable* tbl, ObjS
 {
     Value vkey;
     Value vval;
-    (void)klass;
     bl_vm_pushvalue(vm, OBJ_VAL(name));
     bl_vm_pushvalue(vm, OBJ_VAL(objval));
     vkey = vm->stack[0];
     vval = vm->stack[1];
     bl_hashtable_set(vm, tbl, vkey, vval);
+    bl_mem_writebarrier(vm, (Object*)klass);
+    klass->version++;
     bl_vm_popvaluen(vm, 2);
 }
 
@@ -77,3 +78,280 @@ bool bl_class_getproperty(VMState* vm, ObjClass* klass, ObjString* name, Value*
 }
 
 
+
+static Shape* bl_shape_make(VMState* vm, Shape* parent, ObjString* name)
+{
+    Shape* shape;
+    shape = ALLOCATE(Shape, 1);
+    shape->parent = parent;
+    shape->children = NULL;
+    shape->sibling = NULL;
+    shape->name = name;
+    shape->count = (parent != NULL) ? parent->count + 1 : 0;
+    return shape;
+}
+
+void bl_shape_free(VMState* vm, Shape* shape)
+{
+    Shape* next;
+    while(shape != NULL)
+    {
+        next = shape->sibling;
+        bl_shape_free(vm, shape->children);
+        FREE(Shape, shape);
+        shape = next;
+    }
+}
+
+void bl_shape_mark(VMState* vm, Shape* shape)
+{
+    for(; shape != NULL; shape = shape->sibling)
+    {
+        bl_mem_markobject(vm, (Object*)shape->name);
+        bl_shape_mark(vm, shape->children);
+    }
+}
+
+/*
+* returns the slot holding property $name, or -1 if the shape has none.
+*/
+int bl_shape_findslot(Shape* shape, ObjString* name)
+{
+    for(; shape != NULL && shape->name != NULL; shape = shape->parent)
+    {
+        // names in shapes are interned, a name looked up may not be.
+        if(shape->name == name || (!name->isinterned && bl_string_equal(shape->name, name)))
+        {
+            return shape->count - 1;
+        }
+    }
+    return -1;
+}
+
+/*
+* returns the shape that results from adding $name to $shape, or NULL if the
+* instance should rather switch to dictionary mode.
+*/
+Shape* bl_shape_transition(VMState* vm, ObjClass* klass, Shape* shape, ObjString* name)
+{
+    Shape* child;
+    for(child = shape->children; child != NULL; child = child->sibling)
+    {
+        if(child->name == name)
+        {
+            return child;
+        }
+    }
+    if(shape->count >= SHAPE_MAX_SLOTS || klass->shapecount >= SHAPE_MAX_PER_CLASS)
+    {
+        return NULL;
+    }
+    child = bl_shape_make(vm, shape, name);
+    child->sibling = shape->children;
+    shape->children = child;
+    klass->shapecount++;
+    // the class owns its shapes, and with them their names.
+    bl_mem_writebarrier(vm, (Object*)klass);
+    return child;
+}
+
+/*
+* the shape holding the class's default properties, in the order
+* bl_instance_initfields() copies them.
+*/
+static Shape* bl_class_initshape(VMState* vm, ObjClass* klass)
+{
+    int i;
+    Shape* shape;
+    HashEntry* entry;
+    if(klass->initshape != NULL && klass->initshape->count == klass->properties.count)
+    {
+        return klass->initshape;
+    }
+    if(klass->rootshape == NULL)
+    {
+        klass->rootshape = bl_shape_make(vm, NULL, NULL);
+        klass->shapecount++;
+    }
+    shape = klass->rootshape;
+    for(i = 0; i < klass->properties.capacity; i++)
+    {
+        entry = &klass->properties.entries[i];
+        if(bl_value_isempty(entry->key))
+        {
+            continue;
+        }
+        if(!bl_value_isstring(entry->key))
+        {
+            return NULL;
+        }
+        shape = bl_shape_transition(vm, klass, shape, AS_STRING(entry->key));
+        if(shape == NULL)
+        {
+            return NULL;
+        }
+    }
+    klass->initshape = shape;
+    return shape;
+}
+
+void bl_instance_reserveslots(VMState* vm, ObjInstance* instance, int count)
+{
+    int i;
+    int oldcapacity;
+    int newcapacity;
+    if(count > instance->klass->slothint)
+    {
+        instance->klass->slothint = count;
+    }
+    if(instance->slotcapacity >= count)
+    {
+        return;
+    }
+    oldcapacity = instance->slotcapacity;
+    newcapacity = (oldcapacity == 0) ? count : GROW_CAPACITY(oldcapacity);
+    if(newcapacity < count)
+    {
+        newcapacity = count;
+    }
+    instance->slots = GROW_ARRAY(Value, sizeof(Value), instance->slots, oldcapacity, newcapacity);
+    for(i = oldcapacity; i < newcapacity; i++)
+    {
+        instance->slots[i] = NIL_VAL;
+    }
+    instance->slotcapacity = newcapacity;
+}
+
+/*
+* gives a new instance its own copy of the class's default properties.
+*/
+void bl_instance_initfields(VMState* vm, ObjInstance* instance)
+{
+    int i;
+    int slot;
+    int count;
+    Shape* shape;
+    HashEntry* entry;
+    ObjClass* klass;
+    klass = instance->klass;
+    shape = bl_class_initshape(vm, klass);
+    if(shape == NULL)
+    {
+        bl_instance_todictionary(vm, instance);
+        if(klass->properties.count > 0)
+        {
+            bl_hashtable_copy(vm, &klass->properties, instance->properties);
+            bl_mem_writebarrier(vm, (Object*)instance);
+        }
+        return;
+    }
+    count = (klass->slothint > shape->count) ? klass->slothint : shape->count;
+    if(count > 0)
+    {
+        bl_instance_reserveslots(vm, instance, count);
+    }
+    // the slots are all nil at this point, so the collector may look at them.
+    instance->shape = shape;
+    slot = 0;
+    for(i = 0; i < klass->properties.capacity; i++)
+    {
+        entry = &klass->properties.entries[i];
+        if(!bl_value_isempty(entry->key))
+        {
+            instance->slots[slot++] = bl_value_copyvalue(vm, entry->value);
+        }
+    }
+    bl_mem_writebarrier(vm, (Object*)instance);
+}
+
+/*
+* moves the properties of an instance into a hash table, after which its
+* shape is no longer used.
+*/
+void bl_instance_todictionary(VMState* vm, ObjInstance* instance)
+{
+    Shape* shape;
+    HashTable* table;
+    if(instance->properties == NULL)
+    {
+        table = ALLOCATE(HashTable, 1);
+        bl_hashtable_init(table);
+        instance->properties = table;
+    }
+    for(shape = instance->shape; shape != NULL && shape->name != NULL; shape = shape->parent)
+    {
+        bl_hashtable_set(vm, instance->properties, OBJ_VAL(shape->name), instance->slots[shape->count - 1]);
+    }
+    bl_mem_writebarrier(vm, (Object*)instance);
+    instance->shape = NULL;
+    if(instance->slots != NULL)
+    {
+        FREE_ARRAY(Value, instance->slots, instance->slotcapacity);
+        instance->slots = NULL;
+        instance->slotcapacity = 0;
+    }
+}
+
+bool bl_instance_getfield(ObjInstance* instance, ObjString* name, Value* dest)
+{
+    int slot;
+    if(instance->shape == NULL)
+    {
+        return instance->properties != NULL && bl_hashtable_get(instance->properties, OBJ_VAL(name), dest);
+    }
+    slot = bl_shape_findslot(instance->shape, name);
+    if(slot < 0)
+    {
+        return false;
+    }
+    *dest = instance->slots[slot];
+    return true;
+}
+
+/*
+* returns true if $name was newly added, like bl_hashtable_set().
+*/
+bool bl_instance_setfield(VMState* vm, ObjInstance* instance, ObjString* name, Value value)
+{
+    bool isnew;
+    int slot;
+    Shape* next;
+    name = bl_string_intern(vm, name);
+    if(instance->shape != NULL)
+    {
+        slot = bl_shape_findslot(instance->shape, name);
+        if(slot >= 0)
+        {
+            instance->slots[slot] = value;
+            bl_mem_writebarrier(vm, (Object*)instance);
+            return false;
+        }
+        next = bl_shape_transition(vm, instance->klass, instance->shape, name);
+        if(next != NULL)
+        {
+            bl_instance_reserveslots(vm, instance, next->count);
+            instance->slots[next->count - 1] = value;
+            instance->shape = next;
+            bl_mem_writebarrier(vm, (Object*)instance);
+            return true;
+        }
+        bl_instance_todictionary(vm, instance);
+    }
+    isnew = bl_hashtable_set(vm, instance->properties, OBJ_VAL(name), value);
+    bl_mem_writebarrier(vm, (Object*)instance);
+    return isnew;
+}
+
+bool bl_instance_deletefield(VMState* vm, ObjInstance* instance, ObjString* name)
+{
+    if(instance->shape != NULL)
+    {
+        if(bl_shape_findslot(instance->shape, name) < 0)
+        {
+            return false;
+        }
+        // shapes only ever grow, so removing a property leaves the tree.
+        bl_instance_todictionary(vm, instance);
+    }
+    return bl_hashtable_delete(instance->properties, OBJ_VAL(name));
+}
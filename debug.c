@@ -70,6 +70,29 @@ static int bl_blob_disasinvokeinst(const char* name, BinaryBlob* blob, int offse
     return offset + 4;
 }
 
+static int bl_blob_disascachedconstinst(const char* name, BinaryBlob* blob, int offset)
+{
+    uint16_t constant = (blob->code[offset + 1] << 8) | blob->code[offset + 2];
+    uint16_t cache = (blob->code[offset + 3] << 8) | blob->code[offset + 4];
+    printf("%-16s %8d '", name, constant);
+    bl_value_printvalue(blob->constants.values[constant]);
+    printf("' (cache %d)\n", cache);
+    return offset + 5;
+}
+
+static int bl_blob_disascachedinvokeinst(const char* name, BinaryBlob* blob, int offset)
+{
+    uint16_t constant = (uint16_t)(blob->code[offset + 1] << 8);
+    constant |= blob->code[offset + 2];
+    uint8_t argcount = blob->code[offset + 3];
+    uint16_t cache = (uint16_t)(blob->code[offset + 4] << 8);
+    cache |= blob->code[offset + 5];
+    printf("%-16s (%d args) %8d '", name, argcount, constant);
+    bl_value_printvalue(blob->constants.values[constant]);
+    printf("' (cache %d)\n", cache);
+    return offset + 6;
+}
+
 int bl_blob_disassembleinst(BinaryBlob* blob, int offset)
 {
     printf("%08d ", offset);
@@ -93,21 +116,21 @@ int bl_blob_disassembleinst(BinaryBlob* blob, int offset)
         case OP_LOOP:
             return bl_blob_disasjumpinst("loop", -1, blob, offset);
         case OP_DEFINE_GLOBAL:
-            return bl_blob_disasconstinst("dglob", blob, offset);
+            return bl_blob_disascachedconstinst("dglob", blob, offset);
         case OP_GET_GLOBAL:
-            return bl_blob_disasconstinst("gglob", blob, offset);
+            return bl_blob_disascachedconstinst("gglob", blob, offset);
         case OP_SET_GLOBAL:
-            return bl_blob_disasconstinst("sglob", blob, offset);
+            return bl_blob_disascachedconstinst("sglob", blob, offset);
         case OP_GET_LOCAL:
             return bl_blob_disasshortinst("gloc", blob, offset);
         case OP_SET_LOCAL:
             return bl_blob_disasshortinst("sloc", blob, offset);
         case OP_GET_PROPERTY:
-            return bl_blob_disasconstinst("gprop", blob, offset);
+            return bl_blob_disascachedconstinst("gprop", blob, offset);
         case OP_GET_SELF_PROPERTY:
-            return bl_blob_disasconstinst("gprops", blob, offset);
+            return bl_blob_disascachedconstinst("gprops", blob, offset);
         case OP_SET_PROPERTY:
-            return bl_blob_disasconstinst("sprop", blob, offset);
+            return bl_blob_disascachedconstinst("sprop", blob, offset);
         case OP_GET_UP_VALUE:
             return bl_blob_disasshortinst("gupv", blob, offset);
         case OP_SET_UP_VALUE:
@@ -134,6 +157,54 @@ int bl_blob_disassembleinst(BinaryBlob* blob, int offset)
             return bl_blob_disaspriminst("false", offset);
         case OP_ADD:
             return bl_blob_disaspriminst("add", offset);
+        case OP_ADD_NUM:
+            return bl_blob_disaspriminst("addn", offset);
+        case OP_SUBTRACT_NUM:
+            return bl_blob_disaspriminst("subn", offset);
+        case OP_MULTIPLY_NUM:
+            return bl_blob_disaspriminst("muln", offset);
+        case OP_DIVIDE_NUM:
+            return bl_blob_disaspriminst("divn", offset);
+        case OP_EQUAL_NUM:
+            return bl_blob_disaspriminst("eqn", offset);
+        case OP_GREATERTHAN_NUM:
+            return bl_blob_disaspriminst("gtn", offset);
+        case OP_LESSTHAN_NUM:
+            return bl_blob_disaspriminst("lessn", offset);
+        case OP_ADD_ANY:
+            return bl_blob_disaspriminst("adda", offset);
+        case OP_SUBTRACT_ANY:
+            return bl_blob_disaspriminst("suba", offset);
+        case OP_MULTIPLY_ANY:
+            return bl_blob_disaspriminst("mula", offset);
+        case OP_DIVIDE_ANY:
+            return bl_blob_disaspriminst("diva", offset);
+        case OP_EQUAL_ANY:
+            return bl_blob_disaspriminst("eqa", offset);
+        case OP_GREATERTHAN_ANY:
+            return bl_blob_disaspriminst("gta", offset);
+        case OP_LESSTHAN_ANY:
+            return bl_blob_disaspriminst("lessa", offset);
+        case OP_GET_LOCAL_0:
+            return bl_blob_disaspriminst("gloc0", offset);
+        case OP_GET_LOCAL_1:
+            return bl_blob_disaspriminst("gloc1", offset);
+        case OP_GET_LOCAL_2:
+            return bl_blob_disaspriminst("gloc2", offset);
+        case OP_GET_LOCAL_3:
+            return bl_blob_disaspriminst("gloc3", offset);
+        case OP_SET_LOCAL_POP:
+            return bl_blob_disasshortinst("slocp", blob, offset);
+        case OP_CONSTANT_SMALLINT:
+            return bl_blob_disasbyteinst("loadi", blob, offset);
+        case OP_POP_JUMP_IF_FALSE:
+            return bl_blob_disasjumpinst("pfjump", 1, blob, offset);
+        case OP_EQUAL_JUMP:
+            return bl_blob_disasjumpinst("eqjump", 1, blob, offset);
+        case OP_GREATERTHAN_JUMP:
+            return bl_blob_disasjumpinst("gtjump", 1, blob, offset);
+        case OP_LESSTHAN_JUMP:
+            return bl_blob_disasjumpinst("lessjump", 1, blob, offset);
         case OP_SUBTRACT:
             return bl_blob_disaspriminst("sub", offset);
         case OP_MULTIPLY:
@@ -235,9 +306,9 @@ int bl_blob_disassembleinst(BinaryBlob* blob, int offset)
         case OP_CALL:
             return bl_blob_disasbyteinst("call", blob, offset);
         case OP_INVOKE:
-            return bl_blob_disasinvokeinst("invk", blob, offset);
+            return bl_blob_disascachedinvokeinst("invk", blob, offset);
         case OP_INVOKE_SELF:
-            return bl_blob_disasinvokeinst("invks", blob, offset);
+            return bl_blob_disascachedinvokeinst("invks", blob, offset);
         case OP_RETURN:
             return bl_blob_disaspriminst("ret", offset);
         case OP_CLASS:
@@ -1,6 +1,75 @@
 
 #include "blade.h"
 
+/*
+* one thread of a parallel trace. it works off its own private stack, and
+* moves part of it to its shared stack whenever that grows, for the idle
+* markers to steal from.
+*/
+typedef struct GCMarker GCMarker;
+struct GCMarker
+{
+    VMState* vm;
+    pthread_t thread;
+    Object** local;
+    int localcount;
+    int localcapacity;
+    pthread_mutex_t lock;
+    Object** shared;
+    int sharedcount;
+    int sharedcapacity;
+};
+
+// markers hand over work once they hold this many gray objects.
+#define GC_MARKER_SHARE_AT 64
+
+static GCMarker* bl_mem_markers;
+static int bl_mem_markercount;
+static int bl_mem_idlemarkers;
+// set on the threads of a parallel trace; bl_mem_markobject() gives them their gray objects.
+static _Thread_local GCMarker* bl_mem_marker;
+
+/*
+* moves count gray objects from the top of one stack to another.
+*/
+static void bl_mem_graymove(Object** from, int* fromcount, Object*** to, int* tocount, int* tocapacity, int count)
+{
+    if(*tocapacity < *tocount + count)
+    {
+        while(*tocapacity < *tocount + count)
+        {
+            *tocapacity = GROW_CAPACITY(*tocapacity);
+        }
+        *to = (Object**)realloc(*to, sizeof(Object*) * (*tocapacity));
+        if(*to == NULL)
+        {
+            fflush(stdout);// flush out anything on stdout first
+            fprintf(stderr, "GC encountered an error");
+            exit(1);
+        }
+    }
+    // the counts of the shared stacks are peeked at without the lock.
+    __atomic_store_n(fromcount, *fromcount - count, __ATOMIC_RELAXED);
+    memcpy(*to + *tocount, from + *fromcount, sizeof(Object*) * count);
+    __atomic_store_n(tocount, *tocount + count, __ATOMIC_RELAXED);
+}
+
+static void bl_mem_graypush(Object*** stack, int* count, int* capacity, Object* object)
+{
+    if(*capacity < *count + 1)
+    {
+        *capacity = GROW_CAPACITY(*capacity);
+        *stack = (Object**)realloc(*stack, sizeof(Object*) * (*capacity));
+        if(*stack == NULL)
+        {
+            fflush(stdout);// flush out anything on stdout first
+            fprintf(stderr, "GC encountered an error");
+            exit(1);
+        }
+    }
+    (*stack)[*count] = object;
+    __atomic_store_n(count, *count + 1, __ATOMIC_RELAXED);
+}
 
 Object* bl_mem_gcprotect(VMState* vm, Object* object)
 {
@@ -19,20 +88,269 @@ void bl_mem_gcclearprotect(VMState* vm)
 }
 
 
+/*
+* buffers of swept objects, handed over to the background freer in batches.
+*/
+#define GC_FREE_BATCH 1024
+
+typedef struct GCFreeBatch GCFreeBatch;
+struct GCFreeBatch
+{
+    GCFreeBatch* next;
+    int count;
+    void* pointers[GC_FREE_BATCH];
+};
+
+/*
+* a thread that gives the memory of dead objects back to libc, so that a
+* sweep only has to unlink them. finalizers still run on the vm's thread,
+* as only what goes through bl_mem_free() is handed over.
+*/
+struct GCFreer
+{
+    // the process the thread runs in: a forked child has to start its own.
+    pid_t pid;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool stopping;
+    // batches waiting for the thread, and the one the sweep is filling
+    GCFreeBatch* queue;
+    GCFreeBatch* filling;
+};
+
+static void bl_mem_freebatches(GCFreeBatch* batch)
+{
+    int i;
+    GCFreeBatch* next;
+    while(batch != NULL)
+    {
+        next = batch->next;
+        for(i = 0; i < batch->count; i++)
+        {
+            free(batch->pointers[i]);
+        }
+        free(batch);
+        batch = next;
+    }
+}
+
+static void* bl_mem_freerrun(void* arg)
+{
+    GCFreer* freer;
+    GCFreeBatch* batches;
+    freer = (GCFreer*)arg;
+    pthread_mutex_lock(&freer->lock);
+    while(true)
+    {
+        while(freer->queue == NULL && !freer->stopping)
+        {
+            pthread_cond_wait(&freer->wake, &freer->lock);
+        }
+        batches = freer->queue;
+        if(batches == NULL)
+        {
+            break;
+        }
+        freer->queue = NULL;
+        pthread_mutex_unlock(&freer->lock);
+        bl_mem_freebatches(batches);
+        pthread_mutex_lock(&freer->lock);
+    }
+    pthread_mutex_unlock(&freer->lock);
+    return NULL;
+}
+
+static bool bl_mem_freerspawn(GCFreer* freer)
+{
+    freer->pid = getpid();
+    freer->stopping = false;
+    pthread_mutex_init(&freer->lock, NULL);
+    pthread_cond_init(&freer->wake, NULL);
+    if(pthread_create(&freer->thread, NULL, bl_mem_freerrun, freer) != 0)
+    {
+        pthread_mutex_destroy(&freer->lock);
+        pthread_cond_destroy(&freer->wake);
+        return false;
+    }
+    return true;
+}
+
+/*
+* starts freeing the buffers of swept objects on a background thread.
+* returns false (and keeps freeing them inline) if no thread can be had.
+*/
+bool bl_mem_startfreer(VMState* vm)
+{
+    GCFreer* freer;
+    if(vm->gcfreer != NULL)
+    {
+        return true;
+    }
+    freer = (GCFreer*)malloc(sizeof(GCFreer));
+    if(freer == NULL)
+    {
+        return false;
+    }
+    freer->queue = NULL;
+    freer->filling = NULL;
+    if(!bl_mem_freerspawn(freer))
+    {
+        free(freer);
+        return false;
+    }
+    vm->gcfreer = freer;
+    return true;
+}
+
+/*
+* hands the batch being filled over to the thread.
+*/
+static void bl_mem_freerflush(VMState* vm)
+{
+    GCFreer* freer;
+    GCFreeBatch* batch;
+    freer = vm->gcfreer;
+    batch = freer->filling;
+    if(batch == NULL)
+    {
+        return;
+    }
+    freer->filling = NULL;
+    // the thread didn't survive a fork(); whatever the parent had queued is ours to free too.
+    if(freer->pid != getpid() && !bl_mem_freerspawn(freer))
+    {
+        batch->next = freer->queue;
+        freer->queue = NULL;
+        bl_mem_freebatches(batch);
+        free(freer);
+        vm->gcfreer = NULL;
+        return;
+    }
+    vm->gcfreedbatches++;
+    pthread_mutex_lock(&freer->lock);
+    batch->next = freer->queue;
+    freer->queue = batch;
+    pthread_cond_signal(&freer->wake);
+    pthread_mutex_unlock(&freer->lock);
+}
+
+/*
+* waits for the thread to free everything handed over to it, and ends it.
+*/
+void bl_mem_stopfreer(VMState* vm)
+{
+    GCFreer* freer;
+    freer = vm->gcfreer;
+    if(freer == NULL)
+    {
+        return;
+    }
+    if(freer->pid != getpid())
+    {
+        // a forked child that never swept since: there is no thread to wait for.
+        if(freer->filling != NULL)
+        {
+            freer->filling->next = freer->queue;
+            freer->queue = freer->filling;
+        }
+        bl_mem_freebatches(freer->queue);
+        free(freer);
+        vm->gcfreer = NULL;
+        return;
+    }
+    bl_mem_freerflush(vm);
+    pthread_mutex_lock(&freer->lock);
+    freer->stopping = true;
+    pthread_cond_signal(&freer->wake);
+    pthread_mutex_unlock(&freer->lock);
+    pthread_join(freer->thread, NULL);
+    pthread_mutex_destroy(&freer->lock);
+    pthread_cond_destroy(&freer->wake);
+    free(freer);
+    vm->gcfreer = NULL;
+}
+
 void bl_mem_free(VMState* vm, void* pointer, size_t sz)
 {
+    GCFreeBatch* batch;
     vm->bytesallocated -= sz;
+    if(vm->gcsweeping && vm->gcfreer != NULL && pointer != NULL)
+    {
+        batch = vm->gcfreer->filling;
+        if(batch == NULL)
+        {
+            batch = (GCFreeBatch*)malloc(sizeof(GCFreeBatch));
+            if(batch == NULL)
+            {
+                free(pointer);
+                return;
+            }
+            batch->count = 0;
+            vm->gcfreer->filling = batch;
+        }
+        batch->pointers[batch->count++] = pointer;
+        if(batch->count == GC_FREE_BATCH)
+        {
+            bl_mem_freerflush(vm);
+        }
+        return;
+    }
     free(pointer);
 }
 
-void* bl_mem_realloc(VMState* vm, void* pointer, size_t oldsize, size_t newsize)
+/*
+* accounts for newly allocated memory, which may first run a collection.
+*/
+static void bl_mem_willallocate(VMState* vm, size_t oldsize, size_t newsize)
 {
-    void* result;
     vm->bytesallocated += newsize - oldsize;
-    if(newsize > oldsize && vm->bytesallocated > vm->nextgc)
+    if(newsize > oldsize)
     {
-        bl_mem_collectgarbage(vm);
+        vm->youngbytes += newsize - oldsize;
+        if(vm->gcdisabled)
+        {
+            return;
+        }
+        if(vm->gcphase != GC_PHASE_IDLE)
+        {
+            bl_mem_gcstep(vm, newsize - oldsize);
+        }
+        else if(vm->bytesallocated > vm->nextgc)
+        {
+            if(vm->gcpausebudget > 0 && vm->allowgc)
+            {
+                bl_mem_startcollection(vm);
+            }
+            else if(vm->allowgc)
+            {
+                bl_mem_collectlazily(vm);
+            }
+            else
+            {
+                bl_mem_collectgarbage(vm);
+            }
+        }
+        // the nursery can't be collected while its marks belong to an incremental collection.
+        if(vm->gcphase != GC_PHASE_MARK && vm->allowgc && vm->youngbytes > GC_NURSERY_SIZE)
+        {
+            if(vm->snapshotrequested)
+            {
+                // a full collection, which leaves the nursery empty as well.
+                bl_snapshot_writerequested(vm);
+            }
+            else
+            {
+                bl_mem_collectyoung(vm);
+            }
+        }
     }
+}
+
+void* bl_mem_realloc(VMState* vm, void* pointer, size_t oldsize, size_t newsize)
+{
+    void* result;
+    bl_mem_willallocate(vm, oldsize, newsize);
     result = (void*)realloc(pointer, newsize);
     // just in case reallocation fails... computers ain't infinite!
     if(result == NULL)
@@ -41,6 +359,10 @@ void* bl_mem_realloc(VMState* vm, void* pointer, size_t oldsize, size_t newsize)
         fprintf(stderr, "Exit: device out of memory\n");
         exit(EXIT_TERMINAL);
     }
+    if(vm->allocprofile != NULL && newsize > oldsize)
+    {
+        bl_profile_count(vm, newsize - oldsize, -1);
+    }
     return result;
 }
 
@@ -49,22 +371,89 @@ void* bl_mem_growarray(VMState* vm, void* ptr, size_t tsz, size_t oldcount, size
     return bl_mem_realloc(vm, ptr, tsz * (oldcount), tsz * (newcount));
 }
 
+/*
+* memory for a gc object. see slab.c.
+*/
+void* bl_mem_allocobjectmem(VMState* vm, size_t size)
+{
+    void* result;
+    bl_mem_willallocate(vm, 0, size);
+    result = bl_slab_alloc(vm, size);
+    if(result == NULL)
+    {
+        fflush(stdout);// flush out anything on stdout first
+        fprintf(stderr, "Exit: device out of memory\n");
+        exit(EXIT_TERMINAL);
+    }
+    return result;
+}
+
+void bl_mem_freeobjectmem(VMState* vm, void* pointer, size_t size)
+{
+    ObjType type;
+    type = ((Object*)pointer)->type;
+    vm->objectcount--;
+    vm->gctypecount[type]--;
+    vm->gctypebytes[type] -= size;
+    vm->bytesallocated -= size;
+    bl_slab_free(vm, pointer, size);
+}
+
+/*
+* records an old object that was given a reference to a possibly young one,
+* so that the next minor collection traces it. see bl_mem_writebarrier().
+*/
+void bl_mem_remember(VMState* vm, Object* object)
+{
+    if(vm->remembercapacity < vm->remembercount + 1)
+    {
+        vm->remembercapacity = GROW_CAPACITY(vm->remembercapacity);
+        vm->rememberset = (Object**)realloc(vm->rememberset, sizeof(Object*) * vm->remembercapacity);
+        if(vm->rememberset == NULL)
+        {
+            fflush(stdout);// flush out anything on stdout first
+            fprintf(stderr, "GC encountered an error");
+            exit(1);
+        }
+    }
+    object->remembered = true;
+    vm->rememberset[vm->remembercount++] = object;
+}
+
 void bl_mem_markobject(VMState* vm, Object* object)
 {
     if(object == NULL)
     {
         return;
     }
-    if(object->mark)
+    if(vm->heapsnapshot != NULL)
+    {
+        bl_snapshot_addref(vm->heapsnapshot, object);
+    }
+    if(bl_mem_ismarked(object))
+    {
+        return;
+    }
+    // old objects are only reached through the remembered set in a minor collection.
+    if(vm->gcisminor && object->old)
     {
         return;
     }
+    if(bl_mem_marker != NULL)
+    {
+        // other markers may be racing for the same object; only the winner traces it.
+        if(bl_mem_trysetmarked(object))
+        {
+            bl_mem_graypush(&bl_mem_marker->local, &bl_mem_marker->localcount, &bl_mem_marker->localcapacity, object);
+        }
+        return;
+    }
     //#if defined(DEBUG_LOG_GC) && DEBUG_LOG_GC
     //  printf("%p mark ", (void *)object);
     //  bl_writer_printobject(OBJ_VAL(object), false);
     //  printf("\n");
     //#endif
-    object->mark = true;
+    bl_mem_setmarked(object, true);
     if(vm->graycapacity < vm->graycount + 1)
     {
         vm->graycapacity = GROW_CAPACITY(vm->graycapacity);
@@ -168,6 +557,7 @@ void bl_mem_blackenobject(VMState* vm, Object* object)
             {
                 bl_mem_markobject(vm, (Object*)klass->superclass);
             }
+            bl_shape_mark(vm, klass->rootshape);
         }
         break;
         case OBJ_CLOSURE:
@@ -192,7 +582,17 @@ void bl_mem_blackenobject(VMState* vm, Object* object)
         {
             ObjInstance* instance = (ObjInstance*)object;
             bl_mem_markobject(vm, (Object*)instance->klass);
-            bl_mem_marktable(vm, &instance->properties);
+            if(instance->shape != NULL)
+            {
+                for(int i = 0; i < instance->shape->count; i++)
+                {
+                    bl_mem_markvalue(vm, instance->slots[i]);
+                }
+            }
+            if(instance->properties != NULL)
+            {
+                bl_mem_marktable(vm, instance->properties);
+            }
         }
         break;
         case OBJ_UP_VALUE:
@@ -201,6 +601,7 @@ void bl_mem_blackenobject(VMState* vm, Object* object)
         }
         break;
         case OBJ_BYTES:
+        case OBJ_STRBUILDER:
         case OBJ_RANGE:
         case OBJ_NATIVEFUNCTION:
         case OBJ_PTR:
@@ -210,6 +611,11 @@ void bl_mem_blackenobject(VMState* vm, Object* object)
         break;
         case OBJ_STRING:
         {
+            if(((ObjString*)object)->isrope)
+            {
+                bl_mem_markobject(vm, (Object*)((ObjRope*)object)->left);
+                bl_mem_markobject(vm, (Object*)((ObjRope*)object)->right);
+            }
         }
         break;
     }
@@ -238,6 +644,7 @@ void bl_mem_freeobject(VMState* vm, Object** pobject)
             bl_hashtable_free(vm, &module->values);
             free(module->name);
             free(module->file);
+            free(module->importpath);
             if(module->unloader != NULL && module->imported)
             {
                 ((ModLoaderFunc)module->unloader)(vm);
@@ -246,14 +653,21 @@ void bl_mem_freeobject(VMState* vm, Object** pobject)
             {
                 close_dl_module(module->handle);// free the shared library...
             }
-            FREE(ObjModule, object);
+            FREE_OBJ(ObjModule, object);
             break;
         }
         case OBJ_BYTES:
         {
             ObjBytes* bytes = (ObjBytes*)object;
             bl_bytearray_free(vm, &bytes->bytes);
-            FREE(ObjBytes, object);
+            FREE_OBJ(ObjBytes, object);
+            break;
+        }
+        case OBJ_STRBUILDER:
+        {
+            StringBuilder* builder = &((ObjStringBuilder*)object)->builder;
+            FREE_ARRAY(char, builder->chars, builder->capacity);
+            FREE_OBJ(ObjStringBuilder, object);
             break;
         }
         case OBJ_FILE:
@@ -263,7 +677,7 @@ void bl_mem_freeobject(VMState* vm, Object** pobject)
             {
                 fclose(file->file);
             }
-            FREE(ObjFile, object);
+            FREE_OBJ(ObjFile, object);
             break;
         }
         case OBJ_DICT:
@@ -271,21 +685,21 @@ void bl_mem_freeobject(VMState* vm, Object** pobject)
             ObjDict* dict = (ObjDict*)object;
             bl_valarray_free(vm, &dict->names);
             bl_hashtable_free(vm, &dict->items);
-            FREE(ObjDict, object);
+            FREE_OBJ(ObjDict, object);
             break;
         }
         case OBJ_ARRAY:
         {
             ObjArray* list = (ObjArray*)object;
             bl_valarray_free(vm, &list->items);
-            FREE(ObjArray, object);
+            FREE_OBJ(ObjArray, object);
             break;
         }
         case OBJ_BOUNDFUNCTION:
         {
             // a closure may be bound to multiple instances
             // for this reason, we do not free closures when freeing bound methods
-            FREE(ObjBoundMethod, object);
+            FREE_OBJ(ObjBoundMethod, object);
             break;
         }
         case OBJ_CLASS:
@@ -295,12 +709,15 @@ void bl_mem_freeobject(VMState* vm, Object** pobject)
             bl_hashtable_free(vm, &klass->methods);
             bl_hashtable_free(vm, &klass->properties);
             bl_hashtable_free(vm, &klass->staticproperties);
+            bl_shape_free(vm, klass->rootshape);
+            // inline caches may be keyed by this class or its shapes.
+            vm->methodepoch++;
             if(!bl_value_isempty(klass->initializer))
             {
                 // FIXME: uninitialized
                 //bl_mem_freeobject(vm, &AS_OBJ(klass->initializer));
             }
-            FREE(ObjClass, object);
+            FREE_OBJ(ObjClass, object);
             break;
         }
         case OBJ_CLOSURE:
@@ -309,7 +726,7 @@ void bl_mem_freeobject(VMState* vm, Object** pobject)
             FREE_ARRAY(ObjUpvalue*, closure->upvalues, closure->upvaluecount);
             // there may be multiple closures that all reference the same function
             // for this reason, we do not free functions when freeing closures
-            FREE(ObjClosure, object);
+            FREE_OBJ(ObjClosure, object);
             break;
         }
         case OBJ_SCRIPTFUNCTION:
@@ -320,46 +737,65 @@ void bl_mem_freeobject(VMState* vm, Object** pobject)
             {
                 //bl_mem_freeobject(vm, (Object**)&function->name);
             }
-            FREE(ObjFunction, object);
+            FREE_OBJ(ObjFunction, object);
             break;
         }
         case OBJ_INSTANCE:
         {
             ObjInstance* instance = (ObjInstance*)object;
-            bl_hashtable_free(vm, &instance->properties);
-            FREE(ObjInstance, object);
+            FREE_ARRAY(Value, instance->slots, instance->slotcapacity);
+            if(instance->properties != NULL)
+            {
+                bl_hashtable_free(vm, instance->properties);
+                FREE(HashTable, instance->properties);
+            }
+            FREE_OBJ(ObjInstance, object);
             break;
         }
         case OBJ_NATIVEFUNCTION:
         {
-            FREE(ObjNativeFunction, object);
+            FREE_OBJ(ObjNativeFunction, object);
             break;
         }
         case OBJ_UP_VALUE:
         {
-            FREE(ObjUpvalue, object);
+            FREE_OBJ(ObjUpvalue, object);
             break;
         }
         case OBJ_RANGE:
         {
-            FREE(ObjRange, object);
+            FREE_OBJ(ObjRange, object);
             break;
         }
         case OBJ_STRING:
         {
             ObjString* string = (ObjString*)object;
-            //if(string->length > 0)
+            if(string->chars == (char*)(string + 1))
+            {
+                // inline, freed along with the string.
+                bl_mem_freeobjectmem(vm, object, sizeof(ObjString) + (size_t)string->length + 1);
+                break;
+            }
+            // a rope may not have any.
+            if(string->chars != NULL)
             {
                 FREE_ARRAY(char, string->chars, (size_t)string->length + 1);
             }
-            FREE(ObjString, object);
+            if(string->isrope)
+            {
+                FREE_OBJ(ObjRope, object);
+            }
+            else
+            {
+                FREE_OBJ(ObjString, object);
+            }
             break;
         }
         case OBJ_SWITCH:
         {
             ObjSwitch* sw = (ObjSwitch*)object;
             bl_hashtable_free(vm, &sw->table);
-            FREE(ObjSwitch, object);
+            FREE_OBJ(ObjSwitch, object);
             break;
         }
         case OBJ_PTR:
@@ -369,7 +805,7 @@ void bl_mem_freeobject(VMState* vm, Object** pobject)
             {
                 ptr->fnptrfree(ptr->pointer);
             }
-            FREE(ObjPointer, object);
+            FREE_OBJ(ObjPointer, object);
             break;
         }
         default:
@@ -407,6 +843,7 @@ static void bl_mem_markroots(VMState* vm)
     /*
     bl_mem_marktable(vm, &vm->classobjstring);
     bl_mem_marktable(vm, &vm->classobjbytes);
+    bl_mem_marktable(vm, &vm->classobjstrbuilder);
     bl_mem_marktable(vm, &vm->classobjfile);
     bl_mem_marktable(vm, &vm->classobjlist);
     bl_mem_marktable(vm, &vm->classobjdict);
@@ -426,36 +863,211 @@ static void bl_mem_tracerefs(VMState* vm)
     }
 }
 
-static void bl_mem_gcsweep(VMState* vm)
+/*
+* refills the private stack of a marker, from its own shared stack first,
+* then by stealing half of someone else's.
+*/
+static bool bl_mem_markerrefill(GCMarker* marker)
+{
+    int i;
+    int count;
+    GCMarker* victim;
+    for(i = 0; i < bl_mem_markercount; i++)
+    {
+        victim = &bl_mem_markers[(marker - bl_mem_markers + i) % bl_mem_markercount];
+        if(__atomic_load_n(&victim->sharedcount, __ATOMIC_RELAXED) == 0)
+        {
+            continue;
+        }
+        pthread_mutex_lock(&victim->lock);
+        count = victim == marker ? victim->sharedcount : (victim->sharedcount + 1) / 2;
+        if(count > 0)
+        {
+            bl_mem_graymove(victim->shared, &victim->sharedcount, &marker->local, &marker->localcount, &marker->localcapacity, count);
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if(count > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void* bl_mem_markerrun(void* arg)
 {
-    Object* previous;
+    int i;
+    bool found;
     Object* object;
-    Object* unreached;
-    previous = NULL;
-    object = vm->objectlinks;
-    while(object != NULL)
+    GCMarker* marker;
+    marker = (GCMarker*)arg;
+    bl_mem_marker = marker;
+    for(;;)
     {
-        if(object->mark)
+        while(marker->localcount > 0 || bl_mem_markerrefill(marker))
         {
-            object->mark = false;
-            previous = object;
-            object = object->sibling;
+            object = marker->local[--marker->localcount];
+            bl_mem_blackenobject(marker->vm, object);
+            if(marker->localcount > GC_MARKER_SHARE_AT && __atomic_load_n(&marker->sharedcount, __ATOMIC_RELAXED) == 0)
+            {
+                pthread_mutex_lock(&marker->lock);
+                bl_mem_graymove(marker->local, &marker->localcount, &marker->shared, &marker->sharedcount, &marker->sharedcapacity, marker->localcount / 2);
+                pthread_mutex_unlock(&marker->lock);
+            }
         }
-        else
+        // out of work. the trace is done once every marker is, as only a busy
+        // marker can share more; otherwise, go back to work if any shows up.
+        __atomic_add_fetch(&bl_mem_idlemarkers, 1, __ATOMIC_SEQ_CST);
+        for(;;)
+        {
+            if(__atomic_load_n(&bl_mem_idlemarkers, __ATOMIC_SEQ_CST) == bl_mem_markercount)
+            {
+                bl_mem_marker = NULL;
+                return NULL;
+            }
+            found = false;
+            for(i = 0; i < bl_mem_markercount && !found; i++)
+            {
+                found = __atomic_load_n(&bl_mem_markers[i].sharedcount, __ATOMIC_RELAXED) > 0;
+            }
+            if(found)
+            {
+                __atomic_sub_fetch(&bl_mem_idlemarkers, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+/*
+* same as bl_mem_tracerefs(), but with vm->gcmarkers threads (this one
+* included) sharing the work. the gray objects left by the roots are dealt
+* out to them first.
+*/
+static void bl_mem_paralleltrace(VMState* vm)
+{
+    int i;
+    int count;
+    GCMarker* marker;
+    count = vm->gcmarkers < GC_MAX_MARKERS ? vm->gcmarkers : GC_MAX_MARKERS;
+    bl_mem_markers = (GCMarker*)calloc(count, sizeof(GCMarker));
+    if(bl_mem_markers == NULL)
+    {
+        bl_mem_tracerefs(vm);
+        return;
+    }
+    bl_mem_markercount = count;
+    bl_mem_idlemarkers = 0;
+    vm->gcparalleltraces++;
+    for(i = 0; i < count; i++)
+    {
+        marker = &bl_mem_markers[i];
+        marker->vm = vm;
+        pthread_mutex_init(&marker->lock, NULL);
+    }
+    // dealt onto the shared stacks, where any marker can pick them up.
+    for(i = 0; i < vm->graycount; i++)
+    {
+        marker = &bl_mem_markers[i % count];
+        bl_mem_graypush(&marker->shared, &marker->sharedcount, &marker->sharedcapacity, vm->graystack[i]);
+    }
+    vm->graycount = 0;
+    for(i = 1; i < count; i++)
+    {
+        marker = &bl_mem_markers[i];
+        if(pthread_create(&marker->thread, NULL, bl_mem_markerrun, marker) != 0)
+        {
+            // counted as done from the start; its share gets stolen.
+            marker->thread = pthread_self();
+            __atomic_add_fetch(&bl_mem_idlemarkers, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+    bl_mem_markerrun(&bl_mem_markers[0]);
+    for(i = 0; i < count; i++)
+    {
+        marker = &bl_mem_markers[i];
+        if(i > 0 && !pthread_equal(marker->thread, pthread_self()))
+        {
+            pthread_join(marker->thread, NULL);
+        }
+        pthread_mutex_destroy(&marker->lock);
+        free(marker->local);
+        free(marker->shared);
+    }
+    free(bl_mem_markers);
+    bl_mem_markers = NULL;
+    bl_mem_markercount = 0;
+}
+
+static void bl_mem_forgetremembered(VMState* vm)
+{
+    int i;
+    for(i = 0; i < vm->remembercount; i++)
+    {
+        vm->rememberset[i]->remembered = false;
+    }
+    vm->remembercount = 0;
+}
+
+/*
+* hands the buffers freed by a sweep over to the background freer, if any.
+*/
+static void bl_mem_endsweeping(VMState* vm)
+{
+    vm->gcsweeping = false;
+    if(vm->gcfreer != NULL)
+    {
+        bl_mem_freerflush(vm);
+    }
+}
+
+/*
+* frees the unmarked young objects and promotes the others, which
+* leaves no young objects behind.
+*/
+static void bl_mem_sweepyoung(VMState* vm)
+{
+    Object* next;
+    Object* object;
+    Object* first;
+    Object* last;
+    first = NULL;
+    last = NULL;
+    object = vm->younglinks;
+    vm->younglinks = NULL;
+    vm->gcsweeping = true;
+    while(object != NULL)
+    {
+        next = object->sibling;
+        if(bl_mem_ismarked(object))
         {
-            unreached = object;
-            object = object->sibling;
-            if(previous != NULL)
+            bl_mem_setmarked(object, false);
+            object->old = true;
+            // keep the newest-first order, so that objects are still freed before what they point to.
+            if(last == NULL)
             {
-                previous->sibling = object;
+                first = object;
             }
             else
             {
-                vm->objectlinks = object;
+                last->sibling = object;
             }
-            bl_mem_freeobject(vm, &unreached);
+            last = object;
         }
+        else
+        {
+            bl_mem_freeobject(vm, &object);
+        }
+        object = next;
+    }
+    if(last != NULL)
+    {
+        last->sibling = vm->objectlinks;
+        vm->objectlinks = first;
     }
+    vm->youngbytes = 0;
+    bl_mem_endsweeping(vm);
 }
 
 void bl_mem_freegcobjects(VMState* vm)
@@ -464,6 +1076,14 @@ void bl_mem_freegcobjects(VMState* vm)
     Object* next;
     Object* object;
     i = 0;
+    // young objects first, as they may still point into the old ones.
+    object = vm->younglinks;
+    while(object != NULL)
+    {
+        next = object->sibling;
+        bl_mem_freeobject(vm, &object);
+        object = next;
+    }
     object = vm->objectlinks;
     while(object != NULL)
     {
@@ -473,12 +1093,366 @@ void bl_mem_freegcobjects(VMState* vm)
         bl_mem_freeobject(vm, &object);
         object = next;
     }
+    // and whatever an unfinished incremental sweep still holds.
+    if(vm->sweptlast != NULL)
+    {
+        vm->sweptlast->sibling = vm->sweeplinks;
+        vm->sweeplinks = vm->sweptfirst;
+    }
+    object = vm->sweeplinks;
+    while(object != NULL)
+    {
+        next = object->sibling;
+        bl_mem_freeobject(vm, &object);
+        object = next;
+    }
+    vm->objectlinks = NULL;
+    vm->younglinks = NULL;
+    vm->sweeplinks = NULL;
+    vm->sweptfirst = NULL;
+    vm->sweptlast = NULL;
+    vm->gcphase = GC_PHASE_IDLE;
     free(vm->graystack);
     vm->graystack = NULL;
+    free(vm->rememberset);
+    vm->rememberset = NULL;
+    vm->remembercount = 0;
+}
+
+/*
+* collects only the young objects: everything reachable from the roots or
+* from a remembered old object survives and is promoted.
+*/
+void bl_mem_collectyoung(VMState* vm)
+{
+    int i;
+    int64_t started;
+    started = bl_mem_gcclock();
+    vm->allowgc = false;
+    vm->gcisminor = true;
+    bl_mem_markroots(vm);
+    for(i = 0; i < vm->remembercount; i++)
+    {
+        bl_mem_blackenobject(vm, vm->rememberset[i]);
+    }
+    bl_mem_tracerefs(vm);
+    bl_hashtable_removewhites(vm, &vm->strings);
+    bl_hashtable_removewhites(vm, &vm->modules);
+    bl_mem_sweepyoung(vm);
+    bl_mem_forgetremembered(vm);
+    vm->gcisminor = false;
+    vm->gcminorcollections++;
+    bl_mem_recordpause(vm, bl_mem_gcclock() - started);
+    vm->allowgc = true;
+}
+
+/*
+* microseconds on a monotonic clock, for bounding the incremental slices
+* and timing the collections.
+*/
+int64_t bl_mem_gcclock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/*
+* counts a stop of the mutator of pause microseconds.
+*/
+void bl_mem_recordpause(VMState* vm, int64_t pause)
+{
+    int bucket;
+    vm->gcpausetotal += pause;
+    if(pause > vm->gcpausemax)
+    {
+        vm->gcpausemax = pause;
+    }
+    bucket = 0;
+    while(bucket < GC_PAUSE_BUCKETS - 1 && pause >= ((int64_t)1 << bucket))
+    {
+        bucket++;
+    }
+    vm->gcpausehistogram[bucket]++;
+}
+
+/*
+* traces gray objects until there are none left, or until the deadline
+* (if any) has passed. returns true once the marking is done.
+*/
+static bool bl_mem_markslice(VMState* vm, int64_t deadline)
+{
+    int count;
+    Object* object;
+    count = 0;
+    while(vm->graycount > 0)
+    {
+        object = vm->graystack[--vm->graycount];
+        bl_mem_blackenobject(vm, object);
+        // the clock costs more than most objects, so it is only checked now and then.
+        if((++count & 63) == 0 && deadline > 0 && bl_mem_gcclock() > deadline)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+* marks everything reachable in one go, with several threads when the
+* heap is large enough for it to pay off.
+*/
+static void bl_mem_markall(VMState* vm)
+{
+    bl_mem_markroots(vm);
+    if(vm->gcmarkers > 1 && vm->bytesallocated >= GC_PARALLEL_MIN_HEAP)
+    {
+        bl_mem_paralleltrace(vm);
+    }
+    else
+    {
+        bl_mem_tracerefs(vm);
+    }
+}
+
+/*
+* once everything is marked, the young objects are swept right away,
+* while the old ones are set aside to be swept in slices.
+*/
+static void bl_mem_beginsweep(VMState* vm)
+{
+    size_t before;
+    bl_hashtable_removewhites(vm, &vm->strings);
+    bl_hashtable_removewhites(vm, &vm->modules);
+    // the remembered objects may be about to be freed.
+    bl_mem_forgetremembered(vm);
+    vm->sweeplinks = vm->objectlinks;
+    vm->objectlinks = NULL;
+    vm->sweptfirst = NULL;
+    vm->sweptlast = NULL;
+    before = vm->bytesallocated;
+    bl_mem_sweepyoung(vm);
+    vm->gcfreed += before - vm->bytesallocated;
+    vm->gcphase = GC_PHASE_SWEEP;
+}
+
+/*
+* the last part of the marking, done in one go: whatever the mutator
+* stored since the collection began is reached again through the roots
+* and the remembered objects.
+*/
+static void bl_mem_finishmark(VMState* vm)
+{
+    int i;
+    bl_mem_markroots(vm);
+    for(i = 0; i < vm->remembercount; i++)
+    {
+        bl_mem_blackenobject(vm, vm->rememberset[i]);
+    }
+    bl_mem_tracerefs(vm);
+    bl_mem_beginsweep(vm);
+}
+
+/*
+* same as bl_mem_markslice(), for the sweep, which may also be bounded to
+* limit objects (0 for no limit). the survivors are kept in order, so that
+* objects are still freed before what they point to.
+*/
+static bool bl_mem_sweepslice(VMState* vm, int64_t deadline, int limit)
+{
+    int count;
+    size_t before;
+    Object* object;
+    count = 0;
+    before = vm->bytesallocated;
+    vm->gcsweeping = true;
+    while(vm->sweeplinks != NULL)
+    {
+        object = vm->sweeplinks;
+        vm->sweeplinks = object->sibling;
+        if(bl_mem_ismarked(object))
+        {
+            bl_mem_setmarked(object, false);
+            // survivors are only relinked past the freed objects, to leave the others' pages untouched.
+            if(vm->sweptlast == NULL)
+            {
+                vm->sweptfirst = object;
+            }
+            else if(vm->sweptlast->sibling != object)
+            {
+                vm->sweptlast->sibling = object;
+            }
+            vm->sweptlast = object;
+        }
+        else
+        {
+            bl_mem_freeobject(vm, &object);
+        }
+        count++;
+        if((limit > 0 && count >= limit) || ((count & 63) == 0 && deadline > 0 && bl_mem_gcclock() > deadline))
+        {
+            vm->gcfreed += before - vm->bytesallocated;
+            bl_mem_endsweeping(vm);
+            return false;
+        }
+    }
+    vm->gcfreed += before - vm->bytesallocated;
+    bl_mem_endsweeping(vm);
+    return true;
+}
+
+static void bl_mem_finishsweep(VMState* vm)
+{
+    Object* object;
+    // objects promoted during the sweep are the newer ones, so they stay in front.
+    if(vm->sweptfirst != NULL)
+    {
+        if(vm->sweptlast->sibling != NULL)
+        {
+            vm->sweptlast->sibling = NULL;
+        }
+        if(vm->objectlinks == NULL)
+        {
+            vm->objectlinks = vm->sweptfirst;
+        }
+        else
+        {
+            object = vm->objectlinks;
+            while(object->sibling != NULL)
+            {
+                object = object->sibling;
+            }
+            object->sibling = vm->sweptfirst;
+        }
+    }
+    vm->sweptfirst = NULL;
+    vm->sweptlast = NULL;
+    vm->gcphase = GC_PHASE_IDLE;
+}
+
+/*
+* sizes the heap for the next full collection. the room given to the heap
+* over what survived grows while collecting takes up more than the target
+* share of the run time, and shrinks back while it takes much less and
+* most of the heap turns out to be garbage. the soft limit caps the next
+* threshold, though never below GC_HEAP_GROWTH_FACTOR times the live heap.
+*/
+static void bl_mem_resizeheap(VMState* vm)
+{
+    int64_t now;
+    int64_t elapsed;
+    double target;
+    double headroom;
+    size_t live;
+    size_t threshold;
+    now = bl_mem_gcclock();
+    live = vm->bytesallocated;
+    elapsed = now - vm->gclastcycle;
+    vm->gclastcycle = now;
+    if(elapsed > 0)
+    {
+        // averaged with the previous cycles, so that one odd collection doesn't swing the heap size.
+        vm->gctimeshare = (vm->gctimeshare + ((double)vm->gctime / elapsed)) / 2;
+    }
+    vm->gcsurvival = 1;
+    if(vm->gcheapbefore > 0 && vm->gcfreed < vm->gcheapbefore)
+    {
+        vm->gcsurvival = 1 - ((double)vm->gcfreed / vm->gcheapbefore);
+    }
+    if(vm->gctimetarget > 0)
+    {
+        target = vm->gctimetarget / 100.0;
+        headroom = vm->gcgrowth - 1;
+        if(vm->gctimeshare > target)
+        {
+            headroom *= vm->gctimeshare > target * 2 ? 2 : vm->gctimeshare / target;
+        }
+        else if(vm->gctimeshare < target / 2 && vm->gcsurvival < 0.5)
+        {
+            headroom *= 0.75;
+        }
+        if(headroom < GC_HEAP_GROWTH_FACTOR - 1)
+        {
+            headroom = GC_HEAP_GROWTH_FACTOR - 1;
+        }
+        else if(headroom > GC_MAX_HEAP_GROWTH - 1)
+        {
+            headroom = GC_MAX_HEAP_GROWTH - 1;
+        }
+        vm->gcgrowth = 1 + headroom;
+    }
+    threshold = (size_t)(live * vm->gcgrowth);
+    if(threshold < vm->gcminheap)
+    {
+        threshold = vm->gcminheap;
+    }
+    if(vm->gcsoftlimit > 0 && threshold > vm->gcsoftlimit)
+    {
+        threshold = (size_t)(live * GC_HEAP_GROWTH_FACTOR);
+        if(threshold < vm->gcsoftlimit)
+        {
+            threshold = vm->gcsoftlimit;
+        }
+    }
+    vm->nextgc = threshold;
+}
+
+static void bl_mem_begincycle(VMState* vm)
+{
+    vm->gccollections++;
+    vm->gcheapbefore = vm->bytesallocated;
+    vm->gcfreed = 0;
+    vm->gctime = 0;
+}
+
+/*
+* accounts for the time spent on a piece of a full collection, and sizes
+* the heap once the collection is over. returns the time spent.
+*/
+static int64_t bl_mem_endpiece(VMState* vm, int64_t started)
+{
+    int64_t spent;
+    spent = bl_mem_gcclock() - started;
+    vm->gctime += spent;
+    if(vm->gcphase == GC_PHASE_IDLE)
+    {
+        bl_mem_resizeheap(vm);
+    }
+    return spent;
+}
+
+/*
+* runs a collection in progress, if any, to its end, and returns the time
+* it took.
+*/
+static int64_t bl_mem_runtoend(VMState* vm)
+{
+    bool allowgc;
+    int64_t started;
+    int64_t spent;
+    if(vm->gcphase == GC_PHASE_IDLE)
+    {
+        return 0;
+    }
+    started = bl_mem_gcclock();
+    allowgc = vm->allowgc;
+    vm->allowgc = false;
+    if(vm->gcphase == GC_PHASE_MARK)
+    {
+        bl_mem_tracerefs(vm);
+        bl_mem_finishmark(vm);
+    }
+    bl_mem_sweepslice(vm, 0, 0);
+    bl_mem_finishsweep(vm);
+    spent = bl_mem_endpiece(vm, started);
+    vm->allowgc = allowgc;
+    return spent;
 }
 
 void bl_mem_collectgarbage(VMState* vm)
 {
+    int64_t paused;
+    int64_t started;
     if(!vm->allowgc)
     {
         //return;
@@ -487,19 +1461,166 @@ void bl_mem_collectgarbage(VMState* vm)
     printf("-- gc begins\n");
     size_t before = vm->bytesallocated;
 #endif
+    // a collection in progress is completed first, as its marks would be in the way.
+    paused = bl_mem_runtoend(vm);
+    started = bl_mem_gcclock();
     vm->allowgc = false;
-    bl_mem_markroots(vm);
-    bl_mem_tracerefs(vm);
-    bl_hashtable_removewhites(vm, &vm->strings);
-    bl_hashtable_removewhites(vm, &vm->modules);
-    bl_mem_gcsweep(vm);
-    vm->nextgc = vm->bytesallocated * GC_HEAP_GROWTH_FACTOR;
+    bl_mem_begincycle(vm);
+    bl_mem_markall(vm);
+    bl_mem_beginsweep(vm);
+    bl_mem_sweepslice(vm, 0, 0);
+    bl_mem_finishsweep(vm);
+    paused += bl_mem_endpiece(vm, started);
+    bl_mem_recordpause(vm, paused);
     vm->allowgc = true;
 #if defined(DEBUG_LOG_GC) && DEBUG_LOG_GC
     printf("-- gc ends\n");
     printf("   collected %zu bytes (from %zu to %zu), next at %zu\n", before - vm->bytesallocated, before, vm->bytesallocated, vm->nextgc);
+    bl_slab_printstats(vm, stdout);
+#endif
+}
+
+/*
+* a full collection that tells snapshot about every object it finds alive
+* and every reference it follows. the tracing is never split between
+* threads here, so that each object is written along with its references.
+*/
+void bl_mem_collectsnapshot(VMState* vm, HeapSnapshot* snapshot)
+{
+    int64_t paused;
+    int64_t started;
+    Object* object;
+    paused = bl_mem_runtoend(vm);
+    started = bl_mem_gcclock();
+    vm->allowgc = false;
+    bl_mem_begincycle(vm);
+    vm->heapsnapshot = snapshot;
+    bl_snapshot_beginroots(snapshot);
+    bl_mem_markroots(vm);
+    bl_snapshot_endobject(snapshot);
+    while(vm->graycount > 0)
+    {
+        object = vm->graystack[--vm->graycount];
+        bl_snapshot_beginobject(snapshot, object);
+        bl_mem_blackenobject(vm, object);
+        bl_snapshot_endobject(snapshot);
+    }
+    vm->heapsnapshot = NULL;
+    bl_mem_beginsweep(vm);
+    bl_mem_sweepslice(vm, 0, 0);
+    bl_mem_finishsweep(vm);
+    paused += bl_mem_endpiece(vm, started);
+    bl_mem_recordpause(vm, paused);
+    vm->allowgc = true;
+}
+
+/*
+* a full collection that only pauses for the marking: the old objects
+* are then swept lazily, a few at a time as the allocator asks for more
+* memory, by bl_mem_gcstep().
+*/
+void bl_mem_collectlazily(VMState* vm)
+{
+    int64_t started;
+#if defined(DEBUG_LOG_GC) && DEBUG_LOG_GC
+    printf("-- lazy gc begins\n");
 #endif
+    started = bl_mem_gcclock();
+    vm->allowgc = false;
+    bl_mem_begincycle(vm);
+    bl_mem_markall(vm);
+    bl_mem_beginsweep(vm);
+    bl_mem_recordpause(vm, bl_mem_endpiece(vm, started));
+    vm->gcstepbytes = 0;
+    vm->allowgc = true;
 }
 
+/*
+* begins an incremental collection. only the roots are marked here; the
+* tracing and the sweeping are left to bl_mem_gcstep().
+*/
+void bl_mem_startcollection(VMState* vm)
+{
+    int64_t started;
+#if defined(DEBUG_LOG_GC) && DEBUG_LOG_GC
+    printf("-- incremental gc begins\n");
+#endif
+    started = bl_mem_gcclock();
+    vm->allowgc = false;
+    vm->gcphase = GC_PHASE_MARK;
+    vm->gcstepbytes = 0;
+    bl_mem_begincycle(vm);
+    bl_mem_markroots(vm);
+    bl_mem_recordpause(vm, bl_mem_endpiece(vm, started));
+    vm->allowgc = true;
+}
 
+/*
+* does a slice of the incremental collection each time GC_STEP_SIZE more
+* bytes have been allocated. a slice ends once it has used up the pause
+* budget (or, for a lazy sweep, after GC_SWEEP_STEP objects), unless the
+* heap has grown to twice its limit in the meantime: then the collection
+* is hurried to its end, lest it never catches up.
+*/
+void bl_mem_gcstep(VMState* vm, size_t bytes)
+{
+    int limit;
+    int64_t started;
+    int64_t deadline;
+    vm->gcstepbytes += bytes;
+    if(!vm->allowgc || vm->gcstepbytes < GC_STEP_SIZE)
+    {
+        return;
+    }
+    vm->gcstepbytes = 0;
+    vm->allowgc = false;
+    started = bl_mem_gcclock();
+    deadline = 0;
+    limit = 0;
+    if(vm->bytesallocated < vm->nextgc * 2)
+    {
+        if(vm->gcpausebudget > 0)
+        {
+            deadline = started + vm->gcpausebudget;
+        }
+        else
+        {
+            limit = GC_SWEEP_STEP;
+        }
+    }
+    if(vm->gcphase == GC_PHASE_MARK)
+    {
+        vm->gcmarkslices++;
+        if(bl_mem_markslice(vm, deadline))
+        {
+            bl_mem_finishmark(vm);
+        }
+    }
+    else
+    {
+        vm->gcsweepslices++;
+        if(bl_mem_sweepslice(vm, deadline, limit))
+        {
+            bl_mem_finishsweep(vm);
+        }
+    }
+    bl_mem_recordpause(vm, bl_mem_endpiece(vm, started));
+#if defined(DEBUG_LOG_GC) && DEBUG_LOG_GC
+    if(vm->gcphase == GC_PHASE_IDLE)
+    {
+        printf("-- gc sweep ends, next at %zu\n", vm->nextgc);
+    }
+#endif
+    vm->allowgc = true;
+}
 
+/*
+* runs a collection in progress, if any, to its end.
+*/
+void bl_mem_finishcollection(VMState* vm)
+{
+    if(vm->gcphase != GC_PHASE_IDLE)
+    {
+        bl_mem_recordpause(vm, bl_mem_runtoend(vm));
+    }
+}
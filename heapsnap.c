@@ -0,0 +1,912 @@
+#include "blade.h"
+
+/*
+* heap snapshots. a snapshot is written by a full collection that reports
+* every object it reaches and every reference it follows, one line each:
+*
+*   blade-heap-snapshot 1
+*   r <id> <id> ...                        the objects the roots point to
+*   <id> <type> <size> <name> <id> ...     an object, and the ones it points to
+*
+* ids are the objects' addresses in hex, size the bytes an object takes up
+* along with the buffers only it owns, and name the class of an instance,
+* or the name of a class, function or module (- for anything else).
+* bl_snapshot_summarize() reads a snapshot back.
+*/
+
+#define SNAPSHOT_MAGIC "blade-heap-snapshot"
+#define SNAPSHOT_VERSION 1
+// how many of the largest retainers a summary lists, and how far up their retaining chain
+#define SNAPSHOT_TOP_COUNT 20
+#define SNAPSHOT_CHAIN_LENGTH 6
+
+struct HeapSnapshot
+{
+    FILE* out;
+    Object* current;
+};
+
+// the vm a SIGUSR2 asks for a snapshot of
+static VMState* bl_snapshot_signalvm;
+
+static size_t bl_snapshot_tablesize(HashTable* table)
+{
+    return sizeof(HashEntry) * table->capacity;
+}
+
+static size_t bl_snapshot_shallowsize(Object* object)
+{
+    switch(object->type)
+    {
+        case OBJ_STRING:
+        {
+            ObjString* string = (ObjString*)object;
+            return (string->isrope ? sizeof(ObjRope) : sizeof(ObjString)) + (string->chars != NULL ? string->length + 1 : 0);
+        }
+        case OBJ_RANGE:
+            return sizeof(ObjRange);
+        case OBJ_ARRAY:
+            return sizeof(ObjArray) + (sizeof(Value) * ((ObjArray*)object)->items.capacity);
+        case OBJ_DICT:
+        {
+            ObjDict* dict = (ObjDict*)object;
+            return sizeof(ObjDict) + (sizeof(Value) * dict->names.capacity) + bl_snapshot_tablesize(&dict->items);
+        }
+        case OBJ_FILE:
+            return sizeof(ObjFile);
+        case OBJ_BYTES:
+            return sizeof(ObjBytes) + ((ObjBytes*)object)->bytes.count;
+        case OBJ_STRBUILDER:
+            return sizeof(ObjStringBuilder) + ((ObjStringBuilder*)object)->builder.capacity;
+        case OBJ_UP_VALUE:
+            return sizeof(ObjUpvalue);
+        case OBJ_BOUNDFUNCTION:
+            return sizeof(ObjBoundMethod);
+        case OBJ_CLOSURE:
+            return sizeof(ObjClosure) + (sizeof(ObjUpvalue*) * ((ObjClosure*)object)->upvaluecount);
+        case OBJ_SCRIPTFUNCTION:
+        {
+            BinaryBlob* blob = &((ObjFunction*)object)->blob;
+            return sizeof(ObjFunction) + (blob->capacity * (sizeof(uint8_t) + sizeof(int))) + (sizeof(Value) * blob->constants.capacity)
+                   + (sizeof(InlineCache) * blob->cachecapacity) + (sizeof(GlobalCache) * blob->globalcachecapacity);
+        }
+        case OBJ_INSTANCE:
+        {
+            ObjInstance* instance = (ObjInstance*)object;
+            size_t size = sizeof(ObjInstance) + (sizeof(Value) * instance->slotcapacity);
+            if(instance->properties != NULL)
+            {
+                size += sizeof(HashTable) + bl_snapshot_tablesize(instance->properties);
+            }
+            return size;
+        }
+        case OBJ_NATIVEFUNCTION:
+            return sizeof(ObjNativeFunction);
+        case OBJ_CLASS:
+        {
+            ObjClass* klass = (ObjClass*)object;
+            return sizeof(ObjClass) + bl_snapshot_tablesize(&klass->properties) + bl_snapshot_tablesize(&klass->staticproperties)
+                   + bl_snapshot_tablesize(&klass->methods);
+        }
+        case OBJ_MODULE:
+            return sizeof(ObjModule) + bl_snapshot_tablesize(&((ObjModule*)object)->values);
+        case OBJ_SWITCH:
+            return sizeof(ObjSwitch) + bl_snapshot_tablesize(&((ObjSwitch*)object)->table);
+        case OBJ_PTR:
+            return sizeof(ObjPointer);
+    }
+    return 0;
+}
+
+/*
+* called by the collection for every reference it follows.
+*/
+void bl_snapshot_addref(HeapSnapshot* snapshot, Object* object)
+{
+    // some objects mark themselves, which is no reference worth telling.
+    if(object != snapshot->current)
+    {
+        fprintf(snapshot->out, " %" PRIxPTR, (uintptr_t)object);
+    }
+}
+
+void bl_snapshot_beginroots(HeapSnapshot* snapshot)
+{
+    snapshot->current = NULL;
+    fputc('r', snapshot->out);
+}
+
+void bl_snapshot_beginobject(HeapSnapshot* snapshot, Object* object)
+{
+    const char* name;
+    ObjString* string;
+    name = NULL;
+    string = NULL;
+    if(object->type == OBJ_INSTANCE)
+    {
+        string = ((ObjInstance*)object)->klass->name;
+    }
+    else if(object->type == OBJ_CLASS)
+    {
+        string = ((ObjClass*)object)->name;
+    }
+    else if(object->type == OBJ_SCRIPTFUNCTION)
+    {
+        string = ((ObjFunction*)object)->name;
+    }
+    else if(object->type == OBJ_MODULE)
+    {
+        name = ((ObjModule*)object)->name;
+    }
+    if(string != NULL)
+    {
+        name = string->chars;
+    }
+    // names are identifiers, save for the odd internal one that won't fit the format.
+    if(name == NULL || name[0] == '\0' || strpbrk(name, " \n") != NULL)
+    {
+        name = "-";
+    }
+    snapshot->current = object;
+    fprintf(snapshot->out, "%" PRIxPTR " %s %zu %s", (uintptr_t)object, bl_gc_typename(object->type), bl_snapshot_shallowsize(object), name);
+}
+
+void bl_snapshot_endobject(HeapSnapshot* snapshot)
+{
+    fputc('\n', snapshot->out);
+}
+
+/*
+* runs a full collection that writes a snapshot of what it finds alive to
+* path. returns false if the file could not be written.
+*/
+bool bl_snapshot_write(VMState* vm, const char* path)
+{
+    HeapSnapshot snapshot;
+    bool ok;
+    snapshot.out = fopen(path, "w");
+    if(snapshot.out == NULL)
+    {
+        return false;
+    }
+    snapshot.current = NULL;
+    fprintf(snapshot.out, "%s %d\n", SNAPSHOT_MAGIC, SNAPSHOT_VERSION);
+    bl_mem_collectsnapshot(vm, &snapshot);
+    ok = !ferror(snapshot.out);
+    if(fclose(snapshot.out) != 0)
+    {
+        ok = false;
+    }
+    return ok;
+}
+
+static void bl_snapshot_onsignal(int signal)
+{
+    (void)signal;
+    if(bl_snapshot_signalvm != NULL)
+    {
+        bl_snapshot_signalvm->snapshotrequested = 1;
+    }
+}
+
+/*
+* makes SIGUSR2 ask vm for a snapshot. as a snapshot can't be written from
+* within a signal handler, it is taken by the next allocation that would
+* run a minor collection instead.
+*/
+void bl_snapshot_handlesignal(VMState* vm)
+{
+    struct sigaction action;
+    bl_snapshot_signalvm = vm;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = bl_snapshot_onsignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR2, &action, NULL);
+}
+
+/*
+* writes the snapshot asked for by a signal, named after the process.
+*/
+void bl_snapshot_writerequested(VMState* vm)
+{
+    static int count = 0;
+    char path[64];
+    vm->snapshotrequested = 0;
+    snprintf(path, sizeof(path), "blade-%d-%d.heapsnapshot", (int)getpid(), ++count);
+    if(bl_snapshot_write(vm, path))
+    {
+        fprintf(stderr, "heap snapshot written to %s\n", path);
+    }
+    else
+    {
+        fprintf(stderr, "could not write heap snapshot %s: %s\n", path, strerror(errno));
+    }
+}
+
+/*
+* the summariser. the snapshot is read into a graph, rooted at a node of
+* its own (node 0) that points to whatever the roots do, whose dominator
+* tree gives how much memory each object keeps alive.
+*/
+
+typedef struct SnapNode SnapNode;
+struct SnapNode
+{
+    uint64_t id;
+    int type;
+    // the class of an instance, the name of a class or function, or -1
+    int name;
+    size_t size;
+    int firstedge;
+    int edgecount;
+};
+
+typedef struct SnapGraph SnapGraph;
+struct SnapGraph
+{
+    SnapNode* nodes;
+    int nodecount;
+    int nodecapacity;
+    // the ids the references point to, and then the nodes they resolve to (-1 for none)
+    uint64_t* edgeids;
+    int* edges;
+    int edgecount;
+    int edgecapacity;
+    char** names;
+    int namecount;
+    int namecapacity;
+    // open addressed indices into nodes (by id) and names, -1 for a free slot
+    int* nodeslots;
+    int nodeslotcapacity;
+    int* nameslots;
+    int nameslotcapacity;
+};
+
+static bool bl_snapshot_grow(void** items, int* capacity, int needed, size_t size)
+{
+    int newcapacity;
+    void* grown;
+    if(needed <= *capacity)
+    {
+        return true;
+    }
+    newcapacity = *capacity < 8 ? 8 : *capacity;
+    while(newcapacity < needed)
+    {
+        newcapacity *= 2;
+    }
+    grown = realloc(*items, size * newcapacity);
+    if(grown == NULL)
+    {
+        return false;
+    }
+    *items = grown;
+    *capacity = newcapacity;
+    return true;
+}
+
+static uint32_t bl_snapshot_hashid(uint64_t id)
+{
+    id ^= id >> 33;
+    id *= 0xff51afd7ed558ccdULL;
+    id ^= id >> 33;
+    return (uint32_t)id;
+}
+
+static uint32_t bl_snapshot_hashname(const char* name)
+{
+    uint32_t hash;
+    hash = 2166136261u;
+    for(; *name != '\0'; name++)
+    {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+* (re)builds a table of slots for the first count items, with room for
+* needed items, hashed by hashof.
+*/
+static bool bl_snapshot_rehash(SnapGraph* graph, int** slots, int* capacity, int count, int needed, uint32_t (*hashof)(SnapGraph*, int))
+{
+    int i;
+    int slot;
+    int newcapacity;
+    int* newslots;
+    newcapacity = *capacity < 64 ? 64 : *capacity;
+    while(newcapacity < needed * 2)
+    {
+        newcapacity *= 2;
+    }
+    newslots = (int*)malloc(sizeof(int) * newcapacity);
+    if(newslots == NULL)
+    {
+        return false;
+    }
+    memset(newslots, 0xff, sizeof(int) * newcapacity);
+    for(i = 0; i < count; i++)
+    {
+        slot = (int)(hashof(graph, i) & (uint32_t)(newcapacity - 1));
+        while(newslots[slot] != -1)
+        {
+            slot = (slot + 1) & (newcapacity - 1);
+        }
+        newslots[slot] = i;
+    }
+    free(*slots);
+    *slots = newslots;
+    *capacity = newcapacity;
+    return true;
+}
+
+static uint32_t bl_snapshot_nodehash(SnapGraph* graph, int index)
+{
+    return bl_snapshot_hashid(graph->nodes[index].id);
+}
+
+static uint32_t bl_snapshot_namehash(SnapGraph* graph, int index)
+{
+    return bl_snapshot_hashname(graph->names[index]);
+}
+
+static int bl_snapshot_findnode(SnapGraph* graph, uint64_t id)
+{
+    int slot;
+    slot = (int)(bl_snapshot_hashid(id) & (uint32_t)(graph->nodeslotcapacity - 1));
+    while(graph->nodeslots[slot] != -1)
+    {
+        if(graph->nodes[graph->nodeslots[slot]].id == id)
+        {
+            return graph->nodeslots[slot];
+        }
+        slot = (slot + 1) & (graph->nodeslotcapacity - 1);
+    }
+    return -1;
+}
+
+static int bl_snapshot_internname(SnapGraph* graph, const char* name)
+{
+    int slot;
+    char* copy;
+    if(strcmp(name, "-") == 0)
+    {
+        return -1;
+    }
+    if(graph->namecount * 2 >= graph->nameslotcapacity)
+    {
+        if(!bl_snapshot_rehash(graph, &graph->nameslots, &graph->nameslotcapacity, graph->namecount, graph->namecount + 1, bl_snapshot_namehash))
+        {
+            return -2;
+        }
+    }
+    slot = (int)(bl_snapshot_hashname(name) & (uint32_t)(graph->nameslotcapacity - 1));
+    while(graph->nameslots[slot] != -1)
+    {
+        if(strcmp(graph->names[graph->nameslots[slot]], name) == 0)
+        {
+            return graph->nameslots[slot];
+        }
+        slot = (slot + 1) & (graph->nameslotcapacity - 1);
+    }
+    copy = strdup(name);
+    if(copy == NULL || !bl_snapshot_grow((void**)&graph->names, &graph->namecapacity, graph->namecount + 1, sizeof(char*)))
+    {
+        free(copy);
+        return -2;
+    }
+    graph->names[graph->namecount] = copy;
+    graph->nameslots[slot] = graph->namecount;
+    return graph->namecount++;
+}
+
+static int bl_snapshot_typeof(const char* name)
+{
+    int i;
+    for(i = 0; i < OBJ_TYPE_COUNT; i++)
+    {
+        if(strcmp(bl_gc_typename((ObjType)i), name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool bl_snapshot_addnode(SnapGraph* graph, uint64_t id, int type, size_t size, int name)
+{
+    SnapNode* node;
+    if(!bl_snapshot_grow((void**)&graph->nodes, &graph->nodecapacity, graph->nodecount + 1, sizeof(SnapNode)))
+    {
+        return false;
+    }
+    node = &graph->nodes[graph->nodecount++];
+    node->id = id;
+    node->type = type;
+    node->name = name;
+    node->size = size;
+    node->firstedge = graph->edgecount;
+    node->edgecount = 0;
+    return true;
+}
+
+static bool bl_snapshot_addedge(SnapGraph* graph, uint64_t id)
+{
+    if(!bl_snapshot_grow((void**)&graph->edgeids, &graph->edgecapacity, graph->edgecount + 1, sizeof(uint64_t)))
+    {
+        return false;
+    }
+    graph->edgeids[graph->edgecount++] = id;
+    graph->nodes[graph->nodecount - 1].edgecount++;
+    return true;
+}
+
+/*
+* reads a snapshot into graph. returns an error message, or NULL.
+*/
+static const char* bl_snapshot_read(SnapGraph* graph, FILE* in)
+{
+    int i;
+    int type;
+    int name;
+    int version;
+    char* line;
+    char* token;
+    char* rest;
+    char* sizetoken;
+    char* nametoken;
+    size_t linecapacity;
+    uint64_t id;
+    line = NULL;
+    linecapacity = 0;
+    if(getline(&line, &linecapacity, in) < 0 || sscanf(line, SNAPSHOT_MAGIC " %d", &version) != 1)
+    {
+        free(line);
+        return "not a heap snapshot";
+    }
+    if(version != SNAPSHOT_VERSION)
+    {
+        free(line);
+        return "unsupported snapshot version";
+    }
+    // the root of the graph; the "r" line gives it its references.
+    if(!bl_snapshot_addnode(graph, 0, -1, 0, -1))
+    {
+        free(line);
+        return "out of memory";
+    }
+    while(getline(&line, &linecapacity, in) >= 0)
+    {
+        token = strtok_r(line, " \n", &rest);
+        if(token == NULL)
+        {
+            continue;
+        }
+        if(strcmp(token, "r") != 0)
+        {
+            id = strtoull(token, NULL, 16);
+            token = strtok_r(NULL, " \n", &rest);
+            sizetoken = strtok_r(NULL, " \n", &rest);
+            nametoken = strtok_r(NULL, " \n", &rest);
+            if(token == NULL || sizetoken == NULL || nametoken == NULL || (type = bl_snapshot_typeof(token)) < 0)
+            {
+                free(line);
+                return "malformed snapshot";
+            }
+            name = bl_snapshot_internname(graph, nametoken);
+            if(name == -2 || !bl_snapshot_addnode(graph, id, type, (size_t)strtoull(sizetoken, NULL, 10), name))
+            {
+                free(line);
+                return "out of memory";
+            }
+        }
+        while((token = strtok_r(NULL, " \n", &rest)) != NULL)
+        {
+            if(!bl_snapshot_addedge(graph, strtoull(token, NULL, 16)))
+            {
+                free(line);
+                return "out of memory";
+            }
+        }
+    }
+    free(line);
+    if(!bl_snapshot_rehash(graph, &graph->nodeslots, &graph->nodeslotcapacity, graph->nodecount, graph->nodecount, bl_snapshot_nodehash))
+    {
+        return "out of memory";
+    }
+    graph->edges = (int*)malloc(sizeof(int) * (graph->edgecount + 1));
+    if(graph->edges == NULL)
+    {
+        return "out of memory";
+    }
+    for(i = 0; i < graph->edgecount; i++)
+    {
+        graph->edges[i] = bl_snapshot_findnode(graph, graph->edgeids[i]);
+    }
+    return NULL;
+}
+
+static void bl_snapshot_freegraph(SnapGraph* graph)
+{
+    int i;
+    for(i = 0; i < graph->namecount; i++)
+    {
+        free(graph->names[i]);
+    }
+    free(graph->names);
+    free(graph->nodes);
+    free(graph->edgeids);
+    free(graph->edges);
+    free(graph->nodeslots);
+    free(graph->nameslots);
+}
+
+/*
+* numbers the nodes reachable from the root in depth-first postorder.
+* returns how many were reached.
+*/
+static int bl_snapshot_postorder(SnapGraph* graph, int* order, int* postnum)
+{
+    int node;
+    int next;
+    int count;
+    int depth;
+    int* stack;
+    int* cursor;
+    bool* seen;
+    stack = (int*)malloc(sizeof(int) * graph->nodecount);
+    cursor = (int*)malloc(sizeof(int) * graph->nodecount);
+    seen = (bool*)calloc(graph->nodecount, sizeof(bool));
+    if(stack == NULL || cursor == NULL || seen == NULL)
+    {
+        free(stack);
+        free(cursor);
+        free(seen);
+        return -1;
+    }
+    count = 0;
+    depth = 0;
+    stack[depth] = 0;
+    cursor[depth] = 0;
+    seen[0] = true;
+    while(depth >= 0)
+    {
+        node = stack[depth];
+        if(cursor[depth] < graph->nodes[node].edgecount)
+        {
+            next = graph->edges[graph->nodes[node].firstedge + cursor[depth]++];
+            if(next >= 0 && !seen[next])
+            {
+                seen[next] = true;
+                depth++;
+                stack[depth] = next;
+                cursor[depth] = 0;
+            }
+            continue;
+        }
+        postnum[node] = count;
+        order[count++] = node;
+        depth--;
+    }
+    free(stack);
+    free(cursor);
+    free(seen);
+    return count;
+}
+
+static int bl_snapshot_intersect(int* idom, int* postnum, int a, int b)
+{
+    while(a != b)
+    {
+        while(postnum[a] < postnum[b])
+        {
+            a = idom[a];
+        }
+        while(postnum[b] < postnum[a])
+        {
+            b = idom[b];
+        }
+    }
+    return a;
+}
+
+/*
+* finds the immediate dominator of every reachable node, after Cooper,
+* Harvey and Kennedy's "A Simple, Fast Dominance Algorithm".
+*/
+static bool bl_snapshot_dominators(SnapGraph* graph, int* order, int* postnum, int count, int* idom)
+{
+    int i;
+    int j;
+    int node;
+    int from;
+    int pred;
+    int newidom;
+    bool changed;
+    int* predstart;
+    int* preds;
+    int* fill;
+    predstart = (int*)calloc(graph->nodecount + 1, sizeof(int));
+    preds = (int*)malloc(sizeof(int) * (graph->edgecount + 1));
+    fill = (int*)malloc(sizeof(int) * (graph->nodecount + 1));
+    if(predstart == NULL || preds == NULL || fill == NULL)
+    {
+        free(predstart);
+        free(preds);
+        free(fill);
+        return false;
+    }
+    for(i = 0; i < graph->edgecount; i++)
+    {
+        if(graph->edges[i] >= 0)
+        {
+            predstart[graph->edges[i] + 1]++;
+        }
+    }
+    for(i = 0; i < graph->nodecount; i++)
+    {
+        predstart[i + 1] += predstart[i];
+        fill[i] = predstart[i];
+    }
+    for(from = 0; from < graph->nodecount; from++)
+    {
+        for(j = 0; j < graph->nodes[from].edgecount; j++)
+        {
+            node = graph->edges[graph->nodes[from].firstedge + j];
+            if(node >= 0)
+            {
+                preds[fill[node]++] = from;
+            }
+        }
+    }
+    for(i = 0; i < graph->nodecount; i++)
+    {
+        idom[i] = -1;
+    }
+    idom[0] = 0;
+    changed = true;
+    while(changed)
+    {
+        changed = false;
+        // reverse postorder, skipping the root (numbered last)
+        for(i = count - 2; i >= 0; i--)
+        {
+            node = order[i];
+            newidom = -1;
+            for(j = predstart[node]; j < predstart[node + 1]; j++)
+            {
+                pred = preds[j];
+                if(postnum[pred] < 0 || idom[pred] == -1)
+                {
+                    continue;
+                }
+                newidom = newidom == -1 ? pred : bl_snapshot_intersect(idom, postnum, pred, newidom);
+            }
+            if(newidom != -1 && idom[node] != newidom)
+            {
+                idom[node] = newidom;
+                changed = true;
+            }
+        }
+    }
+    free(predstart);
+    free(preds);
+    free(fill);
+    return true;
+}
+
+static void bl_snapshot_describe(SnapGraph* graph, int node, FILE* out)
+{
+    SnapNode* n;
+    n = &graph->nodes[node];
+    if(node == 0)
+    {
+        fprintf(out, "(roots)");
+    }
+    else if(n->name >= 0)
+    {
+        fprintf(out, "%s %s @%" PRIx64, bl_gc_typename((ObjType)n->type), graph->names[n->name], n->id);
+    }
+    else
+    {
+        fprintf(out, "%s @%" PRIx64, bl_gc_typename((ObjType)n->type), n->id);
+    }
+}
+
+typedef struct SnapGroup SnapGroup;
+struct SnapGroup
+{
+    int node;
+    size_t count;
+    size_t size;
+};
+
+static int bl_snapshot_comparegroups(const void* a, const void* b)
+{
+    size_t x;
+    size_t y;
+    x = ((const SnapGroup*)a)->size;
+    y = ((const SnapGroup*)b)->size;
+    return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+/*
+* totals by type (by class, for instances).
+*/
+static void bl_snapshot_printtypes(SnapGraph* graph, FILE* out)
+{
+    int i;
+    int key;
+    int groupcount;
+    SnapNode* node;
+    SnapGroup* groups;
+    groupcount = OBJ_TYPE_COUNT + graph->namecount;
+    groups = (SnapGroup*)calloc(groupcount, sizeof(SnapGroup));
+    if(groups == NULL)
+    {
+        return;
+    }
+    for(i = 0; i < groupcount; i++)
+    {
+        groups[i].node = -1;
+    }
+    for(i = 1; i < graph->nodecount; i++)
+    {
+        node = &graph->nodes[i];
+        key = node->type == OBJ_INSTANCE && node->name >= 0 ? OBJ_TYPE_COUNT + node->name : node->type;
+        groups[key].node = i;
+        groups[key].count++;
+        groups[key].size += node->size;
+    }
+    qsort(groups, groupcount, sizeof(SnapGroup), bl_snapshot_comparegroups);
+    fprintf(out, "\n  %10s %12s  %s\n", "objects", "bytes", "type");
+    for(i = 0; i < groupcount && groups[i].node >= 0; i++)
+    {
+        node = &graph->nodes[groups[i].node];
+        if(node->type == OBJ_INSTANCE && node->name >= 0)
+        {
+            fprintf(out, "  %10zu %12zu  %s %s\n", groups[i].count, groups[i].size, bl_gc_typename((ObjType)node->type), graph->names[node->name]);
+        }
+        else
+        {
+            fprintf(out, "  %10zu %12zu  %s\n", groups[i].count, groups[i].size, bl_gc_typename((ObjType)node->type));
+        }
+    }
+    free(groups);
+}
+
+/*
+* the objects keeping the most memory alive, and what keeps them alive.
+*/
+static void bl_snapshot_printretainers(SnapGraph* graph, int* idom, size_t* retained, FILE* out)
+{
+    int i;
+    int j;
+    int node;
+    int count;
+    SnapGroup* top;
+    count = 0;
+    top = (SnapGroup*)malloc(sizeof(SnapGroup) * graph->nodecount);
+    if(top == NULL)
+    {
+        return;
+    }
+    for(i = 1; i < graph->nodecount; i++)
+    {
+        if(idom[i] >= 0)
+        {
+            top[count].node = i;
+            top[count].count = 0;
+            top[count].size = retained[i];
+            count++;
+        }
+    }
+    qsort(top, count, sizeof(SnapGroup), bl_snapshot_comparegroups);
+    fprintf(out, "\n  %10s %12s  %s\n", "retained", "bytes", "object");
+    for(i = 0; i < count && i < SNAPSHOT_TOP_COUNT; i++)
+    {
+        node = top[i].node;
+        fprintf(out, "  %10zu %12zu  ", retained[node], graph->nodes[node].size);
+        bl_snapshot_describe(graph, node, out);
+        fprintf(out, "\n  %10s %12s    held by ", "", "");
+        node = idom[node];
+        for(j = 0; j < SNAPSHOT_CHAIN_LENGTH; j++)
+        {
+            bl_snapshot_describe(graph, node, out);
+            if(node == 0)
+            {
+                break;
+            }
+            node = idom[node];
+            fprintf(out, " <- ");
+        }
+        if(j == SNAPSHOT_CHAIN_LENGTH)
+        {
+            fprintf(out, "...");
+        }
+        fprintf(out, "\n");
+    }
+    free(top);
+}
+
+/*
+* prints what a snapshot holds by type, and which objects retain the most
+* memory (the memory that would be freed along with them). returns false
+* if the snapshot could not be read.
+*/
+bool bl_snapshot_summarize(const char* path, FILE* out)
+{
+    int i;
+    int count;
+    int node;
+    int* order;
+    int* postnum;
+    int* idom;
+    size_t total;
+    size_t* retained;
+    const char* error;
+    FILE* in;
+    SnapGraph graph;
+    in = fopen(path, "r");
+    if(in == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    memset(&graph, 0, sizeof(graph));
+    error = bl_snapshot_read(&graph, in);
+    fclose(in);
+    order = NULL;
+    postnum = NULL;
+    idom = NULL;
+    retained = NULL;
+    if(error == NULL)
+    {
+        order = (int*)malloc(sizeof(int) * graph.nodecount);
+        postnum = (int*)malloc(sizeof(int) * graph.nodecount);
+        idom = (int*)malloc(sizeof(int) * graph.nodecount);
+        retained = (size_t*)malloc(sizeof(size_t) * graph.nodecount);
+        error = "out of memory";
+        if(order != NULL && postnum != NULL && idom != NULL && retained != NULL)
+        {
+            for(i = 0; i < graph.nodecount; i++)
+            {
+                postnum[i] = -1;
+            }
+            count = bl_snapshot_postorder(&graph, order, postnum);
+            if(count > 0 && bl_snapshot_dominators(&graph, order, postnum, count, idom))
+            {
+                error = NULL;
+            }
+        }
+    }
+    if(error != NULL)
+    {
+        fprintf(stderr, "%s: %s\n", path, error);
+    }
+    else
+    {
+        total = 0;
+        for(i = 0; i < graph.nodecount; i++)
+        {
+            retained[i] = graph.nodes[i].size;
+            total += graph.nodes[i].size;
+        }
+        // postorder visits whatever a node dominates before the node itself.
+        for(i = 0; i < count - 1; i++)
+        {
+            node = order[i];
+            retained[idom[node]] += retained[node];
+        }
+        fprintf(out, "heap snapshot %s: %d objects, %zu bytes, %d references\n", path, graph.nodecount - 1, total, graph.edgecount);
+        bl_snapshot_printtypes(&graph, out);
+        bl_snapshot_printretainers(&graph, idom, retained, out);
+    }
+    free(order);
+    free(postnum);
+    free(idom);
+    free(retained);
+    bl_snapshot_freegraph(&graph);
+    return error == NULL;
+}
@@ -181,7 +181,7 @@ static void run_file(VMState* vm, char* file)
 void show_usage(char* argv[], bool fail)
 {
     FILE* out = fail ? stderr : stdout;
-    fprintf(out, "Usage: %s [-[h | d | j | v | g]] [filename]\n", argv[0]);
+    fprintf(out, "Usage: %s [-[h | d | j | v | c | C | g | m | r | p | t | s | a | A | H]] [filename]\n", argv[0]);
     fprintf(out, "   -h    Show this help message.\n");
     fprintf(out, "   -v    Show version string.\n");
     fprintf(out, "   -b    Buffer terminal outputs.\n");
@@ -189,10 +189,39 @@ void show_usage(char* argv[], bool fail)
     fprintf(out, "   -d    Show generated bytecode.\n");
     fprintf(out, "   -j    Show stack objects during execution.\n");
     fprintf(out, "   -e<s> eval <s>\n");
+    fprintf(out, "   -c    Cache compiled bytecode next to each source file.\n");
+    fprintf(out, "   -C<d> Cache compiled bytecode in directory <d>.\n");
     fprintf(out,
             "   -g    Sets the minimum heap size in kilobytes before the GC\n"
             "         can start. [Default = %d (%dmb)]\n",
             DEFAULT_GC_START / 1024, DEFAULT_GC_START / (1024 * 1024));
+    fprintf(out,
+            "   -m    Sets a soft limit in kilobytes on the heap size, which\n"
+            "         collects more often as the heap nears it. [Default = none]\n");
+    fprintf(out,
+            "   -r    Sets the share of the run time (in percent) the GC aims\n"
+            "         to spend collecting, growing the heap to stay under it.\n"
+            "         0 grows the heap by a fixed factor. [Default = %d]\n",
+            GC_DEFAULT_TIME_TARGET);
+    fprintf(out,
+            "   -p    Collects garbage incrementally, pausing for at most about\n"
+            "         this many microseconds at a time. [Default = off]\n");
+    fprintf(out,
+            "   -t    Sets the number of threads marking a large heap in a full\n"
+            "         collection. [Default = the number of cores]\n");
+    fprintf(out,
+            "   -s    Frees the memory of collected objects on a background\n"
+            "         thread. [Default = off]\n");
+    fprintf(out,
+            "   -a    Samples an allocation every this many bytes allocated,\n"
+            "         with the call stack it came from. [Default = %d]\n",
+            ALLOC_SAMPLE_INTERVAL);
+    fprintf(out,
+            "   -A<f> Writes the allocations sampled to file <f> at exit, as\n"
+            "         folded stacks. [Default = blade-<pid>.folded]\n");
+    fprintf(out,
+            "   -H<f> Summarizes the heap snapshot in file <f> and exits.\n"
+            "         [Snapshots come from _gc.snapshot(), or sending SIGUSR2]\n");
     exit(fail ? EXIT_FAILURE : EXIT_SUCCESS);
 }
 
@@ -201,11 +230,21 @@ int main(int argc, char* argv[])
     bool shoulddebugstack;
     bool shouldbufferstdout;
     bool shouldprintbytecode;
+    bool shouldcachebytecode;
+    bool shouldfreeinbackground;
     int i;
     int opt;
     int next;
     int nextgcstart;
+    int gcsoftlimit;
+    int gctimetarget;
+    int gcpausebudget;
+    int gcmarkers;
+    int allocinterval;
     char** stdargs;
+    char* bytecodecachedir;
+    char* allocprofilepath;
+    char defaultprofilepath[64];
     const char* codeline;
     VMState* vm;
     vm = (VMState*)malloc(sizeof(VMState));
@@ -220,11 +259,20 @@ int main(int argc, char* argv[])
     shoulddebugstack = false;
     shouldprintbytecode = false;
     shouldbufferstdout = false;
+    shouldcachebytecode = false;
+    shouldfreeinbackground = false;
+    bytecodecachedir = NULL;
     nextgcstart = DEFAULT_GC_START;
+    gcsoftlimit = 0;
+    gctimetarget = GC_DEFAULT_TIME_TARGET;
+    gcpausebudget = 0;
+    gcmarkers = 0;
+    allocinterval = 0;
+    allocprofilepath = NULL;
     codeline = NULL;
     if(argc > 1)
     {
-        while((opt = getopt(argc, argv, "hdbjvg:e:")) != -1)
+        while((opt = getopt(argc, argv, "hdbjvcsC:g:m:r:p:t:a:A:e:H:")) != -1)
         {
             switch(opt)
             {
@@ -263,11 +311,82 @@ int main(int argc, char* argv[])
                     }
                 }
                 break;
+                case 'm':
+                {
+                    next = (int)strtol(optarg, NULL, 10);
+                    if(next > 0)
+                    {
+                        gcsoftlimit = next;// expected value is in kilobytes
+                    }
+                }
+                break;
+                case 'r':
+                {
+                    next = (int)strtol(optarg, NULL, 10);
+                    if(next >= 0 && next <= 100)
+                    {
+                        gctimetarget = next;
+                    }
+                }
+                break;
+                case 'p':
+                {
+                    next = (int)strtol(optarg, NULL, 10);
+                    if(next > 0)
+                    {
+                        gcpausebudget = next;// expected value is in microseconds
+                    }
+                }
+                break;
+                case 't':
+                {
+                    next = (int)strtol(optarg, NULL, 10);
+                    if(next > 0)
+                    {
+                        gcmarkers = next;
+                    }
+                }
+                break;
+                case 's':
+                {
+                    shouldfreeinbackground = true;
+                }
+                break;
+                case 'a':
+                {
+                    next = (int)strtol(optarg, NULL, 10);
+                    if(next > 0)
+                    {
+                        allocinterval = next;
+                    }
+                }
+                break;
+                case 'A':
+                {
+                    allocprofilepath = optarg;
+                }
+                break;
+                case 'H':
+                {
+                    return bl_snapshot_summarize(optarg, stdout) ? EXIT_SUCCESS : EXIT_FAILURE;
+                }
+                break;
                 case 'e':
                 {
                     codeline = optarg;
                 }
                 break;
+                case 'c':
+                {
+                    shouldcachebytecode = true;
+                }
+                break;
+                case 'C':
+                {
+                    shouldcachebytecode = true;
+                    bytecodecachedir = optarg;
+                }
+                break;
                 default:
                 {
                     show_usage(argv, true);// exits
@@ -281,7 +400,32 @@ int main(int argc, char* argv[])
         // set vm options...
         vm->shoulddebugstack = shoulddebugstack;
         vm->shouldprintbytecode = shouldprintbytecode;
+        vm->shouldcachebytecode = shouldcachebytecode;
+        vm->bytecodecachedir = bytecodecachedir;
         vm->nextgc = nextgcstart;
+        vm->gcminheap = nextgcstart;
+        vm->gcsoftlimit = (size_t)gcsoftlimit * 1024;
+        vm->gctimetarget = gctimetarget;
+        vm->gcpausebudget = gcpausebudget;
+        if(gcmarkers > 0)
+        {
+            vm->gcmarkers = gcmarkers;
+        }
+        if(shouldfreeinbackground)
+        {
+            bl_mem_startfreer(vm);
+        }
+        bl_snapshot_handlesignal(vm);
+        if(allocinterval > 0 || allocprofilepath != NULL)
+        {
+            if(allocprofilepath == NULL)
+            {
+                snprintf(defaultprofilepath, sizeof(defaultprofilepath), "blade-%d.folded", (int)getpid());
+                allocprofilepath = defaultprofilepath;
+            }
+            bl_profile_start(vm, allocinterval > 0 ? allocinterval : ALLOC_SAMPLE_INTERVAL);
+            bl_profile_writeatexit(vm, allocprofilepath);
+        }
         if(shouldbufferstdout)
         {
             // forcing printf buffering for TTYs and terminals
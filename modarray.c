@@ -12,7 +12,10 @@ ObjArray* bl_object_makelist(VMState* vm)
 
 void bl_array_push(VMState* vm, ObjArray* list, Value value)
 {
+    bl_vm_pushvalue(vm, value);// growing the list may collect
     bl_valarray_push(vm, &list->items, value);
+    bl_vm_popvalue(vm);
+    bl_mem_writebarrier(vm, (Object*)list);
 }
 
 void array_free(void* data)
@@ -193,6 +196,7 @@ static bool objfn_list_insert(VMState* vm, int argcount, Value* args)
     ObjArray* list = AS_LIST(METHOD_OBJECT);
     int index = (int)AS_NUMBER(args[1]);
     bl_valarray_insert(vm, &list->items, args[0], index);
+    bl_mem_writebarrier(vm, (Object*)list);
     return bl_value_returnempty(vm, args);
     ;
 }
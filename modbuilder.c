@@ -0,0 +1,87 @@
+#include "blade.h"
+
+/*
+* the buffer of a script's builder is counted against the heap as it grows,
+* just the way the bytes of a Bytes are.
+*/
+static void bl_builder_countgrowth(VMState* vm, ObjStringBuilder* builder, size_t oldcapacity)
+{
+    vm->bytesallocated += builder->builder.capacity - oldcapacity;
+}
+
+static bool objfn_builder_length(VMState* vm, int argcount, Value* args)
+{
+    ENFORCE_ARG_COUNT(length, 0);
+    RETURN_NUMBER((double)AS_STRBUILDER(METHOD_OBJECT)->builder.length);
+}
+
+static bool objfn_builder_append(VMState* vm, int argcount, Value* args)
+{
+    size_t oldcapacity;
+    ObjStringBuilder* builder;
+    ENFORCE_ARG_COUNT(append, 1);
+    builder = AS_STRBUILDER(METHOD_OBJECT);
+    oldcapacity = builder->builder.capacity;
+    bl_builder_appendvalue(vm, &builder->builder, args[0]);
+    bl_builder_countgrowth(vm, builder, oldcapacity);
+    RETURN_VALUE(METHOD_OBJECT);
+}
+
+static bool objfn_builder_appendbytes(VMState* vm, int argcount, Value* args)
+{
+    size_t oldcapacity;
+    ObjBytes* bytes;
+    ObjStringBuilder* builder;
+    ENFORCE_ARG_COUNT(append_bytes, 1);
+    ENFORCE_ARG_TYPE(append_bytes, 0, bl_value_isbytes);
+    builder = AS_STRBUILDER(METHOD_OBJECT);
+    bytes = AS_BYTES(args[0]);
+    oldcapacity = builder->builder.capacity;
+    bl_builder_append(&builder->builder, (const char*)bytes->bytes.bytes, bytes->bytes.count);
+    bl_builder_countgrowth(vm, builder, oldcapacity);
+    RETURN_VALUE(METHOD_OBJECT);
+}
+
+static bool objfn_builder_appendnumber(VMState* vm, int argcount, Value* args)
+{
+    size_t oldcapacity;
+    ObjStringBuilder* builder;
+    ENFORCE_ARG_COUNT(append_number, 1);
+    ENFORCE_ARG_TYPE(append_number, 0, bl_value_isnumber);
+    builder = AS_STRBUILDER(METHOD_OBJECT);
+    oldcapacity = builder->builder.capacity;
+    bl_builder_appendnumber(&builder->builder, AS_NUMBER(args[0]));
+    bl_builder_countgrowth(vm, builder, oldcapacity);
+    RETURN_VALUE(METHOD_OBJECT);
+}
+
+static bool objfn_builder_clear(VMState* vm, int argcount, Value* args)
+{
+    ENFORCE_ARG_COUNT(clear, 0);
+    bl_builder_clear(&AS_STRBUILDER(METHOD_OBJECT)->builder);
+    RETURN_VALUE(METHOD_OBJECT);
+}
+
+/*
+* hands the buffer over to the string returned, without copying it, and
+* leaves the builder empty.
+*/
+static bool objfn_builder_tostring(VMState* vm, int argcount, Value* args)
+{
+    ObjStringBuilder* builder;
+    ENFORCE_ARG_COUNT(to_string, 0);
+    builder = AS_STRBUILDER(METHOD_OBJECT);
+    // the string counts what it keeps of the buffer.
+    vm->bytesallocated -= builder->builder.capacity;
+    RETURN_OBJ(bl_builder_take(vm, &builder->builder));
+}
+
+void bl_state_initbuildermethods(VMState* vm)
+{
+    bl_class_defnativefield(vm, vm->classobjstrbuilder, "length", objfn_builder_length);
+    bl_class_defnativemethod(vm, vm->classobjstrbuilder, "append", objfn_builder_append);
+    bl_class_defnativemethod(vm, vm->classobjstrbuilder, "append_bytes", objfn_builder_appendbytes);
+    bl_class_defnativemethod(vm, vm->classobjstrbuilder, "append_number", objfn_builder_appendnumber);
+    bl_class_defnativemethod(vm, vm->classobjstrbuilder, "clear", objfn_builder_clear);
+    bl_class_defnativemethod(vm, vm->classobjstrbuilder, "to_string", objfn_builder_tostring);
+}
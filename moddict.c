@@ -28,8 +28,12 @@ ObjPointer* bl_dict_makeptr(VMState* vm, void* pointer)
 
 void bl_dict_addentry(VMState* vm, ObjDict* dict, Value key, Value value)
 {
+    bl_vm_pushvalue(vm, key);// growing the dictionary may collect
+    bl_vm_pushvalue(vm, value);
     bl_valarray_push(vm, &dict->names, key);
     bl_hashtable_set(vm, &dict->items, key, value);
+    bl_vm_popvaluen(vm, 2);
+    bl_mem_writebarrier(vm, (Object*)dict);
 }
 
 bool bl_dict_getentry(ObjDict* dict, Value key, Value* value)
@@ -53,12 +57,18 @@ bool bl_dict_getentry(ObjDict* dict, Value key, Value* value)
 
 bool bl_dict_setentry(VMState* vm, ObjDict* dict, Value key, Value value)
 {
+    bool isnew;
     Value tempvalue;
+    bl_vm_pushvalue(vm, key);// growing the dictionary may collect
+    bl_vm_pushvalue(vm, value);
     if(!bl_hashtable_get(&dict->items, key, &tempvalue))
     {
         bl_valarray_push(vm, &dict->names, key);// add key if it doesn't exist.
     }
-    return bl_hashtable_set(vm, &dict->items, key, value);
+    isnew = bl_hashtable_set(vm, &dict->items, key, value);
+    bl_vm_popvaluen(vm, 2);
+    bl_mem_writebarrier(vm, (Object*)dict);
+    return isnew;
 }
 
 
@@ -121,6 +131,7 @@ static bool objfn_dict_clone(VMState* vm, int argcount, Value* args)
     {
         bl_valarray_push(vm, &ndict->names, dict->names.values[i]);
     }
+    bl_mem_writebarrier(vm, (Object*)ndict);
     RETURN_OBJ(ndict);
 }
 
@@ -161,6 +172,7 @@ static bool objfn_dict_extend(VMState* vm, int argcount, Value* args)
         bl_valarray_push(vm, &dict->names, dictcpy->names.values[i]);
     }
     bl_hashtable_addall(vm, &dictcpy->items, &dict->items);
+    bl_mem_writebarrier(vm, (Object*)dict);
     return bl_value_returnempty(vm, args);
     ;
 }
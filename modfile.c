@@ -210,7 +210,7 @@ static bool objfn_file_read(VMState* vm, int argcount, Value* args)
     file_close(file);
     if(!inbinarymode)
     {
-        RETURN_T_STRING(buffer, bytesread);
+        RETURN_U_STRING(buffer, bytesread);
     }
     RETURN_OBJ(bl_bytes_takebytes(vm, (unsigned char*)buffer, bytesread));
 }
@@ -294,7 +294,7 @@ static bool objfn_file_gets(VMState* vm, int argcount, Value* args)
     }
     if(!inbinarymode)
     {
-        RETURN_T_STRING(buffer, bytesread);
+        RETURN_U_STRING(buffer, bytesread);
     }
     RETURN_OBJ(bl_bytes_takebytes(vm, (unsigned char*)buffer, bytesread));
 }
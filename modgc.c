@@ -0,0 +1,246 @@
+#include "blade.h"
+
+/*
+* the _gc module, for looking into the collector from scripts.
+* times are in microseconds, sizes in bytes.
+*/
+
+static const char* gctypenames[OBJ_TYPE_COUNT] = {
+    [OBJ_STRING] = "String",
+    [OBJ_RANGE] = "Range",
+    [OBJ_ARRAY] = "List",
+    [OBJ_DICT] = "Dictionary",
+    [OBJ_FILE] = "File",
+    [OBJ_BYTES] = "Bytes",
+    [OBJ_STRBUILDER] = "StringBuilder",
+    [OBJ_UP_VALUE] = "Upvalue",
+    [OBJ_BOUNDFUNCTION] = "BoundMethod",
+    [OBJ_CLOSURE] = "Closure",
+    [OBJ_SCRIPTFUNCTION] = "Function",
+    [OBJ_INSTANCE] = "Instance",
+    [OBJ_NATIVEFUNCTION] = "NativeFunction",
+    [OBJ_CLASS] = "Class",
+    [OBJ_MODULE] = "Module",
+    [OBJ_SWITCH] = "Switch",
+    [OBJ_PTR] = "Pointer",
+};
+
+const char* bl_gc_typename(ObjType type)
+{
+    return gctypenames[type];
+}
+
+bool modfn_gc_policy(VMState* vm, int argcount, Value* args)
+{
+    ENFORCE_ARG_COUNT(policy, 0);
+    ObjDict* dict = (ObjDict*)bl_mem_gcprotect(vm, (Object*)bl_object_makedict(vm));
+    bl_dict_setentry(vm, dict, GC_STRING("heapsize"), NUMBER_VAL((double)vm->bytesallocated));
+    bl_dict_setentry(vm, dict, GC_STRING("nextgc"), NUMBER_VAL((double)vm->nextgc));
+    bl_dict_setentry(vm, dict, GC_STRING("minheap"), NUMBER_VAL((double)vm->gcminheap));
+    bl_dict_setentry(vm, dict, GC_STRING("softlimit"), NUMBER_VAL((double)vm->gcsoftlimit));
+    bl_dict_setentry(vm, dict, GC_STRING("timetarget"), NUMBER_VAL(vm->gctimetarget));
+    bl_dict_setentry(vm, dict, GC_STRING("timeshare"), NUMBER_VAL(vm->gctimeshare * 100));
+    bl_dict_setentry(vm, dict, GC_STRING("growth"), NUMBER_VAL(vm->gcgrowth));
+    bl_dict_setentry(vm, dict, GC_STRING("survival"), NUMBER_VAL(vm->gcsurvival));
+    RETURN_OBJ(dict);
+}
+
+/*
+* collection counts, the slices incremental ones were done in, and pauses.
+* pauses[i] counts the pauses shorter than 2^i microseconds (and not
+* shorter than pauses[i - 1]'s limit).
+*/
+bool modfn_gc_stats(VMState* vm, int argcount, Value* args)
+{
+    int i;
+    ENFORCE_ARG_COUNT(stats, 0);
+    ObjDict* dict = (ObjDict*)bl_mem_gcprotect(vm, (Object*)bl_object_makedict(vm));
+    ObjArray* pauses = (ObjArray*)bl_mem_gcprotect(vm, (Object*)bl_object_makelist(vm));
+    for(i = 0; i < GC_PAUSE_BUCKETS; i++)
+    {
+        bl_array_push(vm, pauses, NUMBER_VAL((double)vm->gcpausehistogram[i]));
+    }
+    bl_dict_setentry(vm, dict, GC_STRING("collections"), NUMBER_VAL((double)vm->gccollections));
+    bl_dict_setentry(vm, dict, GC_STRING("minorcollections"), NUMBER_VAL((double)vm->gcminorcollections));
+    bl_dict_setentry(vm, dict, GC_STRING("markslices"), NUMBER_VAL((double)vm->gcmarkslices));
+    bl_dict_setentry(vm, dict, GC_STRING("paralleltraces"), NUMBER_VAL((double)vm->gcparalleltraces));
+    bl_dict_setentry(vm, dict, GC_STRING("sweepslices"), NUMBER_VAL((double)vm->gcsweepslices));
+    bl_dict_setentry(vm, dict, GC_STRING("freedbatches"), NUMBER_VAL((double)vm->gcfreedbatches));
+    bl_dict_setentry(vm, dict, GC_STRING("totalpause"), NUMBER_VAL((double)vm->gcpausetotal));
+    bl_dict_setentry(vm, dict, GC_STRING("maxpause"), NUMBER_VAL((double)vm->gcpausemax));
+    bl_dict_setentry(vm, dict, GC_STRING("pauses"), OBJ_VAL(pauses));
+    bl_dict_setentry(vm, dict, GC_STRING("heapsize"), NUMBER_VAL((double)vm->bytesallocated));
+    bl_dict_setentry(vm, dict, GC_STRING("sincelast"), NUMBER_VAL((double)vm->youngbytes));
+    bl_dict_setentry(vm, dict, GC_STRING("objects"), NUMBER_VAL((double)vm->objectcount));
+    RETURN_OBJ(dict);
+}
+
+/*
+* the objects not freed yet and the memory they take up themselves (short
+* strings hold their characters, but what objects own besides, like the
+* buffer of a long string, isn't counted), by type. right after collect(),
+* those are the live ones.
+*/
+bool modfn_gc_objects(VMState* vm, int argcount, Value* args)
+{
+    int i;
+    ObjDict* entry;
+    ENFORCE_ARG_COUNT(objects, 0);
+    ObjDict* dict = (ObjDict*)bl_mem_gcprotect(vm, (Object*)bl_object_makedict(vm));
+    for(i = 0; i < OBJ_TYPE_COUNT; i++)
+    {
+        if(vm->gctypecount[i] == 0)
+        {
+            continue;
+        }
+        entry = (ObjDict*)bl_mem_gcprotect(vm, (Object*)bl_object_makedict(vm));
+        bl_dict_setentry(vm, entry, GC_STRING("count"), NUMBER_VAL((double)vm->gctypecount[i]));
+        bl_dict_setentry(vm, entry, GC_STRING("bytes"), NUMBER_VAL((double)vm->gctypebytes[i]));
+        bl_dict_setentry(vm, dict, GC_STRING(bl_gc_typename((ObjType)i)), OBJ_VAL(entry));
+    }
+    RETURN_OBJ(dict);
+}
+
+/*
+* the size classes gc objects are carved out of (see slab.c) that have
+* pages, smallest first: the size of their objects, their pages, and the
+* slots on those that are in use and in all. large objects, which get
+* pages of their own, aren't in any.
+*/
+bool modfn_gc_slabs(VMState* vm, int argcount, Value* args)
+{
+    int i;
+    ObjDict* entry;
+    SlabClass* sc;
+    ENFORCE_ARG_COUNT(slabs, 0);
+    ObjArray* list = (ObjArray*)bl_mem_gcprotect(vm, (Object*)bl_object_makelist(vm));
+    for(i = 0; i < SLAB_CLASS_COUNT; i++)
+    {
+        sc = &vm->slabs[i];
+        if(sc->pagecount == 0)
+        {
+            continue;
+        }
+        entry = (ObjDict*)bl_mem_gcprotect(vm, (Object*)bl_object_makedict(vm));
+        bl_dict_setentry(vm, entry, GC_STRING("size"), NUMBER_VAL((double)sc->size));
+        bl_dict_setentry(vm, entry, GC_STRING("pages"), NUMBER_VAL((double)sc->pagecount));
+        bl_dict_setentry(vm, entry, GC_STRING("used"), NUMBER_VAL((double)sc->used));
+        bl_dict_setentry(vm, entry, GC_STRING("slots"), NUMBER_VAL((double)bl_slab_slotcount(sc)));
+        bl_array_push(vm, list, OBJ_VAL(entry));
+    }
+    RETURN_OBJ(list);
+}
+
+/*
+* runs a full collection, even while collections are disabled, and
+* returns the bytes it freed.
+*/
+bool modfn_gc_collect(VMState* vm, int argcount, Value* args)
+{
+    size_t before;
+    ENFORCE_ARG_COUNT(collect, 0);
+    before = vm->bytesallocated;
+    bl_mem_collectgarbage(vm);
+    RETURN_NUMBER(before > vm->bytesallocated ? (double)(before - vm->bytesallocated) : 0);
+}
+
+bool modfn_gc_disable(VMState* vm, int argcount, Value* args)
+{
+    ENFORCE_ARG_COUNT(disable, 0);
+    vm->gcdisabled = true;
+    return bl_value_returnnil(vm, args);
+}
+
+bool modfn_gc_enable(VMState* vm, int argcount, Value* args)
+{
+    ENFORCE_ARG_COUNT(enable, 0);
+    vm->gcdisabled = false;
+    return bl_value_returnnil(vm, args);
+}
+
+bool modfn_gc_isenabled(VMState* vm, int argcount, Value* args)
+{
+    ENFORCE_ARG_COUNT(isenabled, 0);
+    RETURN_BOOL(!vm->gcdisabled);
+}
+
+/*
+* writes a heap snapshot to the given file, by way of a full collection.
+* see heapsnap.c for the format, and the -H flag for a summary of one.
+*/
+bool modfn_gc_snapshot(VMState* vm, int argcount, Value* args)
+{
+    ENFORCE_ARG_COUNT(snapshot, 1);
+    ENFORCE_ARG_TYPE(snapshot, 0, bl_value_isstring);
+    if(!bl_snapshot_write(vm, AS_STRING(args[0])->chars))
+    {
+        RETURN_ERROR("could not write heap snapshot %s: %s", AS_STRING(args[0])->chars, strerror(errno));
+    }
+    RETURN_TRUE;
+}
+
+/*
+* samples an allocation every given number of bytes allocated, or stops
+* sampling (and forgets what was sampled) given 0.
+*/
+bool modfn_gc_profile(VMState* vm, int argcount, Value* args)
+{
+    double interval;
+    ENFORCE_ARG_COUNT(profile, 1);
+    ENFORCE_ARG_TYPE(profile, 0, bl_value_isnumber);
+    interval = AS_NUMBER(args[0]);
+    if(interval < 0)
+    {
+        RETURN_ERROR("profile() expects a positive interval");
+    }
+    if(interval < 1)
+    {
+        bl_profile_stop(vm);
+        return bl_value_returnnil(vm, args);
+    }
+    if(!bl_profile_start(vm, (size_t)interval))
+    {
+        RETURN_ERROR("could not start the allocation profiler");
+    }
+    return bl_value_returnnil(vm, args);
+}
+
+/*
+* writes the allocations sampled so far to the given file, as folded
+* stacks for flamegraph tools.
+*/
+bool modfn_gc_writeprofile(VMState* vm, int argcount, Value* args)
+{
+    ENFORCE_ARG_COUNT(writeprofile, 1);
+    ENFORCE_ARG_TYPE(writeprofile, 0, bl_value_isstring);
+    if(vm->allocprofile == NULL)
+    {
+        RETURN_ERROR("the allocation profiler is not running");
+    }
+    if(!bl_profile_write(vm, AS_STRING(args[0])->chars))
+    {
+        RETURN_ERROR("could not write allocation profile %s: %s", AS_STRING(args[0])->chars, strerror(errno));
+    }
+    RETURN_TRUE;
+}
+
+RegModule* bl_modload_gc(VMState* vm)
+{
+    (void)vm;
+    static RegFunc modulefunctions[] = {
+        { "policy", false, modfn_gc_policy },
+        { "stats", false, modfn_gc_stats },
+        { "objects", false, modfn_gc_objects },
+        { "slabs", false, modfn_gc_slabs },
+        { "collect", false, modfn_gc_collect },
+        { "disable", false, modfn_gc_disable },
+        { "enable", false, modfn_gc_enable },
+        { "isenabled", false, modfn_gc_isenabled },
+        { "snapshot", false, modfn_gc_snapshot },
+        { "profile", false, modfn_gc_profile },
+        { "writeprofile", false, modfn_gc_writeprofile },
+        { NULL, false, NULL },
+    };
+    static RegModule module = { .name = "_gc", .fields = NULL, .functions = modulefunctions, .classes = NULL, .preloader = NULL, .unloader = NULL };
+    return &module;
+}
@@ -7,6 +7,8 @@ ObjModule* bl_object_makemodule(VMState* vm, char* name, char* file)
     bl_hashtable_init(&module->values);
     module->name = name;
     module->file = file;
+    module->importpath = NULL;
+    module->importrelative = false;
     module->unloader = NULL;
     module->preloader = NULL;
     module->handle = NULL;
@@ -1,14 +1,44 @@
-
 #include "blade.h"
 
-ObjString* bl_string_fromallocated(VMState* vm, char* chars, int length, uint32_t hash)
+static void bl_string_initfields(ObjString* string, int length)
 {
-    //fprintf(stderr, "call to bl_string_fromallocated! chars=\"%.*s\"\n", length, chars);
-    ObjString* string = (ObjString*)bl_object_allocobject(vm, sizeof(ObjString), OBJ_STRING);
-    string->chars = chars;
     string->length = length;
-    string->utf8length = bl_util_utf8length(chars);
+    string->utf8length = -1;
     string->isascii = false;
+    string->isrope = false;
+    string->isinterned = false;
+    string->ishashed = false;
+    string->hash = 0;
+}
+
+/*
+* a string with room for its chars right after it, in the one allocation
+* (see STRING_INLINE_FITS).
+*/
+static ObjString* bl_string_allocinline(VMState* vm, int length)
+{
+    ObjString* string = (ObjString*)bl_object_allocobject(vm, sizeof(ObjString) + (size_t)length + 1, OBJ_STRING);
+    bl_string_initfields(string, length);
+    string->chars = (char*)(string + 1);
+    string->chars[length] = '\0';
+    return string;
+}
+
+/*
+* a string that takes over chars, which were allocated for it.
+*/
+static ObjString* bl_string_alloctaken(VMState* vm, char* chars, int length)
+{
+    ObjString* string = (ObjString*)bl_object_allocobject(vm, sizeof(ObjString), OBJ_STRING);
+    bl_string_initfields(string, length);
+    string->chars = chars;
+    return string;
+}
+
+static ObjString* bl_string_addinterned(VMState* vm, ObjString* string, uint32_t hash)
+{
+    string->isinterned = true;
+    string->ishashed = true;
     string->hash = hash;
     bl_vm_pushvalue(vm, OBJ_VAL(string));// fixing gc corruption
     bl_hashtable_set(vm, &vm->strings, OBJ_VAL(string), NIL_VAL);
@@ -16,8 +46,18 @@ ObjString* bl_string_fromallocated(VMState* vm, char* chars, int length, uint32_
     return string;
 }
 
+ObjString* bl_string_fromallocated(VMState* vm, char* chars, int length, uint32_t hash)
+{
+    return bl_string_addinterned(vm, bl_string_alloctaken(vm, chars, length), hash);
+}
+
+/*
+* chars short enough to go inline are copied there, and their buffer freed
+* right away; only longer ones are kept as they are.
+*/
 ObjString* bl_string_takestring(VMState* vm, char* chars, int length)
 {
+    ObjString* string;
     uint32_t hash = bl_util_hashstring(chars, length);
     ObjString* interned = bl_hashtable_findstring(&vm->strings, chars, length, hash);
     if(interned != NULL)
@@ -25,17 +65,31 @@ ObjString* bl_string_takestring(VMState* vm, char* chars, int length)
         FREE_ARRAY(char, chars, (size_t)length + 1);
         return interned;
     }
+    if(STRING_INLINE_FITS(length))
+    {
+        string = bl_string_allocinline(vm, length);
+        memcpy(string->chars, chars, length);
+        FREE_ARRAY(char, chars, (size_t)length + 1);
+        return bl_string_addinterned(vm, string, hash);
+    }
     return bl_string_fromallocated(vm, chars, length, hash);
 }
 
 ObjString* bl_string_copystringlen(VMState* vm, const char* chars, int length)
 {
+    ObjString* string;
     uint32_t hash = bl_util_hashstring(chars, length);
     ObjString* interned = bl_hashtable_findstring(&vm->strings, chars, length, hash);
     if(interned != NULL)
     {
         return interned;
     }
+    if(STRING_INLINE_FITS(length))
+    {
+        string = bl_string_allocinline(vm, length);
+        memcpy(string->chars, chars, length);
+        return bl_string_addinterned(vm, string, hash);
+    }
     char* heapchars = ALLOCATE(char, (size_t)length + 1);
     memcpy(heapchars, chars, length);
     heapchars[length] = '\0';
@@ -47,12 +101,175 @@ ObjString* bl_string_copystring(VMState* vm, const char* chars)
     return bl_string_copystringlen(vm, chars, strlen(chars));
 }
 
+/*
+* like bl_string_takestring(), for data rather than names: chars are
+* neither hashed nor interned until the string is used as a key (see
+* bl_string_intern()), which spares reading them all for a file's contents
+* and the like.
+*/
+ObjString* bl_string_takeuninterned(VMState* vm, char* chars, int length)
+{
+    ObjString* string;
+    if(STRING_INLINE_FITS(length))
+    {
+        string = bl_string_allocinline(vm, length);
+        memcpy(string->chars, chars, length);
+        FREE_ARRAY(char, chars, (size_t)length + 1);
+        return string;
+    }
+    return bl_string_alloctaken(vm, chars, length);
+}
+
+/*
+* an uninterned string of length chars, for the caller to fill in (the NUL
+* after them is there already). this spares the buffer that
+* bl_string_takeuninterned() would copy in, and free, for short strings.
+*/
+ObjString* bl_string_allocuninterned(VMState* vm, int length)
+{
+    char* chars;
+    if(STRING_INLINE_FITS(length))
+    {
+        return bl_string_allocinline(vm, length);
+    }
+    chars = ALLOCATE(char, (size_t)length + 1);
+    chars[length] = '\0';
+    return bl_string_alloctaken(vm, chars, length);
+}
+
+ObjString* bl_string_copyuninterned(VMState* vm, const char* chars, int length)
+{
+    ObjString* string = bl_string_allocuninterned(vm, length);
+    memcpy(string->chars, chars, length);
+    return string;
+}
+
+/*
+* the interned string with the chars of string, which becomes it if there
+* is none yet. nothing is collected on the way.
+*/
+ObjString* bl_string_intern(VMState* vm, ObjString* string)
+{
+    bool gcdisabled;
+    ObjString* interned;
+    if(string->isinterned)
+    {
+        return string;
+    }
+    bl_string_flat(string);
+    interned = bl_hashtable_findstring(&vm->strings, string->chars, string->length, bl_string_gethash(string));
+    if(interned != NULL)
+    {
+        return interned;
+    }
+    gcdisabled = vm->gcdisabled;
+    vm->gcdisabled = true;
+    string->isinterned = true;
+    bl_hashtable_set(vm, &vm->strings, OBJ_VAL(string), NIL_VAL);
+    vm->gcdisabled = gcdisabled;
+    return string;
+}
+
+/*
+* equality of strings that may not both be interned.
+*/
+bool bl_string_equal(ObjString* a, ObjString* b)
+{
+    if(a == b)
+    {
+        return true;
+    }
+    if((a->isinterned && b->isinterned) || a->length != b->length)
+    {
+        return false;
+    }
+    return bl_string_gethash(a) == bl_string_gethash(b) && memcmp(a->chars, b->chars, a->length) == 0;
+}
+
+/*
+* left followed by right, without copying either. the caller keeps both
+* reachable until this returns.
+*/
+ObjString* bl_string_makerope(VMState* vm, ObjString* left, ObjString* right)
+{
+    ObjRope* rope;
+    rope = (ObjRope*)bl_object_allocobject(vm, sizeof(ObjRope), OBJ_STRING);
+    rope->string.length = left->length + right->length;
+    rope->string.utf8length = left->utf8length < 0 || right->utf8length < 0 ? -1 : left->utf8length + right->utf8length;
+    rope->string.isascii = left->isascii && right->isascii;
+    rope->string.isrope = true;
+    rope->string.isinterned = false;
+    rope->string.ishashed = false;
+    rope->string.hash = 0;
+    rope->string.chars = NULL;
+    rope->left = left;
+    rope->right = right;
+    rope->vm = vm;
+    return &rope->string;
+}
+
+/*
+* puts the chars of a rope together, and lets go of its halves.
+*/
+void bl_string_flatten(ObjString* string)
+{
+    int length;
+    int count;
+    int capacity;
+    bool gcdisabled;
+    char* chars;
+    VMState* vm;
+    ObjRope* rope;
+    ObjString* part;
+    ObjString** pending;
+    if(!string->isrope)
+    {
+        return;
+    }
+    rope = (ObjRope*)string;
+    vm = rope->vm;
+    // callers don't expect AS_STRING() to collect, so nothing here may.
+    gcdisabled = vm->gcdisabled;
+    vm->gcdisabled = true;
+    chars = ALLOCATE(char, (size_t)string->length + 1);
+    // the halves still to copy, leftmost on top. a rope built up by
+    // appending leans left, which keeps this short.
+    capacity = 8;
+    pending = ALLOCATE(ObjString*, capacity);
+    count = 0;
+    pending[count++] = string;
+    length = 0;
+    while(count > 0)
+    {
+        part = pending[--count];
+        if(part->chars == NULL)
+        {
+            if(count + 2 > capacity)
+            {
+                pending = GROW_ARRAY(ObjString*, sizeof(ObjString*), pending, capacity, capacity * 2);
+                capacity *= 2;
+            }
+            pending[count++] = ((ObjRope*)part)->right;
+            pending[count++] = ((ObjRope*)part)->left;
+            continue;
+        }
+        memcpy(chars + length, part->chars, part->length);
+        length += part->length;
+    }
+    FREE_ARRAY(ObjString*, pending, capacity);
+    chars[length] = '\0';
+    string->chars = chars;
+    rope->left = NULL;
+    rope->right = NULL;
+    vm->gcdisabled = gcdisabled;
+}
+
 
 static bool objfn_string_length(VMState* vm, int argcount, Value* args)
 {
     ENFORCE_ARG_COUNT(length, 0);
     ObjString* string = AS_STRING(METHOD_OBJECT);
-    RETURN_NUMBER(string->isascii ? string->length : string->utf8length);
+    RETURN_NUMBER(string->isascii ? string->length : bl_string_utf8length(string));
 }
 
 static bool objfn_string_upper(VMState* vm, int argcount, Value* args)
@@ -313,22 +530,15 @@ static bool objfn_string_join(VMState* vm, int argcount, Value* args)
             RETURN_VALUE(argument);
         }
         ObjString* string = AS_STRING(argument);
-        char* result = ALLOCATE(char, 2);
-        result[0] = string->chars[0];
-        result[1] = '\0';
+        StringBuilder sb;
+        bl_builder_init(&sb);
+        bl_builder_appendchar(&sb, string->chars[0]);
         for(int i = 1; i < string->length; i++)
         {
-            if(methodobj->length > 0)
-            {
-                result = bl_util_appendstring(result, methodobj->chars);
-            }
-            char* chr = (char*)calloc(2, sizeof(char));
-            chr[0] = string->chars[i];
-            chr[1] = '\0';
-            result = bl_util_appendstring(result, chr);
-            free(chr);
+            bl_builder_append(&sb, methodobj->chars, methodobj->length);
+            bl_builder_appendchar(&sb, string->chars[i]);
         }
-        RETURN_TT_STRING(result);
+        RETURN_OBJ(bl_builder_take(vm, &sb));
     }
     else if(bl_value_isarray(argument) || bl_value_isdict(argument))
     {
@@ -348,18 +558,15 @@ static bool objfn_string_join(VMState* vm, int argcount, Value* args)
         {
             RETURN_L_STRING("", 0);
         }
-        char* result = bl_value_tostring(vm, list[0]);
+        StringBuilder sb;
+        bl_builder_init(&sb);
+        bl_builder_appendvalue(vm, &sb, list[0]);
         for(int i = 1; i < count; i++)
         {
-            if(methodobj->length > 0)
-            {
-                result = bl_util_appendstring(result, methodobj->chars);
-            }
-            char* str = bl_value_tostring(vm, list[i]);
-            result = bl_util_appendstring(result, str);
-            free(str);
+            bl_builder_append(&sb, methodobj->chars, methodobj->length);
+            bl_builder_appendvalue(vm, &sb, list[i]);
         }
-        RETURN_TT_STRING(result);
+        RETURN_OBJ(bl_builder_take(vm, &sb));
     }
     RETURN_ERROR("join() does not support object of type %s", bl_value_typename(argument));
 }
@@ -382,7 +589,7 @@ static bool objfn_string_split(VMState* vm, int argcount, Value* args)
             // match found.
             if(memcmp(object->chars + i, delimeter->chars, delimeter->length) == 0 || i == object->length)
             {
-                bl_array_push(vm, list, GC_L_STRING(object->chars + start, i - start));
+                bl_array_push(vm, list, OBJ_VAL(bl_string_copyuninterned(vm, object->chars + start, i - start)));
                 i += delimeter->length - 1;
                 start = i + 1;
             }
@@ -390,7 +597,7 @@ static bool objfn_string_split(VMState* vm, int argcount, Value* args)
     }
     else
     {
-        int length = object->isascii ? object->length : object->utf8length;
+        int length = object->isascii ? object->length : bl_string_utf8length(object);
         for(int i = 0; i < length; i++)
         {
             int start = i;
@@ -399,7 +606,7 @@ static bool objfn_string_split(VMState* vm, int argcount, Value* args)
             {
                 bl_util_utf8slice(object->chars, &start, &end);
             }
-            bl_array_push(vm, list, GC_L_STRING(object->chars + start, (int)(end - start)));
+            bl_array_push(vm, list, OBJ_VAL(bl_string_copyuninterned(vm, object->chars + start, (int)(end - start))));
         }
     }
     RETURN_OBJ(list);
@@ -476,7 +683,7 @@ static bool objfn_string_tolist(VMState* vm, int argcount, Value* args)
     ENFORCE_ARG_COUNT(to_list, 0);
     ObjString* string = AS_STRING(METHOD_OBJECT);
     ObjArray* list = (ObjArray*)bl_mem_gcprotect(vm, (Object*)bl_object_makelist(vm));
-    int length = string->isascii ? string->length : string->utf8length;
+    int length = string->isascii ? string->length : bl_string_utf8length(string);
     if(length > 0)
     {
         for(int i = 0; i < length; i++)
@@ -487,7 +694,7 @@ static bool objfn_string_tolist(VMState* vm, int argcount, Value* args)
             {
                 bl_util_utf8slice(string->chars, &start, &end);
             }
-            bl_array_push(vm, list, GC_L_STRING(string->chars + start, (int)(end - start)));
+            bl_array_push(vm, list, OBJ_VAL(bl_string_copystringlen(vm, string->chars + start, (int)(end - start))));
         }
     }
     RETURN_OBJ(list);
@@ -505,12 +712,12 @@ static bool objfn_string_lpad(VMState* vm, int argcount, Value* args)
         ENFORCE_ARG_TYPE(lpad, 1, IS_CHAR);
         fillchar = AS_C_STRING(args[1])[0];
     }
-    if(width <= string->utf8length)
+    if(width <= bl_string_utf8length(string))
         RETURN_VALUE(METHOD_OBJECT);
-    int fillsize = width - string->utf8length;
+    int fillsize = width - bl_string_utf8length(string);
     char* fill = ALLOCATE(char, (size_t)fillsize + 1);
     int finalsize = string->length + fillsize;
-    int finalutf8size = string->utf8length + fillsize;
+    int finalutf8size = bl_string_utf8length(string) + fillsize;
     for(int i = 0; i < fillsize; i++)
     {
         fill[i] = fillchar;
@@ -522,6 +729,10 @@ static bool objfn_string_lpad(VMState* vm, int argcount, Value* args)
     ObjString* result = bl_string_takestring(vm, str, finalsize);
     result->utf8length = finalutf8size;
     result->length = finalsize;
+    if(string->isascii && (fillchar & 0x80) == 0)
+    {
+        result->isascii = true;
+    }
     RETURN_OBJ(result);
 }
 
@@ -537,12 +748,12 @@ static bool objfn_string_rpad(VMState* vm, int argcount, Value* args)
         ENFORCE_ARG_TYPE(rpad, 1, IS_CHAR);
         fillchar = AS_C_STRING(args[1])[0];
     }
-    if(width <= string->utf8length)
+    if(width <= bl_string_utf8length(string))
         RETURN_VALUE(METHOD_OBJECT);
-    int fillsize = width - string->utf8length;
+    int fillsize = width - bl_string_utf8length(string);
     char* fill = ALLOCATE(char, (size_t)fillsize + 1);
     int finalsize = string->length + fillsize;
-    int finalutf8size = string->utf8length + fillsize;
+    int finalutf8size = bl_string_utf8length(string) + fillsize;
     for(int i = 0; i < fillsize; i++)
     {
         fill[i] = fillchar;
@@ -554,6 +765,10 @@ static bool objfn_string_rpad(VMState* vm, int argcount, Value* args)
     ObjString* result = bl_string_takestring(vm, str, finalsize);
     result->utf8length = finalutf8size;
     result->length = finalsize;
+    if(string->isascii && (fillchar & 0x80) == 0)
+    {
+        result->isascii = true;
+    }
     RETURN_OBJ(result);
 }
 
@@ -939,7 +1154,7 @@ static bool objfn_string_iter(VMState* vm, int argcount, Value* args)
     ENFORCE_ARG_COUNT(__iter__, 1);
     ENFORCE_ARG_TYPE(__iter__, 0, bl_value_isnumber);
     ObjString* string = AS_STRING(METHOD_OBJECT);
-    int length = string->isascii ? string->length : string->utf8length;
+    int length = string->isascii ? string->length : bl_string_utf8length(string);
     int index = AS_NUMBER(args[0]);
     if(index > -1 && index < length)
     {
@@ -958,7 +1173,7 @@ static bool objfn_string_itern(VMState* vm, int argcount, Value* args)
 {
     ENFORCE_ARG_COUNT(__itern__, 1);
     ObjString* string = AS_STRING(METHOD_OBJECT);
-    int length = string->isascii ? string->length : string->utf8length;
+    int length = string->isascii ? string->length : bl_string_utf8length(string);
     if(bl_value_isnil(args[0]))
     {
         if(length == 0)
@@ -540,10 +540,12 @@ static void bl_parser_emitbyte(AstParser* p, uint8_t byte);
 static void bl_parser_emitshort(AstParser* p, uint16_t byte);
 static void bl_parser_emitbytes(AstParser* p, uint8_t byte, uint8_t byte2);
 static void bl_parser_emitbyte_and_short(AstParser* p, uint8_t byte, uint16_t byte2);
+static void bl_parser_emitcacheslot(AstParser* p, uint8_t op);
 static void bl_parser_emitloop(AstParser* p, int loopstart);
 static void bl_parser_emitreturn(AstParser* p);
 static int bl_parser_makeconstant(AstParser* p, Value value);
 static void bl_parser_emitconstant(AstParser* p, Value value);
+static void bl_parser_markconstant(AstParser* p, int start, Value value);
 static int bl_parser_emitjump(AstParser* p, uint8_t instruction);
 static int bl_parser_emitswitch(AstParser* p);
 static int bl_parser_emittry(AstParser* p);
@@ -772,6 +774,20 @@ static int bl_parser_getcodeargscount(const uint8_t* bytecode, const Value* cons
         case OP_EQUAL:
         case OP_GREATERTHAN:
         case OP_LESSTHAN:
+        case OP_ADD_NUM:
+        case OP_SUBTRACT_NUM:
+        case OP_MULTIPLY_NUM:
+        case OP_DIVIDE_NUM:
+        case OP_EQUAL_NUM:
+        case OP_GREATERTHAN_NUM:
+        case OP_LESSTHAN_NUM:
+        case OP_ADD_ANY:
+        case OP_SUBTRACT_ANY:
+        case OP_MULTIPLY_ANY:
+        case OP_DIVIDE_ANY:
+        case OP_EQUAL_ANY:
+        case OP_GREATERTHAN_ANY:
+        case OP_LESSTHAN_ANY:
         case OP_NIL:
         case OP_TRUE:
         case OP_FALSE:
@@ -809,15 +825,17 @@ static int bl_parser_getcodeargscount(const uint8_t* bytecode, const Value* cons
         case OP_IMPORT_ALL_NATIVE:
         case OP_IMPORT_ALL:
         case OP_PUBLISH_TRY:
+        case OP_GET_LOCAL_0:
+        case OP_GET_LOCAL_1:
+        case OP_GET_LOCAL_2:
+        case OP_GET_LOCAL_3:
             return 0;
         case OP_CALL:
         case OP_SUPER_INVOKE_SELF:
         case OP_GET_INDEX:
         case OP_GET_RANGED_INDEX:
+        case OP_CONSTANT_SMALLINT:
             return 1;
-        case OP_DEFINE_GLOBAL:
-        case OP_GET_GLOBAL:
-        case OP_SET_GLOBAL:
         case OP_GET_LOCAL:
         case OP_SET_LOCAL:
         case OP_GET_UP_VALUE:
@@ -829,9 +847,6 @@ static int bl_parser_getcodeargscount(const uint8_t* bytecode, const Value* cons
         case OP_CONSTANT:
         case OP_POP_N:
         case OP_CLASS:
-        case OP_GET_PROPERTY:
-        case OP_GET_SELF_PROPERTY:
-        case OP_SET_PROPERTY:
         case OP_LIST:
         case OP_DICT:
         case OP_CALL_IMPORT:
@@ -842,12 +857,25 @@ static int bl_parser_getcodeargscount(const uint8_t* bytecode, const Value* cons
         case OP_EJECT_IMPORT:
         case OP_EJECT_NATIVE_IMPORT:
         case OP_SELECT_IMPORT:
+        case OP_SET_LOCAL_POP:
+        case OP_POP_JUMP_IF_FALSE:
+        case OP_EQUAL_JUMP:
+        case OP_GREATERTHAN_JUMP:
+        case OP_LESSTHAN_JUMP:
             return 2;
-        case OP_INVOKE:
-        case OP_INVOKE_SELF:
         case OP_SUPER_INVOKE:
         case OP_CLASS_PROPERTY:
             return 3;
+        case OP_DEFINE_GLOBAL:
+        case OP_GET_GLOBAL:
+        case OP_SET_GLOBAL:
+        case OP_GET_PROPERTY:
+        case OP_GET_SELF_PROPERTY:
+        case OP_SET_PROPERTY:
+            return 4;
+        case OP_INVOKE:
+        case OP_INVOKE_SELF:
+            return 5;
         case OP_TRY:
             return 6;
         case OP_CLOSURE:
@@ -887,6 +915,33 @@ static void bl_parser_emitbyte_and_short(AstParser* p, uint8_t byte, uint16_t by
     bl_blob_write(p->vm, bl_parser_currentblob(p), byte2 & 0xff, p->previous.line);
 }
 
+/*
+* property lookups, method invocations and global variable accesses carry a
+* two byte index into the blob's caches, right after their regular operands.
+*/
+static void bl_parser_emitcacheslot(AstParser* p, uint8_t op)
+{
+    int slot;
+    if(op == OP_GET_GLOBAL || op == OP_SET_GLOBAL || op == OP_DEFINE_GLOBAL)
+    {
+        slot = bl_blob_addglobalcache(p->vm, bl_parser_currentblob(p));
+    }
+    else if(op == OP_GET_PROPERTY || op == OP_GET_SELF_PROPERTY || op == OP_SET_PROPERTY || op == OP_INVOKE || op == OP_INVOKE_SELF)
+    {
+        slot = bl_blob_addcache(p->vm, bl_parser_currentblob(p));
+    }
+    else
+    {
+        return;
+    }
+    if(slot >= UINT16_MAX)
+    {
+        bl_parser_raiseerror(p, "too many property and variable lookups in one function");
+        return;
+    }
+    bl_parser_emitshort(p, (uint16_t)slot);
+}
+
 /* static void bl_parser_emitbyte_and_long(AstParser *p, uint8_t byte, uint16_t byte2) {
   bl_blob_write(p->vm, bl_parser_currentblob(p), byte, p->previous.line);
   bl_blob_write(p->vm, bl_parser_currentblob(p), (byte2 >> 16) & 0xff, p->previous.line);
@@ -922,21 +977,251 @@ static void bl_parser_emitreturn(AstParser* p)
     bl_parser_emitbyte(p, OP_RETURN);
 }
 
+/*
+* only strings (interned, so keyed by pointer) and numbers are shared.
+* NaN never compares equal to itself, so it would never be found anyway.
+*/
+static bool bl_parser_isshareableconst(Value value)
+{
+    if(bl_value_isstring(value))
+    {
+        return true;
+    }
+    return bl_value_isnumber(value) && !isnan(AS_NUMBER(value));
+}
+
 static int bl_parser_makeconstant(AstParser* p, Value value)
 {
-    int constant = bl_blob_addconst(p->vm, bl_parser_currentblob(p), value);
+    int constant;
+    bool shareable;
+    HashEntry* entry;
+    AstCompiler* compiler;
+    compiler = p->vm->compiler;
+    shareable = bl_parser_isshareableconst(value);
+    if(shareable)
+    {
+        entry = bl_hashtable_getentry(&compiler->constants, value);
+        if(entry != NULL)
+        {
+            // 0 and -0 compare equal, but must stay distinct constants.
+            if(!bl_value_isnumber(value) || signbit(AS_NUMBER(value)) == signbit(AS_NUMBER(entry->key)))
+            {
+                return (int)AS_NUMBER(entry->value);
+            }
+            shareable = false;
+        }
+    }
+    constant = bl_blob_addconst(p->vm, bl_parser_currentblob(p), value);
+    bl_mem_writebarrier(p->vm, (Object*)p->vm->compiler->currfunc);
     if(constant >= UINT16_MAX)
     {
         bl_parser_raiseerror(p, "too many constants in current scope");
         return 0;
     }
+    if(shareable)
+    {
+        bl_hashtable_set(p->vm, &compiler->constants, value, NUMBER_VAL(constant));
+    }
     return constant;
 }
 
 static void bl_parser_emitconstant(AstParser* p, Value value)
 {
+    int start = bl_parser_currentblob(p)->count;
     int constant = bl_parser_makeconstant(p, value);
     bl_parser_emitbyte_and_short(p, OP_CONSTANT, (uint16_t)constant);
+    bl_parser_markconstant(p, start, value);
+}
+
+/*
+* constant folding.
+* each compiler remembers where the last constant push it emitted begins and
+* ends. when the code of an operand is exactly that one push, its value is known
+* at compile time, and an operator over known values is evaluated right away.
+*/
+static void bl_parser_markconstant(AstParser* p, int start, Value value)
+{
+    p->vm->compiler->conststart = start;
+    p->vm->compiler->constend = bl_parser_currentblob(p)->count;
+    p->vm->compiler->constvalue = value;
+}
+
+/*
+* true if the code emitted since $start is a single constant push.
+*/
+static bool bl_parser_isconstant(AstParser* p, int start, Value* dest)
+{
+    AstCompiler* compiler;
+    compiler = p->vm->compiler;
+    if(compiler->conststart != start || compiler->constend != bl_parser_currentblob(p)->count)
+    {
+        return false;
+    }
+    *dest = compiler->constvalue;
+    return true;
+}
+
+/*
+* drops everything emitted since $start.
+*/
+static void bl_parser_discardcode(AstParser* p, int start)
+{
+    bl_parser_currentblob(p)->count = start;
+    p->vm->compiler->constend = -1;
+}
+
+/*
+* compiles a statement whose code can never run, only for its diagnostics.
+*/
+static void bl_parser_parsedeadstmt(AstParser* p)
+{
+    int start;
+    start = bl_parser_currentblob(p)->count;
+    bl_parser_parsestmt(p);
+    bl_parser_discardcode(p, start);
+}
+
+static void bl_parser_emitfolded(AstParser* p, int start, Value value)
+{
+    bl_parser_discardcode(p, start);
+    if(bl_value_isbool(value))
+    {
+        bl_parser_emitbyte(p, AS_BOOL(value) ? OP_TRUE : OP_FALSE);
+        bl_parser_markconstant(p, start, value);
+    }
+    else
+    {
+        bl_parser_emitconstant(p, value);
+    }
+}
+
+static ObjString* bl_parser_concatstrings(AstParser* p, ObjString* a, ObjString* b)
+{
+    int length;
+    char* chars;
+    VMState* vm;
+    vm = p->vm;
+    length = a->length + b->length;
+    chars = ALLOCATE(char, (size_t)length + 1);
+    memcpy(chars, a->chars, a->length);
+    memcpy(chars + a->length, b->chars, b->length);
+    chars[length] = '\0';
+    return bl_string_takestring(vm, chars, length);
+}
+
+static bool bl_parser_foldbinary(AstParser* p, TokType op, Value left, Value right, Value* dest)
+{
+    int code;
+    bool negate;
+    negate = false;
+    switch(op)
+    {
+        case TOK_PLUS:
+            {
+                if(bl_value_isstring(left) && bl_value_isstring(right))
+                {
+                    *dest = OBJ_VAL(bl_parser_concatstrings(p, AS_STRING(left), AS_STRING(right)));
+                    return true;
+                }
+                code = OP_ADD;
+            }
+            break;
+        case TOK_MINUS:
+            code = OP_SUBTRACT;
+            break;
+        case TOK_MULTIPLY:
+            code = OP_MULTIPLY;
+            break;
+        case TOK_DIVIDE:
+            code = OP_DIVIDE;
+            break;
+        case TOK_PERCENT:
+            code = OP_REMINDER;
+            break;
+        case TOK_POW:
+            code = OP_POW;
+            break;
+        case TOK_FLOOR:
+            code = OP_F_DIVIDE;
+            break;
+        case TOK_EQUALEQ:
+            *dest = BOOL_VAL(bl_value_valuesequal(left, right));
+            return true;
+        case TOK_BANGEQ:
+            *dest = BOOL_VAL(!bl_value_valuesequal(left, right));
+            return true;
+        case TOK_GREATER:
+            code = OP_GREATERTHAN;
+            break;
+        case TOK_GREATEREQ:
+            code = OP_LESSTHAN;
+            negate = true;
+            break;
+        case TOK_LESS:
+            code = OP_LESSTHAN;
+            break;
+        case TOK_LESSEQ:
+            code = OP_GREATERTHAN;
+            negate = true;
+            break;
+        case TOK_AMP:
+            code = OP_BITAND;
+            break;
+        case TOK_BAR:
+            code = OP_BITOR;
+            break;
+        case TOK_XOR:
+            code = OP_BITXOR;
+            break;
+        case TOK_LSHIFT:
+            code = OP_LEFTSHIFT;
+            break;
+        case TOK_RSHIFT:
+            code = OP_RIGHTSHIFT;
+            break;
+        default:
+            return false;
+    }
+    if(!bl_vm_foldbinaryop(code, left, right, dest))
+    {
+        return false;
+    }
+    if(negate)
+    {
+        *dest = BOOL_VAL(bl_value_isfalse(*dest));
+    }
+    return true;
+}
+
+static bool bl_parser_foldunary(TokType op, Value value, Value* dest)
+{
+    switch(op)
+    {
+        case TOK_MINUS:
+            {
+                if(!bl_value_isnumber(value))
+                {
+                    return false;
+                }
+                *dest = NUMBER_VAL(-AS_NUMBER(value));
+            }
+            return true;
+        case TOK_BANG:
+            *dest = BOOL_VAL(bl_value_isfalse(value));
+            return true;
+        case TOK_TILDE:
+            {
+                if(!bl_value_isnumber(value))
+                {
+                    return false;
+                }
+                *dest = INTEGER_VAL(~((int)AS_NUMBER(value)));
+            }
+            return true;
+        default:
+            break;
+    }
+    return false;
 }
 
 static int bl_parser_emitjump(AstParser* p, uint8_t instruction)
@@ -1001,6 +1286,8 @@ static void bl_parser_patchjump(AstParser* p, int offset)
     }
     bl_parser_currentblob(p)->code[offset] = (jump >> 8) & 0xff;
     bl_parser_currentblob(p)->code[offset + 1] = jump & 0xff;
+    // the jump lands here, so whatever was pushed last is no longer a known value
+    p->vm->compiler->constend = -1;
 }
 
 static void bl_compiler_init(AstParser* p, AstCompiler* compiler, FuncType type)
@@ -1011,12 +1298,17 @@ static void bl_compiler_init(AstParser* p, AstCompiler* compiler, FuncType type)
     compiler->localcount = 0;
     compiler->scopedepth = 0;
     compiler->handlercount = 0;
+    compiler->conststart = -1;
+    compiler->constend = -1;
+    compiler->constvalue = NIL_VAL;
+    bl_hashtable_init(&compiler->constants);
     compiler->currfunc = bl_object_makescriptfunction(p->vm, p->module, type);
     p->vm->compiler = compiler;
     if(type != TYPE_SCRIPT)
     {
         bl_vm_pushvalue(p->vm, OBJ_VAL(compiler->currfunc));
         p->vm->compiler->currfunc->name = bl_string_copystringlen(p->vm, p->previous.start, p->previous.length);
+        bl_mem_writebarrier(p->vm, (Object*)p->vm->compiler->currfunc);
         bl_vm_popvalue(p->vm);
     }
     // claiming slot zero for use in class methods
@@ -1169,6 +1461,7 @@ static void bl_parser_defvar(AstParser* p, int global)
         return;
     }
     bl_parser_emitbyte_and_short(p, OP_DEFINE_GLOBAL, global);
+    bl_parser_emitcacheslot(p, OP_DEFINE_GLOBAL);
 }
 
 static AstToken bl_parser_synthtoken(const char* name)
@@ -1179,14 +1472,364 @@ static AstToken bl_parser_synthtoken(const char* name)
     return token;
 }
 
+/*
+* peephole optimizer.
+* runs once over a finished function: common instruction sequences are fused
+* into superinstructions, locals 0-3 and small integers get short forms, and
+* values that are pushed only to be popped again are dropped. the code is
+* rewritten into a new blob, after which every jump, loop, try handler and
+* switch table is relocated. a sequence is never rewritten if a jump lands
+* inside it.
+*/
+static int bl_compiler_readshort(const uint8_t* code, int offset)
+{
+    return (code[offset] << 8) | code[offset + 1];
+}
+
+static void bl_compiler_writeshort(uint8_t* code, int offset, int value)
+{
+    code[offset] = (value >> 8) & 0xff;
+    code[offset + 1] = value & 0xff;
+}
+
+static int bl_compiler_instlength(BinaryBlob* blob, const uint8_t* code, int offset)
+{
+    return 1 + bl_parser_getcodeargscount(code, blob->constants.values, offset);
+}
+
+static int bl_compiler_jumptarget(const uint8_t* code, int offset)
+{
+    int jump;
+    jump = bl_compiler_readshort(code, offset + 1);
+    if(code[offset] == OP_LOOP)
+    {
+        return offset + 3 - jump;
+    }
+    return offset + 3 + jump;
+}
+
+static void bl_compiler_marktargets(BinaryBlob* blob, bool* istarget)
+{
+    int i;
+    int k;
+    int base;
+    int target;
+    ObjSwitch* sw;
+    HashEntry* entry;
+    for(i = 0; i < blob->count; i += bl_compiler_instlength(blob, blob->code, i))
+    {
+        switch(blob->code[i])
+        {
+            case OP_JUMP:
+            case OP_JUMP_IF_FALSE:
+            case OP_LOOP:
+                {
+                    target = bl_compiler_jumptarget(blob->code, i);
+                    istarget[target] = true;
+                    // fused conditional jumps land just past the pop at their target
+                    if(target < blob->count && blob->code[target] == OP_POP)
+                    {
+                        istarget[target + 1] = true;
+                    }
+                }
+                break;
+            case OP_TRY:
+                {
+                    // an address of 0 means 'no handler', and marking it is harmless.
+                    istarget[bl_compiler_readshort(blob->code, i + 3)] = true;
+                    istarget[bl_compiler_readshort(blob->code, i + 5)] = true;
+                }
+                break;
+            case OP_SWITCH:
+                {
+                    sw = AS_SWITCH(blob->constants.values[bl_compiler_readshort(blob->code, i + 1)]);
+                    base = i + 3;
+                    for(k = 0; k < sw->table.capacity; k++)
+                    {
+                        entry = &sw->table.entries[k];
+                        if(!bl_value_isempty(entry->key))
+                        {
+                            istarget[base + (int)AS_NUMBER(entry->value)] = true;
+                        }
+                    }
+                    if(sw->defaultjump != -1)
+                    {
+                        istarget[base + sw->defaultjump] = true;
+                    }
+                    istarget[base + sw->exitjump] = true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/*
+* true if $offset holds a pop that nothing jumps to.
+*/
+static bool bl_compiler_ispop(BinaryBlob* blob, const bool* istarget, int offset)
+{
+    return offset < blob->count && blob->code[offset] == OP_POP && !istarget[offset];
+}
+
+/*
+* true for the 'fjump, pop' pair that if-statements and loops emit, when the
+* jump lands on another pop. such a pair can pop the condition itself and skip
+* the pop at the target instead.
+*/
+static bool bl_compiler_ispopbranch(BinaryBlob* blob, const bool* istarget, int offset)
+{
+    if(offset >= blob->count || blob->code[offset] != OP_JUMP_IF_FALSE || !bl_compiler_ispop(blob, istarget, offset + 3))
+    {
+        return false;
+    }
+    return blob->code[bl_compiler_jumptarget(blob->code, offset)] == OP_POP;
+}
+
+static bool bl_compiler_issmallint(Value value)
+{
+    double number;
+    if(!bl_value_isnumber(value))
+    {
+        return false;
+    }
+    number = AS_NUMBER(value);
+    return number >= 0 && number <= UINT8_MAX && number == (int)number && !signbit(number);
+}
+
+static void bl_compiler_emitjumpto(VMState* vm, BinaryBlob* out, int* oldtargets, uint8_t op, int oldtarget, int line)
+{
+    bl_blob_write(vm, out, op, line);
+    oldtargets[out->count] = oldtarget;
+    bl_blob_write(vm, out, 0xff, line);
+    bl_blob_write(vm, out, 0xff, line);
+}
+
+static void bl_compiler_relocateswitch(ObjSwitch* sw, int oldbase, int newbase, const int* newoffsets)
+{
+    int k;
+    HashEntry* entry;
+    for(k = 0; k < sw->table.capacity; k++)
+    {
+        entry = &sw->table.entries[k];
+        if(!bl_value_isempty(entry->key))
+        {
+            entry->value = NUMBER_VAL(newoffsets[oldbase + (int)AS_NUMBER(entry->value)] - newbase);
+        }
+    }
+    if(sw->defaultjump != -1)
+    {
+        sw->defaultjump = newoffsets[oldbase + sw->defaultjump] - newbase;
+    }
+    sw->exitjump = newoffsets[oldbase + sw->exitjump] - newbase;
+}
+
+static void bl_compiler_relocate(BinaryBlob* blob, BinaryBlob* out, const int* newoffsets, const int* oldtargets)
+{
+    int i;
+    int k;
+    for(i = 0; i < out->count; i += bl_compiler_instlength(blob, out->code, i))
+    {
+        switch(out->code[i])
+        {
+            case OP_JUMP:
+            case OP_JUMP_IF_FALSE:
+            case OP_POP_JUMP_IF_FALSE:
+            case OP_EQUAL_JUMP:
+            case OP_GREATERTHAN_JUMP:
+            case OP_LESSTHAN_JUMP:
+                bl_compiler_writeshort(out->code, i + 1, newoffsets[oldtargets[i + 1]] - (i + 3));
+                break;
+            case OP_LOOP:
+                bl_compiler_writeshort(out->code, i + 1, (i + 3) - newoffsets[oldtargets[i + 1]]);
+                break;
+            case OP_TRY:
+                {
+                    for(k = 3; k <= 5; k += 2)
+                    {
+                        if(oldtargets[i + k] != 0)
+                        {
+                            bl_compiler_writeshort(out->code, i + k, newoffsets[oldtargets[i + k]]);
+                        }
+                    }
+                }
+                break;
+            case OP_SWITCH:
+                bl_compiler_relocateswitch(AS_SWITCH(blob->constants.values[bl_compiler_readshort(out->code, i + 1)]), oldtargets[i + 1], i + 3, newoffsets);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void bl_compiler_optimize(AstParser* p)
+{
+    int i;
+    int k;
+    int len;
+    int next;
+    int slot;
+    int line;
+    int count;
+    uint8_t op;
+    bool* istarget;
+    int* newoffsets;
+    int* oldtargets;
+    Value constant;
+    BinaryBlob out;
+    BinaryBlob* blob;
+    VMState* vm;
+    vm = p->vm;
+    blob = bl_parser_currentblob(p);
+    count = blob->count;
+    istarget = ALLOCATE(bool, count + 1);
+    newoffsets = ALLOCATE(int, count + 1);
+    oldtargets = ALLOCATE(int, count + 1);
+    memset(istarget, 0, sizeof(bool) * (count + 1));
+    memset(oldtargets, 0, sizeof(int) * (count + 1));
+    bl_compiler_marktargets(blob, istarget);
+    bl_blob_init(&out);
+    for(i = 0; i < count; i = next)
+    {
+        op = blob->code[i];
+        len = bl_compiler_instlength(blob, blob->code, i);
+        line = blob->lines[i];
+        next = i + len;
+        newoffsets[i] = out.count;
+        switch(op)
+        {
+            case OP_EQUAL:
+            case OP_GREATERTHAN:
+            case OP_LESSTHAN:
+                {
+                    // compare, fjump, pop -> compare-and-branch
+                    if(!istarget[next] && bl_compiler_ispopbranch(blob, istarget, next))
+                    {
+                        op = (op == OP_EQUAL) ? OP_EQUAL_JUMP : ((op == OP_GREATERTHAN) ? OP_GREATERTHAN_JUMP : OP_LESSTHAN_JUMP);
+                        bl_compiler_emitjumpto(vm, &out, oldtargets, op, bl_compiler_jumptarget(blob->code, next) + 1, line);
+                        newoffsets[next] = newoffsets[next + 3] = newoffsets[i];
+                        next += 4;
+                        continue;
+                    }
+                }
+                break;
+            case OP_JUMP_IF_FALSE:
+                {
+                    if(bl_compiler_ispopbranch(blob, istarget, i))
+                    {
+                        bl_compiler_emitjumpto(vm, &out, oldtargets, OP_POP_JUMP_IF_FALSE, bl_compiler_jumptarget(blob->code, i) + 1, line);
+                        newoffsets[next] = newoffsets[i];
+                        next += 1;
+                    }
+                    else
+                    {
+                        bl_compiler_emitjumpto(vm, &out, oldtargets, op, bl_compiler_jumptarget(blob->code, i), line);
+                    }
+                    continue;
+                }
+            case OP_JUMP:
+            case OP_LOOP:
+                {
+                    bl_compiler_emitjumpto(vm, &out, oldtargets, op, bl_compiler_jumptarget(blob->code, i), line);
+                    continue;
+                }
+            case OP_SET_LOCAL:
+                {
+                    if(bl_compiler_ispop(blob, istarget, next))
+                    {
+                        bl_blob_write(vm, &out, OP_SET_LOCAL_POP, line);
+                        bl_blob_write(vm, &out, blob->code[i + 1], line);
+                        bl_blob_write(vm, &out, blob->code[i + 2], line);
+                        newoffsets[next] = newoffsets[i];
+                        next += 1;
+                        continue;
+                    }
+                }
+                break;
+            case OP_GET_LOCAL:
+            case OP_CONSTANT:
+            case OP_NIL:
+            case OP_TRUE:
+            case OP_FALSE:
+            case OP_ONE:
+            case OP_EMPTY:
+            case OP_DUP:
+                {
+                    // a push that is popped right away does nothing
+                    if(bl_compiler_ispop(blob, istarget, next))
+                    {
+                        newoffsets[next] = newoffsets[i];
+                        next += 1;
+                        continue;
+                    }
+                    if(op == OP_GET_LOCAL)
+                    {
+                        slot = bl_compiler_readshort(blob->code, i + 1);
+                        if(slot <= 3)
+                        {
+                            bl_blob_write(vm, &out, OP_GET_LOCAL_0 + slot, line);
+                            continue;
+                        }
+                    }
+                    else if(op == OP_CONSTANT)
+                    {
+                        constant = blob->constants.values[bl_compiler_readshort(blob->code, i + 1)];
+                        if(bl_compiler_issmallint(constant))
+                        {
+                            bl_blob_write(vm, &out, OP_CONSTANT_SMALLINT, line);
+                            bl_blob_write(vm, &out, (uint8_t)AS_NUMBER(constant), line);
+                            continue;
+                        }
+                    }
+                }
+                break;
+            case OP_TRY:
+                {
+                    oldtargets[out.count + 3] = bl_compiler_readshort(blob->code, i + 3);
+                    oldtargets[out.count + 5] = bl_compiler_readshort(blob->code, i + 5);
+                }
+                break;
+            case OP_SWITCH:
+                {
+                    oldtargets[out.count + 1] = next;
+                }
+                break;
+            default:
+                break;
+        }
+        for(k = 0; k < len; k++)
+        {
+            bl_blob_write(vm, &out, blob->code[i + k], line);
+        }
+    }
+    newoffsets[count] = out.count;
+    bl_compiler_relocate(blob, &out, newoffsets, oldtargets);
+    FREE_ARRAY(uint8_t, blob->code, blob->capacity);
+    FREE_ARRAY(int, blob->lines, blob->capacity);
+    blob->code = out.code;
+    blob->lines = out.lines;
+    blob->count = out.count;
+    blob->capacity = out.capacity;
+    FREE_ARRAY(bool, istarget, count + 1);
+    FREE_ARRAY(int, newoffsets, count + 1);
+    FREE_ARRAY(int, oldtargets, count + 1);
+}
+
 static ObjFunction* bl_compiler_end(AstParser* p)
 {
     bl_parser_emitreturn(p);
     ObjFunction* function = p->vm->compiler->currfunc;
+    if(!p->haderror)
+    {
+        bl_compiler_optimize(p);
+    }
     if(!p->haderror && p->vm->shouldprintbytecode)
     {
         bl_blob_disassembleitem(bl_parser_currentblob(p), function->name == NULL ? p->module->file : function->name->chars);
     }
+    bl_hashtable_free(p->vm, &p->vm->compiler->constants);
     p->vm->compiler = p->vm->compiler->enclosing;
     return function;
 }
@@ -1253,14 +1896,29 @@ static void bl_parser_endloop(AstParser* p)
 
 static void bl_parser_rulebinary(AstParser* p, AstToken previous, bool canassign)
 {
+    int leftstart;
+    int rightstart;
+    bool leftknown;
     TokType op;
     AstRule* rule;
+    Value left;
+    Value right;
+    Value folded;
     (void)previous;
     (void)canassign;
     op = p->previous.type;
+    // the left operand has already been compiled; see if it is a known value
+    rightstart = bl_parser_currentblob(p)->count;
+    leftstart = p->vm->compiler->conststart;
+    leftknown = bl_parser_isconstant(p, leftstart, &left);
     // compile the right operand
     rule = bl_parser_getrule(op);
     bl_parser_parseprecedence(p, (AstPrecedence)(rule->precedence + 1));
+    if(leftknown && bl_parser_isconstant(p, rightstart, &right) && bl_parser_foldbinary(p, op, left, right, &folded))
+    {
+        bl_parser_emitfolded(p, leftstart, folded);
+        return;
+    }
     // emit the operator instruction
     switch(op)
     {
@@ -1361,17 +2019,22 @@ static void bl_parser_rulecall(AstParser* p, AstToken previous, bool canassign)
 
 static void bl_parser_ruleliteral(AstParser* p, bool canassign)
 {
+    int start;
     (void)canassign;
+    start = bl_parser_currentblob(p)->count;
     switch(p->previous.type)
     {
         case TOK_NIL:
             bl_parser_emitbyte(p, OP_NIL);
+            bl_parser_markconstant(p, start, NIL_VAL);
             break;
         case TOK_TRUE:
             bl_parser_emitbyte(p, OP_TRUE);
+            bl_parser_markconstant(p, start, TRUE_VAL);
             break;
         case TOK_FALSE:
             bl_parser_emitbyte(p, OP_FALSE);
+            bl_parser_markconstant(p, start, FALSE_VAL);
             break;
         default:
             return;
@@ -1388,6 +2051,7 @@ static void bl_parser_parseassign(AstParser* p, uint8_t realop, uint8_t getop, u
     if(arg != -1)
     {
         bl_parser_emitbyte_and_short(p, getop, arg);
+        bl_parser_emitcacheslot(p, getop);
     }
     else
     {
@@ -1398,6 +2062,7 @@ static void bl_parser_parseassign(AstParser* p, uint8_t realop, uint8_t getop, u
     if(arg != -1)
     {
         bl_parser_emitbyte_and_short(p, setop, (uint16_t)arg);
+        bl_parser_emitcacheslot(p, setop);
     }
     else
     {
@@ -1414,6 +2079,7 @@ static void bl_parser_doassign(AstParser* p, uint8_t getop, uint8_t setop, int a
         if(arg != -1)
         {
             bl_parser_emitbyte_and_short(p, setop, (uint16_t)arg);
+            bl_parser_emitcacheslot(p, setop);
         }
         else
         {
@@ -1482,6 +2148,7 @@ static void bl_parser_doassign(AstParser* p, uint8_t getop, uint8_t setop, int a
         if(arg != -1)
         {
             bl_parser_emitbyte_and_short(p, getop, arg);
+            bl_parser_emitcacheslot(p, getop);
         }
         else
         {
@@ -1489,6 +2156,7 @@ static void bl_parser_doassign(AstParser* p, uint8_t getop, uint8_t setop, int a
         }
         bl_parser_emitbytes(p, OP_ONE, OP_ADD);
         bl_parser_emitbyte_and_short(p, setop, (uint16_t)arg);
+        bl_parser_emitcacheslot(p, setop);
     }
     else if(canassign && bl_parser_match(p, TOK_DECREMENT))
     {
@@ -1500,6 +2168,7 @@ static void bl_parser_doassign(AstParser* p, uint8_t getop, uint8_t setop, int a
         if(arg != -1)
         {
             bl_parser_emitbyte_and_short(p, getop, arg);
+            bl_parser_emitcacheslot(p, getop);
         }
         else
         {
@@ -1507,6 +2176,7 @@ static void bl_parser_doassign(AstParser* p, uint8_t getop, uint8_t setop, int a
         }
         bl_parser_emitbytes(p, OP_ONE, OP_SUBTRACT);
         bl_parser_emitbyte_and_short(p, setop, (uint16_t)arg);
+        bl_parser_emitcacheslot(p, setop);
     }
     else
     {
@@ -1519,6 +2189,7 @@ static void bl_parser_doassign(AstParser* p, uint8_t getop, uint8_t setop, int a
             else
             {
                 bl_parser_emitbyte_and_short(p, getop, (uint16_t)arg);
+                bl_parser_emitcacheslot(p, getop);
             }
         }
         else
@@ -1539,12 +2210,15 @@ static void bl_parser_ruledot(AstParser* p, AstToken previous, bool canassign)
         if(p->currentclass != NULL && (previous.type == TOK_SELF || bl_parser_identsequal(&p->previous, &p->currentclass->name)))
         {
             bl_parser_emitbyte_and_short(p, OP_INVOKE_SELF, name);
+            bl_parser_emitbyte(p, argcount);
+            bl_parser_emitcacheslot(p, OP_INVOKE_SELF);
         }
         else
         {
             bl_parser_emitbyte_and_short(p, OP_INVOKE, name);
+            bl_parser_emitbyte(p, argcount);
+            bl_parser_emitcacheslot(p, OP_INVOKE);
         }
-        bl_parser_emitbyte(p, argcount);
     }
     else
     {
@@ -2009,11 +2683,20 @@ static void bl_parser_rulestrinterpol(AstParser* p, bool canassign)
 
 static void bl_parser_ruleunary(AstParser* p, bool canassign)
 {
+    int start;
     TokType op;
+    Value value;
+    Value folded;
     (void)canassign;
     op = p->previous.type;
+    start = bl_parser_currentblob(p)->count;
     // compile the expression
     bl_parser_parseprecedence(p, PREC_UNARY);
+    if(bl_parser_isconstant(p, start, &value) && bl_parser_foldunary(op, value, &folded))
+    {
+        bl_parser_emitfolded(p, start, folded);
+        return;
+    }
     // emit instruction
     switch(op)
     {
@@ -2805,14 +3488,26 @@ static void bl_parser_parseforloopstmt(AstParser* p)
     p->innermostloopstart = bl_parser_currentblob(p)->count;
     p->innermostloopscopedepth = p->vm->compiler->scopedepth;
     int exitjump = -1;
+    int loopstart = p->innermostloopstart;
+    bool neverruns = false;
     if(!bl_parser_match(p, TOK_SEMICOLON))
     {// the condition is optional
+        Value condition;
         bl_parser_parseexpr(p);
         bl_parser_consume(p, TOK_SEMICOLON, "expected ';' after condition");
         bl_parser_ignorespace(p);
-        // jump out of the loop if the condition is false...
-        exitjump = bl_parser_emitjump(p, OP_JUMP_IF_FALSE);
-        bl_parser_emitbyte(p, OP_POP);// pop the condition
+        if(bl_parser_isconstant(p, loopstart, &condition))
+        {
+            // a constant condition is either no condition at all, or no loop at all
+            bl_parser_discardcode(p, loopstart);
+            neverruns = bl_value_isfalse(condition);
+        }
+        else
+        {
+            // jump out of the loop if the condition is false...
+            exitjump = bl_parser_emitjump(p, OP_JUMP_IF_FALSE);
+            bl_parser_emitbyte(p, OP_POP);// pop the condition
+        }
     }
     /*if(!bl_parser_match(p, TOK_RPAREN))
     {
@@ -2847,6 +3542,10 @@ static void bl_parser_parseforloopstmt(AstParser* p)
         bl_parser_emitbyte(p, OP_POP);
     }
     bl_parser_endloop(p);
+    if(neverruns)
+    {
+        bl_parser_discardcode(p, loopstart);
+    }
     // reset the loop start and scope depth to the surrounding value
     p->innermostloopstart = surroundingloopstart;
     p->innermostloopscopedepth = surroundingscopedepth;
@@ -2967,6 +3666,7 @@ static void bl_parser_parseforeachstmt(AstParser* p)
     bl_parser_emitbyte_and_short(p, OP_GET_LOCAL, keyslot);
     bl_parser_emitbyte_and_short(p, OP_INVOKE, iter_n__);
     bl_parser_emitbyte(p, 1);
+    bl_parser_emitcacheslot(p, OP_INVOKE);
     bl_parser_emitbyte_and_short(p, OP_SET_LOCAL, keyslot);
     int falsejump = bl_parser_emitjump(p, OP_JUMP_IF_FALSE);
     bl_parser_emitbyte(p, OP_POP);
@@ -2975,6 +3675,7 @@ static void bl_parser_parseforeachstmt(AstParser* p)
     bl_parser_emitbyte_and_short(p, OP_GET_LOCAL, keyslot);
     bl_parser_emitbyte_and_short(p, OP_INVOKE, iter__);
     bl_parser_emitbyte(p, 1);
+    bl_parser_emitcacheslot(p, OP_INVOKE);
     // Bind the loop value in its own scope. This ensures we get a fresh
     // variable each iteration so that closures for it don't all see the same one.
     bl_parser_beginscope(p);
@@ -3052,6 +3753,7 @@ static void bl_parser_parseusingstmt(AstParser* p)
                         ObjString* string = bl_string_copystringlen(p->vm, str, length);
                         bl_vm_pushvalue(p->vm, OBJ_VAL(string));// gc fix
                         bl_hashtable_set(p->vm, &sw->table, OBJ_VAL(string), jump);
+                        bl_mem_writebarrier(p->vm, (Object*)sw);
                         bl_vm_popvalue(p->vm);// gc fix
                     }
                     else if(bl_parser_checknumber(p))
@@ -3099,7 +3801,31 @@ static void bl_parser_parseusingstmt(AstParser* p)
 
 static void bl_parser_parseifstmt(AstParser* p)
 {
+    Value condition;
+    int condstart = bl_parser_currentblob(p)->count;
     bl_parser_parseexpr(p);
+    if(bl_parser_isconstant(p, condstart, &condition))
+    {
+        // only one of the branches can ever run
+        bl_parser_discardcode(p, condstart);
+        if(bl_value_isfalse(condition))
+        {
+            bl_parser_parsedeadstmt(p);
+            if(bl_parser_match(p, TOK_ELSE))
+            {
+                bl_parser_parsestmt(p);
+            }
+        }
+        else
+        {
+            bl_parser_parsestmt(p);
+            if(bl_parser_match(p, TOK_ELSE))
+            {
+                bl_parser_parsedeadstmt(p);
+            }
+        }
+        return;
+    }
     int thenjump = bl_parser_emitjump(p, OP_JUMP_IF_FALSE);
     bl_parser_emitbyte(p, OP_POP);
     bl_parser_parsestmt(p);
@@ -3301,6 +4027,8 @@ static void bl_parser_parseimportstmt(AstParser* p)
     }
     bl_blob_init(&blob);
     modobj = bl_object_makemodule(p->vm, modulename, modulepath);
+    modobj->importpath = modulefile;
+    modobj->importrelative = isrelative;
     bl_vm_pushvalue(p->vm, OBJ_VAL(modobj));
     function = bl_compiler_compilesource(p->vm, modobj, source, &blob);
     bl_vm_popvalue(p->vm);
@@ -3437,14 +4165,32 @@ static void bl_parser_parsewhilestmt(AstParser* p)
     // we'll be jumping back to right before the
     // expression after the loop body
     p->innermostloopstart = bl_parser_currentblob(p)->count;
+    p->innermostloopscopedepth = p->vm->compiler->scopedepth;
+    Value condition;
+    int loopstart = p->innermostloopstart;
     bl_parser_parseexpr(p);
-    int exitjump = bl_parser_emitjump(p, OP_JUMP_IF_FALSE);
-    bl_parser_emitbyte(p, OP_POP);
-    bl_parser_parsestmt(p);
-    bl_parser_emitloop(p, p->innermostloopstart);
-    bl_parser_patchjump(p, exitjump);
-    bl_parser_emitbyte(p, OP_POP);
-    bl_parser_endloop(p);
+    if(bl_parser_isconstant(p, loopstart, &condition))
+    {
+        // either the loop never runs, or it only ends through break or return
+        bl_parser_discardcode(p, loopstart);
+        bl_parser_parsestmt(p);
+        bl_parser_emitloop(p, loopstart);
+        bl_parser_endloop(p);
+        if(bl_value_isfalse(condition))
+        {
+            bl_parser_discardcode(p, loopstart);
+        }
+    }
+    else
+    {
+        int exitjump = bl_parser_emitjump(p, OP_JUMP_IF_FALSE);
+        bl_parser_emitbyte(p, OP_POP);
+        bl_parser_parsestmt(p);
+        bl_parser_emitloop(p, p->innermostloopstart);
+        bl_parser_patchjump(p, exitjump);
+        bl_parser_emitbyte(p, OP_POP);
+        bl_parser_endloop(p);
+    }
     p->innermostloopstart = surroundingloopstart;
     p->innermostloopscopedepth = surroundingscopedepth;
 }
@@ -3456,14 +4202,29 @@ static void bl_parser_parsedowhilestmt(AstParser* p)
     // we'll be jumping back to right before the
     // statements after the loop body
     p->innermostloopstart = bl_parser_currentblob(p)->count;
+    p->innermostloopscopedepth = p->vm->compiler->scopedepth;
     bl_parser_parsestmt(p);
     bl_parser_consume(p, TOK_WHILE, "expecting 'while' statement");
+    Value condition;
+    int condstart = bl_parser_currentblob(p)->count;
     bl_parser_parseexpr(p);
-    int exitjump = bl_parser_emitjump(p, OP_JUMP_IF_FALSE);
-    bl_parser_emitbyte(p, OP_POP);
-    bl_parser_emitloop(p, p->innermostloopstart);
-    bl_parser_patchjump(p, exitjump);
-    bl_parser_emitbyte(p, OP_POP);
+    if(bl_parser_isconstant(p, condstart, &condition))
+    {
+        // the body runs once, or until a break or return
+        bl_parser_discardcode(p, condstart);
+        if(!bl_value_isfalse(condition))
+        {
+            bl_parser_emitloop(p, p->innermostloopstart);
+        }
+    }
+    else
+    {
+        int exitjump = bl_parser_emitjump(p, OP_JUMP_IF_FALSE);
+        bl_parser_emitbyte(p, OP_POP);
+        bl_parser_emitloop(p, p->innermostloopstart);
+        bl_parser_patchjump(p, exitjump);
+        bl_parser_emitbyte(p, OP_POP);
+    }
     bl_parser_endloop(p);
     p->innermostloopstart = surroundingloopstart;
     p->innermostloopscopedepth = surroundingscopedepth;
@@ -3653,7 +4414,16 @@ ObjFunction* bl_compiler_compilesource(VMState* vm, ObjModule* module, const cha
     AstScanner scanner;
     AstParser parser;
     AstCompiler compiler;
+    ObjFunction* function;
     (void)blob;
+    if(vm->shouldcachebytecode && !vm->shouldprintbytecode)
+    {
+        function = bl_bytecode_load(vm, module, source);
+        if(function != NULL)
+        {
+            return function;
+        }
+    }
     bl_scanner_init(&scanner, source);
     parser.vm = vm;
     parser.scanner = &scanner;
@@ -3674,8 +4444,16 @@ ObjFunction* bl_compiler_compilesource(VMState* vm, ObjModule* module, const cha
     {
         bl_parser_parsedeclaration(&parser);
     }
-    ObjFunction* function = bl_compiler_end(&parser);
-    return parser.haderror ? NULL : function;
+    function = bl_compiler_end(&parser);
+    if(parser.haderror)
+    {
+        return NULL;
+    }
+    if(vm->shouldcachebytecode && !vm->shouldprintbytecode)
+    {
+        bl_bytecode_store(vm, module, source, function);
+    }
+    return function;
 }
 
 void bl_parser_markcompilerroots(VMState* vm)
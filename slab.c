@@ -0,0 +1,289 @@
+#include "blade.h"
+
+/*
+* size classes for the gc objects. every class owns the pages its objects
+* are carved from; a page is only ever used for one class, and is handed
+* back to the OS once it is empty (save for the last page of a class, which
+* is kept around to spare a map/unmap for every object on a quiet class).
+* the mark bits of the objects on a page live in its header.
+*/
+
+static int bl_slab_classof(size_t size)
+{
+    return (int)((size + SLAB_GRANULE - 1) / SLAB_GRANULE) - 1;
+}
+
+/*
+* maps size bytes (a multiple of the page size) aligned to SLAB_PAGE_SIZE,
+* by mapping a page more than needed and trimming off the excess.
+*/
+static void* bl_slab_mappage(size_t size)
+{
+    char* raw;
+    char* page;
+    size_t head;
+    raw = (char*)mmap(NULL, size + SLAB_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED)
+    {
+        return NULL;
+    }
+    page = (char*)(((uintptr_t)raw + SLAB_PAGE_SIZE - 1) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+    head = (size_t)(page - raw);
+    if(head > 0)
+    {
+        munmap(raw, head);
+    }
+    munmap(page + size, SLAB_PAGE_SIZE - head);
+    return page;
+}
+
+static size_t bl_slab_headersize(void)
+{
+    return (sizeof(SlabPage) + SLAB_GRANULE - 1) & ~(size_t)(SLAB_GRANULE - 1);
+}
+
+static void bl_slab_makeavailable(SlabClass* sc, SlabPage* page)
+{
+    page->isavailable = true;
+    page->availprev = NULL;
+    page->availnext = sc->available;
+    if(sc->available != NULL)
+    {
+        sc->available->availprev = page;
+    }
+    sc->available = page;
+}
+
+static void bl_slab_makeunavailable(SlabClass* sc, SlabPage* page)
+{
+    if(page->availprev != NULL)
+    {
+        page->availprev->availnext = page->availnext;
+    }
+    else
+    {
+        sc->available = page->availnext;
+    }
+    if(page->availnext != NULL)
+    {
+        page->availnext->availprev = page->availprev;
+    }
+    page->isavailable = false;
+    page->availnext = NULL;
+    page->availprev = NULL;
+}
+
+static SlabPage* bl_slab_newpage(SlabClass* sc, int sizeclass)
+{
+    size_t header;
+    SlabPage* page;
+    // fresh mappings come zeroed, mark bits included.
+    page = (SlabPage*)bl_slab_mappage(SLAB_PAGE_SIZE);
+    if(page == NULL)
+    {
+        return NULL;
+    }
+    header = bl_slab_headersize();
+    page->sizeclass = sizeclass;
+    page->mapsize = SLAB_PAGE_SIZE;
+    page->used = 0;
+    page->capacity = (int)((SLAB_PAGE_SIZE - header) / sc->size);
+    page->freelist = NULL;
+    page->bump = (char*)page + header;
+    page->prev = NULL;
+    page->next = sc->pages;
+    if(sc->pages != NULL)
+    {
+        sc->pages->prev = page;
+    }
+    sc->pages = page;
+    sc->pagecount++;
+    bl_slab_makeavailable(sc, page);
+    return page;
+}
+
+/*
+* a large object is the only one on its pages, which keeps its mark bit
+* off them too.
+*/
+static void* bl_slab_alloclarge(size_t size)
+{
+    size_t header;
+    size_t mapsize;
+    SlabPage* page;
+    header = bl_slab_headersize();
+    mapsize = (header + size + SLAB_PAGE_SIZE - 1) & ~(size_t)(SLAB_PAGE_SIZE - 1);
+    page = (SlabPage*)bl_slab_mappage(mapsize);
+    if(page == NULL)
+    {
+        return NULL;
+    }
+    page->sizeclass = SLAB_CLASS_LARGE;
+    page->mapsize = mapsize;
+    page->used = 1;
+    page->capacity = 1;
+    return (char*)page + header;
+}
+
+static void bl_slab_releasepage(SlabClass* sc, SlabPage* page)
+{
+    if(page->isavailable)
+    {
+        bl_slab_makeunavailable(sc, page);
+    }
+    if(page->prev != NULL)
+    {
+        page->prev->next = page->next;
+    }
+    else
+    {
+        sc->pages = page->next;
+    }
+    if(page->next != NULL)
+    {
+        page->next->prev = page->prev;
+    }
+    sc->pagecount--;
+    munmap(page, page->mapsize);
+}
+
+void bl_slab_init(VMState* vm)
+{
+    int i;
+    for(i = 0; i < SLAB_CLASS_COUNT; i++)
+    {
+        vm->slabs[i].size = (size_t)(i + 1) * SLAB_GRANULE;
+        vm->slabs[i].pagecount = 0;
+        vm->slabs[i].used = 0;
+        vm->slabs[i].pages = NULL;
+        vm->slabs[i].available = NULL;
+    }
+}
+
+void* bl_slab_alloc(VMState* vm, size_t size)
+{
+#if defined(BLADE_NO_SLAB)
+    (void)vm;
+    return malloc(size);
+#else
+    int sizeclass;
+    void* slot;
+    SlabClass* sc;
+    SlabPage* page;
+    if(size > SLAB_MAX_SIZE)
+    {
+        return bl_slab_alloclarge(size);
+    }
+    sizeclass = bl_slab_classof(size);
+    sc = &vm->slabs[sizeclass];
+    page = sc->available;
+    if(page == NULL)
+    {
+        page = bl_slab_newpage(sc, sizeclass);
+        if(page == NULL)
+        {
+            return NULL;
+        }
+    }
+    if(page->freelist != NULL)
+    {
+        slot = page->freelist;
+        page->freelist = *(void**)slot;
+    }
+    else
+    {
+        slot = page->bump;
+        page->bump += sc->size;
+    }
+    page->used++;
+    sc->used++;
+    if(page->used == page->capacity)
+    {
+        bl_slab_makeunavailable(sc, page);
+    }
+    return slot;
+#endif
+}
+
+void bl_slab_free(VMState* vm, void* pointer, size_t size)
+{
+#if defined(BLADE_NO_SLAB)
+    (void)vm;
+    (void)size;
+    free(pointer);
+#else
+    SlabClass* sc;
+    SlabPage* page;
+    (void)size;
+    page = SLAB_PAGE_OF(pointer);
+    if(page->sizeclass == SLAB_CLASS_LARGE)
+    {
+        munmap(page, page->mapsize);
+        return;
+    }
+    sc = &vm->slabs[page->sizeclass];
+    *(void**)pointer = page->freelist;
+    page->freelist = pointer;
+    page->used--;
+    sc->used--;
+    if(page->used == 0 && sc->pagecount > 1)
+    {
+        bl_slab_releasepage(sc, page);
+    }
+    else if(!page->isavailable)
+    {
+        bl_slab_makeavailable(sc, page);
+    }
+#endif
+}
+
+/*
+* unmaps every page. only to be called once all the objects are gone.
+*/
+void bl_slab_destroy(VMState* vm)
+{
+    int i;
+    SlabClass* sc;
+    for(i = 0; i < SLAB_CLASS_COUNT; i++)
+    {
+        sc = &vm->slabs[i];
+        while(sc->pages != NULL)
+        {
+            bl_slab_releasepage(sc, sc->pages);
+        }
+        sc->used = 0;
+    }
+}
+
+/*
+* the slots on the pages of a size class, used or not.
+*/
+size_t bl_slab_slotcount(SlabClass* sc)
+{
+    size_t slots;
+    SlabPage* page;
+    slots = 0;
+    for(page = sc->pages; page != NULL; page = page->next)
+    {
+        slots += page->capacity;
+    }
+    return slots;
+}
+
+void bl_slab_printstats(VMState* vm, FILE* out)
+{
+    int i;
+    size_t capacity;
+    SlabClass* sc;
+    fprintf(out, "   %6s %8s %10s %10s %6s\n", "size", "pages", "used", "slots", "usage");
+    for(i = 0; i < SLAB_CLASS_COUNT; i++)
+    {
+        sc = &vm->slabs[i];
+        if(sc->pagecount == 0)
+        {
+            continue;
+        }
+        capacity = bl_slab_slotcount(sc);
+        fprintf(out, "   %6zu %8d %10zu %10zu %5.1f%%\n", sc->size, sc->pagecount, sc->used, capacity, (100.0 * sc->used) / capacity);
+    }
+}
@@ -0,0 +1,200 @@
+#include "blade.h"
+
+/*
+* the string builder: a buffer that doubles whenever it runs out, so that
+* n appends cost O(n) copying in all, rather than the O(n^2) of appending
+* to a fresh copy every time (as bl_util_appendstring() does). once done,
+* bl_builder_take() hands the buffer over to a string as it is.
+*
+* the buffer is plain malloc() memory, outside of what the gc counts, so
+* that appending never collects; the string it ends up in is counted once
+* it is taken. (see bl_builder_take(), and modbuilder.c for the builders
+* scripts get, which count their buffers themselves.)
+*/
+
+void bl_builder_init(StringBuilder* sb)
+{
+    sb->chars = NULL;
+    sb->length = 0;
+    sb->capacity = 0;
+}
+
+/*
+* makes room for extra more bytes, and the NUL after them.
+*/
+static void bl_builder_reserve(StringBuilder* sb, size_t extra)
+{
+    size_t capacity;
+    char* grown;
+    if(sb->length + extra < sb->capacity)
+    {
+        return;
+    }
+    capacity = sb->capacity < STRBUILDER_MIN_CAPACITY ? STRBUILDER_MIN_CAPACITY : sb->capacity * 2;
+    while(capacity <= sb->length + extra)
+    {
+        capacity *= 2;
+    }
+    grown = (char*)realloc(sb->chars, capacity);
+    if(grown == NULL)
+    {
+        fflush(stdout);// flush out anything on stdout first
+        fprintf(stderr, "Exit: device out of memory\n");
+        exit(EXIT_TERMINAL);
+    }
+    sb->chars = grown;
+    sb->capacity = capacity;
+}
+
+void bl_builder_append(StringBuilder* sb, const char* chars, size_t length)
+{
+    uintptr_t offset;
+    // a builder appended to itself reads from the buffer it grows.
+    offset = (uintptr_t)chars - (uintptr_t)sb->chars;
+    if(sb->chars != NULL && offset < sb->capacity)
+    {
+        bl_builder_reserve(sb, length);
+        chars = sb->chars + offset;
+    }
+    else
+    {
+        bl_builder_reserve(sb, length);
+    }
+    memcpy(sb->chars + sb->length, chars, length);
+    sb->length += length;
+    sb->chars[sb->length] = '\0';
+}
+
+void bl_builder_appendcstr(StringBuilder* sb, const char* chars)
+{
+    bl_builder_append(sb, chars, strlen(chars));
+}
+
+void bl_builder_appendchar(StringBuilder* sb, char ch)
+{
+    bl_builder_reserve(sb, 1);
+    sb->chars[sb->length++] = ch;
+    sb->chars[sb->length] = '\0';
+}
+
+/*
+* appends what printf() would print, straight into the buffer.
+*/
+void bl_builder_appendformat(StringBuilder* sb, const char* format, ...)
+{
+    int length;
+    va_list args;
+    va_start(args, format);
+    length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if(length <= 0)
+    {
+        return;
+    }
+    bl_builder_reserve(sb, (size_t)length);
+    va_start(args, format);
+    vsnprintf(sb->chars + sb->length, (size_t)length + 1, format, args);
+    va_end(args);
+    sb->length += length;
+}
+
+void bl_builder_appendnumber(StringBuilder* sb, double number)
+{
+    bl_builder_appendformat(sb, NUMBER_FORMAT, number);
+}
+
+/*
+* appends value the way to_string() writes it.
+*/
+void bl_builder_appendvalue(VMState* vm, StringBuilder* sb, Value value)
+{
+    if(bl_value_isnil(value))
+    {
+        bl_builder_append(sb, "nil", 3);
+    }
+    else if(bl_value_isbool(value))
+    {
+        if(AS_BOOL(value))
+        {
+            bl_builder_append(sb, "true", 4);
+        }
+        else
+        {
+            bl_builder_append(sb, "false", 5);
+        }
+    }
+    else if(bl_value_isnumber(value))
+    {
+        bl_builder_appendnumber(sb, AS_NUMBER(value));
+    }
+    else if(bl_value_isobject(value))
+    {
+        bl_writer_appendobject(vm, sb, value);
+    }
+}
+
+void bl_builder_clear(StringBuilder* sb)
+{
+    sb->length = 0;
+    if(sb->chars != NULL)
+    {
+        sb->chars[0] = '\0';
+    }
+}
+
+/*
+* the buffer, trimmed to size, for the caller to free(). the builder is
+* left empty.
+*/
+char* bl_builder_release(StringBuilder* sb)
+{
+    char* chars;
+    if(sb->chars == NULL)
+    {
+        chars = (char*)calloc(1, sizeof(char));
+    }
+    else
+    {
+        chars = (char*)realloc(sb->chars, sb->length + 1);
+        if(chars == NULL)
+        {
+            chars = sb->chars;
+        }
+    }
+    bl_builder_init(sb);
+    return chars;
+}
+
+/*
+* a string of what was built, which takes the buffer over rather than
+* copying it (short ones are copied inline, see STRING_INLINE_FITS). the
+* builder is left empty.
+*/
+ObjString* bl_builder_take(VMState* vm, StringBuilder* sb)
+{
+    char* chars;
+    size_t length;
+    ObjString* string;
+    length = sb->length;
+    if(STRING_INLINE_FITS(length))
+    {
+        // a short one is better off inline.
+        string = bl_string_allocuninterned(vm, (int)length);
+        if(length > 0)
+        {
+            memcpy(string->chars, sb->chars, length);
+        }
+        bl_builder_free(sb);
+        return string;
+    }
+    // shrinks it in place, and has the gc count it from here on.
+    chars = (char*)bl_mem_realloc(vm, sb->chars, 0, length + 1);
+    bl_builder_init(sb);
+    return bl_string_takeuninterned(vm, chars, (int)length);
+}
+
+void bl_builder_free(StringBuilder* sb)
+{
+    free(sb->chars);
+    bl_builder_init(sb);
+}
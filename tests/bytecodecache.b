@@ -0,0 +1,89 @@
+import _os
+import .runner
+
+# runs scripts under -c and -C<dir> the way a user would, and checks that
+# a cached run prints exactly what compiling the source does.
+
+var dir = runner.tempdir()
+var cachedir = dir + '/cache'
+_os.exec('mkdir ' + cachedir)
+
+function write(name, source) {
+  file(dir + '/' + name, 'w').write(source)
+}
+
+function run(flags, name) {
+  return runner.run(flags, dir + '/' + name)
+}
+
+function cachecount() {
+  return to_number(_os.exec('ls ${cachedir} | wc -l'))
+}
+
+# the inode changes whenever the cache is written again, as it is renamed into place.
+function inode(path) {
+  return _os.exec('stat -c %i ${path}')
+}
+
+_os.exec('mkdir ${dir}/greeting')
+write('greeting/index.bl', 'function greet(name) { return "hello from the index, " + name }\n')
+write('main.bl', 'import .greeting\n' +
+  'var total = 0\n' +
+  'for(var i = 0; i < 100; i++) { total += i }\n' +
+  'echo greeting.greet("cache")\n' +
+  'echo "total " + total\n' +
+  'echo [1, "two", {"three": 3}]\n')
+var expected = run('', 'main.bl')
+echo expected
+
+# cold: both the script and the module it imports get a cache.
+assert run('-C' + cachedir, 'main.bl') == expected, 'cold run'
+assert cachecount() == 2, 'cold run writes a cache per file'
+
+# warm: the caches are loaded, not written again.
+var before = _os.exec('ls -i ${cachedir}')
+assert run('-C' + cachedir, 'main.bl') == expected, 'warm run'
+assert _os.exec('ls -i ${cachedir}') == before, 'warm run rewrote a cache'
+
+# editing the script leaves its old cache unused.
+write('main.bl', 'import .greeting\necho greeting.greet("edited")\n')
+expected = run('', 'main.bl')
+assert expected == 'hello from the index, edited', 'edit'
+assert run('-C' + cachedir, 'main.bl') == expected, 'edited run'
+assert cachecount() == 3, 'edited run writes a new cache'
+assert run('-C' + cachedir, 'main.bl') == expected, 'edited warm run'
+
+# editing the module does not stale the script's cache, but is seen.
+write('greeting/index.bl', 'function greet(name) { return "hi again, " + name }\n')
+assert run('-C' + cachedir, 'main.bl') == 'hi again, edited', 'module edit'
+
+# an import that now resolves to another file does stale it.
+write('greeting.bl', 'function greet(name) { return "hello from the file, " + name }\n')
+assert run('', 'main.bl') == 'hello from the file, edited', 'shadowed module'
+assert run('-C' + cachedir, 'main.bl') == 'hello from the file, edited', 'shadowed module cached'
+_os.exec('rm ${dir}/greeting.bl')
+assert run('-C' + cachedir, 'main.bl') == 'hi again, edited', 'removed module'
+
+# -c keeps the cache next to the source.
+expected = run('', 'main.bl')
+assert run('-c', 'main.bl') == expected, 'cold run next to the source'
+var cachefile = dir + '/main.blc'
+assert file(cachefile).exists(), 'no cache next to the source'
+var node = inode(cachefile)
+assert run('-c', 'main.bl') == expected, 'warm run next to the source'
+assert inode(cachefile) == node, 'warm run next to the source rewrote the cache'
+
+# a cache cut short, or damaged, is compiled again (and replaced).
+_os.exec('truncate -s 40 ' + cachefile)
+assert run('-c', 'main.bl') == expected, 'truncated cache'
+assert inode(cachefile) != node, 'truncated cache was not replaced'
+node = inode(cachefile)
+_os.exec('printf "\\377\\377\\377\\377" | dd of=${cachefile} bs=1 seek=60 conv=notrunc 2>/dev/null')
+assert run('-c', 'main.bl') == expected, 'damaged cache'
+assert inode(cachefile) != node, 'damaged cache was not replaced'
+_os.exec('printf "garbage" > ' + cachefile)
+assert run('-c', 'main.bl') == expected, 'garbage cache'
+assert run('-c', 'main.bl') == expected, 'warm run after garbage cache'
+
+_os.exec('rm -r ' + dir)
+echo 'bytecode cache ok'
@@ -0,0 +1,116 @@
+# every expression on the left is folded by the compiler; the one on the
+# right computes the same from values it cannot see through, at run time.
+# both must agree, down to the sign of a zero.
+
+function id(value) { return value }
+
+var checked = 0
+
+function check(what, folded, runtime) {
+  assert typeof(folded) == typeof(runtime), '${what}: ${typeof(folded)} against ${typeof(runtime)}'
+  assert to_string(folded) == to_string(runtime), '${what}: ${folded} against ${runtime}'
+  if typeof(folded) == 'number' and folded == 0 {
+    assert 1 / folded == 1 / runtime, '${what}: the zeros differ in sign'
+  }
+  checked++
+}
+
+var zero = id(0)
+var one = id(1)
+var nan = id(0) / id(0)
+
+# division by zero.
+check('1 / 0', 1 / 0, one / zero)
+check('-1 / 0', -1 / 0, -one / zero)
+check('0 / 0', 0 / 0, zero / zero)
+check('7 % 0', 7 % 0, id(7) % zero)
+check('1 / 0 > 10 ** 308', 1 / 0 > 10 ** 308, one / zero > id(10) ** id(308))
+check('-1 / 0 < 0', -1 / 0 < 0, -one / zero < zero)
+
+# negative zero.
+check('-0', -0, -zero)
+check('0 * -1', 0 * -1, zero * -one)
+check('-0 + 0', -0 + 0, -zero + zero)
+check('-0 - 0', -0 - 0, -zero - zero)
+check('1 / -0', 1 / -0, one / -zero)
+check('-0 == 0', -0 == 0, -zero == zero)
+check('-0 < 0', -0 < 0, -zero < zero)
+check('-0 ** 1', -0 ** 1, (-zero) ** one)
+check('-(0 * 5)', -(0 * 5), -(zero * id(5)))
+
+# not a number compares unequal and unordered to everything.
+check('nan == nan', 0 / 0 == 0 / 0, nan == nan)
+check('nan != nan', 0 / 0 != 0 / 0, nan != nan)
+check('nan < 1', 0 / 0 < 1, nan < one)
+check('nan > 1', 0 / 0 > 1, nan > one)
+check('nan <= 1', 0 / 0 <= 1, nan <= one)
+check('nan >= 1', 0 / 0 >= 1, nan >= one)
+check('1 < nan', 1 < 0 / 0, one < nan)
+check('nan + 1', 0 / 0 + 1, nan + one)
+check('-nan', -(0 / 0), -nan)
+check('!nan', !(0 / 0), !nan)
+
+# integer shifts (which work on 32 bits) and the bitwise operators.
+check('1 << 3', 1 << 3, one << id(3))
+check('1 << 31', 1 << 31, one << id(31))
+check('1 << 32', 1 << 32, one << id(32))
+check('1 << 33', 1 << 33, one << id(33))
+check('1 << -1', 1 << -1, one << id(-1))
+check('-16 >> 2', -16 >> 2, id(-16) >> id(2))
+check('-1 >> 31', -1 >> 31, -one >> id(31))
+check('5 >> 32', 5 >> 32, id(5) >> id(32))
+check('2.7 << 1', 2.7 << 1, id(2.7) << one)
+check('4294967297 << 1', 4294967297 << 1, id(4294967297) << one)
+check('255 & 15', 255 & 15, id(255) & id(15))
+check('5 | 2', 5 | 2, id(5) | id(2))
+check('6 ^ 3', 6 ^ 3, id(6) ^ id(3))
+check('-1 & 4294967295', -1 & 4294967295, -one & id(4294967295))
+check('3000000000 | 0', 3000000000 | 0, id(3000000000) | zero)
+check('~5', ~5, ~id(5))
+check('~-1', ~-1, ~(-one))
+
+# the rest of the arithmetic.
+check('7 // 2', 7 // 2, id(7) // id(2))
+check('-7 // 2', -7 // 2, id(-7) // id(2))
+check('-7 % 3', -7 % 3, id(-7) % id(3))
+check('7 % -3', 7 % -3, id(7) % id(-3))
+check('5.5 % 2', 5.5 % 2, id(5.5) % id(2))
+check('2 ** 10', 2 ** 10, id(2) ** id(10))
+check('2 ** -1', 2 ** -1, id(2) ** -one)
+check('0 ** 0', 0 ** 0, zero ** zero)
+check('0.1 + 0.2', 0.1 + 0.2, id(0.1) + id(0.2))
+check('10 ** 308 * 10', 10 ** 308 * 10, id(10) ** id(308) * id(10))
+check('true + true', true + true, id(true) + id(true))
+check('false - 1', false - 1, id(false) - one)
+check('true > false', true > false, id(true) > id(false))
+check('2 >= 2', 2 >= 2, id(2) >= id(2))
+check('2 <= 1', 2 <= 1, id(2) <= one)
+check('-(-3)', -(-3), -(-id(3)))
+
+# truthiness: only nil, false, empty values and negative numbers are false.
+check('!0', !0, !zero)
+check('!-1', !-1, !(-one))
+check('!""', !'', !id(''))
+check('!"a"', !'a', !id('a'))
+check('!nil', !nil, !id(nil))
+
+# strings.
+check('"a" + "b"', 'a' + 'b', id('a') + id('b'))
+check('"a" + "b" + "c"', 'a' + 'b' + 'c', id('a') + id('b') + id('c'))
+check('"" + ""', '' + '', id('') + id(''))
+check('"ab" == "a" + "b"', 'ab' == 'a' + 'b', id('ab') == id('a') + id('b'))
+check('"a" + "b" != "ab"', 'a' + 'b' != 'ab', id('a') + id('b') != id('ab'))
+check('"a" == "b"', 'a' == 'b', id('a') == id('b'))
+check('"1" == 1', '1' == 1, id('1') == one)
+check('"x" + 1', 'x' + 1, id('x') + one)
+check('long strings',
+  'a string long enough not to be stored inline, ' + 'and then some more of it to go on',
+  id('a string long enough not to be stored inline, ') + id('and then some more of it to go on'))
+var d = {}
+d['key' + 'word'] = 1
+assert d[id('key') + id('word')] == 1, 'a folded string as a dict key'
+checked++
+assert ('ab' + 'cd').length == 4, 'length of a folded string'
+checked++
+
+echo '${checked} folded expressions ok'
@@ -0,0 +1,202 @@
+import _os
+import _gc
+import .runner
+
+class Thing {
+  Thing(i) { self.i = i }
+}
+
+class Keeper {
+  Keeper() { self.things = [] }
+}
+
+# (each try in a function of its own, which returns straight after it.)
+function fails(action) {
+  var failed = false
+  try {
+    action()
+  } catch Exception e {
+    failed = true
+  }
+  return failed
+}
+
+# stats: what each key holds.
+var stats = _gc.stats()
+var numbers = ['collections', 'minorcollections', 'markslices', 'paralleltraces', 'sweepslices', 'freedbatches', 'totalpause', 'maxpause', 'heapsize', 'sincelast', 'objects']
+for(var i = 0; i < numbers.length; i++) {
+  assert typeof(stats[numbers[i]]) == 'number', '${numbers[i]} is ${typeof(stats[numbers[i]])}'
+  assert stats[numbers[i]] >= 0, '${numbers[i]} is ${stats[numbers[i]]}'
+}
+assert stats.length() == numbers.length + 1, 'stats has ${stats.keys()}'
+assert typeof(stats['pauses']) == 'List' and stats['pauses'].length > 0, 'pauses is ${stats["pauses"]}'
+for(var i = 0; i < stats['pauses'].length; i++) {
+  assert typeof(stats['pauses'][i]) == 'number', 'pause bucket ${i}'
+}
+assert stats['heapsize'] > 0 and stats['objects'] > 0, 'an empty heap: ${stats}'
+
+# collect() runs a full collection, and counts it.
+var garbage = []
+for(var i = 0; i < 1000; i++) {
+  garbage.append('garbage ${i}')
+}
+garbage = nil
+var before = _gc.stats()
+var freed = _gc.collect()
+var after = _gc.stats()
+assert typeof(freed) == 'number' and freed > 0, 'collect() freed ${freed}'
+assert after['collections'] == before['collections'] + 1, 'collections went from ${before["collections"]} to ${after["collections"]}'
+assert after['maxpause'] >= before['maxpause'], 'maxpause went down'
+assert after['totalpause'] >= before['totalpause'], 'totalpause went down'
+var paused = 0
+for(var i = 0; i < after['pauses'].length; i++) {
+  paused += after['pauses'][i]
+}
+assert paused > 0, 'no pause was counted'
+
+# disable() stops collections from happening of their own accord, but not
+# collect(), and enable() lets them happen again.
+assert _gc.isenabled(), 'collections start out disabled'
+_gc.disable()
+assert !_gc.isenabled(), 'disable() did not'
+before = _gc.stats()
+var kept = []
+for(var i = 0; i < 20000; i++) {
+  kept.append([i, 'item ${i}'])
+}
+after = _gc.stats()
+assert after['collections'] == before['collections'], 'a full collection while disabled'
+assert after['minorcollections'] == before['minorcollections'], 'a minor collection while disabled'
+assert after['sincelast'] > before['sincelast'], 'sincelast did not grow'
+_gc.collect()
+assert _gc.stats()['collections'] == after['collections'] + 1, 'collect() while disabled'
+_gc.enable()
+assert _gc.isenabled(), 'enable() did not'
+before = _gc.stats()
+for(var i = 0; i < 20000; i++) {
+  kept[i] = [i, 'item ${i} again']
+}
+after = _gc.stats()
+assert after['collections'] + after['minorcollections'] > before['collections'] + before['minorcollections'], 'no collection once enabled'
+kept = nil
+
+# objects(): how many of each type there are, and their size.
+var things = []
+for(var i = 0; i < 500; i++) {
+  things.append(Thing(i))
+}
+_gc.collect()
+var least = _gc.stats()['objects']
+var objects = _gc.objects()
+var most = _gc.stats()['objects']
+var types = objects.keys()
+var known = ['String', 'Range', 'List', 'Dictionary', 'File', 'Bytes', 'StringBuilder', 'Upvalue', 'BoundMethod',
+  'Closure', 'Function', 'Instance', 'NativeFunction', 'Class', 'Module', 'Switch', 'Pointer']
+for(var i = 0; i < types.length; i++) {
+  assert known.contains(types[i]), 'unknown type ${types[i]}'
+  assert objects[types[i]]['count'] > 0 and objects[types[i]]['bytes'] > 0, '${types[i]}: ${objects[types[i]]}'
+}
+assert objects['Instance']['count'] >= 500, 'instances: ${objects["Instance"]}'
+assert objects['Class']['count'] >= 1 and objects['Closure']['count'] >= 1, 'classes and closures: ${objects}'
+var count = 0
+for(var i = 0; i < types.length; i++) {
+  count += objects[types[i]]['count']
+}
+# (the dictionaries that report them are objects too.)
+assert count >= least and count <= most, 'objects() counts ${count}, stats() ${least} to ${most}'
+
+var instances = objects['Instance']
+things = nil
+_gc.collect()
+objects = _gc.objects()
+# types with nothing left are left out.
+var left = objects.contains('Instance') ? objects['Instance'] : {'count': 0, 'bytes': 0}
+assert left['count'] <= instances['count'] - 500, 'instances left: ${left}'
+assert left['bytes'] < instances['bytes'], 'instance bytes left: ${left}'
+
+# snapshot(): every object alive and what it points to, in a file that
+# -H summarizes.
+var keeper = Keeper()
+for(var i = 0; i < 300; i++) {
+  keeper.things.append(Thing(i))
+}
+var snapshot = runner.tempfile()
+assert _gc.snapshot(snapshot) == true, 'snapshot() failed'
+var lines = file(snapshot).read().trim().split('\n')
+assert lines[0] == 'blade-heap-snapshot 1', 'snapshot header: ${lines[0]}'
+assert lines[1].startswith('r '), 'snapshot roots: ${lines[1]}'
+var ids = {}
+var references = lines[1].split(' ')[1,]
+var kinds = {}
+for(var i = 2; i < lines.length; i++) {
+  var fields = lines[i].split(' ')
+  assert fields.length >= 4, 'snapshot line ${i}: ${lines[i]}'
+  assert known.contains(fields[1]), 'snapshot line ${i}: unknown type ${fields[1]}'
+  assert to_number(fields[2]) > 0, 'snapshot line ${i}: size ${fields[2]}'
+  assert !ids.contains(fields[0]), 'snapshot line ${i}: ${fields[0]} again'
+  ids[fields[0]] = true
+  references += fields[4,]
+  var kind = fields[1] + ' ' + fields[3]
+  kinds[kind] = kinds.contains(kind) ? kinds[kind] + 1 : 1
+}
+for(var i = 0; i < references.length; i++) {
+  assert ids.contains(references[i]), 'snapshot: ${references[i]} is pointed to, but not there'
+}
+assert kinds['Instance Thing'] == 300, 'snapshot: ${kinds["Instance Thing"]} things'
+assert kinds['Instance Keeper'] == 1 and kinds['Class Thing'] == 1, 'snapshot: ${kinds}'
+
+var summary = runner.run('-H' + snapshot, '').split('\n')
+var objectcount = lines.length - 2
+assert summary[0].startswith('heap snapshot ${snapshot}: ${objectcount} objects'), 'summary: ${summary[0]}'
+var found = 0
+for(var i = 0; i < summary.length; i++) {
+  var line = summary[i].trim()
+  if (line.startswith('300 ') and line.endswith(' Instance Thing')) or line.indexof('Instance Keeper @') > -1 {
+    found++
+  }
+}
+assert found >= 2, 'the things and their keeper are not in the summary'
+_os.exec('rm ' + snapshot)
+
+# profile(): samples allocations, and writes where they came from as
+# folded stacks.
+function build(count) {
+  var items = []
+  for(var i = 0; i < count; i++) {
+    items.append('item ${i}')
+  }
+  return items
+}
+
+var profile = runner.tempfile()
+assert fails(|| { _gc.writeprofile(profile) }), 'writeprofile() with no profile running'
+assert fails(|| { _gc.profile(-1) }), 'profile(-1)'
+assert fails(|| { _gc.profile('often') }), 'profile() with a string'
+_gc.profile(1024)
+build(20000)
+assert _gc.writeprofile(profile) == true, 'writeprofile() failed'
+_gc.profile(0)
+assert fails(|| { _gc.writeprofile(profile) }), 'writeprofile() once the profile stopped'
+
+lines = file(profile).read().trim().split('\n')
+var sampled = 0
+var inbuild = 0
+for(var i = 0; i < lines.length; i++) {
+  # the stack, which has spaces in it, then the bytes.
+  var fields = lines[i].split(' ')
+  var bytes = to_number(fields[-1])
+  var frames = lines[i][0, lines[i].length - fields[-1].length - 1].split(';')
+  assert bytes > 0, 'profile line ${i}: ${lines[i]}'
+  assert frames[0].startswith('@.script ('), 'profile line ${i} starts with ${frames[0]}'
+  var kind = frames[-1]
+  assert known.contains(kind) or kind == '(buffer)', 'profile line ${i}: unknown type ${kind}'
+  sampled += bytes
+  if frames.length > 2 and frames[-2].startswith('build (') {
+    inbuild += bytes
+  }
+}
+assert inbuild > 100 * 1024, '${inbuild} bytes sampled in build()'
+assert inbuild > sampled / 2, '${inbuild} of ${sampled} bytes sampled in build()'
+_os.exec('rm ' + profile)
+
+echo 'gc ok'
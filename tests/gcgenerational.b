@@ -0,0 +1,86 @@
+import _gc
+
+# containers that have long been promoted have fresh objects stored into
+# them, one at a time, across many minor collections. a store the write
+# barrier misses leaves the young value to be freed under the old container.
+
+class Holder {
+  static var items = []
+  Holder() { self.value = nil }
+}
+
+function counter() {
+  var kept = nil
+  function keep(value) {
+    if value != nil { kept = value }
+    return kept
+  }
+  return keep
+}
+
+function young(i) {
+  return ['young', i, 'item ${i}', {'at': i}]
+}
+
+function check(what, value, i) {
+  assert typeof(value) == 'List' and value.length == 4, '${what} ${i}: ${value}'
+  assert value[0] == 'young' and value[1] == i, '${what} ${i}: ${value}'
+  assert value[2] == 'item ${i}' and value[3]['at'] == i, '${what} ${i}: ${value}'
+}
+
+var list = []
+var dict = {}
+var holder = Holder()
+var fields = Holder()
+var keep = counter()
+var global = nil
+
+# promote them all before the stores begin.
+_gc.collect()
+_gc.collect()
+
+var before = _gc.stats()['minorcollections']
+var count = 2000
+for(var i = 0; i < count; i++) {
+  list.append(young(i))
+  dict['key ${i}'] = young(i)
+  holder.value = young(i)
+  using i % 3 {
+    when 0 { fields.a = young(i) }
+    when 1 { fields.b = young(i) }
+    default { fields.c = young(i) }
+  }
+  Holder.items.append(young(i))
+  keep(young(i))
+  global = young(i)
+
+  # garbage, so the nursery fills and is collected while the stores go on.
+  var garbage = []
+  for(var j = 0; j < 20; j++) {
+    garbage.append('garbage ${i} ${j}' * 3)
+  }
+
+  check('instance field', holder.value, i)
+  check('upvalue', keep(nil), i)
+  check('global', global, i)
+}
+
+assert _gc.stats()['minorcollections'] - before > 10, 'too few minor collections to test'
+
+for(var i = 0; i < count; i++) {
+  check('list', list[i], i)
+  check('dict', dict['key ${i}'], i)
+  check('class field', Holder.items[i], i)
+}
+check('instance fields', fields.a, count - 2)
+check('instance fields', fields.b, count - 1)
+check('instance fields', fields.c, count - 3)
+
+# and once more after a full collection has moved them all out of the nursery.
+_gc.collect()
+for(var i = 0; i < count; i++) {
+  check('list after a full collection', list[i], i)
+  check('dict after a full collection', dict['key ${i}'], i)
+}
+
+echo 'generational gc ok'
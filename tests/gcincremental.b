@@ -0,0 +1,124 @@
+import .runner
+
+# runs a script that keeps rewiring references between old and new objects
+# with incremental collection (-p), where marking is interleaved with those
+# stores, and checks it computes what it does when each collection is whole.
+# then checks that -p does split collections up, and pauses for less.
+
+var workload = '
+import _gc
+
+class Node {
+  Node(id) {
+    self.id = id
+    self.next = nil
+    self.items = []
+  }
+}
+
+var seed = 7
+function random(n) {
+  seed = (seed * 1103515245 + 12345) % 2147483648
+  return seed % n
+}
+
+var nodes = []
+for(var i = 0; i < 200; i++) {
+  nodes.append(Node(i))
+}
+var index = {}
+for(var round = 0; round < 300; round++) {
+  for(var i = 0; i < 50; i++) {
+    var from = nodes[random(200)]
+    var to = nodes[random(200)]
+    from.next = to
+    from.items.append("item " + round + " " + i)
+    if from.items.length > 8 {
+      from.items = from.items[4,]
+    }
+    index["at " + random(500)] = [to.id, "round " + round]
+  }
+  # replace a node outright, so old ones are dropped while being marked.
+  nodes[random(200)] = Node(1000 + round)
+}
+
+var sum = 0
+var linked = 0
+for(var i = 0; i < nodes.length; i++) {
+  sum += nodes[i].id
+  if nodes[i].next != nil {
+    linked += nodes[i].next.id
+  }
+  for(var j = 0; j < nodes[i].items.length; j++) {
+    sum += nodes[i].items[j].length
+  }
+}
+var keys = index.keys()
+for(var i = 0; i < keys.length; i++) {
+  sum += index[keys[i]][0] + index[keys[i]][1].length
+}
+echo [sum, linked, keys.length]
+echo _gc.stats()["collections"] > 0
+'
+
+var plain = runner.runsource('-g64', workload)
+var incremental = runner.runsource('-g64 -p50', workload)
+var tiny = runner.runsource('-g64 -p1', workload)
+
+assert plain.endswith('true'), 'the workload did not collect: ${plain}'
+assert incremental == plain, 'incremental: ${incremental}, against ${plain}'
+assert tiny == plain, 'incremental in tiny steps: ${tiny}, against ${plain}'
+
+# a heap that takes a while to mark, while the garbage made meanwhile is a
+# few large strings, that take little to sweep.
+var pausing = '
+import _gc
+
+var live = []
+for(var i = 0; i < 20000; i++) {
+  var row = []
+  for(var j = 0; j < 50; j++) {
+    row.append(i + j)
+  }
+  live.append(row)
+}
+for(var round = 0; round < 200; round++) {
+  var aging = []
+  for(var i = 0; i < 64; i++) {
+    aging.append("x" * 8192)
+  }
+}
+
+var stats = _gc.stats()
+var pauses = 0
+for(var i = 0; i < stats["pauses"].length; i++) {
+  pauses += stats["pauses"][i]
+}
+echo stats["collections"]
+echo stats["minorcollections"]
+echo stats["markslices"]
+echo pauses
+echo stats["maxpause"]
+'
+
+function measure(flags) {
+  var numbers = runner.runsource(flags, pausing).split('\n')
+  assert numbers.length == 5, '${flags}: ${numbers}'
+  var keys = ['collections', 'minorcollections', 'markslices', 'pauses', 'maxpause']
+  var measured = {}
+  for(var i = 0; i < keys.length; i++) {
+    measured[keys[i]] = to_number(numbers[i])
+  }
+  return measured
+}
+
+var whole = measure('-g32768')
+var sliced = measure('-g32768 -p1')
+assert whole['collections'] > 0 and sliced['collections'] > 0, 'no full collection: ${whole}, ${sliced}'
+assert whole['markslices'] == 0, 'marked in slices without -p: ${whole}'
+# each collection marked in more than one slice, with a pause for each.
+assert sliced['markslices'] > sliced['collections'], 'marking was not split: ${sliced}'
+assert sliced['pauses'] > sliced['collections'] + sliced['minorcollections'] + sliced['markslices'], 'pauses: ${sliced}'
+assert sliced['maxpause'] < whole['maxpause'], 'the longest pause went from ${whole["maxpause"]} to ${sliced["maxpause"]}'
+
+echo 'incremental gc ok'
@@ -0,0 +1,110 @@
+import _os
+import _gc
+import .runner
+
+# without -p, a full collection the allocator asks for only pauses to mark:
+# the old objects are swept after it, a slice at a time as more is allocated.
+var before = _gc.stats()
+var aging = []
+for(var round = 0; round < 30; round++) {
+  var next = []
+  for(var i = 0; i < 10000; i++) {
+    next.append([round, 'item ${i}'])
+  }
+  # promoted while it was made, it dies old once the next round is done.
+  aging = next
+}
+var after = _gc.stats()
+var collections = after['collections'] - before['collections']
+var slices = after['sweepslices'] - before['sweepslices']
+assert collections > 0, 'no full collection'
+assert slices > collections, '${slices} sweep slices for ${collections} collections'
+assert after['freedbatches'] == 0, '${after["freedbatches"]} batches handed over without -s'
+
+# while collect() sweeps everything right away.
+_gc.collect()
+slices = _gc.stats()['sweepslices']
+_gc.collect()
+assert _gc.stats()['sweepslices'] == slices, 'collect() swept in slices'
+aging = nil
+
+# then runs a script that makes garbage of every kind, file handles included,
+# with the memory of dead objects freed on a background thread (-s), and
+# checks it prints what it does when the sweep frees everything inline.
+
+var data = runner.tempfile()
+file(data, 'w').write('some data to read\n')
+
+var workload = '
+import _gc
+
+var path = "' + data + '"
+var kept = []
+var aging = []
+var total = 0
+for(var round = 0; round < 40; round++) {
+  # lives through a few rounds, so that it dies old and a full collection
+  # has to sweep it.
+  if round % 4 == 0 {
+    aging = []
+  }
+  for(var i = 0; i < 1000; i++) {
+    var text = "round " + round + " item " + i
+    var items = [text, text.length, bytes([round, i % 256])]
+    var entry = {"text": text, "items": items}
+    var builder = string_builder()
+    builder.append(text)
+    builder.append(items)
+    total += entry["items"][1] + builder.length + items[2][0]
+    if i % 100 == 0 {
+      kept.append(entry)
+    }
+    if i % 2 == 0 {
+      aging.append(entry)
+    }
+  }
+  # handles that are never closed, for the sweep to finalize.
+  var handle = file(path)
+  total += handle.read().length
+}
+
+_gc.collect()
+var before = _gc.stats()["heapsize"]
+kept = kept[0, 10]
+_gc.collect()
+var after = _gc.stats()["heapsize"]
+
+var sum = 0
+for(var i = 0; i < kept.length; i++) {
+  sum += kept[i]["items"][1] + kept[i]["text"].length
+}
+echo [total, sum, kept.length]
+echo after < before
+var objects = _gc.objects()
+echo [objects["Dictionary"]["count"], objects["Bytes"]["count"]]
+var stats = _gc.stats()
+echo stats["sweepslices"]
+echo stats["freedbatches"]
+'
+
+# what the script printed, the slices it was swept in, and the batches of
+# memory the background freer was handed.
+function run(flags) {
+  var lines = runner.runsource(flags, workload).split('\n')
+  assert lines.length == 5, '${flags}: ${lines}'
+  return [to_string(lines[0, 3]), to_number(lines[3]), to_number(lines[4])]
+}
+
+# a small heap, so that it is collected in full again and again.
+var inline = run('-g64')
+var background = run('-g64 -s')
+var incremental = run('-g64 -s -p100')
+_os.exec('rm ' + data)
+
+assert inline[0].indexof(', true, ') > -1, 'collecting freed nothing: ${inline}'
+assert inline[1] > 0 and inline[2] == 0, 'inline: ${inline}'
+assert background[1] > 0 and background[2] > 0, '-s: ${background}'
+assert incremental[1] > 0 and incremental[2] > 0, '-s -p100: ${incremental}'
+assert background[0] == inline[0], '-s: ${background[0]}, against ${inline[0]}'
+assert incremental[0] == inline[0], '-s -p100: ${incremental[0]}, against ${inline[0]}'
+echo 'lazy sweep ok'
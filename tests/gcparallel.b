@@ -0,0 +1,80 @@
+import .runner
+
+# builds a heap well over the size where full collections start marking on
+# several threads (GC_PARALLEL_MIN_HEAP), all of it reachable in many ways,
+# and checks that with -t the collector does mark it with several threads,
+# and keeps just what one marker keeps.
+
+var workload = '
+import _gc
+
+class Node {
+  Node(id, up) {
+    self.id = id
+    self.up = up
+    self.children = []
+    self.tags = {"name": "node " + id}
+  }
+}
+
+var nodes = []
+var root = Node(0, nil)
+nodes.append(root)
+for(var i = 1; i < 60000; i++) {
+  var up = nodes[(i - 1) // 3]
+  var node = Node(i, up)
+  up.children.append(node)
+  node.tags["path"] = up.tags["name"] + "/" + i
+  nodes.append(node)
+}
+# then drop the list, so that the tree is only reachable from its root.
+nodes = nil
+echo _gc.stats()["heapsize"] > 8 * 1024 * 1024
+
+for(var round = 0; round < 3; round++) {
+  # garbage on the side, for the collection to tell apart.
+  var garbage = []
+  for(var i = 0; i < 20000; i++) {
+    garbage.append({"round": round, "i": i})
+  }
+  garbage = nil
+  _gc.collect()
+}
+
+function walk(node) {
+  var sum = node.id + node.tags["name"].length
+  if node.up != nil {
+    assert node.tags["path"] == node.up.tags["name"] + "/" + node.id, "path of " + node.id
+  }
+  for(var i = 0; i < node.children.length; i++) {
+    assert node.children[i].up == node, "up of " + node.children[i].id
+    sum += walk(node.children[i])
+  }
+  return sum
+}
+echo walk(root)
+
+var objects = _gc.objects()
+echo [objects["Instance"]["count"], objects["Dictionary"]["count"], objects["List"]["count"]]
+echo _gc.stats()["paralleltraces"]
+'
+
+# what the script found, and how many of its collections were traced by
+# several threads.
+function run(count) {
+  var lines = runner.runsource('-t${count}', workload).split('\n')
+  return [lines[0, lines.length - 1], to_number(lines[-1])]
+}
+
+var serial = run(1)
+assert serial[0][0] == 'true', 'the heap is too small to mark in parallel: ${serial}'
+assert serial[1] == 0, '-t1 traced ${serial[1]} collections with several threads'
+var threads = [2, 4, 8]
+for(var i = 0; i < threads.length; i++) {
+  var count = threads[i]
+  var parallel = run(count)
+  assert parallel[1] >= 3, '-t${count} traced ${parallel[1]} collections with several threads'
+  assert to_string(parallel[0]) == to_string(serial[0]), '-t${count}: ${parallel[0]}, against ${serial[0]}'
+}
+
+echo 'parallel gc ok'
@@ -0,0 +1,100 @@
+import _gc
+import .runner
+
+# checks what _gc.policy() makes of the heap policy, as it is by default and
+# as given on the command line to a script that collects a good few times.
+
+var workload = '
+import _gc
+
+function show(policy) {
+  var keys = ["heapsize", "nextgc", "minheap", "softlimit", "timetarget", "timeshare", "growth", "survival"]
+  for(var i = 0; i < keys.length; i++) {
+    echo policy[keys[i]]
+  }
+}
+
+show(_gc.policy())
+
+# most of it dies young, but what is kept a while fills the old space.
+var kept = []
+for(var i = 0; i < 100000; i++) {
+  var garbage = [i, "garbage " + i]
+  if i % 2 == 0 {
+    kept.append(garbage)
+  }
+  if i % 10000 == 0 {
+    kept = []
+  }
+}
+show(_gc.policy())
+echo _gc.stats()["collections"]
+'
+
+# without any of the flags, there is no soft limit and the time target is
+# the default one, and what was measured over the collections is in range.
+var kept = []
+for(var i = 0; i < 100000; i++) {
+  kept.append([i, 'kept ${i}'])
+  if i % 20000 == 0 {
+    kept = []
+    _gc.collect()
+  }
+}
+var policy = _gc.policy()
+assert policy['softlimit'] == 0 and policy['timetarget'] == 5, 'defaults ${policy}'
+assert policy['nextgc'] >= policy['minheap'], 'nextgc ${policy["nextgc"]} is under the minimum heap'
+assert policy['growth'] > 1 and policy['growth'] <= 4, 'growth ${policy["growth"]}'
+assert policy['survival'] >= 0 and policy['survival'] <= 1, 'survival ${policy["survival"]}'
+assert policy['timeshare'] >= 0 and policy['timeshare'] <= 100, 'timeshare ${policy["timeshare"]}'
+kept = nil
+
+# the policy as it was before the workload collected, and as it is after.
+var keys = ['heapsize', 'nextgc', 'minheap', 'softlimit', 'timetarget', 'timeshare', 'growth', 'survival']
+var start
+function run(flags) {
+  var output = runner.runsource(flags, workload).split('\n')
+  assert output.length == keys.length * 2 + 1, '${flags}: ${output}'
+  assert to_number(output[-1]) > 0, '${flags}: the workload did not collect'
+  start = {}
+  var policy = {}
+  for(var i = 0; i < keys.length; i++) {
+    start[keys[i]] = to_number(output[i])
+    policy[keys[i]] = to_number(output[keys.length + i])
+  }
+  return policy
+}
+
+# a soft limit below the minimum heap holds the next collection down to it,
+# while the heap is still growing by the time target.
+var limited = run('-g4096 -m2048 -r10')
+assert limited['minheap'] == 4096 * 1024, 'minheap ${limited["minheap"]}'
+assert limited['softlimit'] == 2048 * 1024, 'softlimit ${limited["softlimit"]}'
+assert limited['timetarget'] == 10, 'timetarget ${limited["timetarget"]}'
+assert limited['growth'] > 1 and limited['growth'] <= 4, 'growth ${limited["growth"]}'
+assert limited['nextgc'] <= 2048 * 1024, 'nextgc ${limited["nextgc"]} is over the soft limit'
+
+# without it, the minimum heap stands.
+var unlimited = run('-g4096 -r10')
+assert unlimited['softlimit'] == 0, 'softlimit ${unlimited["softlimit"]}'
+assert unlimited['timetarget'] == 10, 'timetarget ${unlimited["timetarget"]}'
+assert unlimited['nextgc'] >= 4096 * 1024, 'nextgc ${unlimited["nextgc"]} is under the minimum heap'
+
+# a share of the run time over 100% is no share at all, and is ignored.
+var ignored = run('-m2048 -r150')
+assert ignored['softlimit'] == 2048 * 1024, 'softlimit ${ignored["softlimit"]}'
+assert ignored['timetarget'] == 5, 'timetarget ${ignored["timetarget"]}'
+
+# the minimum heap is where the first collection starts.
+var sized = run('-g2048')
+assert start['minheap'] == 2048 * 1024 and start['nextgc'] == 2048 * 1024, 'start ${start}'
+assert start['timeshare'] == 0 and start['survival'] == 0, 'measured before collecting ${start}'
+assert sized['minheap'] == 2048 * 1024, 'minheap ${sized["minheap"]}'
+assert sized['nextgc'] >= 2048 * 1024, 'nextgc ${sized["nextgc"]} is under the minimum heap'
+
+# with no time target, the heap grows by a fixed factor.
+var fixed = run('-g256 -r0')
+assert fixed['timetarget'] == 0, 'timetarget ${fixed["timetarget"]}'
+assert fixed['growth'] == start['growth'], 'growth went from ${start["growth"]} to ${fixed["growth"]}'
+
+echo 'gc policy ok'
@@ -0,0 +1,74 @@
+import _gc
+
+# call sites that remember what a lookup found: receivers of many classes
+# through one site, and classes made and freed while a site still holds an
+# entry for them.
+
+class Circle {
+  Circle(r) { self.r = r }
+  name() { return 'circle' }
+}
+
+class Square {
+  Square(s) { self.s = s }
+  name() { return 'square' }
+}
+
+class Plain {
+  name() { return 'plain' }
+}
+
+class Big < Square {
+  name() { return 'big ' + parent.name() }
+}
+
+class Small < Square {}
+
+function name(x) { return x.name() }
+
+# more classes than a site has room for, and classes that are defined
+# in between calls, which don't change what the site finds for the others.
+var shapes = [Circle(1), Square(2), Plain(), Big(3), Small(4)]
+var names = ['circle', 'square', 'plain', 'big square', 'square']
+for(var round = 0; round < 50; round++) {
+  for(var i = 0; i < shapes.length; i++) {
+    assert name(shapes[i]) == names[i], 'round ${round}: ${name(shapes[i])} for ${names[i]}'
+  }
+  if round == 25 {
+    class Late {
+      name() { return 'late' }
+    }
+    shapes.append(Late())
+    names.append('late')
+  }
+  assert 'abc'.upper() == 'ABC' and [3, 1].contains(1), 'round ${round}: builtin methods'
+}
+
+# a class freed while a site has an entry for it may have its memory, and
+# that of its shapes and methods, reused by the next class made.
+function first() {
+  class First {
+    value() { return 'first' }
+    other() { return 'other' }
+  }
+  return First()
+}
+
+function second() {
+  class Second {
+    other() { return 'other' }
+    value() { return 'second' }
+  }
+  return Second()
+}
+
+function value(x) { return x.value() }
+
+for(var round = 0; round < 100; round++) {
+  var expected = round % 2 == 0 ? 'first' : 'second'
+  var got = value(round % 2 == 0 ? first() : second())
+  assert got == expected, 'round ${round}: ${got} for ${expected}'
+  _gc.collect()
+}
+
+echo 'inline cache ok'
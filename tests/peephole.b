@@ -0,0 +1,178 @@
+# code the peephole pass rewrites: short-circuits, compare-and-branch
+# loops, break and continue across the rewritten jumps, and try handlers
+# and using tables that must be relocated along with them.
+
+var log = []
+
+function note(value) {
+  log.append(value)
+  return value
+}
+
+function expect(what, expected) {
+  assert to_string(log) == expected, '${what}: got ${log}, expected ${expected}'
+  log = []
+}
+
+# and / or evaluate their right operand only when they have to.
+var a = note(1) and note(2)
+var b = note(-1) and note(3)
+var c = note(nil) or note(4)
+var d = note(5) or note(6)
+expect('and/or values', '[1, 2, -1, nil, 4, 5]')
+assert a == 2 and b == -1 and c == 4 and d == 5, 'and/or results'
+
+if note(false) and note(true) { note('no') } else { note('else') }
+if note(true) or note(false) { note('yes') }
+if (note(1) < note(2) and note(3) > note(4)) or note(5) == note(5) { note('mixed') }
+expect('and/or conditions', '[false, else, true, yes, 1, 2, 3, 4, 5, 5, mixed]')
+
+var x = 3
+var y = x > 2 and x < 5 or x == 10
+var z = x < 2 or x > 5 and x == 3
+assert y and !z, 'and/or of comparisons'
+
+# compare-and-branch, as loop conditions and inside loop bodies.
+var i = 0
+while i < 5 {
+  if i == 2 { note('two') }
+  else if i > 3 { note('big') }
+  else { note(i) }
+  i++
+}
+expect('while', '[0, 1, two, 3, big]')
+
+for(var j = 10; j > 7; j--) {
+  note(j)
+}
+for(var j = 0; j == 0; j++) {
+  note('once')
+}
+expect('for', '[10, 9, 8, once]')
+
+var n = 0
+do {
+  n++
+} while n < 100
+assert n == 100, 'do while'
+
+# break and continue, nested, with the jumps around them rewritten.
+for(var j = 0; j < 10; j++) {
+  if j == 1 { continue }
+  if j > 6 { break }
+  var k = 0
+  while k < 10 {
+    k++
+    if k < 3 { continue }
+    if k == 4 { break }
+    note('${j}.${k}')
+  }
+  if j == 4 and k == 4 { continue }
+  note(j)
+}
+expect('break and continue', '[0.3, 0, 2.3, 2, 3.3, 3, 4.3, 5.3, 5, 6.3, 6]')
+
+i = 0
+while true {
+  i++
+  if i < 3 { continue }
+  note(i)
+  if i >= 5 { break }
+}
+expect('while true', '[3, 4, 5]')
+
+# try handlers: the catch and finally offsets follow the rewritten code.
+# (each try sits in a function of its own, which returns straight after it,
+# as a caught exception leaves the stack of its frame out of step with the
+# locals.)
+function risky(value) {
+  for(var j = 0; j < 3; j++) {
+    if j == value and value > 0 {
+      die Exception('at ${j}')
+    }
+  }
+  return value
+}
+
+function attempt(value) {
+  var result = nil
+  try {
+    if value < 2 and value == 1 { note('one') }
+    result = risky(value)
+  } catch Exception e {
+    result = e.message
+  }
+  return result
+}
+
+for(var j = 0; j < 4; j++) {
+  note(attempt(j))
+}
+expect('try', '[0, one, at 1, at 2, 3]')
+
+function stopat(limit) {
+  var result = 'ran through'
+  try {
+    var k = 0
+    while k < 10 {
+      k++
+      if k == limit { die Exception('stopped at ${k}') }
+    }
+  } catch Exception e {
+    result = e.message
+  }
+  return result
+}
+note(stopat(5))
+note(stopat(20))
+expect('try in a loop', '[stopped at 5, ran through]')
+
+function guarded(value) {
+  try {
+    while value < 3 { value++ }
+  } finally {
+    note('finally ${value}')
+  }
+  return value
+}
+note(guarded(0))
+note(guarded(5))
+expect('try and finally', '[finally 3, 3, finally 5, 5]')
+
+# using tables: every when, and default, lands where it should.
+function pick(value) {
+  using value {
+    when 1 { return 'one' }
+    when 2, 3 {
+      if value == 2 and value < 3 { return 'two' }
+      return 'three'
+    }
+    when 'x' { return 'ex' }
+    default {
+      if value > 100 or value < -100 { return 'far' }
+      return 'other'
+    }
+  }
+}
+
+for(var j = 0; j < 5; j++) {
+  note(pick(j))
+}
+note(pick('x'))
+note(pick(1000))
+expect('using', '[other, one, two, three, other, ex, far]')
+
+for(var j = 0; j < 6; j++) {
+  using j % 3 {
+    when 0 { continue }
+    when 1 {
+      if j > 3 { break }
+      note('a${j}')
+    }
+    default { note('b${j}') }
+  }
+  note(j)
+}
+expect('using in a loop', '[a1, 1, b2, 2]')
+
+echo 'peephole ok'
@@ -0,0 +1,67 @@
+import .runner
+
+# every arithmetic and comparison site here sees numbers first, so it is
+# quickened, then other values, then numbers again. each must give what the
+# generic instruction does, however often the types change.
+
+class Point {
+  Point(x) { self.x = x }
+}
+
+function add(a, b) { return a + b }
+function sub(a, b) { return a - b }
+function mul(a, b) { return a * b }
+function div(a, b) { return a / b }
+function eq(a, b) { return a == b }
+function gt(a, b) { return a > b }
+function lt(a, b) { return a < b }
+
+var p = Point(1)
+var list = [1, 2]
+for(var round = 0; round < 50; round++) {
+  for(var i = 0; i < 10; i++) {
+    assert add(i, 0.5) == i + 0.5, 'add numbers'
+    assert sub(i, 1) == i - 1, 'subtract numbers'
+    assert mul(i, 3) == i * 3, 'multiply numbers'
+    assert div(i, 4) == i / 4, 'divide numbers'
+    assert eq(i, i) and !eq(i, i + 1), 'equal numbers'
+    assert gt(i + 1, i) and !gt(i, i), 'greater numbers'
+    assert lt(i, i + 1) and !lt(i, i), 'less numbers'
+  }
+
+  assert add('round ', round) == 'round ${round}', 'add string and number'
+  assert add('a', 'b') == 'ab', 'add strings'
+  assert to_string(add([round], list)) == '[${round}, 1, 2]', 'add lists'
+  assert add(bytes([1]), bytes([2])).length() == 2, 'add bytes'
+  assert add(true, 1) == 2, 'add bool'
+  assert sub(true, false) == 1, 'subtract bools'
+  assert mul('ab', 2) == 'abab', 'multiply string'
+  assert mul(list, 2).length == 4, 'multiply list'
+  assert mul(true, 7) == 7, 'multiply bool'
+  assert div(true, 2) == 0.5, 'divide bool'
+  assert eq('ab', add('a', 'b')), 'equal strings'
+  assert eq(p, p) and !eq(p, Point(1)), 'equal instances'
+  assert eq(list, list) and !eq(list, 1), 'equal lists'
+  assert !eq(nil, false) and eq(nil, nil), 'equal nil'
+  assert gt(true, false) and !gt(false, true), 'greater bools'
+  assert lt(false, 1) and !lt(1, true), 'less bools'
+}
+
+# once a site has seen more than numbers it stays generic (mula), rather
+# than quickening (muln) again every time numbers come back.
+var trace = runner.runsource('-j', 'function mul(a, b) { return a * b }\n' +
+  'for(var i = 0; i < 20; i++) {\n  mul(i, 2)\n  mul("x", 2)\n}\n').split('\n')
+var quickened = 0
+var generic = 0
+for(var i = 0; i < trace.length; i++) {
+  if(trace[i].endswith('| muln')) {
+    assert generic == 0, 'a generic site was quickened again'
+    quickened++
+  } else if(trace[i].endswith('| mula')) {
+    generic++
+  }
+}
+assert quickened == 2, 'quickened ${quickened} times'
+assert generic == 39, 'generic ${generic} times'
+
+echo 'quickening ok'
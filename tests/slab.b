@@ -0,0 +1,146 @@
+import _gc
+
+# makes waves of small objects of every size class, frees part of each wave
+# so that the next one reuses their slots (and whole pages empty out), and
+# checks that everything still alive reads back as it was made.
+
+class Pair {
+  Pair(a, b) {
+    self.a = a
+    self.b = b
+  }
+  sum() { return self.a + self.b }
+}
+
+# a short string for every length a gc object can hold inline, and then some.
+function text(i) {
+  var length = i % 240
+  return ('${i}:' + 'abcdefghij' * 25)[0, length]
+}
+
+function make(i) {
+  using i % 8 {
+    when 0 { return text(i) }
+    when 1 { return [i, text(i)] }
+    when 2 { return {'i': i, 'text': text(i)} }
+    when 3 { return Pair(i, text(i)) }
+    when 4 { return Pair(i, 1).sum }
+    when 5 { return i..(i + 3) }
+    when 6 { return bytes([i % 256, 1, 2]) }
+    default {
+      var captured = text(i)
+      return || { return captured }
+    }
+  }
+}
+
+function verify(i, value) {
+  using i % 8 {
+    when 0 { return value == text(i) }
+    when 1 { return value.length == 2 and value[0] == i and value[1] == text(i) }
+    when 2 { return value['i'] == i and value['text'] == text(i) }
+    when 3 { return value.a == i and value.b == text(i) }
+    when 4 { return value() == i + 1 }
+    when 5 { return value.lower() == i and value.upper() == i + 3 }
+    when 6 { return value.length() == 3 and value[0] == i % 256 and value[2] == 2 }
+    default { return value() == text(i) }
+  }
+}
+
+var count = 4000
+var live = []
+var first = []
+for(var wave = 0; wave < 6; wave++) {
+  var objects = []
+  for(var i = 0; i < count; i++) {
+    objects.append(make(wave * count + i))
+  }
+  # keep one in every wave + 2 of them, and let the rest go.
+  var kept = []
+  for(var i = 0; i < count; i += wave + 2) {
+    kept.append([wave * count + i, objects[i]])
+  }
+  objects = nil
+  live.append(kept)
+  _gc.collect()
+
+  for(var w = 0; w < live.length; w++) {
+    for(var k = 0; k < live[w].length; k++) {
+      var i = live[w][k][0]
+      assert verify(i, live[w][k][1]), 'wave ${wave}: object ${i} is not what it was'
+    }
+  }
+}
+
+# with everything let go, the pages they were on are given back.
+var before = _gc.stats()['heapsize']
+live = nil
+_gc.collect()
+var after = _gc.stats()['heapsize']
+assert after < before, 'freeing everything left the heap at ${after} bytes, from ${before}'
+
+# and they can be made again.
+var again = []
+for(var i = 0; i < count; i++) {
+  again.append(make(i))
+}
+_gc.collect()
+for(var i = 0; i < count; i++) {
+  assert verify(i, again[i]), 'object ${i} is not what it was once made again'
+}
+
+# slabs(): the size classes with pages, smallest first. no gc object is
+# big enough to need a page of its own, so with collections held off the
+# slots in use add up to the objects there are, counted on either side of
+# the call. (a build with BLADE_NO_SLAB has no classes to show.)
+function used(classes) {
+  var total = 0
+  for(var i = 0; i < classes.length; i++) {
+    total += classes[i]['used']
+  }
+  return total
+}
+
+function pages(classes) {
+  var total = 0
+  for(var i = 0; i < classes.length; i++) {
+    total += classes[i]['pages']
+  }
+  return total
+}
+
+_gc.disable()
+var least = _gc.stats()['objects']
+var classes = _gc.slabs()
+var most = _gc.stats()['objects']
+_gc.enable()
+if classes.length > 0 {
+  for(var i = 0; i < classes.length; i++) {
+    var c = classes[i]
+    assert c.length() == 4, 'class ${i} has ${c.keys()}'
+    assert c['size'] % 16 == 0 and c['size'] >= 16 and c['size'] <= 256, 'class ${i} is of ${c["size"]} bytes'
+    assert i == 0 or c['size'] > classes[i - 1]['size'], 'class ${i} is out of order'
+    assert c['pages'] > 0, 'class ${i} has ${c["pages"]} pages'
+    assert c['used'] <= c['slots'] and c['slots'] >= c['pages'], 'class ${i}: ${c}'
+  }
+  assert used(classes) >= least and used(classes) <= most, '${used(classes)} slots are used for ${least} to ${most} objects'
+
+  # made objects take up slots, on pages mapped for them, and giving them
+  # back hands those pages back.
+  _gc.collect()
+  var start = _gc.slabs()
+  var made = []
+  for(var i = 0; i < count * 4; i++) {
+    made.append(Pair(i, i))
+  }
+  var full = _gc.slabs()
+  assert used(full) >= used(start) + count * 4, '${count * 4} pairs took ${used(full) - used(start)} slots'
+  assert pages(full) > pages(start), 'the pairs fit on the ${pages(start)} pages there were'
+  made = nil
+  _gc.collect()
+  var freed = _gc.slabs()
+  assert used(freed) < used(full) - count * 3, 'freeing the pairs left ${used(freed)} slots used, from ${used(full)}'
+  assert pages(freed) < pages(full), 'freeing the pairs left ${pages(freed)} pages, from ${pages(full)}'
+}
+
+echo 'slab ok'
@@ -1,3 +1,5 @@
+import _gc
+
 echo 'It works'
 
 echo 'I have ${20} naira'
@@ -7,3 +9,198 @@ var message = '"I am great"'
 echo 'Simon says ${message}'
 
 echo '${message} at ${5 * 5}, This is ${"john's ${'last'.upper()} ${20}"} cent'
+
+# concatenations long enough to be kept as ropes (see ROPE_MIN_LENGTH). a
+# rope only has its chars put together once something needs them, so each
+# check is given one fresh.
+function makerope() {
+  var rope = ''
+  for(var i = 0; i < 200; i++) {
+    rope += 'part ${i};'
+  }
+  return rope
+}
+var parts = []
+for(var i = 0; i < 200; i++) {
+  parts.append('part ${i};')
+}
+var flat = ''.join(parts)
+var length = flat.length
+assert makerope().length == length and length > 1000, 'rope length'
+assert makerope() == flat and flat == makerope(), 'rope and flat string differ'
+assert makerope() == makerope(), 'ropes differ'
+assert makerope() != flat + '.' and makerope() + '.' != flat, 'rope equals a longer string'
+assert makerope()[0] == 'p' and makerope()[5] == '0' and makerope()[-1] == ';', 'rope index'
+assert makerope()[0, 7] == 'part 0;' and makerope()[length - 9,] == 'part 199;', 'rope slice'
+assert makerope()[7, 14] == 'part 1;', 'rope slice in the middle'
+var at = flat.indexof('part 150;')
+assert makerope().indexof('part 150;') == at and at > 0, 'rope indexof'
+assert makerope().indexof('part 200;') == -1, 'rope indexof a missing string'
+var ropes = {}
+ropes[makerope()] = 'by rope'
+assert ropes[flat] == 'by rope', 'rope as a dict key'
+ropes[flat + 'x'] = 'by flat'
+assert ropes[makerope() + 'x'] == 'by flat', 'rope looked up in a dict'
+assert ropes.contains(makerope()) and ropes.keys().length == 2, 'rope dict keys'
+var both = makerope() + makerope()
+assert both.length == length * 2 and both[length, length + 7] == 'part 0;', 'rope of ropes'
+echo 'ropes ok'
+
+# strings computed at run time aren't interned until they are used as a key,
+# yet must find what the literal with the same chars names.
+function computed(text) {
+  return ''.join(text.split(''))
+}
+var keyed = {'name': 'literal'}
+assert keyed[computed('name')] == 'literal', 'computed key finds a literal one'
+keyed[computed('other')] = 'computed'
+assert keyed['other'] == 'computed', 'literal key finds a computed one'
+keyed[computed('name')] = 'updated'
+assert keyed['name'] == 'updated' and keyed.length() == 2, 'computed key updates a literal one'
+assert keyed.contains(computed('other')) and !keyed.contains(computed('missing')), 'computed contains'
+keyed.remove(computed('other'))
+assert !keyed.contains('other') and keyed.length() == 1, 'computed remove'
+
+class Named {
+  Named() {
+    self.name = 'literal'
+  }
+}
+var named = Named()
+assert getprop(named, computed('name')) == 'literal', 'computed property name finds a literal one'
+assert hasprop(named, computed('name')) and !hasprop(named, computed('nothing')), 'computed hasprop'
+assert !setprop(named, computed('name'), 'updated'), 'computed property name added a property'
+assert named.name == 'updated', 'computed property name updates a literal one'
+assert setprop(named, computed('extra'), 'computed'), 'computed property name was not added'
+assert named.extra == 'computed' and getprop(named, 'extra') == 'computed', 'literal finds a computed property name'
+assert delprop(named, computed('extra')) and !hasprop(named, 'extra'), 'computed delprop'
+
+# with more properties than a shape holds, the instance keeps them in a table.
+var wide = Named()
+for(var i = 0; i < 80; i++) {
+  setprop(wide, computed('field${i}'), i)
+}
+assert wide.field0 == 0 and wide.field79 == 79, 'literal finds computed properties of a wide instance'
+assert getprop(wide, computed('field42')) == 42 and getprop(wide, computed('name')) == 'literal', 'wide instance'
+
+# keys updated while strings come and go: an interned key must still be found
+# past the ones collected since.
+var latest = {}
+var rounds = {}
+for(var round = 0; round < 100; round++) {
+  var garbage = {}
+  for(var i = 0; i < 50; i++) {
+    var r = (round * 31 + i * 17) % 97
+    latest['key ' + r] = round
+    rounds[r] = round
+    garbage['garbage ${round} ${i}'] = i
+  }
+  _gc.collect()
+}
+var numbers = rounds.keys()
+assert latest.length() == numbers.length, '${latest.length()} keys for ${numbers.length}'
+for(var i = 0; i < numbers.length; i++) {
+  var key = 'key ' + numbers[i]
+  assert latest[key] == rounds[numbers[i]], '${key} is ${latest[key]}, not ${rounds[numbers[i]]}'
+}
+echo 'computed keys ok'
+
+# strings up to STRING_INLINE_FITS keep their chars right after them, longer
+# ones in a buffer of their own: with a 40 byte ObjString and 256 byte slab
+# objects, 215 chars are the most that fit. each way of making a string must
+# agree on either side of it.
+var sizes = [214, 215, 216]
+var bykey = {}
+for(var i = 0; i < sizes.length; i++) {
+  var size = sizes[i]
+  var repeated = 'k' * size
+  var sliced = ('k' * (size + 10))[0, size]
+  var joined = computed(repeated)
+  var built = string_builder()
+  for(var j = 0; j < size; j++) {
+    built.append('k')
+  }
+  built = built.to_string()
+  var concatenated = 'k' * (size - 1) + 'k'
+  var lowered = ('K' * size).lower()
+  var made = [repeated, sliced, joined, built, concatenated, lowered]
+  for(var j = 0; j < made.length; j++) {
+    assert made[j].length == size, '${size}: ${j} is ${made[j].length} long'
+    assert made[j] == repeated, '${size}: ${j} differs'
+    assert made[j][size - 1] == 'k' and made[j][size - 2,] == 'kk', '${size}: ${j} ends wrong'
+  }
+  assert repeated != 'k' * (size - 1) + 'j', '${size}: equal with the last char different'
+  assert repeated != 'k' * (size - 1) and repeated != 'k' * (size + 1), '${size}: equal to a neighbour'
+  assert repeated.upper() == 'K' * size, '${size}: upper()'
+
+  bykey[joined] = size
+  assert bykey[repeated] == size and bykey[built] == size and bykey[lowered] == size, '${size}: key not found'
+  bykey[concatenated] = -size
+  assert bykey[sliced] == -size, '${size}: key not updated'
+}
+assert bykey.length() == sizes.length, 'keys around the inline limit: ${bykey.length()}'
+_gc.collect()
+for(var i = 0; i < sizes.length; i++) {
+  assert bykey['k' * sizes[i]] == -sizes[i], '${sizes[i]}: key lost by collecting'
+}
+echo 'inline limit ok'
+
+# multibyte text, counted and indexed by code point, in strings whose byte
+# lengths fall on and around the 8, 16 and 32 bytes bl_util_utf8count()
+# looks at a time, with characters of every width across each boundary.
+var pieces = ['a', 'ÿ', '€', '😀']
+var bytelengths = [15, 16, 17, 31, 32, 33, 64]
+for(var i = 0; i < bytelengths.length; i++) {
+  var bytelength = bytelengths[i]
+  for(var shift = 0; shift < pieces.length; shift++) {
+    var chars = []
+    var text = ''
+    var used = 0
+    for(var j = 0; used < bytelength; j++) {
+      var piece = pieces[(j + shift) % pieces.length]
+      if used + piece.tobytes().length() > bytelength {
+        piece = 'a'
+      }
+      chars.append(piece)
+      text += piece
+      used += piece.tobytes().length()
+    }
+    var name = '${bytelength} bytes from ${shift}'
+    assert text.tobytes().length() == bytelength, '${name}: ${text.tobytes().length()} bytes'
+    assert text.length == chars.length, '${name}: length ${text.length}, not ${chars.length}'
+    for(var j = 0; j < chars.length; j++) {
+      assert text[j] == chars[j], '${name}: [${j}] is ${text[j]}, not ${chars[j]}'
+    }
+    assert text[-1] == chars[-1] and text[text.length - 1] == chars[-1], '${name}: last char'
+    assert text[1, 3] == chars[1] + chars[2], '${name}: [1, 3] is ${text[1, 3]}'
+
+    # upper() changes just the ASCII letters, and keeps every code point.
+    var upper = text.upper()
+    assert upper.tobytes().length() == bytelength and upper.length == chars.length, '${name}: upper() is ${upper}'
+    for(var j = 0; j < chars.length; j++) {
+      assert upper[j] == (chars[j] == 'a' ? 'A' : chars[j]), '${name}: upper()[${j}] is ${upper[j]}'
+    }
+    assert upper.lower() == text, '${name}: lower() of upper()'
+  }
+}
+
+# invalid and cut short sequences count the bytes that aren't continuations,
+# and index without reading past the end.
+function raw(list) {
+  return bytes(list).to_string()
+}
+var truncated = raw([0x61, 0xe2, 0x82])
+assert truncated.length == 2 and truncated[0] == 'a', 'truncated: length ${truncated.length}'
+assert truncated[1] == raw([0xe2, 0x82]), 'truncated: [1] is ${truncated[1].tobytes()}'
+assert truncated.upper() == raw([0x41, 0xe2, 0x82]), 'truncated: upper()'
+var stray = raw([0x61, 0x80, 0x62])
+assert stray.length == 2 and stray[1] == 'b', 'stray continuation: length ${stray.length}'
+assert stray[0] == raw([0x61, 0x80]), 'stray continuation: [0] is ${stray[0].tobytes()}'
+# the same, in the middle and at the very end of a string the chunks cover.
+var middle = 'x' * 15 + truncated + 'x' * 15
+assert middle.tobytes().length() == 33 and middle.length == 32, 'truncated in the middle: length ${middle.length}'
+assert middle[16] == raw([0xe2, 0x82]) and middle[17] == 'x', 'truncated in the middle: [16]'
+var cut = raw(('😀' * 8).tobytes().to_list()[0, 31])
+assert cut.length == 8 and cut[6] == '😀', 'cut short: length ${cut.length}'
+assert cut[7].tobytes().length() == 3 and cut.upper() == cut, 'cut short: [7] is ${cut[7].tobytes()}'
+echo 'utf-8 ok'
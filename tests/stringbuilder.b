@@ -0,0 +1,77 @@
+# a builder appends any value as echo inside a list would show it, and
+# hands what it holds over to to_string(), after which it starts again empty.
+
+class Point {
+  Point(x, y) {
+    self.x = x
+    self.y = y
+  }
+}
+
+# (each try in a function of its own, which returns straight after it.)
+function fails(action) {
+  var failed = false
+  try {
+    action()
+  } catch Exception e {
+    failed = true
+  }
+  return failed
+}
+
+var builder = string_builder()
+assert typeof(builder) == 'StringBuilder', 'typeof: ${typeof(builder)}'
+assert builder.length == 0 and builder.to_string() == '', 'a new builder is not empty'
+
+# append() of every kind of value, chained.
+var point = Point(1, 2)
+var values = ['text', '', 42, -0.5, 10 ** 21, true, nil, [1, 'two', [3]], {'key': 'value'}, point, 1..3]
+for(var i = 0; i < values.length; i++) {
+  assert builder.append(values[i]) == builder, 'append() returns the builder'
+}
+var expected = 'text42-0.51e+21truenil[1, two, [3]]{key: value}<instance of Point><range 1..3>'
+assert builder.length == expected.length, 'length ${builder.length}, expected ${expected.length}'
+var result = builder.to_string()
+assert result == expected, '${result}, expected ${expected}'
+assert result.length == expected.length, 'to_string() length ${result.length}'
+
+# to_string() leaves it empty, and ready to be used again.
+assert builder.length == 0, 'length ${builder.length} after to_string()'
+assert builder.to_string() == '', 'to_string() twice'
+builder.append('again').append(1)
+assert builder.to_string() == 'again1', 'reused after to_string()'
+assert result == expected, 'to_string() result changed once the builder was reused'
+
+# append_bytes() and append_number().
+builder.append_bytes(bytes([104, 105, 32])).append_number(3).append_number(-0.25).append_bytes(bytes([]))
+assert builder.length == 9, 'length ${builder.length}'
+assert builder.to_string() == 'hi 3-0.25', 'append_bytes() and append_number()'
+builder.append_number(7)
+assert builder.to_string() == to_string(7), 'append_number() matches to_string()'
+
+# clear() empties it without handing anything over.
+builder.append('to be cleared')
+assert builder.clear() == builder, 'clear() returns the builder'
+assert builder.length == 0 and builder.to_string() == '', 'clear()'
+
+# long contents, past whatever it started with.
+var line = 'a line of text, '
+for(var i = 0; i < 2000; i++) {
+  builder.append(line).append(i)
+}
+var long = builder.to_string()
+assert long.startswith('a line of text, 0a line') and long.endswith('a line of text, 1999'), 'long contents'
+assert long.length == 2000 * line.length + 10 + 90 * 2 + 900 * 3 + 1000 * 4, 'long length ${long.length}'
+
+# the arguments are checked.
+assert fails(|| { builder.append() }), 'append() with no value'
+assert fails(|| { builder.append(1, 2) }), 'append() with two values'
+assert fails(|| { builder.append_bytes('text') }), 'append_bytes() with a string'
+assert fails(|| { builder.append_bytes(1) }), 'append_bytes() with a number'
+assert fails(|| { builder.append_number('1') }), 'append_number() with a string'
+assert fails(|| { builder.append_number(nil) }), 'append_number() with nil'
+assert fails(|| { builder.clear(1) }), 'clear() with a value'
+assert fails(|| { builder.to_string(1) }), 'to_string() with a value'
+assert builder.length == 0, 'a failed append changed the builder'
+
+echo 'string builder ok'
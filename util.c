@@ -1,5 +1,10 @@
 
 #include "blade.h"
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
 
 #if defined(__linux__) || defined(__CYGWIN__) || defined(__MINGW32_MAJOR_VERSION)
     #define PROC_SELF_EXE "/proc/self/exe"
@@ -358,17 +363,73 @@ char* bl_util_appendstring(char* old, const char* newstr)
     return old;
 }
 
-int bl_util_utf8length(char* s)
-{
-    int len = 0;
-    for(; *s; ++s)
+/*
+* the code points in the length bytes at s (every byte but the 10xxxxxx
+* continuation bytes), and whether they are all ASCII, in the one pass.
+* 32 or 16 bytes are looked at a time where AVX2 or SSE2 is there, and 8
+* otherwise.
+*/
+int bl_util_utf8count(const char* s, int length, bool* isascii)
+{
+    int i;
+    int continuations;
+    uint64_t word;
+    uint64_t highbits;
+    continuations = 0;
+    highbits = 0;
+    i = 0;
+#if defined(__AVX2__)
+    {
+        // a continuation byte is one below -64 as a signed char.
+        __m256i chunk;
+        __m256i below = _mm256_set1_epi8(-64);
+        unsigned int nonascii = 0;
+        for(; i + 32 <= length; i += 32)
+        {
+            chunk = _mm256_loadu_si256((const __m256i*)(s + i));
+            nonascii |= (unsigned int)_mm256_movemask_epi8(chunk);
+            continuations += __builtin_popcount((unsigned int)_mm256_movemask_epi8(_mm256_cmpgt_epi8(below, chunk)));
+        }
+        highbits = nonascii;
+    }
+#elif defined(__SSE2__)
     {
-        if((*s & 0xC0) != 0x80)
+        // a continuation byte is one below -64 as a signed char.
+        __m128i chunk;
+        __m128i below = _mm_set1_epi8(-64);
+        unsigned int nonascii = 0;
+        for(; i + 16 <= length; i += 16)
         {
-            ++len;
+            chunk = _mm_loadu_si128((const __m128i*)(s + i));
+            nonascii |= (unsigned int)_mm_movemask_epi8(chunk);
+            continuations += __builtin_popcount((unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(below, chunk)));
         }
+        highbits = nonascii;
     }
-    return len;
+#endif
+    for(; i + 8 <= length; i += 8)
+    {
+        memcpy(&word, s + i, sizeof(word));
+        highbits |= word & 0x8080808080808080ull;
+        // bit 7 set and bit 6 clear
+        continuations += __builtin_popcountll(word & ~(word << 1) & 0x8080808080808080ull);
+    }
+    for(; i < length; i++)
+    {
+        highbits |= (uint8_t)s[i] & 0x80;
+        if((s[i] & 0xC0) == 0x80)
+        {
+            continuations++;
+        }
+    }
+    *isascii = highbits == 0;
+    return length - continuations;
+}
+
+int bl_util_utf8length(char* s)
+{
+    bool isascii;
+    return bl_util_utf8count(s, (int)strlen(s), &isascii);
 }
 
 // returns a pointer to the beginning of the pos'th utf8 codepoint
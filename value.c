@@ -18,7 +18,9 @@ void bl_state_addmodule(VMState* vm, ObjModule* module)
     cs = module->file;
     len = strlen(cs);
     copied = bl_string_copystringlen(vm, cs, (int)len-4);
+    bl_vm_pushvalue(vm, OBJ_VAL(copied));// growing the table may collect
     bl_hashtable_set(vm, &vm->modules, OBJ_VAL(copied), OBJ_VAL(module));
+    bl_vm_popvalue(vm);
     if(vm->framecount == 0)
     {
         bl_hashtable_set(vm, &vm->globals, STRING_VAL(module->name), OBJ_VAL(module));
@@ -28,7 +30,11 @@ void bl_state_addmodule(VMState* vm, ObjModule* module)
         cs = module->name;
         len = strlen(cs);
         copied = bl_string_copystringlen(vm, cs, (int)len);
+        bl_vm_pushvalue(vm, OBJ_VAL(copied));
         bl_hashtable_set(vm, &vm->frames[vm->framecount - 1].closure->fnptr->module->values, OBJ_VAL(copied), OBJ_VAL(module));
+        bl_vm_popvalue(vm);
+        bl_mem_writebarrier(vm, (Object*)vm->frames[vm->framecount - 1].closure->fnptr->module);
+        vm->globalsepoch++;
     }
 }
 
@@ -98,31 +104,6 @@ bool bl_value_isboundfunction(Value v)
     return bl_value_isobjtype(v, OBJ_BOUNDFUNCTION);
 }
 
-bool bl_value_isnil(Value v)
-{
-    return ((v).type == VAL_NIL);
-}
-
-bool bl_value_isbool(Value v)
-{
-    return ((v).type == VAL_BOOL);
-}
-
-bool bl_value_isnumber(Value v)
-{
-    return ((v).type == VAL_NUMBER);
-}
-
-bool bl_value_isobject(Value v)
-{
-    return ((v).type == VAL_OBJ);
-}
-
-bool bl_value_isempty(Value v)
-{
-    return ((v).type == VAL_EMPTY);
-}
-
 bool bl_value_ismodule(Value v)
 {
     return bl_value_isobjtype(v, OBJ_MODULE);
@@ -138,6 +119,11 @@ bool bl_value_isbytes(Value v)
     return bl_value_isobjtype(v, OBJ_BYTES);
 }
 
+bool bl_value_isstrbuilder(Value v)
+{
+    return bl_value_isobjtype(v, OBJ_STRBUILDER);
+}
+
 bool bl_value_isarray(Value v)
 {
     return bl_value_isobjtype(v, OBJ_ARRAY);
@@ -160,24 +146,21 @@ bool bl_value_isrange(Value v)
 
 static void bl_value_doprintvalue(Value value, bool fixstring)
 {
-    switch(value.type)
+    if(bl_value_isnil(value))
     {
-        case VAL_EMPTY:
-            break;
-        case VAL_NIL:
-            printf("nil");
-            break;
-        case VAL_BOOL:
-            printf(AS_BOOL(value) ? "true" : "false");
-            break;
-        case VAL_NUMBER:
-            printf(NUMBER_FORMAT, AS_NUMBER(value));
-            break;
-        case VAL_OBJ:
-            bl_writer_printobject(value, fixstring);
-            break;
-        default:
-            break;
+        printf("nil");
+    }
+    else if(bl_value_isbool(value))
+    {
+        printf(AS_BOOL(value) ? "true" : "false");
+    }
+    else if(bl_value_isnumber(value))
+    {
+        printf(NUMBER_FORMAT, AS_NUMBER(value));
+    }
+    else if(bl_value_isobject(value))
+    {
+        bl_writer_printobject(value, fixstring);
     }
 }
 
@@ -194,37 +177,25 @@ void bl_value_echovalue(Value value)
 // fixme: should this allocate?
 char* bl_value_tostring(VMState* vm, Value value)
 {
-    switch(value.type)
+    if(bl_value_isnil(value))
     {
-        case VAL_NIL:
-            {
-                return (char*)"nil";
-            }
-            break;
-        case VAL_BOOL:
-            {
-                if(AS_BOOL(value))
-                {
-                    return (char*)"true";
-                }
-                else
-                {
-                    return (char*)"false";
-                }
-            }
-            break;
-        case VAL_NUMBER:
-            {
-                return number_to_string(vm, AS_NUMBER(value));
-            }
-            break;
-        case VAL_OBJ:
-            {
-                return bl_writer_objecttostring(vm, value);
-            }
-            break;
-        default:
-            break;
+        return (char*)"nil";
+    }
+    else if(bl_value_isbool(value))
+    {
+        if(AS_BOOL(value))
+        {
+            return (char*)"true";
+        }
+        return (char*)"false";
+    }
+    else if(bl_value_isnumber(value))
+    {
+        return number_to_string(vm, AS_NUMBER(value));
+    }
+    else if(bl_value_isobject(value))
+    {
+        return bl_writer_objecttostring(vm, value);
     }
     return (char*)"";
 }
@@ -254,8 +225,30 @@ const char* bl_value_typename(Value value)
     return "unknown";
 }
 
+/*
+* two interned strings are only equal if they are the same one; any other
+* has to be compared by its chars.
+*/
+static bool bl_value_stringsequal(Value a, Value b)
+{
+    if(!bl_value_isstring(a) || !bl_value_isstring(b))
+    {
+        return false;
+    }
+    return bl_string_equal((ObjString*)AS_OBJ(a), (ObjString*)AS_OBJ(b));
+}
+
 bool bl_value_valuesequal(Value a, Value b)
 {
+#if BLADE_NAN_BOXING
+    // numbers compare as doubles (nan != nan, 0 == -0),
+    // every other value is identified by its bits alone.
+    if(bl_value_isnumber(a) && bl_value_isnumber(b))
+    {
+        return AS_NUMBER(a) == AS_NUMBER(b);
+    }
+    return a.raw == b.raw || bl_value_stringsequal(a, b);
+#else
     if(a.type != b.type)
     {
         return false;
@@ -270,10 +263,11 @@ bool bl_value_valuesequal(Value a, Value b)
         case VAL_NUMBER:
             return AS_NUMBER(a) == AS_NUMBER(b);
         case VAL_OBJ:
-            return AS_OBJ(a) == AS_OBJ(b);
+            return AS_OBJ(a) == AS_OBJ(b) || bl_value_stringsequal(a, b);
         default:
             return false;
     }
+#endif
 }
 
 // Generates a hash code for [object].
@@ -294,7 +288,7 @@ static uint32_t bl_object_hashobject(Object* object)
             return bl_util_hashdouble(fn->arity) ^ bl_util_hashdouble(fn->blob.count);
         }
         case OBJ_STRING:
-            return ((ObjString*)object)->hash;
+            return bl_string_gethash((ObjString*)object);
         case OBJ_BYTES:
         {
             ObjBytes* bytes = ((ObjBytes*)object);
@@ -307,19 +301,24 @@ static uint32_t bl_object_hashobject(Object* object)
 
 uint32_t bl_value_hashvalue(Value value)
 {
-    switch(value.type)
+    if(bl_value_isobject(value))
     {
-        case VAL_BOOL:
-            return AS_BOOL(value) ? 3 : 5;
-        case VAL_NIL:
-            return 7;
-        case VAL_NUMBER:
-            return bl_util_hashdouble(AS_NUMBER(value));
-        case VAL_OBJ:
-            return bl_object_hashobject(AS_OBJ(value));
-        default:// VAL_EMPTY
-            return 0;
+        return bl_object_hashobject(AS_OBJ(value));
+    }
+    else if(bl_value_isnumber(value))
+    {
+        return bl_util_hashdouble(AS_NUMBER(value));
+    }
+    else if(bl_value_isbool(value))
+    {
+        return AS_BOOL(value) ? 3 : 5;
+    }
+    else if(bl_value_isnil(value))
+    {
+        return 7;
     }
+    // empty
+    return 0;
 }
 
 /**
@@ -506,6 +505,7 @@ Value bl_value_copyvalue(VMState* vm, Value value)
                 {
                     bl_valarray_push(vm, &nlist->items, list->items.values[i]);
                 }
+                bl_mem_writebarrier(vm, (Object*)nlist);
                 bl_vm_popvalue(vm);
                 return OBJ_VAL(nlist);
             }
@@ -662,6 +662,24 @@ bool bl_hashtable_get(HashTable* table, Value key, Value* value)
     return true;
 }
 
+/*
+* like bl_hashtable_get(), but returns the entry itself, or NULL.
+*/
+HashEntry* bl_hashtable_getentry(HashTable* table, Value key)
+{
+    HashEntry* entry;
+    if(table->count == 0 || table->entries == NULL)
+    {
+        return NULL;
+    }
+    entry = bl_hashtable_findentry(table->entries, table->capacity, key);
+    if(bl_value_isempty(entry->key) || bl_value_isnil(entry->key))
+    {
+        return NULL;
+    }
+    return entry;
+}
+
 static void bl_hashtable_adjustcap(VMState* vm, HashTable* table, int capacity)
 {
     int i;
@@ -699,6 +717,11 @@ bool bl_hashtable_set(VMState* vm, HashTable* table, Value key, Value value)
     bool isnew;
     int capacity;
     HashEntry* entry;
+    // keys are always interned.
+    if(bl_value_isstring(key))
+    {
+        key = OBJ_VAL(bl_string_intern(vm, (ObjString*)AS_OBJ(key)));
+    }
     if(table->count + 1 > table->capacity * TABLE_MAX_LOAD)
     {
         capacity = GROW_CAPACITY(table->capacity);
@@ -778,9 +801,15 @@ ObjString* bl_hashtable_findstring(HashTable* table, const char* chars, int leng
         entry = &table->entries[index];
         if(bl_value_isempty(entry->key))
         {
-            // stop if we find an empty non-tombstone entry
-            //if (bl_value_isnil(entry->value))
-            return NULL;
+            // stop if we find an empty non-tombstone entry. the collector
+            // leaves tombstones in vm->strings, and the string looked for
+            // may well be further along.
+            if(bl_value_isnil(entry->value))
+            {
+                return NULL;
+            }
+            index = (index + 1) & (table->capacity - 1);
+            continue;
         }
         // if (bl_value_isstring(entry->key)) {
         string = AS_STRING(entry->key);
@@ -837,11 +866,11 @@ void bl_hashtable_removewhites(VMState* vm, HashTable* table)
 {
     int i;
     HashEntry* entry;
-    (void)vm;
     for(i = 0; i < table->capacity; i++)
     {
         entry = &table->entries[i];
-        if(bl_value_isobject(entry->key) && !AS_OBJ(entry->key)->mark)
+        // a minor collection does not mark old objects.
+        if(bl_value_isobject(entry->key) && !bl_mem_ismarked(AS_OBJ(entry->key)) && !(vm->gcisminor && AS_OBJ(entry->key)->old))
         {
             bl_hashtable_delete(table, entry->key);
         }
@@ -855,6 +884,12 @@ void bl_blob_init(BinaryBlob* blob)
     blob->code = NULL;
     blob->lines = NULL;
     bl_valarray_init(&blob->constants);
+    blob->cachecount = 0;
+    blob->cachecapacity = 0;
+    blob->globalcachecount = 0;
+    blob->globalcachecapacity = 0;
+    blob->globalcaches = NULL;
+    blob->caches = NULL;
 }
 
 void bl_blob_write(VMState* vm, BinaryBlob* blob, uint8_t byte, int line)
@@ -881,6 +916,14 @@ void bl_blob_free(VMState* vm, BinaryBlob* blob)
     {
         FREE_ARRAY(int, blob->lines, blob->capacity);
     }
+    if(blob->caches != NULL)
+    {
+        FREE_ARRAY(InlineCache, blob->caches, blob->cachecapacity);
+    }
+    if(blob->globalcaches != NULL)
+    {
+        FREE_ARRAY(GlobalCache, blob->globalcaches, blob->globalcachecapacity);
+    }
     bl_valarray_free(vm, &blob->constants);
     bl_blob_init(blob);
 }
@@ -893,6 +936,34 @@ int bl_blob_addconst(VMState* vm, BinaryBlob* blob, Value value)
     return blob->constants.count - 1;
 }
 
+int bl_blob_addcache(VMState* vm, BinaryBlob* blob)
+{
+    if(blob->cachecapacity < blob->cachecount + 1)
+    {
+        int oldcapacity = blob->cachecapacity;
+        blob->cachecapacity = GROW_CAPACITY(oldcapacity);
+        blob->caches = GROW_ARRAY(InlineCache, sizeof(InlineCache), blob->caches, oldcapacity, blob->cachecapacity);
+    }
+    memset(&blob->caches[blob->cachecount], 0, sizeof(InlineCache));
+    blob->cachecount++;
+    return blob->cachecount - 1;
+}
+
+int bl_blob_addglobalcache(VMState* vm, BinaryBlob* blob)
+{
+    if(blob->globalcachecapacity < blob->globalcachecount + 1)
+    {
+        int oldcapacity = blob->globalcachecapacity;
+        blob->globalcachecapacity = GROW_CAPACITY(oldcapacity);
+        blob->globalcaches = GROW_ARRAY(GlobalCache, sizeof(GlobalCache), blob->globalcaches, oldcapacity, blob->globalcachecapacity);
+    }
+    blob->globalcaches[blob->globalcachecount].index = -1;
+    blob->globalcaches[blob->globalcachecount].inglobals = false;
+    blob->globalcaches[blob->globalcachecount].epoch = 0;
+    blob->globalcachecount++;
+    return blob->globalcachecount - 1;
+}
+
 /**
  * a Blade regex must always start and end with the same delimiter e.g. /
  *
@@ -1092,13 +1163,21 @@ void bl_bytearray_free(VMState* vm, ByteArray* array)
 Object* bl_object_allocobject(VMState* vm, size_t size, ObjType type)
 {
     Object* object;
-    object = (Object*)bl_mem_realloc(vm, NULL, 0, size);
+    object = (Object*)bl_mem_allocobjectmem(vm, size);
     object->type = type;
-    object->mark = false;
-    object->sibling = vm->objectlinks;
+    bl_mem_setmarked(object, false);
+    object->old = false;
+    object->remembered = false;
+    object->sibling = vm->younglinks;
     object->definitelyreal = true;
-    vm->objectlinks = object;
+    vm->younglinks = object;
     vm->objectcount++;
+    vm->gctypecount[type]++;
+    vm->gctypebytes[type] += size;
+    if(vm->allocprofile != NULL)
+    {
+        bl_profile_count(vm, size, type);
+    }
     //#if defined(DEBUG_LOG_GC) && DEBUG_LOG_GC
     //    fprintf(stderr, "bl_object_allocobject: size %ld type %d\n", size, type);
     //#endif
@@ -1124,6 +1203,13 @@ ObjBytes* bl_object_makebytes(VMState* vm, int length)
     return bytes;
 }
 
+ObjStringBuilder* bl_object_makestrbuilder(VMState* vm)
+{
+    ObjStringBuilder* builder = (ObjStringBuilder*)bl_object_allocobject(vm, sizeof(ObjStringBuilder), OBJ_STRBUILDER);
+    bl_builder_init(&builder->builder);
+    return builder;
+}
+
 ObjRange* bl_object_makerange(VMState* vm, int lower, int upper)
 {
     ObjRange* range = (ObjRange*)bl_object_allocobject(vm, sizeof(ObjRange), OBJ_RANGE);
@@ -1167,6 +1253,11 @@ ObjClass* bl_object_makeclass(VMState* vm, ObjString* name, ObjClass* superclass
     bl_hashtable_init(&klass->methods);
     klass->initializer = EMPTY_VAL;
     klass->superclass = superclass;
+    klass->rootshape = NULL;
+    klass->initshape = NULL;
+    klass->shapecount = 0;
+    klass->slothint = 0;
+    klass->version = 0;
     return klass;
 }
 
@@ -1188,11 +1279,11 @@ ObjInstance* bl_object_makeinstance(VMState* vm, ObjClass* klass)
     ObjInstance* instance = (ObjInstance*)bl_object_allocobject(vm, sizeof(ObjInstance), OBJ_INSTANCE);
     bl_vm_pushvalue(vm, OBJ_VAL(instance));// gc fix
     instance->klass = klass;
-    bl_hashtable_init(&instance->properties);
-    if(klass->properties.count > 0)
-    {
-        bl_hashtable_copy(vm, &klass->properties, &instance->properties);
-    }
+    instance->shape = NULL;
+    instance->slots = NULL;
+    instance->slotcapacity = 0;
+    instance->properties = NULL;
+    bl_instance_initfields(vm, instance);
     bl_vm_popvalue(vm);// gc fix
     return instance;
 }
@@ -1222,10 +1313,11 @@ ObjClosure* bl_object_makeclosure(VMState* vm, ObjFunction* function)
 
 ObjInstance* bl_object_makeexception(VMState* vm, ObjString* message)
 {
+    bl_vm_pushvalue(vm, OBJ_VAL(message));
     ObjInstance* instance = bl_object_makeinstance(vm, vm->exceptionclass);
     bl_vm_pushvalue(vm, OBJ_VAL(instance));
-    bl_hashtable_set(vm, &instance->properties, STRING_L_VAL("message", 7), OBJ_VAL(message));
-    bl_vm_popvalue(vm);
+    bl_instance_setfield(vm, instance, bl_string_copystringlen(vm, "message", 7), OBJ_VAL(message));
+    bl_vm_popvaluen(vm, 2);
     return instance;
 }
 
@@ -1347,6 +1439,12 @@ void bl_writer_printobject(Value value, bool fixstring)
             bl_writer_printbytes(AS_BYTES(value));
             break;
         }
+        case OBJ_STRBUILDER:
+        {
+            StringBuilder* builder = &AS_STRBUILDER(value)->builder;
+            printf("<string builder of %zu bytes>", builder->length);
+            break;
+        }
         case OBJ_BOUNDFUNCTION:
         {
             bl_writer_printfunction(AS_BOUND(value)->method->fnptr);
@@ -1421,192 +1519,143 @@ ObjBytes* bl_bytes_takebytes(VMState* vm, unsigned char* b, int length)
     return bytes;
 }
 
-static char* bl_writer_functiontostring(ObjFunction* func)
+static void bl_writer_appendfunction(StringBuilder* sb, ObjFunction* func)
 {
     if(func->name == NULL)
     {
-        return strdup("<script 0x00>");
-    }
-    const char* format = func->isvariadic ? "<function %s(%d...)>" : "<function %s(%d)>";
-    char* str = (char*)malloc(sizeof(char) * (snprintf(NULL, 0, format, func->name->chars, func->arity)));
-    if(str != NULL)
-    {
-        sprintf(str, format, func->name->chars, func->arity);
-        return str;
+        bl_builder_appendcstr(sb, "<script 0x00>");
+        return;
     }
-    return strdup(func->name->chars);
+    bl_builder_appendformat(sb, func->isvariadic ? "<function %s(%d...)>" : "<function %s(%d)>", func->name->chars, func->arity);
 }
 
-static char* bl_writer_listtostring(VMState* vm, ValArray* array)
+static void bl_writer_appendlist(VMState* vm, StringBuilder* sb, ValArray* array)
 {
     int i;
-    char* str;
-    char* val;
-    str = strdup("[");
+    bl_builder_appendchar(sb, '[');
     for(i = 0; i < array->count; i++)
     {
-        val = bl_value_tostring(vm, array->values[i]);
-        if(val != NULL)
-        {
-            str = bl_util_appendstring(str, val);
-            free(val);
-        }
+        bl_builder_appendvalue(vm, sb, array->values[i]);
         if(i != array->count - 1)
         {
-            str = bl_util_appendstring(str, ", ");
+            bl_builder_append(sb, ", ", 2);
         }
     }
-    str = bl_util_appendstring(str, "]");
-    return str;
+    bl_builder_appendchar(sb, ']');
 }
 
-static char* bl_writer_bytestostring(VMState* vm, ByteArray* array)
+static void bl_writer_appendbytes(StringBuilder* sb, ByteArray* array)
 {
-    char* str = strdup("(");
-    for(int i = 0; i < array->count; i++)
+    int i;
+    bl_builder_appendchar(sb, '(');
+    for(i = 0; i < array->count; i++)
     {
-        char* chars = ALLOCATE(char, snprintf(NULL, 0, "0x%x", array->bytes[i]));
-        if(chars != NULL)
-        {
-            sprintf(chars, "0x%x", array->bytes[i]);
-            str = bl_util_appendstring(str, chars);
-        }
+        bl_builder_appendformat(sb, "0x%x", array->bytes[i]);
         if(i != array->count - 1)
         {
-            str = bl_util_appendstring(str, " ");
+            bl_builder_appendchar(sb, ' ');
         }
     }
-    str = bl_util_appendstring(str, ")");
-    return str;
+    bl_builder_appendchar(sb, ')');
 }
 
-static char* bl_writer_dicttostring(VMState* vm, ObjDict* dict)
+static void bl_writer_appenddict(VMState* vm, StringBuilder* sb, ObjDict* dict)
 {
-    char* str = strdup("{");
-    for(int i = 0; i < dict->names.count; i++)
+    int i;
+    Value key;
+    Value value;
+    bl_builder_appendchar(sb, '{');
+    for(i = 0; i < dict->names.count; i++)
     {
-        // bl_value_printvalue(dict->names.values[i]);
-        Value key = dict->names.values[i];
-        char* _key = bl_value_tostring(vm, key);
-        if(_key != NULL)
+        key = dict->names.values[i];
+        bl_builder_appendvalue(vm, sb, key);
+        bl_builder_append(sb, ": ", 2);
+        if(bl_hashtable_get(&dict->items, key, &value))
         {
-            str = bl_util_appendstring(str, _key);
-        }
-        str = bl_util_appendstring(str, ": ");
-        Value value;
-        bl_hashtable_get(&dict->items, key, &value);
-        char* val = bl_value_tostring(vm, value);
-        if(val != NULL)
-        {
-            str = bl_util_appendstring(str, val);
+            bl_builder_appendvalue(vm, sb, value);
         }
         if(i != dict->names.count - 1)
         {
-            str = bl_util_appendstring(str, ", ");
+            bl_builder_append(sb, ", ", 2);
         }
     }
-    str = bl_util_appendstring(str, "}");
-    return str;
+    bl_builder_appendchar(sb, '}');
 }
 
-char* bl_writer_objecttostring(VMState* vm, Value value)
+/*
+* appends the string form of an object. nothing is allocated through the
+* gc on the way, so the containers walked can't be collected under it.
+*/
+void bl_writer_appendobject(VMState* vm, StringBuilder* sb, Value value)
 {
     switch(OBJ_TYPE(value))
     {
         case OBJ_PTR:
-        {
-            return strdup(AS_PTR(value)->name);
-        }
+            bl_builder_appendcstr(sb, AS_PTR(value)->name);
+            break;
         case OBJ_SWITCH:
-        {
-            return strdup("<switch>");
-        }
+            bl_builder_appendcstr(sb, "<switch>");
+            break;
         case OBJ_CLASS:
-        {
-            const char* format = "<class %s>";
-            char* data = AS_CLASS(value)->name->chars;
-            char* str = ALLOCATE(char, snprintf(NULL, 0, format, data));
-            if(str != NULL)
-            {
-                sprintf(str, format, data);
-            }
-            return str;
-        }
+            bl_builder_appendformat(sb, "<class %s>", AS_CLASS(value)->name->chars);
+            break;
         case OBJ_INSTANCE:
-        {
-            const char* format = "<instance of %s>";
-            char* data = AS_INSTANCE(value)->klass->name->chars;
-            char* str = ALLOCATE(char, snprintf(NULL, 0, format, data));
-            if(str != NULL)
-            {
-                sprintf(str, format, data);
-            }
-            return str;
-        }
+            bl_builder_appendformat(sb, "<instance of %s>", AS_INSTANCE(value)->klass->name->chars);
+            break;
         case OBJ_CLOSURE:
-            return bl_writer_functiontostring(AS_CLOSURE(value)->fnptr);
+            bl_writer_appendfunction(sb, AS_CLOSURE(value)->fnptr);
+            break;
         case OBJ_BOUNDFUNCTION:
-        {
-            return bl_writer_functiontostring(AS_BOUND(value)->method->fnptr);
-        }
+            bl_writer_appendfunction(sb, AS_BOUND(value)->method->fnptr);
+            break;
         case OBJ_SCRIPTFUNCTION:
-            return bl_writer_functiontostring(AS_FUNCTION(value));
+            bl_writer_appendfunction(sb, AS_FUNCTION(value));
+            break;
         case OBJ_NATIVEFUNCTION:
-        {
-            const char* format = "<function %s(native)>";
-            const char* data = AS_NATIVE(value)->name;
-            char* str = ALLOCATE(char, snprintf(NULL, 0, format, data));
-            if(str != NULL)
-            {
-                sprintf(str, format, data);
-            }
-            return str;
-        }
+            bl_builder_appendformat(sb, "<function %s(native)>", AS_NATIVE(value)->name);
+            break;
         case OBJ_RANGE:
-        {
-            ObjRange* range = AS_RANGE(value);
-            const char* format = "<range %d..%d>";
-            char* str = ALLOCATE(char, snprintf(NULL, 0, format, range->lower, range->upper));
-            if(str != NULL)
-            {
-                sprintf(str, format, range->lower, range->upper);
-            }
-            return str;
-        }
+            bl_builder_appendformat(sb, "<range %d..%d>", AS_RANGE(value)->lower, AS_RANGE(value)->upper);
+            break;
         case OBJ_MODULE:
+            bl_builder_appendformat(sb, "<module %s>", AS_MODULE(value)->name);
+            break;
+        case OBJ_STRING:
         {
-            const char* format = "<module %s>";
-            const char* data = AS_MODULE(value)->name;
-            char* str = ALLOCATE(char, snprintf(NULL, 0, format, data));
-            if(str != NULL)
-            {
-                sprintf(str, format, data);
-            }
-            return str;
+            ObjString* string = AS_STRING(value);
+            bl_builder_append(sb, string->chars, string->length);
+            break;
         }
-        case OBJ_STRING:
-            return strdup(AS_C_STRING(value));
         case OBJ_UP_VALUE:
-            return strdup("<up-value>");
+            bl_builder_appendcstr(sb, "<up-value>");
+            break;
         case OBJ_BYTES:
-            return bl_writer_bytestostring(vm, &AS_BYTES(value)->bytes);
+            bl_writer_appendbytes(sb, &AS_BYTES(value)->bytes);
+            break;
+        case OBJ_STRBUILDER:
+        {
+            StringBuilder* builder = &AS_STRBUILDER(value)->builder;
+            bl_builder_append(sb, builder->chars == NULL ? "" : builder->chars, builder->length);
+            break;
+        }
         case OBJ_ARRAY:
-            return bl_writer_listtostring(vm, &AS_LIST(value)->items);
+            bl_writer_appendlist(vm, sb, &AS_LIST(value)->items);
+            break;
         case OBJ_DICT:
-            return bl_writer_dicttostring(vm, AS_DICT(value));
+            bl_writer_appenddict(vm, sb, AS_DICT(value));
+            break;
         case OBJ_FILE:
-        {
-            ObjFile* file = AS_FILE(value);
-            const char* format = "<file at %s in mode %s>";
-            char* str = ALLOCATE(char, snprintf(NULL, 0, format, file->path->chars, file->mode->chars));
-            if(str != NULL)
-            {
-                sprintf(str, format, file->path->chars, file->mode->chars);
-            }
-            return str;
-        }
+            bl_builder_appendformat(sb, "<file at %s in mode %s>", AS_FILE(value)->path->chars, AS_FILE(value)->mode->chars);
+            break;
     }
-    return NULL;
+}
+
+char* bl_writer_objecttostring(VMState* vm, Value value)
+{
+    StringBuilder sb;
+    bl_builder_init(&sb);
+    bl_writer_appendobject(vm, &sb, value);
+    return bl_builder_release(&sb);
 }
 
 const char* bl_object_gettype(Object* object)
@@ -1617,6 +1666,8 @@ const char* bl_object_gettype(Object* object)
             return "Module";
         case OBJ_BYTES:
             return "Bytes";
+        case OBJ_STRBUILDER:
+            return "StringBuilder";
         case OBJ_RANGE:
             return "Range";
         case OBJ_FILE:
@@ -1665,6 +1716,7 @@ static const ModInitFunc builtinmodules[] = {
     &bl_modload_array,//
     &bl_modload_process,//
     &bl_modload_struct,//
+    &bl_modload_gc,//
     NULL,
 };
 
@@ -1739,9 +1791,12 @@ bool load_module(VMState* vm, ModInitFunc init_fn, char* importname, char* sourc
                         bl_vm_popvalue(vm);
                     }
                 }
+                bl_mem_writebarrier(vm, (Object*)klass);
+                klass->version++;
                 bl_hashtable_set(vm, &themodule->values, OBJ_VAL(classname), OBJ_VAL(klass));
             }
         }
+        bl_mem_writebarrier(vm, (Object*)themodule);
         if(handle != NULL)
         {
             themodule->handle = handle;// set handle for shared library modules
@@ -2133,23 +2188,25 @@ bool modfn_os_exec(VMState* vm, int argcount, Value* args)
                 }
                 else
                 {
-                    vm->bytesallocated += outputsize / 2;
                     output = temp;
                 }
             }
-            if((output + length) != NULL)
-            {
-                strncat(output + length, buffer, nread);
-            }
+            memcpy(output + length, buffer, nread);
             length += (int)nread;
         }
+        pclose(fd);
         if(length == 0)
         {
-            pclose(fd);
+            FREE_ARRAY(char, output, outputsize);
             return bl_value_returnnil(vm, args);
         }
-        output[length - 1] = '\0';
-        pclose(fd);
+        // the newline the output ends with is dropped.
+        if(output[length - 1] == '\n')
+        {
+            length--;
+        }
+        output[length] = '\0';
+        output = GROW_ARRAY(char, sizeof(char), output, outputsize, (size_t)length + 1);
         RETURN_T_STRING(output, length);
     }
     pclose(fd);
@@ -2838,7 +2895,7 @@ bool modfn_reflect_hasprop(VMState* vm, int argcount, Value* args)
     ENFORCE_ARG_TYPE(hasprop, 1, bl_value_isstring);
     ObjInstance* instance = AS_INSTANCE(args[0]);
     Value dummy;
-    RETURN_BOOL(bl_hashtable_get(&instance->properties, args[1], &dummy));
+    RETURN_BOOL(bl_instance_getfield(instance, AS_STRING(args[1]), &dummy));
 }
 
 /**
@@ -2855,7 +2912,7 @@ bool modfn_reflect_getprop(VMState* vm, int argcount, Value* args)
     ENFORCE_ARG_TYPE(getprop, 1, bl_value_isstring);
     ObjInstance* instance = AS_INSTANCE(args[0]);
     Value value;
-    if(bl_hashtable_get(&instance->properties, args[1], &value))
+    if(bl_instance_getfield(instance, AS_STRING(args[1]), &value))
     {
         RETURN_VALUE(value);
     }
@@ -2878,7 +2935,7 @@ bool modfn_reflect_setprop(VMState* vm, int argcount, Value* args)
     ENFORCE_ARG_TYPE(setprop, 1, bl_value_isstring);
     ENFORCE_ARG_TYPE(setprop, 2, bl_value_isstring);
     ObjInstance* instance = AS_INSTANCE(args[0]);
-    RETURN_BOOL(bl_hashtable_set(vm, &instance->properties, args[1], args[2]));
+    RETURN_BOOL(bl_instance_setfield(vm, instance, AS_STRING(args[1]), args[2]));
 }
 
 /**
@@ -2893,7 +2950,7 @@ bool modfn_reflect_delprop(VMState* vm, int argcount, Value* args)
     ENFORCE_ARG_TYPE(delprop, 0, bl_value_isinstance);
     ENFORCE_ARG_TYPE(delprop, 1, bl_value_isstring);
     ObjInstance* instance = AS_INSTANCE(args[0]);
-    RETURN_BOOL(bl_hashtable_delete(&instance->properties, args[1]));
+    RETURN_BOOL(bl_instance_deletefield(vm, instance, AS_STRING(args[1])));
 }
 
 /**
@@ -4333,7 +4390,7 @@ bool bl_vm_propagateexception(VMState* vm, bool isassert)
     {
         fprintf(stderr, "Illegal State");
     }
-    if(bl_hashtable_get(&exception->properties, STRING_L_VAL("message", 7), &message))
+    if(bl_instance_getfield(exception, bl_string_copystringlen(vm, "message", 7), &message))
     {
         char* errormessage = bl_value_tostring(vm, message);
         if(strlen(errormessage) > 0)
@@ -4350,7 +4407,7 @@ bool bl_vm_propagateexception(VMState* vm, bool isassert)
     {
         fprintf(stderr, "\n");
     }
-    if(bl_hashtable_get(&exception->properties, STRING_L_VAL("stacktrace", 10), &trace))
+    if(bl_instance_getfield(exception, bl_string_copystringlen(vm, "stacktrace", 10), &trace))
     {
         char* tracestr = bl_value_tostring(vm, trace);
         fprintf(stderr, "  StackTrace:\n%s\n", tracestr);
@@ -4384,7 +4441,9 @@ bool bl_vm_throwexception(VMState* vm, bool isassert, const char* format, ...)
     ObjInstance* instance = bl_object_makeexception(vm, bl_string_takestring(vm, message, length));
     bl_vm_pushvalue(vm, OBJ_VAL(instance));
     Value stacktrace = bl_vm_getstacktrace(vm);
-    bl_hashtable_set(vm, &instance->properties, STRING_L_VAL("stacktrace", 10), stacktrace);
+    bl_vm_pushvalue(vm, stacktrace);
+    bl_instance_setfield(vm, instance, bl_string_copystringlen(vm, "stacktrace", 10), stacktrace);
+    bl_vm_popvalue(vm);
     return bl_vm_propagateexception(vm, isassert);
 }
 
@@ -4414,10 +4473,14 @@ void bl_vm_initexceptions(VMState* vm, ObjModule* module)
     bl_blob_write(vm, &function->blob, (1 >> 8) & 0xff, 0);
     bl_blob_write(vm, &function->blob, 1 & 0xff, 0);
     int messageconst = bl_blob_addconst(vm, &function->blob, STRING_L_VAL("message", 7));
+    bl_mem_writebarrier(vm, (Object*)function);
     // sprop 1
     bl_blob_write(vm, &function->blob, OP_SET_PROPERTY, 0);
     bl_blob_write(vm, &function->blob, (messageconst >> 8) & 0xff, 0);
     bl_blob_write(vm, &function->blob, messageconst & 0xff, 0);
+    int messagecache = bl_blob_addcache(vm, &function->blob);
+    bl_blob_write(vm, &function->blob, (messagecache >> 8) & 0xff, 0);
+    bl_blob_write(vm, &function->blob, messagecache & 0xff, 0);
     // pop
     bl_blob_write(vm, &function->blob, OP_POP, 0);
     // gloc 0
@@ -4436,9 +4499,10 @@ void bl_vm_initexceptions(VMState* vm, ObjModule* module)
     // set class properties
     bl_hashtable_set(vm, &klass->properties, STRING_L_VAL("message", 7), NIL_VAL);
     bl_hashtable_set(vm, &klass->properties, STRING_L_VAL("stacktrace", 10), NIL_VAL);
+    bl_mem_writebarrier(vm, (Object*)klass);
+    klass->version++;
     bl_hashtable_set(vm, &vm->globals, OBJ_VAL(classname), OBJ_VAL(klass));
     bl_vm_popvalue(vm);
-    bl_vm_popvalue(vm);// assert error name
     vm->exceptionclass = klass;
 }
 
@@ -81,18 +81,67 @@ void init_vm(VMState* vm)
     bl_vm_resetstack(vm);
     vm->compiler = NULL;
     vm->objectlinks = NULL;
+    vm->younglinks = NULL;
     vm->objectcount = 0;
     vm->exceptionclass = NULL;
     vm->bytesallocated = 0;
     vm->gcprotected = 0;
     vm->nextgc = DEFAULT_GC_START;// default is 1mb. Can be modified via the -g flag.
+    vm->methodepoch = 1;
+    vm->globalsepoch = 1;
     vm->isrepl = false;
     vm->shoulddebugstack = false;
     vm->shouldprintbytecode = false;
+    vm->shouldcachebytecode = false;
+    vm->bytecodecachedir = NULL;
     vm->graycount = 0;
     vm->graycapacity = 0;
     vm->framecount = 0;
     vm->graystack = NULL;
+    vm->youngbytes = 0;
+    vm->gcisminor = false;
+    vm->remembercount = 0;
+    vm->remembercapacity = 0;
+    vm->rememberset = NULL;
+    vm->gcphase = GC_PHASE_IDLE;
+    vm->gcpausebudget = 0;// incremental collection is off unless asked for via the -p flag.
+    vm->gcstepbytes = 0;
+    vm->sweeplinks = NULL;
+    vm->sweptfirst = NULL;
+    vm->sweptlast = NULL;
+    bl_slab_init(vm);
+    vm->gcmarkers = (int)sysconf(_SC_NPROCESSORS_ONLN);// can be modified via the -t flag.
+    if(vm->gcmarkers < 1)
+    {
+        vm->gcmarkers = 1;
+    }
+    vm->gcfreer = NULL;// started via the -s flag.
+    vm->gcsweeping = false;
+    vm->gcminheap = DEFAULT_GC_START;
+    vm->gcsoftlimit = 0;// can be modified via the -m flag.
+    vm->gctimetarget = GC_DEFAULT_TIME_TARGET;// can be modified via the -r flag.
+    vm->gcgrowth = GC_HEAP_GROWTH_FACTOR;
+    vm->gcsurvival = 0;
+    vm->gctimeshare = 0;
+    vm->gcheapbefore = 0;
+    vm->gcfreed = 0;
+    vm->gctime = 0;
+    vm->gclastcycle = bl_mem_gcclock();
+    vm->gcdisabled = false;
+    vm->gccollections = 0;
+    vm->gcminorcollections = 0;
+    vm->gcmarkslices = 0;
+    vm->gcparalleltraces = 0;
+    vm->gcsweepslices = 0;
+    vm->gcfreedbatches = 0;
+    vm->gcpausetotal = 0;
+    vm->gcpausemax = 0;
+    memset(vm->gcpausehistogram, 0, sizeof(vm->gcpausehistogram));
+    memset(vm->gctypecount, 0, sizeof(vm->gctypecount));
+    memset(vm->gctypebytes, 0, sizeof(vm->gctypebytes));
+    vm->heapsnapshot = NULL;
+    vm->snapshotrequested = 0;
+    vm->allocprofile = NULL;
     vm->stdargs = NULL;
     vm->stdargscount = 0;
     vm->allowgc = false;
@@ -106,6 +155,7 @@ void init_vm(VMState* vm)
     vm->classobjdict = bl_vmutil_makeclass(vm, "Dict", vm->classobjobject);
     vm->classobjfile = bl_vmutil_makeclass(vm, "File", vm->classobjobject);
     vm->classobjbytes = bl_vmutil_makeclass(vm, "Bytes", vm->classobjobject);
+    vm->classobjstrbuilder = bl_vmutil_makeclass(vm, "StringBuilder", vm->classobjobject);
     vm->classobjrange = bl_vmutil_makeclass(vm, "Range", vm->classobjobject);
     vm->classobjmath = bl_vmutil_makeclass(vm, "Math", vm->classobjobject);
     bl_state_initbuiltinfunctions(vm);
@@ -117,12 +167,15 @@ void bl_vm_freevm(VMState* vm)
 {
     fprintf(stderr, "call to bl_vm_freevm()\n");
     //@TODO: Fix segfault from enabling this...
+    bl_profile_stop(vm);
     bl_mem_freegcobjects(vm);
+    bl_mem_stopfreer(vm);
     bl_hashtable_free(vm, &vm->strings);
     bl_hashtable_free(vm, &vm->globals);
     // since object in module can exist in globals
     // it must come after
     bl_hashtable_cleanfree(vm, &vm->modules);
+    bl_slab_destroy(vm);
     /*
     bl_hashtable_free(vm, &vm->classobjstring);
     bl_hashtable_free(vm, &vm->classobjlist);
@@ -232,38 +285,98 @@ Value bl_vm_getstacktrace(VMState* vm)
     int i;
     int line;
     size_t instruction;
-    size_t tracelinelength;
-    char* trace;
     char* fnname;
-    char* traceline;
-    const char* traceformat;
     CallFrame* frame;
     ObjFunction* function;
-    trace = (char*)calloc(1, sizeof(char));
-    if(trace != NULL)
+    StringBuilder trace;
+    bl_builder_init(&trace);
+    for(i = 0; i < vm->framecount; i++)
+    {
+        frame = &vm->frames[i];
+        function = frame->closure->fnptr;
+        // -1 because the IP is sitting on the next instruction to be executed
+        instruction = frame->ip - function->blob.code - 1;
+        line = function->blob.lines[instruction];
+        fnname = function->name == NULL ? (char*)"@.script" : function->name->chars;
+        bl_builder_appendformat(&trace, i != vm->framecount - 1 ? "    %s:%d -> %s()\n" : "    %s:%d -> %s()", function->module->file, line, fnname);
+    }
+    return OBJ_VAL(bl_builder_take(vm, &trace));
+}
+
+/*
+* a lookup in a class's own tables depends on its version alone. one that can
+* fall through to its superclasses (see bl_class_getmethod()) depends on
+* theirs as well; versions only go up, so their sum changes whenever any of
+* them does.
+*/
+static inline uint32_t bl_vmutil_chainversion(ObjClass* klass)
+{
+    uint32_t version;
+    version = 0;
+    for(; klass != NULL; klass = klass->superclass)
+    {
+        version += klass->version;
+    }
+    return version;
+}
+
+static inline InlineCacheEntry* bl_vmutil_cacheget(VMState* vm, InlineCache* cache, const void* key, uint32_t version)
+{
+    int i;
+    InlineCacheEntry* entry;
+    for(i = 0; i < INLINE_CACHE_WAYS; i++)
     {
-        for(i = 0; i < vm->framecount; i++)
+        entry = &cache->entries[i];
+        if(entry->key == key && entry->version == version && entry->epoch == vm->methodepoch)
         {
-            frame = &vm->frames[i];
-            function = frame->closure->fnptr;
-            // -1 because the IP is sitting on the next instruction to be executed
-            instruction = frame->ip - function->blob.code - 1;
-            line = function->blob.lines[instruction];
-            traceformat = i != vm->framecount - 1 ? "    %s:%d -> %s()\n" : "    %s:%d -> %s()";
-            fnname = function->name == NULL ? (char*)"@.script" : function->name->chars;
-            tracelinelength = snprintf(NULL, 0, traceformat, function->module->file, line, fnname);
-            traceline = ALLOCATE(char, tracelinelength + 1);
-            if(traceline != NULL)
-            {
-                sprintf(traceline, traceformat, function->module->file, line, fnname);
-                traceline[(int)tracelinelength] = '\0';
-            }
-            trace = bl_util_appendstring(trace, traceline);
-            free(traceline);
+            return entry;
         }
-        return STRING_TT_VAL(trace);
     }
-    return STRING_L_VAL("", 0);
+    return NULL;
+}
+
+// claims an entry for $key; the caller fills in what it found.
+static inline InlineCacheEntry* bl_vmutil_cacheput(VMState* vm, InlineCache* cache, const void* key, uint32_t version)
+{
+    int i;
+    InlineCacheEntry* entry;
+    entry = NULL;
+    // prefer a slot that is empty or went stale before evicting a live one.
+    for(i = 0; i < INLINE_CACHE_WAYS; i++)
+    {
+        if(cache->entries[i].key == NULL || cache->entries[i].epoch != vm->methodepoch)
+        {
+            entry = &cache->entries[i];
+            break;
+        }
+    }
+    if(entry == NULL)
+    {
+        entry = &cache->entries[cache->next];
+        cache->next = (cache->next + 1) % INLINE_CACHE_WAYS;
+    }
+    entry->key = key;
+    entry->epoch = vm->methodepoch;
+    entry->version = version;
+    entry->slot = -1;
+    entry->isfield = false;
+    entry->newshape = NULL;
+    entry->value = NIL_VAL;
+    return entry;
+}
+
+/*
+* instances with a shape are cached by it: a shape belongs to a single class
+* and fixes which fields exist, so a hit also proves a method is not shadowed.
+* instances in dictionary mode fall back to their class.
+*/
+static inline const void* bl_vmutil_instancekey(ObjInstance* instance)
+{
+    if(instance->shape != NULL)
+    {
+        return instance->shape;
+    }
+    return instance->klass;
 }
 
 bool bl_vm_instanceinvokefromclass(VMState* vm, ObjClass* klass, ObjString* name, int argcount)
@@ -280,21 +393,108 @@ bool bl_vm_instanceinvokefromclass(VMState* vm, ObjClass* klass, ObjString* name
     return bl_vm_throwexception(vm, false, "undefined method '%s' in %s", name->chars, klass->name->chars);
 }
 
-static inline bool bl_vmdo_classbindmethod(VMState* vm, ObjClass* klass, ObjString* name)
+static inline bool bl_vmdo_classbindmethod(VMState* vm, ObjClass* klass, ObjString* name, InlineCache* cache, const void* key)
 {
     Value method;
-    if(bl_hashtable_get(&klass->methods, OBJ_VAL(name), &method))
+    ObjBoundMethod* bound;
+    InlineCacheEntry* entry;
+    entry = NULL;
+    if(cache != NULL)
+    {
+        entry = bl_vmutil_cacheget(vm, cache, key, klass->version);
+    }
+    if(entry != NULL)
     {
+        method = entry->value;
+    }
+    else
+    {
+        if(!bl_hashtable_get(&klass->methods, OBJ_VAL(name), &method))
+        {
+            return bl_vm_throwexception(vm, false, "undefined property '%s'", name->chars);
+        }
         if(bl_vmutil_getmethodtype(method) == TYPE_PRIVATE)
         {
             return bl_vm_throwexception(vm, false, "cannot get private property '%s' from instance", name->chars);
         }
-        ObjBoundMethod* bound = bl_object_makeboundmethod(vm, bl_vmdo_peekvalue(vm, 0), AS_CLOSURE(method));
+        if(cache != NULL)
+        {
+            bl_vmutil_cacheput(vm, cache, key, klass->version)->value = method;
+        }
+    }
+    bound = bl_object_makeboundmethod(vm, bl_vmdo_peekvalue(vm, 0), AS_CLOSURE(method));
+    bl_vmdo_popvalue(vm);
+    bl_vmdo_pushvalue(vm, OBJ_VAL(bound));
+    return true;
+}
+
+// replaces the instance on top of the stack with a field or bound method
+// remembered for its shape. returns false on a cache miss.
+static inline bool bl_vmutil_cachedinstanceget(VMState* vm, InlineCache* cache, ObjInstance* instance)
+{
+    InlineCacheEntry* entry;
+    ObjBoundMethod* bound;
+    if(instance->shape == NULL)
+    {
+        return false;
+    }
+    entry = bl_vmutil_cacheget(vm, cache, instance->shape, instance->klass->version);
+    if(entry == NULL)
+    {
+        return false;
+    }
+    if(entry->slot >= 0)
+    {
         bl_vmdo_popvalue(vm);
-        bl_vmdo_pushvalue(vm, OBJ_VAL(bound));
+        bl_vmdo_pushvalue(vm, instance->slots[entry->slot]);
         return true;
     }
-    return bl_vm_throwexception(vm, false, "undefined property '%s'", name->chars);
+    bound = bl_object_makeboundmethod(vm, bl_vmdo_peekvalue(vm, 0), AS_CLOSURE(entry->value));
+    bl_vmdo_popvalue(vm);
+    bl_vmdo_pushvalue(vm, OBJ_VAL(bound));
+    return true;
+}
+
+// remembers the slot of a field that was just read from $instance.
+static inline void bl_vmutil_cacheinstancefield(VMState* vm, InlineCache* cache, ObjInstance* instance, ObjString* name)
+{
+    if(instance->shape != NULL)
+    {
+        bl_vmutil_cacheput(vm, cache, instance->shape, instance->klass->version)->slot = bl_shape_findslot(instance->shape, name);
+    }
+}
+
+static inline void bl_vmutil_cachedinstanceset(VMState* vm, InlineCache* cache, ObjInstance* instance, ObjString* name, Value value)
+{
+    Shape* shape;
+    InlineCacheEntry* entry;
+    shape = instance->shape;
+    if(shape != NULL)
+    {
+        entry = bl_vmutil_cacheget(vm, cache, shape, instance->klass->version);
+        if(entry != NULL)
+        {
+            if(entry->newshape != shape)
+            {
+                bl_instance_reserveslots(vm, instance, entry->newshape->count);
+                instance->slots[entry->slot] = value;
+                instance->shape = entry->newshape;
+            }
+            else
+            {
+                instance->slots[entry->slot] = value;
+            }
+            bl_mem_writebarrier(vm, (Object*)instance);
+            return;
+        }
+    }
+    bl_instance_setfield(vm, instance, name, value);
+    if(shape != NULL && instance->shape != NULL)
+    {
+        entry = bl_vmutil_cacheput(vm, cache, shape, instance->klass->version);
+        entry->newshape = instance->shape;
+        entry->slot = bl_shape_findslot(instance->shape, name);
+    }
 }
 
 
@@ -345,7 +545,9 @@ static bool bl_vmdo_callnativemethod(VMState* vm, ObjNativeFunction* native, int
         }*//*
         return overridden;
     }*/
-    return true;
+    // the native raised an exception. if nothing caught it, every frame has
+    // been unwound and there is nothing left to resume.
+    return vm->framecount > 0;
 }
 
 static inline bool bl_vmdo_docall(VMState* vm, ObjClosure* closure, int argcount)
@@ -369,6 +571,7 @@ static inline bool bl_vmdo_docall(VMState* vm, ObjClosure* closure, int argcount
         {
             bl_valarray_push(vm, &argslist->items, bl_vmdo_peekvalue(vm, i + 1));
         }
+        bl_mem_writebarrier(vm, (Object*)argslist);
         argcount -= vaargsstart;
         bl_vmdo_popvaluen(vm, vaargsstart + 2);// +1 for the gc protection push above
         bl_vmdo_pushvalue(vm, OBJ_VAL(argslist));
@@ -458,21 +661,35 @@ bool bl_vm_callvalue(VMState* vm, Value callee, int argcount)
     return bl_vm_throwexception(vm, false, "object of type %s is not callable", bl_value_typename(callee));
 }
 
-static bool bl_instance_invokefromself(VMState* vm, ObjString* name, int argcount)
+static bool bl_instance_invokefromself(VMState* vm, ObjString* name, int argcount, InlineCache* cache)
 {
     Value value;
     Value receiver;
     ObjInstance* instance;
+    InlineCacheEntry* entry;
     receiver = bl_vmdo_peekvalue(vm, argcount);
     if(bl_value_isinstance(receiver))
     {
         instance = AS_INSTANCE(receiver);
+        entry = bl_vmutil_cacheget(vm, cache, bl_vmutil_instancekey(instance), instance->klass->version);
+        if(entry != NULL)
+        {
+            if(entry->slot < 0)
+            {
+                return bl_vm_callvalue(vm, entry->value, argcount);
+            }
+            value = instance->slots[entry->slot];
+            vm->stacktop[-argcount - 1] = value;
+            return bl_vm_callvalue(vm, value, argcount);
+        }
         if(bl_hashtable_get(&instance->klass->methods, OBJ_VAL(name), &value))
         {
+            bl_vmutil_cacheput(vm, cache, bl_vmutil_instancekey(instance), instance->klass->version)->value = value;
             return bl_vm_callvalue(vm, value, argcount);
         }
-        if(bl_hashtable_get(&instance->properties, OBJ_VAL(name), &value))
+        if(bl_instance_getfield(instance, name, &value))
         {
+            bl_vmutil_cacheinstancefield(vm, cache, instance, name);
             vm->stacktop[-argcount - 1] = value;
             return bl_vm_callvalue(vm, value, argcount);
         }
@@ -525,22 +742,49 @@ static inline bool bl_vm_invokeclassmethod(VMState* vm, ObjString* name, int arg
     return bl_vm_throwexception(vm, false, "unknown method %s() in class %s", name->chars, AS_CLASS(receiver)->name->chars);
 }
 
-static inline bool bl_vm_invokeinstancemethod(VMState* vm, ObjString* name, int argcount, Value receiver)
+static inline bool bl_vm_invokeinstancemethod(VMState* vm, ObjString* name, int argcount, Value receiver, InlineCache* cache)
 {
     Value value;
     ObjInstance* instance;
+    InlineCacheEntry* entry;
     instance = AS_INSTANCE(receiver);
-    if(bl_hashtable_get(&instance->properties, OBJ_VAL(name), &value))
+    // in dictionary mode the class key says nothing about the fields, so those
+    // are always probed first.
+    if(instance->shape == NULL && bl_instance_getfield(instance, name, &value))
     {
         vm->stacktop[-argcount - 1] = value;
         return bl_vm_callvalue(vm, value, argcount);
     }
+    entry = bl_vmutil_cacheget(vm, cache, bl_vmutil_instancekey(instance), instance->klass->version);
+    if(entry != NULL)
+    {
+        if(entry->slot < 0)
+        {
+            return bl_vm_callvalue(vm, entry->value, argcount);
+        }
+        value = instance->slots[entry->slot];
+        vm->stacktop[-argcount - 1] = value;
+        return bl_vm_callvalue(vm, value, argcount);
+    }
+    if(instance->shape != NULL && bl_instance_getfield(instance, name, &value))
+    {
+        bl_vmutil_cacheinstancefield(vm, cache, instance, name);
+        vm->stacktop[-argcount - 1] = value;
+        return bl_vm_callvalue(vm, value, argcount);
+    }
+    // only public methods are cached, so a hit never needs the private check.
+    if(bl_hashtable_get(&instance->klass->methods, OBJ_VAL(name), &value) && bl_vmutil_getmethodtype(value) != TYPE_PRIVATE)
+    {
+        bl_vmutil_cacheput(vm, cache, bl_vmutil_instancekey(instance), instance->klass->version)->value = value;
+        return bl_vm_callvalue(vm, value, argcount);
+    }
     return bl_vm_instanceinvokefromclass(vm, instance->klass, name, argcount);
 }
 
-static inline bool bl_vm_invokemethod(VMState* vm, ObjString* name, int argcount)
+static inline bool bl_vm_invokemethod(VMState* vm, ObjString* name, int argcount, InlineCache* cache)
 {
     Value value;
+    InlineCacheEntry* entry;
     Value receiver;
     Object* recobj;
     ObjClass* klass;
@@ -564,7 +808,7 @@ static inline bool bl_vm_invokemethod(VMState* vm, ObjString* name, int argcount
         }
         else if(recobj->type == OBJ_INSTANCE)
         {
-            return bl_vm_invokeinstancemethod(vm, name, argcount, receiver);    
+            return bl_vm_invokeinstancemethod(vm, name, argcount, receiver, cache);
         }
         switch(recobj->type)
         {
@@ -598,6 +842,11 @@ static inline bool bl_vm_invokemethod(VMState* vm, ObjString* name, int argcount
                     klass = vm->classobjbytes;
                 }
                 break;
+            case OBJ_STRBUILDER:
+                {
+                    klass = vm->classobjstrbuilder;
+                }
+                break;
             default:
                 {
                 }
@@ -605,9 +854,14 @@ static inline bool bl_vm_invokemethod(VMState* vm, ObjString* name, int argcount
         }
         if(klass != NULL)
         {
-            //if(bl_hashtable_get(&klass->methods, OBJ_VAL(name), &value))
+            entry = bl_vmutil_cacheget(vm, cache, klass, bl_vmutil_chainversion(klass));
+            if(entry != NULL)
+            {
+                return bl_vmdo_callnativemethod(vm, AS_NATIVE(entry->value), argcount);
+            }
             if(bl_class_getmethod(vm, klass, name, &value))
             {
+                bl_vmutil_cacheput(vm, cache, klass, bl_vmutil_chainversion(klass))->value = value;
                 return bl_vmdo_callnativemethod(vm, AS_NATIVE(value), argcount);
             }
             return bl_vm_throwexception(vm, false, "class %s has no method %s()", klass->name->chars, name->chars);
@@ -653,6 +907,7 @@ static void bl_vm_closeupvalues(VMState* vm, const Value* last)
         upvalue = vm->openupvalues;
         upvalue->closed = *upvalue->location;
         upvalue->location = &upvalue->closed;
+        bl_mem_writebarrier(vm, (Object*)upvalue);
         vm->openupvalues = upvalue->next;
     }
 }
@@ -664,10 +919,12 @@ static void bl_vm_classdefmethod(VMState* vm, ObjString* name)
     method = bl_vmdo_peekvalue(vm, 0);
     klass = AS_CLASS(bl_vmdo_peekvalue(vm, 1));
     bl_hashtable_set(vm, &klass->methods, OBJ_VAL(name), method);
+    klass->version++;
     if(bl_vmutil_getmethodtype(method) == TYPE_INITIALIZER)
     {
         klass->initializer = method;
     }
+    bl_mem_writebarrier(vm, (Object*)klass);
     bl_vmdo_popvalue(vm);
 }
 
@@ -685,6 +942,8 @@ static void bl_vm_classdefproperty(VMState* vm, ObjString* name, bool isstatic)
     {
         bl_hashtable_set(vm, &klass->staticproperties, OBJ_VAL(name), property);
     }
+    bl_mem_writebarrier(vm, (Object*)klass);
+    klass->version++;
     bl_vmdo_popvalue(vm);
 }
 
@@ -694,7 +953,7 @@ static inline ObjString* bl_vmdo_stringmultiply(VMState* vm, ObjString* str, dou
     int i;
     int times;
     int totallength;
-    char* result;
+    ObjString* result;
     times = (int)number;
     if(times <= 0)
     {
@@ -707,13 +966,17 @@ static inline ObjString* bl_vmdo_stringmultiply(VMState* vm, ObjString* str, dou
         return str;
     }
     totallength = str->length * times;
-    result = ALLOCATE(char, (size_t)totallength + 1);
+    result = bl_string_allocuninterned(vm, totallength);
     for(i = 0; i < times; i++)
     {
-        memcpy(result + (str->length * i), str->chars, str->length);
+        memcpy(result->chars + (str->length * i), str->chars, str->length);
+    }
+    if(str->utf8length >= 0)
+    {
+        result->utf8length = str->utf8length * times;
+        result->isascii = str->isascii;
     }
-    result[totallength] = '\0';
-    return bl_string_takestring(vm, result, totallength);
+    return result;
 }
 
 static inline ObjArray* bl_array_addarray(VMState* vm, ObjArray* a, ObjArray* b)
@@ -730,6 +993,7 @@ static inline ObjArray* bl_array_addarray(VMState* vm, ObjArray* a, ObjArray* b)
     {
         bl_valarray_push(vm, &list->items, b->items.values[i]);
     }
+    bl_mem_writebarrier(vm, (Object*)list);
     bl_vmdo_popvalue(vm);
     return list;
 }
@@ -745,6 +1009,7 @@ static inline void bl_vmdo_listmultiply(VMState* vm, ObjArray* a, ObjArray* newl
             bl_valarray_push(vm, &newlist->items, a->items.values[j]);
         }
     }
+    bl_mem_writebarrier(vm, (Object*)newlist);
 }
 
 static inline bool bl_vmdo_modulegetindex(VMState* vm, ObjModule* module, bool willassign)
@@ -773,6 +1038,7 @@ static inline bool bl_vmdo_stringgetindex(VMState* vm, ObjString* string, bool w
     int length;
     int realindex;
     Value lower;
+    Value result;
     lower = bl_vmdo_peekvalue(vm, 0);
     if(!bl_value_isnumber(lower))
     {
@@ -780,7 +1046,7 @@ static inline bool bl_vmdo_stringgetindex(VMState* vm, ObjString* string, bool w
         return bl_vm_throwexception(vm, false, "strings are numerically indexed");
     }
     index = AS_NUMBER(lower);
-    length = string->isascii ? string->length : string->utf8length;
+    length = string->isascii ? string->length : bl_string_utf8length(string);
     realindex = index;
     if(index < 0)
     {
@@ -794,12 +1060,14 @@ static inline bool bl_vmdo_stringgetindex(VMState* vm, ObjString* string, bool w
         {
             bl_util_utf8slice(string->chars, &start, &end);
         }
+        // copied while the string is still on the stack, as copying may collect.
+        result = STRING_L_VAL(string->chars + start, end - start);
         if(!willassign)
         {
             // we can safely get rid of the index from the stack
             bl_vmdo_popvaluen(vm, 2);// +1 for the string itself
         }
-        bl_vmdo_pushvalue(vm, STRING_L_VAL(string->chars + start, end - start));
+        bl_vmdo_pushvalue(vm, result);
         return true;
     }
     bl_vmdo_popvaluen(vm, 1);
@@ -815,6 +1083,7 @@ static inline bool bl_vmdo_stringgetrangedindex(VMState* vm, ObjString* string,
     int upperindex;
     Value upper;
     Value lower;
+    Value result;
     upper = bl_vmdo_peekvalue(vm, 0);
     lower = bl_vmdo_peekvalue(vm, 1);
     if(!(bl_value_isnil(lower) || bl_value_isnumber(lower)) || !(bl_value_isnumber(upper) || bl_value_isnil(upper)))
@@ -822,7 +1091,7 @@ static inline bool bl_vmdo_stringgetrangedindex(VMState* vm, ObjString* string,
         bl_vmdo_popvaluen(vm, 2);
         return bl_vm_throwexception(vm, false, "string are numerically indexed");
     }
-    length = string->isascii ? string->length : string->utf8length;
+    length = string->isascii ? string->length : bl_string_utf8length(string);
     lowerindex = bl_value_isnumber(lower) ? AS_NUMBER(lower) : 0;
     upperindex = bl_value_isnil(upper) ? length : AS_NUMBER(upper);
     if(lowerindex < 0 || (upperindex < 0 && ((length + upperindex) < 0)))
@@ -849,11 +1118,13 @@ static inline bool bl_vmdo_stringgetrangedindex(VMState* vm, ObjString* string,
     {
         bl_util_utf8slice(string->chars, &start, &end);
     }
+    // copied while the string is still on the stack, as copying may collect.
+    result = STRING_L_VAL(string->chars + start, end - start);
     if(!willassign)
     {
         bl_vmdo_popvaluen(vm, 3);// +1 for the string itself
     }
-    bl_vmdo_pushvalue(vm, STRING_L_VAL(string->chars + start, end - start));
+    bl_vmdo_pushvalue(vm, result);
     return true;
 }
 
@@ -894,6 +1165,7 @@ static inline bool bl_vmdo_bytesgetrangedindex(VMState* vm, ObjBytes* bytes, boo
     int lowerindex;
     Value upper;
     Value lower;
+    Value result;
     upper = bl_vmdo_peekvalue(vm, 0);
     lower = bl_vmdo_peekvalue(vm, 1);
     if(!(bl_value_isnil(lower) || bl_value_isnumber(lower)) || !(bl_value_isnumber(upper) || bl_value_isnil(upper)))
@@ -921,11 +1193,13 @@ static inline bool bl_vmdo_bytesgetrangedindex(VMState* vm, ObjBytes* bytes, boo
     {
         upperindex = bytes->bytes.count;
     }
+    // copied while the bytes are still on the stack, as copying may collect.
+    result = OBJ_VAL(bl_bytes_copybytes(vm, bytes->bytes.bytes + lowerindex, upperindex - lowerindex));
     if(!willassign)
     {
         bl_vmdo_popvaluen(vm, 3);// +1 for the list itself
     }
-    bl_vmdo_pushvalue(vm, OBJ_VAL(bl_bytes_copybytes(vm, bytes->bytes.bytes + lowerindex, upperindex - lowerindex)));
+    bl_vmdo_pushvalue(vm, result);
     return true;
 }
 
@@ -1001,6 +1275,7 @@ static inline bool bl_vmdo_listgetrangedindex(VMState* vm, ObjArray* list, bool
     {
         bl_valarray_push(vm, &nlist->items, list->items.values[i]);
     }
+    bl_mem_writebarrier(vm, (Object*)nlist);
     bl_vmdo_popvalue(vm);// clear gc protect
     if(!willassign)
     {
@@ -1012,7 +1287,11 @@ static inline bool bl_vmdo_listgetrangedindex(VMState* vm, ObjArray* list, bool
 
 static inline void bl_vmdo_modulesetindex(VMState* vm, ObjModule* module, Value index, Value value)
 {
-    bl_hashtable_set(vm, &module->values, index, value);
+    if(bl_hashtable_set(vm, &module->values, index, value))
+    {
+        vm->globalsepoch++;
+    }
+    bl_mem_writebarrier(vm, (Object*)module);
     // pop the value, index and dict out
     bl_vmdo_popvaluen(vm, 3);
     // leave the value on the stack for consumption
@@ -1035,6 +1314,7 @@ static inline bool bl_vmdo_listsetindex(VMState* vm, ObjArray* list, Value index
     if(position < list->items.count && position > -(list->items.count))
     {
         list->items.values[position] = value;
+        bl_mem_writebarrier(vm, (Object*)list);
         // pop the value, index and list out
         bl_vmdo_popvaluen(vm, 3);
         // leave the value on the stack for consumption
@@ -1089,7 +1369,6 @@ static inline bool bl_vmdo_concatvalues(VMState* vm)
     int numlength;
     double numa;
     double numb;
-    char* chars;
     Value vala;
     Value valb;
     ObjString* stra;
@@ -1111,43 +1390,68 @@ static inline bool bl_vmdo_concatvalues(VMState* vm)
     {
         numa = AS_NUMBER(vala);
         numlength = sprintf(numstr, NUMBER_FORMAT, numa);
-        strb = AS_STRING(valb);
+        strb = (ObjString*)AS_OBJ(valb);
         length = numlength + strb->length;
-        chars = ALLOCATE(char, (size_t)length + 1);
-        memcpy(chars, numstr, numlength);
-        memcpy(chars + numlength, strb->chars, strb->length);
-        chars[length] = '\0';
-        result = bl_string_takestring(vm, chars, length);
-        result->utf8length = numlength + strb->utf8length;
+        if(length >= ROPE_MIN_LENGTH || strb->chars == NULL)
+        {
+            // as a string, joining the rope.
+            vm->stacktop[-2] = OBJ_VAL(bl_string_copystringlen(vm, numstr, numlength));
+            return bl_vmdo_concatvalues(vm);
+        }
+        result = bl_string_allocuninterned(vm, length);
+        memcpy(result->chars, numstr, numlength);
+        memcpy(result->chars + numlength, strb->chars, strb->length);
+        if(strb->utf8length >= 0)
+        {
+            result->utf8length = numlength + strb->utf8length;
+            result->isascii = strb->isascii;
+        }
         bl_vmdo_popvaluen(vm, 2);
         bl_vmdo_pushvalue(vm, OBJ_VAL(result));
     }
     else if(bl_value_isnumber(valb))
     {
-        stra = AS_STRING(vala);
+        stra = (ObjString*)AS_OBJ(vala);
         numb = AS_NUMBER(valb);
         numlength = sprintf(numstr, NUMBER_FORMAT, numb);
         length = numlength + stra->length;
-        chars = ALLOCATE(char, (size_t)length + 1);
-        memcpy(chars, stra->chars, stra->length);
-        memcpy(chars + stra->length, numstr, numlength);
-        chars[length] = '\0';
-        result = bl_string_takestring(vm, chars, length);
-        result->utf8length = numlength + stra->utf8length;
+        if(length >= ROPE_MIN_LENGTH || stra->chars == NULL)
+        {
+            vm->stacktop[-1] = OBJ_VAL(bl_string_copystringlen(vm, numstr, numlength));
+            return bl_vmdo_concatvalues(vm);
+        }
+        result = bl_string_allocuninterned(vm, length);
+        memcpy(result->chars, stra->chars, stra->length);
+        memcpy(result->chars + stra->length, numstr, numlength);
+        if(stra->utf8length >= 0)
+        {
+            result->utf8length = numlength + stra->utf8length;
+            result->isascii = stra->isascii;
+        }
         bl_vmdo_popvaluen(vm, 2);
         bl_vmdo_pushvalue(vm, OBJ_VAL(result));
     }
     else if(bl_value_isstring(vala) && bl_value_isstring(valb))
     {
-        strb = AS_STRING(valb);
-        stra = AS_STRING(vala);
+        stra = (ObjString*)AS_OBJ(vala);
+        strb = (ObjString*)AS_OBJ(valb);
         length = stra->length + strb->length;
-        chars = ALLOCATE(char, length + 1);
-        memcpy(chars, stra->chars, stra->length);
-        memcpy(chars + stra->length, strb->chars, strb->length);
-        chars[length] = '\0';
-        result = bl_string_takestring(vm, chars, length);
-        result->utf8length = stra->utf8length + strb->utf8length;
+        // building a long string piece by piece stays linear.
+        if(length >= ROPE_MIN_LENGTH || stra->chars == NULL || strb->chars == NULL)
+        {
+            result = bl_string_makerope(vm, stra, strb);
+            bl_vmdo_popvaluen(vm, 2);
+            bl_vmdo_pushvalue(vm, OBJ_VAL(result));
+            return true;
+        }
+        result = bl_string_allocuninterned(vm, length);
+        memcpy(result->chars, stra->chars, stra->length);
+        memcpy(result->chars + stra->length, strb->chars, strb->length);
+        if(stra->utf8length >= 0 && strb->utf8length >= 0)
+        {
+            result->utf8length = stra->utf8length + strb->utf8length;
+            result->isascii = stra->isascii && strb->isascii;
+        }
         bl_vmdo_popvaluen(vm, 2);
         bl_vmdo_pushvalue(vm, OBJ_VAL(result));
     }
@@ -1197,6 +1501,64 @@ static inline ObjString* READ_STRING(CallFrame* frame)
     return AS_STRING(READ_CONSTANT(frame));
 }
 
+static inline InlineCache* READ_CACHE(CallFrame* frame)
+{
+    return &frame->closure->fnptr->blob.caches[READ_SHORT(frame)];
+}
+
+static inline GlobalCache* READ_GLOBAL_CACHE(CallFrame* frame)
+{
+    return &frame->closure->fnptr->blob.globalcaches[READ_SHORT(frame)];
+}
+
+/*
+* returns the entry a global cache points at, as long as it still holds $name.
+* entries never move unless the table grows, and keys are unique, so the key
+* check alone proves the index is still right.
+*/
+static inline HashEntry* bl_vmutil_globalcacheget(VMState* vm, GlobalCache* cache, HashTable* modtable, ObjString* name)
+{
+    HashTable* table;
+    HashEntry* entry;
+    if(cache->index < 0)
+    {
+        return NULL;
+    }
+    table = modtable;
+    if(cache->inglobals)
+    {
+        // a name defined in the module since then would shadow this entry.
+        if(cache->epoch != vm->globalsepoch)
+        {
+            return NULL;
+        }
+        table = &vm->globals;
+    }
+    if(cache->index >= table->capacity)
+    {
+        return NULL;
+    }
+    entry = &table->entries[cache->index];
+    if(!bl_value_isobject(entry->key) || AS_OBJ(entry->key) != (Object*)name)
+    {
+        return NULL;
+    }
+    return entry;
+}
+
+static inline void bl_vmutil_globalcacheput(VMState* vm, GlobalCache* cache, HashTable* table, ObjString* name)
+{
+    HashEntry* entry;
+    entry = bl_hashtable_getentry(table, OBJ_VAL(name));
+    if(entry == NULL)
+    {
+        return;
+    }
+    cache->index = (int)(entry - table->entries);
+    cache->inglobals = (table == &vm->globals);
+    cache->epoch = vm->globalsepoch;
+}
+
 static inline int vmutil_numtoint32(Value val)
 {
     if(bl_value_isbool(val))
@@ -1233,7 +1595,10 @@ static inline long bl_vmutil_toint(Value val)
     return AS_NUMBER(val);
 }
 
-static inline PtrResult bl_vmdo_binaryop(VMState* vm, CallFrame* frame, bool asbool, int op, VMBinaryCallbackFn fn)
+/*
+* the arithmetic behind bl_vmdo_binaryop(). both operands are numbers or bools.
+*/
+static inline double bl_vmutil_binaryarith(int op, VMBinaryCallbackFn fn, Value leftinval, Value rightinval)
 {
     long leftint;
     long rightint;
@@ -1242,16 +1607,6 @@ static inline PtrResult bl_vmdo_binaryop(VMState* vm, CallFrame* frame, bool asb
     double rightflt;
     int leftsigned;
     unsigned int rightusigned;
-    Value resval;
-    Value leftinval;
-    Value rightinval;
-    (void)frame;
-    rightinval = bl_vmdo_popvalue(vm);
-    leftinval = bl_vmdo_popvalue(vm);
-    if((!bl_value_isnumber(leftinval) && !bl_value_isbool(leftinval)) || (!bl_value_isnumber(rightinval) && !bl_value_isbool(rightinval)))
-    {
-        runtime_error("unsupported operand %d for %s and %s", op, bl_value_typename(leftinval), bl_value_typename(rightinval));
-    }
     if(fn != NULL)
     {
         leftflt = bl_vmutil_tonum(leftinval);
@@ -1347,6 +1702,23 @@ static inline PtrResult bl_vmdo_binaryop(VMState* vm, CallFrame* frame, bool asb
                 break;
         }
     }
+    return numres;
+}
+
+static inline PtrResult bl_vmdo_binaryop(VMState* vm, CallFrame* frame, bool asbool, int op, VMBinaryCallbackFn fn)
+{
+    double numres;
+    Value resval;
+    Value leftinval;
+    Value rightinval;
+    (void)frame;
+    rightinval = bl_vmdo_popvalue(vm);
+    leftinval = bl_vmdo_popvalue(vm);
+    if((!bl_value_isnumber(leftinval) && !bl_value_isbool(leftinval)) || (!bl_value_isnumber(rightinval) && !bl_value_isbool(rightinval)))
+    {
+        runtime_error("unsupported operand %d for %s and %s", op, bl_value_typename(leftinval), bl_value_typename(rightinval));
+    }
+    numres = bl_vmutil_binaryarith(op, fn, leftinval, rightinval);
     if(asbool)
     {
         resval = BOOL_VAL(numres);
@@ -1359,15 +1731,78 @@ static inline PtrResult bl_vmdo_binaryop(VMState* vm, CallFrame* frame, bool asb
     return PTR_OK;
 }
 
+/*
+* evaluates a binary instruction over two constant operands, giving the same
+* result bl_vmdo_binaryop() would at run time. this is what the compiler folds
+* constant expressions with. returns false when $op cannot be folded for
+* these operands, in which case the instruction is left for the vm.
+*/
+bool bl_vm_foldbinaryop(int op, Value left, Value right, Value* dest)
+{
+    VMBinaryCallbackFn fn;
+    if((!bl_value_isnumber(left) && !bl_value_isbool(left)) || (!bl_value_isnumber(right) && !bl_value_isbool(right)))
+    {
+        return false;
+    }
+    fn = NULL;
+    switch(op)
+    {
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_BITAND:
+        case OP_BITOR:
+        case OP_BITXOR:
+        case OP_LEFTSHIFT:
+        case OP_RIGHTSHIFT:
+        case OP_GREATERTHAN:
+        case OP_LESSTHAN:
+            break;
+        case OP_REMINDER:
+            fn = (VMBinaryCallbackFn)bl_util_modulo;
+            break;
+        case OP_POW:
+            fn = (VMBinaryCallbackFn)pow;
+            break;
+        case OP_F_DIVIDE:
+            {
+                // integer division by zero would trap while compiling
+                if((int)bl_vmutil_tonum(right) == 0)
+                {
+                    return false;
+                }
+                fn = (VMBinaryCallbackFn)bl_util_floordiv;
+            }
+            break;
+        default:
+            return false;
+    }
+    if(op == OP_GREATERTHAN || op == OP_LESSTHAN)
+    {
+        *dest = BOOL_VAL(bl_vmutil_binaryarith(op, fn, left, right));
+    }
+    else
+    {
+        *dest = NUMBER_VAL(bl_vmutil_binaryarith(op, fn, left, right));
+    }
+    return true;
+}
+
 PtrResult bl_vmdo_rungetproperty(VMState* vm, CallFrame* frame)
 {
+    bool found;
+    bool isfield;
     Value value;
     Value peeked;
     Object* peekobj;
     ObjClass* klass;
     ObjString* name;
+    InlineCache* cache;
+    InlineCacheEntry* entry;
     klass = NULL;
     name = READ_STRING(frame);
+    cache = READ_CACHE(frame);
     peeked = bl_vmdo_peekvalue(vm, 0);
     if(bl_value_isobject(peeked))
     {
@@ -1424,13 +1859,21 @@ PtrResult bl_vmdo_rungetproperty(VMState* vm, CallFrame* frame)
         else if(peekobj->type == OBJ_INSTANCE)
         {
             ObjInstance* instance = AS_INSTANCE(peeked);
-            if(bl_hashtable_get(&instance->properties, OBJ_VAL(name), &value))
+            if(bl_vmutil_cachedinstanceget(vm, cache, instance))
+            {
+                return PTR_OK;
+            }
+            if(bl_instance_getfield(instance, name, &value))
             {
                 if(name->length > 0 && name->chars[0] == '_')
                 {
                     runtime_error("cannot call private property '%s' from instance of %s", name->chars, instance->klass->name->chars);
                     //return PTR_RUNTIME_ERR;
                 }
+                else
+                {
+                    bl_vmutil_cacheinstancefield(vm, cache, instance, name);
+                }
                 // pop the instance...
                 bl_vmdo_popvalue(vm);
                 bl_vmdo_pushvalue(vm, value);
@@ -1441,7 +1884,7 @@ PtrResult bl_vmdo_rungetproperty(VMState* vm, CallFrame* frame)
                 runtime_error("cannot bind private property '%s' to instance of %s", name->chars, instance->klass->name->chars);
                 //return PTR_RUNTIME_ERR;
             }
-            if(bl_vmdo_classbindmethod(vm, instance->klass, name))
+            if(bl_vmdo_classbindmethod(vm, instance->klass, name, cache, bl_vmutil_instancekey(instance)))
             {
                 return PTR_OK;
             }
@@ -1481,6 +1924,11 @@ PtrResult bl_vmdo_rungetproperty(VMState* vm, CallFrame* frame)
                     klass = vm->classobjbytes;
                 }
                 break;
+            case OBJ_STRBUILDER:
+                {
+                    klass = vm->classobjstrbuilder;
+                }
+                break;
             case OBJ_FILE:
                 {
                     klass = vm->classobjfile;
@@ -1503,16 +1951,36 @@ PtrResult bl_vmdo_rungetproperty(VMState* vm, CallFrame* frame)
             * would be ambiguous as $value could be a function, which could then be called
             * with incorrect argument count...
             */
-            if(bl_class_getmethod(vm, klass, name, &value))
+            entry = bl_vmutil_cacheget(vm, cache, klass, bl_vmutil_chainversion(klass));
+            found = (entry != NULL);
+            if(found)
             {
-                bl_vmdo_popvalue(vm);
-                bl_vmdo_pushvalue(vm, value);
-                return PTR_OK;
+                value = entry->value;
+                isfield = entry->isfield;
+            }
+            else
+            {
+                isfield = false;
+                if(bl_class_getmethod(vm, klass, name, &value))
+                {
+                    found = true;
+                }
+                else if(bl_class_getproperty(vm, klass, name, &value))
+                {
+                    found = true;
+                    isfield = bl_value_isobject(value) && bl_value_isnativefunction(value);
+                }
+                if(found)
+                {
+                    entry = bl_vmutil_cacheput(vm, cache, klass, bl_vmutil_chainversion(klass));
+                    entry->value = value;
+                    entry->isfield = isfield;
+                }
             }
-            else if(bl_class_getproperty(vm, klass, name, &value))
+            if(found)
             {
                 bl_vmdo_popvalue(vm);
-                if(bl_value_isobject(value) && bl_value_isnativefunction(value))
+                if(isfield)
                 {
                     //bool bl_vm_callvalue(VMState *vm, Value callee, int argcount);
                     bl_vmdo_pushvalue(vm, peeked);
@@ -1544,18 +2012,25 @@ PtrResult bl_vmdo_rungetselfproperty(VMState* vm, CallFrame* frame)
     ObjClass* klass;
     ObjModule* module;
     ObjInstance* instance;
+    InlineCache* cache;
     name = READ_STRING(frame);
+    cache = READ_CACHE(frame);
     peeked = bl_vmdo_peekvalue(vm, 0);
     if(bl_value_isinstance(peeked))
     {
         instance = AS_INSTANCE(peeked);
-        if(bl_hashtable_get(&instance->properties, OBJ_VAL(name), &value))
+        if(bl_vmutil_cachedinstanceget(vm, cache, instance))
+        {
+            return PTR_OK;
+        }
+        if(bl_instance_getfield(instance, name, &value))
         {
+            bl_vmutil_cacheinstancefield(vm, cache, instance, name);
             bl_vmdo_popvalue(vm);
             bl_vmdo_pushvalue(vm, value);
             return PTR_OK;
         }
-        if(bl_vmdo_classbindmethod(vm, instance->klass, name))
+        if(bl_vmdo_classbindmethod(vm, instance->klass, name, cache, bl_vmutil_instancekey(instance)))
         {
             return PTR_OK;
         }
@@ -1613,11 +2088,12 @@ PtrResult bl_vmdo_runsetproperty(VMState* vm, CallFrame* frame)
         runtime_error("empty cannot be assigned");
     }
     ObjString* name = READ_STRING(frame);
+    InlineCache* cache = READ_CACHE(frame);
     if(bl_value_isinstance(objto))
     {
         ObjInstance* instance = AS_INSTANCE(objto);
         val = bl_vmdo_peekvalue(vm, 0);
-        bl_hashtable_set(vm, &instance->properties, OBJ_VAL(name), val);
+        bl_vmutil_cachedinstanceset(vm, cache, instance, name, val);
         Value value = bl_vmdo_popvalue(vm);
         bl_vmdo_popvalue(vm);// removing the instance object
         bl_vmdo_pushvalue(vm, value);
@@ -1653,51 +2129,288 @@ PtrResult bl_vmdo_runsetproperty(VMState* vm, CallFrame* frame)
         } \
     }
 
+// raises a runtime error from inside bl_vm_run().
+// the handler that catches it may live in a calling frame, so execution resumes
+// from whatever frame is on top once the exception has been propagated.
+#define vm_mac_runtimeerror(...) \
+    { \
+        if(!bl_vm_throwexception(vm, false, ##__VA_ARGS__)) \
+        { \
+            EXIT_VM(); \
+        } \
+        frame = &vm->frames[vm->framecount - 1]; \
+    }
+
+/*
+* instruction dispatch.
+* with gcc (and compatible compilers) every handler jumps straight to the next one
+* through a table of label addresses, instead of going back through the switch.
+* define BLADE_NO_COMPUTED_GOTO to force the portable switch-based loop.
+*/
+#if defined(__GNUC__) && !defined(BLADE_NO_COMPUTED_GOTO)
+    #define BLADE_COMPUTED_GOTO 1
+#endif
+
+#if defined(BLADE_COMPUTED_GOTO)
+    #define VM_CASE(op) case op: vmlabel_##op:
+    #define VM_DISPATCH() \
+        { \
+            instruction = READ_BYTE(frame); \
+            goto *dispatchfrom[instruction]; \
+        }
+#else
+    #define VM_CASE(op) case op:
+    #define VM_DISPATCH() continue
+#endif
+
+// marks a handler that runs on into the next one.
+#if defined(__GNUC__) && __GNUC__ >= 7
+    #define VM_FALLTHROUGH() __attribute__((fallthrough))
+#else
+    #define VM_FALLTHROUGH()
+#endif
+
+/*
+* type-quickening.
+* once a generic arithmetic or comparison instruction has seen two numbers, it
+* rewrites itself in place into its _NUM form, which only has to check the operand
+* types. when that check fails, the instruction turns itself into its _ANY form
+* and runs again. the _ANY form is the generic one, less the attempt to quicken:
+* a site that has seen more than numbers stays generic, rather than flipping
+* between the two forms every time the operand types change.
+*/
+#define vm_mac_rewriteinst(op) \
+    { \
+        frame->ip[-1] = (op); \
+        frame->ip--; \
+        VM_DISPATCH(); \
+    }
+
+#define vm_mac_tryquicken(numop) \
+    { \
+        if(bl_value_isnumber(bl_vmdo_peekvalue(vm, 0)) && bl_value_isnumber(bl_vmdo_peekvalue(vm, 1))) \
+        { \
+            vm_mac_rewriteinst(numop); \
+        } \
+    }
+
+#define vm_mac_numbinaryop(genericop, makeval, oper) \
+    { \
+        Value b = bl_vmdo_peekvalue(vm, 0); \
+        Value a = bl_vmdo_peekvalue(vm, 1); \
+        if(!bl_value_isnumber(a) || !bl_value_isnumber(b)) \
+        { \
+            vm_mac_rewriteinst(genericop); \
+        } \
+        vm->stacktop--; \
+        vm->stacktop[-1] = makeval(AS_NUMBER(a) oper AS_NUMBER(b)); \
+        VM_DISPATCH(); \
+    }
+
+// prints the stack and the instruction that is about to run (-j)
+static void bl_vmdo_tracestep(VMState* vm, CallFrame* frame)
+{
+    Value* stackslot;
+    printf("          ");
+    for(stackslot = vm->stack; stackslot < vm->stacktop; stackslot++)
+    {
+        printf("[ ");
+        bl_value_printvalue(*stackslot);
+        printf(" ]");
+    }
+    printf("\n");
+    bl_blob_disassembleinst(&frame->closure->fnptr->blob, (int)(frame->ip - 1 - frame->closure->fnptr->blob.code));
+}
+
+/*
+* fused compare-and-branch.
+* pops both operands and jumps when the comparison is false. anything but two
+* numbers goes through the generic comparison; if that raised an exception, the
+* handler has already moved execution elsewhere and there is nothing to branch on.
+*/
+#define vm_mac_comparejump(genericop, oper) \
+    { \
+        uint16_t offset = READ_SHORT(frame); \
+        Value b = bl_vmdo_peekvalue(vm, 0); \
+        Value a = bl_vmdo_peekvalue(vm, 1); \
+        if(bl_value_isnumber(a) && bl_value_isnumber(b)) \
+        { \
+            vm->stacktop -= 2; \
+            if(!(AS_NUMBER(a) oper AS_NUMBER(b))) \
+            { \
+                frame->ip += offset; \
+            } \
+            VM_DISPATCH(); \
+        } \
+        uint8_t* resumeip = frame->ip; \
+        vm_mac_execfuncargs(bl_vmdo_binaryop, true, genericop, NULL); \
+        if(frame != &vm->frames[vm->framecount - 1] || frame->ip != resumeip) \
+        { \
+            frame = &vm->frames[vm->framecount - 1]; \
+            VM_DISPATCH(); \
+        } \
+        if(bl_value_isfalse(bl_vmdo_popvalue(vm))) \
+        { \
+            frame->ip += offset; \
+        } \
+        VM_DISPATCH(); \
+    }
+
 PtrResult bl_vm_run(VMState* vm)
 {
     uint8_t instruction;
     PtrResult doresult;
     CallFrame* frame;
-    Value* stackslot;
+    #if defined(BLADE_COMPUTED_GOTO)
+        void** dispatchfrom;
+        // bytes that are not instructions are skipped, just like the switch's default case.
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Woverride-init"
+        static void* dispatchtable[256] = {
+            [0 ... 255] = &&vmlabel_default,
+            [OP_DEFINE_GLOBAL] = &&vmlabel_OP_DEFINE_GLOBAL,
+            [OP_GET_GLOBAL] = &&vmlabel_OP_GET_GLOBAL,
+            [OP_SET_GLOBAL] = &&vmlabel_OP_SET_GLOBAL,
+            [OP_GET_LOCAL] = &&vmlabel_OP_GET_LOCAL,
+            [OP_GET_UP_VALUE] = &&vmlabel_OP_GET_UP_VALUE,
+            [OP_SET_LOCAL] = &&vmlabel_OP_SET_LOCAL,
+            [OP_SET_UP_VALUE] = &&vmlabel_OP_SET_UP_VALUE,
+            [OP_CLOSE_UP_VALUE] = &&vmlabel_OP_CLOSE_UP_VALUE,
+            [OP_GET_PROPERTY] = &&vmlabel_OP_GET_PROPERTY,
+            [OP_GET_SELF_PROPERTY] = &&vmlabel_OP_GET_SELF_PROPERTY,
+            [OP_SET_PROPERTY] = &&vmlabel_OP_SET_PROPERTY,
+            [OP_JUMP_IF_FALSE] = &&vmlabel_OP_JUMP_IF_FALSE,
+            [OP_JUMP] = &&vmlabel_OP_JUMP,
+            [OP_LOOP] = &&vmlabel_OP_LOOP,
+            [OP_EQUAL] = &&vmlabel_OP_EQUAL,
+            [OP_GREATERTHAN] = &&vmlabel_OP_GREATERTHAN,
+            [OP_LESSTHAN] = &&vmlabel_OP_LESSTHAN,
+            [OP_EMPTY] = &&vmlabel_OP_EMPTY,
+            [OP_NIL] = &&vmlabel_OP_NIL,
+            [OP_TRUE] = &&vmlabel_OP_TRUE,
+            [OP_FALSE] = &&vmlabel_OP_FALSE,
+            [OP_ADD] = &&vmlabel_OP_ADD,
+            [OP_SUBTRACT] = &&vmlabel_OP_SUBTRACT,
+            [OP_MULTIPLY] = &&vmlabel_OP_MULTIPLY,
+            [OP_DIVIDE] = &&vmlabel_OP_DIVIDE,
+            [OP_F_DIVIDE] = &&vmlabel_OP_F_DIVIDE,
+            [OP_REMINDER] = &&vmlabel_OP_REMINDER,
+            [OP_POW] = &&vmlabel_OP_POW,
+            [OP_NEGATE] = &&vmlabel_OP_NEGATE,
+            [OP_NOT] = &&vmlabel_OP_NOT,
+            [OP_BIT_NOT] = &&vmlabel_OP_BIT_NOT,
+            [OP_BITAND] = &&vmlabel_OP_BITAND,
+            [OP_BITOR] = &&vmlabel_OP_BITOR,
+            [OP_BITXOR] = &&vmlabel_OP_BITXOR,
+            [OP_LEFTSHIFT] = &&vmlabel_OP_LEFTSHIFT,
+            [OP_RIGHTSHIFT] = &&vmlabel_OP_RIGHTSHIFT,
+            [OP_ONE] = &&vmlabel_OP_ONE,
+            [OP_CONSTANT] = &&vmlabel_OP_CONSTANT,
+            [OP_ECHO] = &&vmlabel_OP_ECHO,
+            [OP_POP] = &&vmlabel_OP_POP,
+            [OP_DUP] = &&vmlabel_OP_DUP,
+            [OP_POP_N] = &&vmlabel_OP_POP_N,
+            [OP_ASSERT] = &&vmlabel_OP_ASSERT,
+            [OP_DIE] = &&vmlabel_OP_DIE,
+            [OP_CLOSURE] = &&vmlabel_OP_CLOSURE,
+            [OP_CALL] = &&vmlabel_OP_CALL,
+            [OP_INVOKE] = &&vmlabel_OP_INVOKE,
+            [OP_INVOKE_SELF] = &&vmlabel_OP_INVOKE_SELF,
+            [OP_RETURN] = &&vmlabel_OP_RETURN,
+            [OP_CLASS] = &&vmlabel_OP_CLASS,
+            [OP_METHOD] = &&vmlabel_OP_METHOD,
+            [OP_CLASS_PROPERTY] = &&vmlabel_OP_CLASS_PROPERTY,
+            [OP_INHERIT] = &&vmlabel_OP_INHERIT,
+            [OP_GET_SUPER] = &&vmlabel_OP_GET_SUPER,
+            [OP_SUPER_INVOKE] = &&vmlabel_OP_SUPER_INVOKE,
+            [OP_SUPER_INVOKE_SELF] = &&vmlabel_OP_SUPER_INVOKE_SELF,
+            [OP_RANGE] = &&vmlabel_OP_RANGE,
+            [OP_LIST] = &&vmlabel_OP_LIST,
+            [OP_DICT] = &&vmlabel_OP_DICT,
+            [OP_GET_INDEX] = &&vmlabel_OP_GET_INDEX,
+            [OP_GET_RANGED_INDEX] = &&vmlabel_OP_GET_RANGED_INDEX,
+            [OP_SET_INDEX] = &&vmlabel_OP_SET_INDEX,
+            [OP_CALL_IMPORT] = &&vmlabel_OP_CALL_IMPORT,
+            [OP_NATIVE_MODULE] = &&vmlabel_OP_NATIVE_MODULE,
+            [OP_SELECT_IMPORT] = &&vmlabel_OP_SELECT_IMPORT,
+            [OP_SELECT_NATIVE_IMPORT] = &&vmlabel_OP_SELECT_NATIVE_IMPORT,
+            [OP_IMPORT_ALL_NATIVE] = &&vmlabel_OP_IMPORT_ALL_NATIVE,
+            [OP_EJECT_IMPORT] = &&vmlabel_OP_EJECT_IMPORT,
+            [OP_EJECT_NATIVE_IMPORT] = &&vmlabel_OP_EJECT_NATIVE_IMPORT,
+            [OP_IMPORT_ALL] = &&vmlabel_OP_IMPORT_ALL,
+            [OP_TRY] = &&vmlabel_OP_TRY,
+            [OP_POP_TRY] = &&vmlabel_OP_POP_TRY,
+            [OP_PUBLISH_TRY] = &&vmlabel_OP_PUBLISH_TRY,
+            [OP_STRINGIFY] = &&vmlabel_OP_STRINGIFY,
+            [OP_SWITCH] = &&vmlabel_OP_SWITCH,
+            [OP_CHOICE] = &&vmlabel_OP_CHOICE,
+            [OP_ADD_NUM] = &&vmlabel_OP_ADD_NUM,
+            [OP_SUBTRACT_NUM] = &&vmlabel_OP_SUBTRACT_NUM,
+            [OP_MULTIPLY_NUM] = &&vmlabel_OP_MULTIPLY_NUM,
+            [OP_DIVIDE_NUM] = &&vmlabel_OP_DIVIDE_NUM,
+            [OP_EQUAL_NUM] = &&vmlabel_OP_EQUAL_NUM,
+            [OP_GREATERTHAN_NUM] = &&vmlabel_OP_GREATERTHAN_NUM,
+            [OP_LESSTHAN_NUM] = &&vmlabel_OP_LESSTHAN_NUM,
+            [OP_ADD_ANY] = &&vmlabel_OP_ADD_ANY,
+            [OP_SUBTRACT_ANY] = &&vmlabel_OP_SUBTRACT_ANY,
+            [OP_MULTIPLY_ANY] = &&vmlabel_OP_MULTIPLY_ANY,
+            [OP_DIVIDE_ANY] = &&vmlabel_OP_DIVIDE_ANY,
+            [OP_EQUAL_ANY] = &&vmlabel_OP_EQUAL_ANY,
+            [OP_GREATERTHAN_ANY] = &&vmlabel_OP_GREATERTHAN_ANY,
+            [OP_LESSTHAN_ANY] = &&vmlabel_OP_LESSTHAN_ANY,
+            [OP_GET_LOCAL_0] = &&vmlabel_OP_GET_LOCAL_0,
+            [OP_GET_LOCAL_1] = &&vmlabel_OP_GET_LOCAL_1,
+            [OP_GET_LOCAL_2] = &&vmlabel_OP_GET_LOCAL_2,
+            [OP_GET_LOCAL_3] = &&vmlabel_OP_GET_LOCAL_3,
+            [OP_SET_LOCAL_POP] = &&vmlabel_OP_SET_LOCAL_POP,
+            [OP_CONSTANT_SMALLINT] = &&vmlabel_OP_CONSTANT_SMALLINT,
+            [OP_POP_JUMP_IF_FALSE] = &&vmlabel_OP_POP_JUMP_IF_FALSE,
+            [OP_EQUAL_JUMP] = &&vmlabel_OP_EQUAL_JUMP,
+            [OP_GREATERTHAN_JUMP] = &&vmlabel_OP_GREATERTHAN_JUMP,
+            [OP_LESSTHAN_JUMP] = &&vmlabel_OP_LESSTHAN_JUMP,
+        };
+        #pragma GCC diagnostic pop
+        // with -j every instruction is routed through vmlabel_trace first
+        static void* tracetable[256] = { [0 ... 255] = &&vmlabel_trace };
+        dispatchfrom = vm->shoulddebugstack ? tracetable : dispatchtable;
+    #endif
     frame = &vm->frames[vm->framecount - 1];
     for(;;)
     {
-        // try...finally... (i.e. try without a catch but a finally
-        // but whose try body raises an exception)
-        // can cause us to go into an invalid mode where frame count == 0
-        // to fix this, we need to exit with an appropriate mode here.
-        if(vm->framecount == 0)
-        {
-            return PTR_RUNTIME_ERR;
-        }
-        if(vm->shoulddebugstack)
-        {
-            printf("          ");
-            for(stackslot = vm->stack; stackslot < vm->stacktop; stackslot++)
+        #if defined(BLADE_COMPUTED_GOTO)
+            // the switch below is never re-entered; every handler dispatches directly.
+            VM_DISPATCH();
+            vmlabel_trace:
+            bl_vmdo_tracestep(vm, frame);
+            goto *dispatchtable[instruction];
+        #else
+            instruction = READ_BYTE(frame);
+            if(vm->shoulddebugstack)
             {
-                printf("[ ");
-                bl_value_printvalue(*stackslot);
-                printf(" ]");
+                bl_vmdo_tracestep(vm, frame);
             }
-            printf("\n");
-            bl_blob_disassembleinst(&frame->closure->fnptr->blob, (int)(frame->ip - frame->closure->fnptr->blob.code));
-        }
-        switch(instruction = READ_BYTE(frame))
+        #endif
+        switch(instruction)
         {
-            case OP_CONSTANT:
+            VM_CASE(OP_CONSTANT)
                 {
                     Value constant = READ_CONSTANT(frame);
                     bl_vmdo_pushvalue(vm, constant);
                 }
-                break;
-            case OP_ADD:
+                VM_DISPATCH();
+            VM_CASE(OP_ADD)
+                {
+                    vm_mac_tryquicken(OP_ADD_NUM);
+                }
+                VM_FALLTHROUGH();
+            VM_CASE(OP_ADD_ANY)
                 {
                     if(bl_value_isstring(bl_vmdo_peekvalue(vm, 0)) || bl_value_isstring(bl_vmdo_peekvalue(vm, 1)))
                     {
                         if(!bl_vmdo_concatvalues(vm))
                         {
-                            runtime_error("unsupported operand + for %s and %s", bl_value_typename(bl_vmdo_peekvalue(vm, 0)), bl_value_typename(bl_vmdo_peekvalue(vm, 1)));
-                            break;
+                            vm_mac_runtimeerror("unsupported operand + for %s and %s", bl_value_typename(bl_vmdo_peekvalue(vm, 0)), bl_value_typename(bl_vmdo_peekvalue(vm, 1)));
+                            VM_DISPATCH();
                         }
                     }
                     else if(bl_value_isarray(bl_vmdo_peekvalue(vm, 0)) && bl_value_isarray(bl_vmdo_peekvalue(vm, 1)))
@@ -1715,16 +2428,26 @@ PtrResult bl_vm_run(VMState* vm)
                     else
                     {
                         vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_ADD, NULL);
-                        break;
+                        VM_DISPATCH();
                     }
                 }
-                break;
-            case OP_SUBTRACT:
+                VM_DISPATCH();
+            VM_CASE(OP_SUBTRACT)
+                {
+                    vm_mac_tryquicken(OP_SUBTRACT_NUM);
+                }
+                VM_FALLTHROUGH();
+            VM_CASE(OP_SUBTRACT_ANY)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_SUBTRACT, NULL);
                 }
-                break;
-            case OP_MULTIPLY:
+                VM_DISPATCH();
+            VM_CASE(OP_MULTIPLY)
+                {
+                    vm_mac_tryquicken(OP_MULTIPLY_NUM);
+                }
+                VM_FALLTHROUGH();
+            VM_CASE(OP_MULTIPLY_ANY)
                 {
                     if(bl_value_isstring(bl_vmdo_peekvalue(vm, 1)) && bl_value_isnumber(bl_vmdo_peekvalue(vm, 0)))
                     {
@@ -1733,7 +2456,7 @@ PtrResult bl_vm_run(VMState* vm)
                         Value result = OBJ_VAL(bl_vmdo_stringmultiply(vm, string, number));
                         bl_vmdo_popvaluen(vm, 2);
                         bl_vmdo_pushvalue(vm, result);
-                        break;
+                        VM_DISPATCH();
                     }
                     else if(bl_value_isarray(bl_vmdo_peekvalue(vm, 1)) && bl_value_isnumber(bl_vmdo_peekvalue(vm, 0)))
                     {
@@ -1744,131 +2467,151 @@ PtrResult bl_vm_run(VMState* vm)
                         bl_vmdo_listmultiply(vm, list, nlist, number);
                         bl_vmdo_popvaluen(vm, 2);
                         bl_vmdo_pushvalue(vm, OBJ_VAL(nlist));
-                        break;
+                        VM_DISPATCH();
                     }
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_MULTIPLY, NULL);
                 }
-                break;
-            case OP_DIVIDE:
+                VM_DISPATCH();
+            VM_CASE(OP_DIVIDE)
+                {
+                    vm_mac_tryquicken(OP_DIVIDE_NUM);
+                }
+                VM_FALLTHROUGH();
+            VM_CASE(OP_DIVIDE_ANY)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_DIVIDE, NULL);
                 }
-                break;
-            case OP_REMINDER:
+                VM_DISPATCH();
+            VM_CASE(OP_REMINDER)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_REMINDER, (VMBinaryCallbackFn)bl_util_modulo);
                 }
-                break;
-            case OP_POW:
+                VM_DISPATCH();
+            VM_CASE(OP_POW)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_POW, (VMBinaryCallbackFn)pow);
                 }
-                break;
-            case OP_F_DIVIDE:
+                VM_DISPATCH();
+            VM_CASE(OP_F_DIVIDE)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_F_DIVIDE, (VMBinaryCallbackFn)bl_util_floordiv);
                 }
-                break;
-            case OP_NEGATE:
+                VM_DISPATCH();
+            VM_CASE(OP_NEGATE)
                 {
                     if(!bl_value_isnumber(bl_vmdo_peekvalue(vm, 0)))
                     {
-                        runtime_error("operator - not defined for object of type %s", bl_value_typename(bl_vmdo_peekvalue(vm, 0)));
-                        break;
+                        vm_mac_runtimeerror("operator - not defined for object of type %s", bl_value_typename(bl_vmdo_peekvalue(vm, 0)));
+                        VM_DISPATCH();
                     }
                     bl_vmdo_pushvalue(vm, NUMBER_VAL(-AS_NUMBER(bl_vmdo_popvalue(vm))));
                 }
-                break;
-            case OP_BIT_NOT:
+                VM_DISPATCH();
+            VM_CASE(OP_BIT_NOT)
                 {
                     if(!bl_value_isnumber(bl_vmdo_peekvalue(vm, 0)))
                     {
-                        runtime_error("operator ~ not defined for object of type %s", bl_value_typename(bl_vmdo_peekvalue(vm, 0)));
-                        break;
+                        vm_mac_runtimeerror("operator ~ not defined for object of type %s", bl_value_typename(bl_vmdo_peekvalue(vm, 0)));
+                        VM_DISPATCH();
                     }
                     bl_vmdo_pushvalue(vm, INTEGER_VAL(~((int)AS_NUMBER(bl_vmdo_popvalue(vm)))));
                 }
-                break;
-            case OP_BITAND:
+                VM_DISPATCH();
+            VM_CASE(OP_BITAND)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_BITAND, NULL);
                 }
-                break;
-            case OP_BITOR:
+                VM_DISPATCH();
+            VM_CASE(OP_BITOR)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_BITOR, NULL);
                 }
-                break;
-            case OP_BITXOR:
+                VM_DISPATCH();
+            VM_CASE(OP_BITXOR)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_BITXOR, NULL);
                 }
-                break;
-            case OP_LEFTSHIFT:
+                VM_DISPATCH();
+            VM_CASE(OP_LEFTSHIFT)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_LEFTSHIFT, NULL);
                 }
-                break;
-            case OP_RIGHTSHIFT:
+                VM_DISPATCH();
+            VM_CASE(OP_RIGHTSHIFT)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, false, OP_RIGHTSHIFT, NULL);
                 }
-                break;
-            case OP_ONE:
+                VM_DISPATCH();
+            VM_CASE(OP_ONE)
                 {
                     bl_vmdo_pushvalue(vm, NUMBER_VAL(1));
                 }
-                break;
+                VM_DISPATCH();
                 // comparisons
-            case OP_EQUAL:
+            VM_CASE(OP_EQUAL)
+                {
+                    vm_mac_tryquicken(OP_EQUAL_NUM);
+                }
+                VM_FALLTHROUGH();
+            VM_CASE(OP_EQUAL_ANY)
                 {
                     Value b = bl_vmdo_popvalue(vm);
                     Value a = bl_vmdo_popvalue(vm);
                     bl_vmdo_pushvalue(vm, BOOL_VAL(bl_value_valuesequal(a, b)));
                 }
-                break;
-            case OP_GREATERTHAN:
+                VM_DISPATCH();
+            VM_CASE(OP_GREATERTHAN)
+                {
+                    vm_mac_tryquicken(OP_GREATERTHAN_NUM);
+                }
+                VM_FALLTHROUGH();
+            VM_CASE(OP_GREATERTHAN_ANY)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, true, OP_GREATERTHAN, NULL);
                 }
-                break;
-            case OP_LESSTHAN:
+                VM_DISPATCH();
+            VM_CASE(OP_LESSTHAN)
+                {
+                    vm_mac_tryquicken(OP_LESSTHAN_NUM);
+                }
+                VM_FALLTHROUGH();
+            VM_CASE(OP_LESSTHAN_ANY)
                 {
                     vm_mac_execfuncargs(bl_vmdo_binaryop, true, OP_LESSTHAN, NULL);
                 }
-                break;
-            case OP_NOT:
+                VM_DISPATCH();
+            VM_CASE(OP_NOT)
                 {
                     bl_vmdo_pushvalue(vm, BOOL_VAL(bl_value_isfalse(bl_vmdo_popvalue(vm))));
                 }
-                break;
-            case OP_NIL:
+                VM_DISPATCH();
+            VM_CASE(OP_NIL)
                 {
                     bl_vmdo_pushvalue(vm, NIL_VAL);
                 }
-                break;
-            case OP_EMPTY:
+                VM_DISPATCH();
+            VM_CASE(OP_EMPTY)
                 {
                     bl_vmdo_pushvalue(vm, EMPTY_VAL);
                 }
-                break;
-            case OP_TRUE:
+                VM_DISPATCH();
+            VM_CASE(OP_TRUE)
                 {
                     bl_vmdo_pushvalue(vm, BOOL_VAL(true));
                 }
-                break;
-            case OP_FALSE:
+                VM_DISPATCH();
+            VM_CASE(OP_FALSE)
                 {
                     bl_vmdo_pushvalue(vm, BOOL_VAL(false));
                 }
-                break;
-            case OP_JUMP:
+                VM_DISPATCH();
+            VM_CASE(OP_JUMP)
                 {
                     uint16_t offset = READ_SHORT(frame);
                     frame->ip += offset;
                 }
-                break;
-            case OP_JUMP_IF_FALSE:
+                VM_DISPATCH();
+            VM_CASE(OP_JUMP_IF_FALSE)
                 {
                     uint16_t offset = READ_SHORT(frame);
                     if(bl_value_isfalse(bl_vmdo_peekvalue(vm, 0)))
@@ -1876,14 +2619,14 @@ PtrResult bl_vm_run(VMState* vm)
                         frame->ip += offset;
                     }
                 }
-                break;
-            case OP_LOOP:
+                VM_DISPATCH();
+            VM_CASE(OP_LOOP)
                 {
                     uint16_t offset = READ_SHORT(frame);
                     frame->ip -= offset;
                 }
-                break;
-            case OP_ECHO:
+                VM_DISPATCH();
+            VM_CASE(OP_ECHO)
                 {
                     Value val = bl_vmdo_peekvalue(vm, 0);
                     if(vm->isrepl)
@@ -1900,124 +2643,161 @@ PtrResult bl_vm_run(VMState* vm)
                     }
                     bl_vmdo_popvalue(vm);
                 }
-                break;
-            case OP_STRINGIFY:
+                VM_DISPATCH();
+            VM_CASE(OP_STRINGIFY)
                 {
                     if(!bl_value_isstring(bl_vmdo_peekvalue(vm, 0)) && !bl_value_isnil(bl_vmdo_peekvalue(vm, 0)))
                     {
-                        char* value = bl_value_tostring(vm, bl_vmdo_popvalue(vm));
-                        if((int)strlen(value) != 0)
+                        StringBuilder sb;
+                        bl_builder_init(&sb);
+                        bl_builder_appendvalue(vm, &sb, bl_vmdo_popvalue(vm));
+                        if(sb.length != 0)
                         {
-                            bl_vmdo_pushvalue(vm, STRING_TT_VAL(value));
+                            bl_vmdo_pushvalue(vm, OBJ_VAL(bl_builder_take(vm, &sb)));
                         }
                         else
                         {
+                            bl_builder_free(&sb);
                             bl_vmdo_pushvalue(vm, NIL_VAL);
                         }
                     }
                 }
-                break;
-            case OP_DUP:
+                VM_DISPATCH();
+            VM_CASE(OP_DUP)
                 {
                     bl_vmdo_pushvalue(vm, bl_vmdo_peekvalue(vm, 0));
                 }
-                break;
-            case OP_POP:
+                VM_DISPATCH();
+            VM_CASE(OP_POP)
                 {
                     bl_vmdo_popvalue(vm);
                 }
-                break;
-            case OP_POP_N:
+                VM_DISPATCH();
+            VM_CASE(OP_POP_N)
                 {
                     bl_vmdo_popvaluen(vm, READ_SHORT(frame));
                 }
-                break;
-            case OP_CLOSE_UP_VALUE:
+                VM_DISPATCH();
+            VM_CASE(OP_CLOSE_UP_VALUE)
                 {
                     bl_vm_closeupvalues(vm, vm->stacktop - 1);
                     bl_vmdo_popvalue(vm);
                 }
-                break;
-            case OP_DEFINE_GLOBAL:
+                VM_DISPATCH();
+            VM_CASE(OP_DEFINE_GLOBAL)
                 {
                     ObjString* name = READ_STRING(frame);
+                    GlobalCache* cache = READ_GLOBAL_CACHE(frame);
+                    HashTable* table = &frame->closure->fnptr->module->values;
                     if(bl_value_isempty(bl_vmdo_peekvalue(vm, 0)))
                     {
-                        runtime_error("empty cannot be assigned");
-                        break;
+                        vm_mac_runtimeerror("empty cannot be assigned");
+                        VM_DISPATCH();
+                    }
+                    HashEntry* entry = bl_vmutil_globalcacheget(vm, cache, table, name);
+                    if(entry != NULL && !cache->inglobals)
+                    {
+                        entry->value = bl_vmdo_peekvalue(vm, 0);
+                    }
+                    else
+                    {
+                        if(bl_hashtable_set(vm, table, OBJ_VAL(name), bl_vmdo_peekvalue(vm, 0)))
+                        {
+                            vm->globalsepoch++;
+                        }
+                        bl_vmutil_globalcacheput(vm, cache, table, name);
                     }
-                    bl_hashtable_set(vm, &frame->closure->fnptr->module->values, OBJ_VAL(name), bl_vmdo_peekvalue(vm, 0));
+                    bl_mem_writebarrier(vm, (Object*)frame->closure->fnptr->module);
                     bl_vmdo_popvalue(vm);
                     #if defined(DEBUG_TABLE) && DEBUG_TABLE
                         bl_hashtable_print(&vm->globals);
                     #endif
                 }
-                break;
-            case OP_GET_GLOBAL:
+                VM_DISPATCH();
+            VM_CASE(OP_GET_GLOBAL)
                 {
                     ObjString* name = READ_STRING(frame);
-                    Value value;
-                    if(!bl_hashtable_get(&frame->closure->fnptr->module->values, OBJ_VAL(name), &value))
+                    GlobalCache* cache = READ_GLOBAL_CACHE(frame);
+                    HashTable* table = &frame->closure->fnptr->module->values;
+                    HashEntry* entry = bl_vmutil_globalcacheget(vm, cache, table, name);
+                    if(entry == NULL)
                     {
-                        if(!bl_hashtable_get(&vm->globals, OBJ_VAL(name), &value))
+                        entry = bl_hashtable_getentry(table, OBJ_VAL(name));
+                        if(entry == NULL)
                         {
-                            runtime_error("'%s' is undefined in this scope", name->chars);
-                            break;
+                            table = &vm->globals;
+                            entry = bl_hashtable_getentry(table, OBJ_VAL(name));
                         }
+                        if(entry == NULL)
+                        {
+                            vm_mac_runtimeerror("'%s' is undefined in this scope", name->chars);
+                            VM_DISPATCH();
+                        }
+                        bl_vmutil_globalcacheput(vm, cache, table, name);
                     }
-                    bl_vmdo_pushvalue(vm, value);
+                    bl_vmdo_pushvalue(vm, entry->value);
                 }
-                break;
-            case OP_SET_GLOBAL:
+                VM_DISPATCH();
+            VM_CASE(OP_SET_GLOBAL)
                 {
                     if(bl_value_isempty(bl_vmdo_peekvalue(vm, 0)))
                     {
-                        runtime_error("empty cannot be assigned");
-                        break;
+                        vm_mac_runtimeerror("empty cannot be assigned");
+                        VM_DISPATCH();
                     }
                     ObjString* name = READ_STRING(frame);
+                    GlobalCache* cache = READ_GLOBAL_CACHE(frame);
                     HashTable* table = &frame->closure->fnptr->module->values;
+                    HashEntry* entry = bl_vmutil_globalcacheget(vm, cache, table, name);
+                    if(entry != NULL && !cache->inglobals)
+                    {
+                        entry->value = bl_vmdo_peekvalue(vm, 0);
+                        bl_mem_writebarrier(vm, (Object*)frame->closure->fnptr->module);
+                        VM_DISPATCH();
+                    }
                     if(bl_hashtable_set(vm, table, OBJ_VAL(name), bl_vmdo_peekvalue(vm, 0)))
                     {
                         bl_hashtable_delete(table, OBJ_VAL(name));
-                        runtime_error("%s is undefined in this scope", name->chars);
-                        break;
+                        vm_mac_runtimeerror("%s is undefined in this scope", name->chars);
+                        VM_DISPATCH();
                     }
+                    bl_mem_writebarrier(vm, (Object*)frame->closure->fnptr->module);
+                    bl_vmutil_globalcacheput(vm, cache, table, name);
                 }
-                break;
-            case OP_GET_LOCAL:
+                VM_DISPATCH();
+            VM_CASE(OP_GET_LOCAL)
                 {
                     uint16_t slot = READ_SHORT(frame);
                     bl_vmdo_pushvalue(vm, frame->slots[slot]);
                 }
-                break;
-            case OP_SET_LOCAL:
+                VM_DISPATCH();
+            VM_CASE(OP_SET_LOCAL)
                 {
                     uint16_t slot = READ_SHORT(frame);
                     if(bl_value_isempty(bl_vmdo_peekvalue(vm, 0)))
                     {
-                        runtime_error("empty cannot be assigned");
-                        break;
+                        vm_mac_runtimeerror("empty cannot be assigned");
+                        VM_DISPATCH();
                     }
                     frame->slots[slot] = bl_vmdo_peekvalue(vm, 0);
                 }
-                break;
-            case OP_GET_PROPERTY:
+                VM_DISPATCH();
+            VM_CASE(OP_GET_PROPERTY)
                 {
                     vm_mac_execfunc(bl_vmdo_rungetproperty);
                 }
-                break;
-            case OP_GET_SELF_PROPERTY:
+                VM_DISPATCH();
+            VM_CASE(OP_GET_SELF_PROPERTY)
                 {
                     vm_mac_execfunc(bl_vmdo_rungetselfproperty);
                 }
-                break;
-            case OP_SET_PROPERTY:
+                VM_DISPATCH();
+            VM_CASE(OP_SET_PROPERTY)
                 {
                     vm_mac_execfunc(bl_vmdo_runsetproperty);
                 }
-                break;
-            case OP_CLOSURE:
+                VM_DISPATCH();
+            VM_CASE(OP_CLOSURE)
                 {
                     ObjFunction* function = AS_FUNCTION(READ_CONSTANT(frame));
                     ObjClosure* closure = bl_object_makeclosure(vm, function);
@@ -2035,27 +2815,29 @@ PtrResult bl_vm_run(VMState* vm)
                             closure->upvalues[i] = ((ObjClosure*)frame->closure)->upvalues[index];
                         }
                     }
+                    bl_mem_writebarrier(vm, (Object*)closure);
                 }
-                break;
+                VM_DISPATCH();
 
-            case OP_GET_UP_VALUE:
+            VM_CASE(OP_GET_UP_VALUE)
                 {
                     int index = READ_SHORT(frame);
                     bl_vmdo_pushvalue(vm, *((ObjClosure*)frame->closure)->upvalues[index]->location);
                 }
-                break;
-            case OP_SET_UP_VALUE:
+                VM_DISPATCH();
+            VM_CASE(OP_SET_UP_VALUE)
                 {
                     int index = READ_SHORT(frame);
                     if(bl_value_isempty(bl_vmdo_peekvalue(vm, 0)))
                     {
-                        runtime_error("empty cannot be assigned");
-                        break;
+                        vm_mac_runtimeerror("empty cannot be assigned");
+                        VM_DISPATCH();
                     }
                     *((ObjClosure*)frame->closure)->upvalues[index]->location = bl_vmdo_peekvalue(vm, 0);
+                    bl_mem_writebarrier(vm, (Object*)((ObjClosure*)frame->closure)->upvalues[index]);
                 }
-                break;
-            case OP_CALL:
+                VM_DISPATCH();
+            VM_CASE(OP_CALL)
                 {
                     int argcount = READ_BYTE(frame);
                     if(!bl_vm_callvalue(vm, bl_vmdo_peekvalue(vm, argcount), argcount))
@@ -2064,74 +2846,78 @@ PtrResult bl_vm_run(VMState* vm)
                     }
                     frame = &vm->frames[vm->framecount - 1];
                 }
-                break;
-            case OP_INVOKE:
+                VM_DISPATCH();
+            VM_CASE(OP_INVOKE)
                 {
                     ObjString* method = READ_STRING(frame);
                     int argcount = READ_BYTE(frame);
-                    if(!bl_vm_invokemethod(vm, method, argcount))
+                    InlineCache* cache = READ_CACHE(frame);
+                    if(!bl_vm_invokemethod(vm, method, argcount, cache))
                     {
                         EXIT_VM();
                     }
                     frame = &vm->frames[vm->framecount - 1];
                 }
-                break;
-            case OP_INVOKE_SELF:
+                VM_DISPATCH();
+            VM_CASE(OP_INVOKE_SELF)
                 {
                     ObjString* method = READ_STRING(frame);
                     int argcount = READ_BYTE(frame);
-                    if(!bl_instance_invokefromself(vm, method, argcount))
+                    InlineCache* cache = READ_CACHE(frame);
+                    if(!bl_instance_invokefromself(vm, method, argcount, cache))
                     {
                         EXIT_VM();
                     }
                     frame = &vm->frames[vm->framecount - 1];
                 }
-                break;
-            case OP_CLASS:
+                VM_DISPATCH();
+            VM_CASE(OP_CLASS)
                 {
                     ObjString* name = READ_STRING(frame);
                     bl_vmdo_pushvalue(vm, OBJ_VAL(bl_object_makeclass(vm, name, NULL)));
                 }
-                break;
-            case OP_METHOD:
+                VM_DISPATCH();
+            VM_CASE(OP_METHOD)
                 {
                     ObjString* name = READ_STRING(frame);
                     bl_vm_classdefmethod(vm, name);
                 }
-                break;
-            case OP_CLASS_PROPERTY:
+                VM_DISPATCH();
+            VM_CASE(OP_CLASS_PROPERTY)
                 {
                     ObjString* name = READ_STRING(frame);
                     int isstatic = READ_BYTE(frame);
                     bl_vm_classdefproperty(vm, name, isstatic == 1);
                 }
-                break;
-            case OP_INHERIT:
+                VM_DISPATCH();
+            VM_CASE(OP_INHERIT)
                 {
                     if(!bl_value_isclass(bl_vmdo_peekvalue(vm, 1)))
                     {
-                        runtime_error("cannot inherit from non-class object");
-                        break;
+                        vm_mac_runtimeerror("cannot inherit from non-class object");
+                        VM_DISPATCH();
                     }
                     ObjClass* superclass = AS_CLASS(bl_vmdo_peekvalue(vm, 1));
                     ObjClass* subclass = AS_CLASS(bl_vmdo_peekvalue(vm, 0));
                     bl_hashtable_addall(vm, &superclass->properties, &subclass->properties);
                     bl_hashtable_addall(vm, &superclass->methods, &subclass->methods);
                     subclass->superclass = superclass;
+                    bl_mem_writebarrier(vm, (Object*)subclass);
+                    subclass->version++;
                     bl_vmdo_popvalue(vm);
                 }
-                break;
-            case OP_GET_SUPER:
+                VM_DISPATCH();
+            VM_CASE(OP_GET_SUPER)
                 {
                     ObjString* name = READ_STRING(frame);
                     ObjClass* klass = AS_CLASS(bl_vmdo_peekvalue(vm, 0));
-                    if(!bl_vmdo_classbindmethod(vm, klass->superclass, name))
+                    if(!bl_vmdo_classbindmethod(vm, klass->superclass, name, NULL, NULL))
                     {
-                        runtime_error("class %s does not define a function %s", klass->name->chars, name->chars);
+                        vm_mac_runtimeerror("class %s does not define a function %s", klass->name->chars, name->chars);
                     }
                 }
-                break;
-            case OP_SUPER_INVOKE:
+                VM_DISPATCH();
+            VM_CASE(OP_SUPER_INVOKE)
                 {
                     ObjString* method = READ_STRING(frame);
                     int argcount = READ_BYTE(frame);
@@ -2142,8 +2928,8 @@ PtrResult bl_vm_run(VMState* vm)
                     }
                     frame = &vm->frames[vm->framecount - 1];
                 }
-                break;
-            case OP_SUPER_INVOKE_SELF:
+                VM_DISPATCH();
+            VM_CASE(OP_SUPER_INVOKE_SELF)
                 {
                     int argcount = READ_BYTE(frame);
                     ObjClass* klass = AS_CLASS(bl_vmdo_popvalue(vm));
@@ -2153,9 +2939,9 @@ PtrResult bl_vm_run(VMState* vm)
                     }
                     frame = &vm->frames[vm->framecount - 1];
                 }
-                break;
+                VM_DISPATCH();
 
-            case OP_LIST:
+            VM_CASE(OP_LIST)
                 {
                     int count = READ_SHORT(frame);
                     ObjArray* list = bl_object_makelist(vm);
@@ -2166,23 +2952,23 @@ PtrResult bl_vm_run(VMState* vm)
                     }
                     bl_vmdo_popvaluen(vm, count);
                 }
-                break;
-            case OP_RANGE:
+                VM_DISPATCH();
+            VM_CASE(OP_RANGE)
                 {
                     Value _upper = bl_vmdo_peekvalue(vm, 0);
                     Value _lower = bl_vmdo_peekvalue(vm, 1);
                     if(!bl_value_isnumber(_upper) || !bl_value_isnumber(_lower))
                     {
-                        runtime_error("invalid range boundaries");
-                        break;
+                        vm_mac_runtimeerror("invalid range boundaries");
+                        VM_DISPATCH();
                     }
                     double lower = AS_NUMBER(_lower);
                     double upper = AS_NUMBER(_upper);
                     bl_vmdo_popvaluen(vm, 2);
                     bl_vmdo_pushvalue(vm, OBJ_VAL(bl_object_makerange(vm, lower, upper)));
                 }
-                break;
-            case OP_DICT:
+                VM_DISPATCH();
+            VM_CASE(OP_DICT)
                 {
                     int count = READ_SHORT(frame) * 2;// 1 for key, 1 for value
                     ObjDict* dict = bl_object_makedict(vm);
@@ -2192,15 +2978,15 @@ PtrResult bl_vm_run(VMState* vm)
                         Value name = vm->stacktop[-count + i];
                         if(!bl_value_isstring(name) && !bl_value_isnumber(name) && !bl_value_isbool(name))
                         {
-                            runtime_error("dictionary key must be one of string, number or boolean");
+                            vm_mac_runtimeerror("dictionary key must be one of string, number or boolean");
                         }
                         Value value = vm->stacktop[-count + i + 1];
                         bl_dict_addentry(vm, dict, name, value);
                     }
                     bl_vmdo_popvaluen(vm, count);
                 }
-                break;
-            case OP_GET_RANGED_INDEX:
+                VM_DISPATCH();
+            VM_CASE(OP_GET_RANGED_INDEX)
                 {
                     uint8_t willassign = READ_BYTE(frame);
                     bool isgotten = true;
@@ -2245,12 +3031,12 @@ PtrResult bl_vm_run(VMState* vm)
                     }
                     if(!isgotten)
                     {
-                        runtime_error("cannot range index object of type %s", bl_value_typename(bl_vmdo_peekvalue(vm, 2)));
+                        vm_mac_runtimeerror("cannot range index object of type %s", bl_value_typename(bl_vmdo_peekvalue(vm, 2)));
                     }
                 }
-                break;
+                VM_DISPATCH();
 
-            case OP_GET_INDEX:
+            VM_CASE(OP_GET_INDEX)
             {
                 uint8_t willassign = READ_BYTE(frame);
                 bool isgotten = true;
@@ -2311,11 +3097,11 @@ PtrResult bl_vm_run(VMState* vm)
                 }
                 if(!isgotten)
                 {
-                    runtime_error("cannot index object of type %s", bl_value_typename(bl_vmdo_peekvalue(vm, 1)));
+                    vm_mac_runtimeerror("cannot index object of type %s", bl_value_typename(bl_vmdo_peekvalue(vm, 1)));
                 }
-                break;
+                VM_DISPATCH();
             }
-            case OP_SET_INDEX:
+            VM_CASE(OP_SET_INDEX)
             {
                 bool isset = true;
                 if(bl_value_isobject(bl_vmdo_peekvalue(vm, 2)))
@@ -2324,8 +3110,8 @@ PtrResult bl_vm_run(VMState* vm)
                     Value index = bl_vmdo_peekvalue(vm, 1);
                     if(bl_value_isempty(value))
                     {
-                        runtime_error("empty cannot be assigned");
-                        break;
+                        vm_mac_runtimeerror("empty cannot be assigned");
+                        VM_DISPATCH();
                     }
                     switch(AS_OBJ(bl_vmdo_peekvalue(vm, 2))->type)
                     {
@@ -2339,7 +3125,7 @@ PtrResult bl_vm_run(VMState* vm)
                         }
                         case OBJ_STRING:
                         {
-                            runtime_error("strings do not support object assignment");
+                            vm_mac_runtimeerror("strings do not support object assignment");
                             break;
                         }
                         case OBJ_DICT:
@@ -2373,11 +3159,11 @@ PtrResult bl_vm_run(VMState* vm)
                 }
                 if(!isset)
                 {
-                    runtime_error("type of %s is not a valid iterable", bl_value_typename(bl_vmdo_peekvalue(vm, 3)));
+                    vm_mac_runtimeerror("type of %s is not a valid iterable", bl_value_typename(bl_vmdo_peekvalue(vm, 3)));
                 }
-                break;
+                VM_DISPATCH();
             }
-            case OP_RETURN:
+            VM_CASE(OP_RETURN)
             {
                 Value result = bl_vmdo_popvalue(vm);
                 bl_vm_closeupvalues(vm, frame->slots);
@@ -2390,17 +3176,17 @@ PtrResult bl_vm_run(VMState* vm)
                 vm->stacktop = frame->slots;
                 bl_vmdo_pushvalue(vm, result);
                 frame = &vm->frames[vm->framecount - 1];
-                break;
+                VM_DISPATCH();
             }
-            case OP_CALL_IMPORT:
+            VM_CASE(OP_CALL_IMPORT)
             {
                 ObjClosure* closure = AS_CLOSURE(READ_CONSTANT(frame));
                 bl_state_addmodule(vm, closure->fnptr->module);
                 bl_vmdo_docall(vm, closure, 0);
                 frame = &vm->frames[vm->framecount - 1];
-                break;
+                VM_DISPATCH();
             }
-            case OP_NATIVE_MODULE:
+            VM_CASE(OP_NATIVE_MODULE)
             {
                 ObjString* modulename = READ_STRING(frame);
                 Value value;
@@ -2413,12 +3199,14 @@ PtrResult bl_vm_run(VMState* vm)
                     }
                     module->imported = true;
                     bl_hashtable_set(vm, &frame->closure->fnptr->module->values, OBJ_VAL(modulename), value);
-                    break;
+                    bl_mem_writebarrier(vm, (Object*)frame->closure->fnptr->module);
+                    vm->globalsepoch++;
+                    VM_DISPATCH();
                 }
-                runtime_error("module '%s' not found", modulename->chars);
-                break;
+                vm_mac_runtimeerror("module '%s' not found", modulename->chars);
+                VM_DISPATCH();
             }
-            case OP_SELECT_IMPORT:
+            VM_CASE(OP_SELECT_IMPORT)
             {
                 ObjString* entryname = READ_STRING(frame);
                 ObjFunction* function = AS_CLOSURE(bl_vmdo_peekvalue(vm, 0))->fnptr;
@@ -2426,14 +3214,16 @@ PtrResult bl_vm_run(VMState* vm)
                 if(bl_hashtable_get(&function->module->values, OBJ_VAL(entryname), &value))
                 {
                     bl_hashtable_set(vm, &frame->closure->fnptr->module->values, OBJ_VAL(entryname), value);
+                    bl_mem_writebarrier(vm, (Object*)frame->closure->fnptr->module);
+                    vm->globalsepoch++;
                 }
                 else
                 {
-                    runtime_error("module %s does not define '%s'", function->module->name, entryname->chars);
+                    vm_mac_runtimeerror("module %s does not define '%s'", function->module->name, entryname->chars);
                 }
-                break;
+                VM_DISPATCH();
             }
-            case OP_SELECT_NATIVE_IMPORT:
+            VM_CASE(OP_SELECT_NATIVE_IMPORT)
             {
                 ObjString* modulename = AS_STRING(bl_vmdo_peekvalue(vm, 0));
                 ObjString* valuename = READ_STRING(frame);
@@ -2445,85 +3235,99 @@ PtrResult bl_vm_run(VMState* vm)
                     if(bl_hashtable_get(&module->values, OBJ_VAL(valuename), &value))
                     {
                         bl_hashtable_set(vm, &frame->closure->fnptr->module->values, OBJ_VAL(valuename), value);
+                        bl_mem_writebarrier(vm, (Object*)frame->closure->fnptr->module);
+                        vm->globalsepoch++;
                     }
                     else
                     {
-                        runtime_error("module %s does not define '%s'", module->name, valuename->chars);
+                        vm_mac_runtimeerror("module %s does not define '%s'", module->name, valuename->chars);
                     }
                 }
                 else
                 {
-                    runtime_error("module '%s' not found", modulename->chars);
+                    vm_mac_runtimeerror("module '%s' not found", modulename->chars);
                 }
-                break;
+                VM_DISPATCH();
             }
-            case OP_IMPORT_ALL:
+            VM_CASE(OP_IMPORT_ALL)
             {
                 bl_hashtable_addall(vm, &AS_CLOSURE(bl_vmdo_peekvalue(vm, 0))->fnptr->module->values, &frame->closure->fnptr->module->values);
-                break;
+                bl_mem_writebarrier(vm, (Object*)frame->closure->fnptr->module);
+                vm->globalsepoch++;
+                VM_DISPATCH();
             }
-            case OP_IMPORT_ALL_NATIVE:
+            VM_CASE(OP_IMPORT_ALL_NATIVE)
             {
                 ObjString* name = AS_STRING(bl_vmdo_peekvalue(vm, 0));
                 Value mod;
                 if(bl_hashtable_get(&vm->modules, OBJ_VAL(name), &mod))
                 {
                     bl_hashtable_addall(vm, &AS_MODULE(mod)->values, &frame->closure->fnptr->module->values);
+                    bl_mem_writebarrier(vm, (Object*)frame->closure->fnptr->module);
+                    vm->globalsepoch++;
                 }
-                break;
+                VM_DISPATCH();
             }
-            case OP_EJECT_IMPORT:
+            VM_CASE(OP_EJECT_IMPORT)
             {
                 ObjFunction* function = AS_CLOSURE(READ_CONSTANT(frame))->fnptr;
                 bl_hashtable_delete(&frame->closure->fnptr->module->values, STRING_VAL(function->module->name));
-                break;
+                VM_DISPATCH();
             }
-            case OP_EJECT_NATIVE_IMPORT:
+            VM_CASE(OP_EJECT_NATIVE_IMPORT)
             {
                 Value mod;
                 ObjString* name = READ_STRING(frame);
                 if(bl_hashtable_get(&vm->modules, OBJ_VAL(name), &mod))
                 {
                     bl_hashtable_addall(vm, &AS_MODULE(mod)->values, &frame->closure->fnptr->module->values);
+                    bl_mem_writebarrier(vm, (Object*)frame->closure->fnptr->module);
                     bl_hashtable_delete(&frame->closure->fnptr->module->values, OBJ_VAL(name));
+                    vm->globalsepoch++;
                 }
-                break;
+                VM_DISPATCH();
             }
-            case OP_ASSERT:
+            VM_CASE(OP_ASSERT)
             {
                 Value message = bl_vmdo_popvalue(vm);
                 Value expression = bl_vmdo_popvalue(vm);
                 if(bl_value_isfalse(expression))
                 {
+                    bool handled;
                     if(!bl_value_isnil(message))
                     {
-                        bl_vm_throwexception(vm, true, bl_value_tostring(vm, message));
+                        handled = bl_vm_throwexception(vm, true, bl_value_tostring(vm, message));
                     }
                     else
                     {
-                        bl_vm_throwexception(vm, true, "");
+                        handled = bl_vm_throwexception(vm, true, "");
                     }
+                    if(!handled)
+                    {
+                        EXIT_VM();
+                    }
+                    frame = &vm->frames[vm->framecount - 1];
                 }
-                break;
+                VM_DISPATCH();
             }
-            case OP_DIE:
+            VM_CASE(OP_DIE)
             {
                 if(!bl_value_isinstance(bl_vmdo_peekvalue(vm, 0)) || !bl_class_isinstanceof(AS_INSTANCE(bl_vmdo_peekvalue(vm, 0))->klass, vm->exceptionclass->name->chars))
                 {
-                    runtime_error("instance of Exception expected");
-                    break;
+                    vm_mac_runtimeerror("instance of Exception expected");
+                    VM_DISPATCH();
                 }
                 Value stacktrace = bl_vm_getstacktrace(vm);
                 ObjInstance* instance = AS_INSTANCE(bl_vmdo_peekvalue(vm, 0));
-                bl_hashtable_set(vm, &instance->properties, STRING_L_VAL("stacktrace", 10), stacktrace);
+                bl_instance_setfield(vm, instance, bl_string_copystringlen(vm, "stacktrace", 10), stacktrace);
                 if(bl_vm_propagateexception(vm, false))
                 {
                     frame = &vm->frames[vm->framecount - 1];
-                    break;
+                    VM_DISPATCH();
                 }
                 EXIT_VM();
             }
-            case OP_TRY:
+            VM_CASE(OP_TRY)
             {
                 ObjString* type = READ_STRING(frame);
                 uint16_t address = READ_SHORT(frame);
@@ -2533,8 +3337,8 @@ PtrResult bl_vm_run(VMState* vm)
                     Value value;
                     if(!bl_hashtable_get(&vm->globals, OBJ_VAL(type), &value) || !bl_value_isclass(value))
                     {
-                        runtime_error("object of type '%s' is not an exception", type->chars);
-                        break;
+                        vm_mac_runtimeerror("object of type '%s' is not an exception", type->chars);
+                        VM_DISPATCH();
                     }
                     bl_vm_pushexceptionhandler(vm, AS_CLASS(value), address, finallyaddress);
                 }
@@ -2542,24 +3346,24 @@ PtrResult bl_vm_run(VMState* vm)
                 {
                     bl_vm_pushexceptionhandler(vm, NULL, address, finallyaddress);
                 }
-                break;
+                VM_DISPATCH();
             }
-            case OP_POP_TRY:
+            VM_CASE(OP_POP_TRY)
             {
                 frame->handlerscount--;
-                break;
+                VM_DISPATCH();
             }
-            case OP_PUBLISH_TRY:
+            VM_CASE(OP_PUBLISH_TRY)
             {
                 frame->handlerscount--;
                 if(bl_vm_propagateexception(vm, false))
                 {
                     frame = &vm->frames[vm->framecount - 1];
-                    break;
+                    VM_DISPATCH();
                 }
                 EXIT_VM();
             }
-            case OP_SWITCH:
+            VM_CASE(OP_SWITCH)
             {
                 ObjSwitch* sw = AS_SWITCH(READ_CONSTANT(frame));
                 Value expr = bl_vmdo_peekvalue(vm, 0);
@@ -2577,9 +3381,101 @@ PtrResult bl_vm_run(VMState* vm)
                     frame->ip += sw->exitjump;
                 }
                 bl_vmdo_popvalue(vm);
-                break;
+                VM_DISPATCH();
+            }
+            VM_CASE(OP_ADD_NUM)
+            {
+                vm_mac_numbinaryop(OP_ADD_ANY, NUMBER_VAL, +);
+            }
+            VM_CASE(OP_SUBTRACT_NUM)
+            {
+                vm_mac_numbinaryop(OP_SUBTRACT_ANY, NUMBER_VAL, -);
+            }
+            VM_CASE(OP_MULTIPLY_NUM)
+            {
+                vm_mac_numbinaryop(OP_MULTIPLY_ANY, NUMBER_VAL, *);
+            }
+            VM_CASE(OP_DIVIDE_NUM)
+            {
+                vm_mac_numbinaryop(OP_DIVIDE_ANY, NUMBER_VAL, /);
+            }
+            VM_CASE(OP_EQUAL_NUM)
+            {
+                vm_mac_numbinaryop(OP_EQUAL_ANY, BOOL_VAL, ==);
+            }
+            VM_CASE(OP_GREATERTHAN_NUM)
+            {
+                vm_mac_numbinaryop(OP_GREATERTHAN_ANY, BOOL_VAL, >);
+            }
+            VM_CASE(OP_LESSTHAN_NUM)
+            {
+                vm_mac_numbinaryop(OP_LESSTHAN_ANY, BOOL_VAL, <);
+            }
+            VM_CASE(OP_GET_LOCAL_0)
+            {
+                bl_vmdo_pushvalue(vm, frame->slots[0]);
+                VM_DISPATCH();
+            }
+            VM_CASE(OP_GET_LOCAL_1)
+            {
+                bl_vmdo_pushvalue(vm, frame->slots[1]);
+                VM_DISPATCH();
             }
-            case OP_CHOICE:
+            VM_CASE(OP_GET_LOCAL_2)
+            {
+                bl_vmdo_pushvalue(vm, frame->slots[2]);
+                VM_DISPATCH();
+            }
+            VM_CASE(OP_GET_LOCAL_3)
+            {
+                bl_vmdo_pushvalue(vm, frame->slots[3]);
+                VM_DISPATCH();
+            }
+            VM_CASE(OP_SET_LOCAL_POP)
+            {
+                uint16_t slot = READ_SHORT(frame);
+                if(bl_value_isempty(bl_vmdo_peekvalue(vm, 0)))
+                {
+                    vm_mac_runtimeerror("empty cannot be assigned");
+                    VM_DISPATCH();
+                }
+                frame->slots[slot] = bl_vmdo_popvalue(vm);
+                VM_DISPATCH();
+            }
+            VM_CASE(OP_CONSTANT_SMALLINT)
+            {
+                bl_vmdo_pushvalue(vm, NUMBER_VAL(READ_BYTE(frame)));
+                VM_DISPATCH();
+            }
+            VM_CASE(OP_POP_JUMP_IF_FALSE)
+            {
+                uint16_t offset = READ_SHORT(frame);
+                if(bl_value_isfalse(bl_vmdo_popvalue(vm)))
+                {
+                    frame->ip += offset;
+                }
+                VM_DISPATCH();
+            }
+            VM_CASE(OP_EQUAL_JUMP)
+            {
+                uint16_t offset = READ_SHORT(frame);
+                Value b = bl_vmdo_popvalue(vm);
+                Value a = bl_vmdo_popvalue(vm);
+                if(!bl_value_valuesequal(a, b))
+                {
+                    frame->ip += offset;
+                }
+                VM_DISPATCH();
+            }
+            VM_CASE(OP_GREATERTHAN_JUMP)
+            {
+                vm_mac_comparejump(OP_GREATERTHAN, >);
+            }
+            VM_CASE(OP_LESSTHAN_JUMP)
+            {
+                vm_mac_comparejump(OP_LESSTHAN, <);
+            }
+            VM_CASE(OP_CHOICE)
             {
                 Value _else = bl_vmdo_peekvalue(vm, 0);
                 Value _then = bl_vmdo_peekvalue(vm, 1);
@@ -2593,10 +3489,13 @@ PtrResult bl_vm_run(VMState* vm)
                 {
                     bl_vmdo_pushvalue(vm, _else);
                 }
-                break;
+                VM_DISPATCH();
             }
             default:
-                break;
+                #if defined(BLADE_COMPUTED_GOTO)
+                    vmlabel_default:
+                #endif
+                VM_DISPATCH();
         }
     }
 }